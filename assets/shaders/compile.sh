@@ -1,4 +1,8 @@
 #!/bin/sh
 glslangValidator -o shader.vert.spv -V shader.vert 
 glslangValidator -o shader.frag.spv -V shader.frag 
+glslangValidator -o shader_instanced.vert.spv -V shader_instanced.vert
+glslangValidator -o shader_uniform.vert.spv -V -DCAMERA_UNIFORM shader.vert
+glslangValidator -o shader_instanced_uniform.vert.spv -V -DCAMERA_UNIFORM shader_instanced.vert
+glslangValidator -o cull.comp.spv -V cull.comp
 
@@ -0,0 +1,11 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// an unsigned value is always >= 0, so this never ends and has to be rejected
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    for (uint i = 10; i >= 0; i--) {
+        outColor = vec4(0.1f);
+    }
+}
@@ -5,8 +5,21 @@ layout(location = 0) in vec3 fragColor;
 
 layout(location = 0) out vec4 outColor;
 
+// specialized per pipeline variant, shows the interpolated vertex colours
+layout(constant_id = 0) const bool DEBUG_VERTEX_COLOR = false;
+// specialized per pipeline variant, shades each face by how squarely it
+// faces the camera, its depth slope on screen standing in for a normal
+layout(constant_id = 1) const bool LIGHTING = false;
+
 void main() {
-    for (float x = 0.01; x < 1; x--) {
+    for (float x = 0.01; x < 1; x++) {
          outColor = vec4(1.0f, x*0.5f, 0.2f, 1.0f);
     }
+    if (DEBUG_VERTEX_COLOR) {
+        outColor = vec4(fragColor, 1.0f);
+    }
+    if (LIGHTING) {
+        vec2 slope = vec2(dFdx(gl_FragCoord.z), dFdy(gl_FragCoord.z)) * 256.0f;
+        outColor.rgb *= inversesqrt(1.0f + dot(slope, slope));
+    }
 }
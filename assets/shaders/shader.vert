@@ -4,9 +4,16 @@
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 
+#ifdef CAMERA_UNIFORM
+// prerecorded frames read the camera from a buffer written every frame
+layout(std140, set = 0, binding = 0) uniform Constants {
+  mat4 mvp;
+} constants;
+#else
 layout(std140, push_constant) uniform Constants {
   mat4 mvp;
 } constants;
+#endif
 
 layout(location = 0) out vec3 fragColor;
 
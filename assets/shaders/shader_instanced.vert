@@ -0,0 +1,31 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+
+// the top three rows of the instance's model matrix
+layout(location = 2) in vec4 inModelRow0;
+layout(location = 3) in vec4 inModelRow1;
+layout(location = 4) in vec4 inModelRow2;
+
+#ifdef CAMERA_UNIFORM
+// prerecorded frames read the camera from a buffer written every frame
+layout(std140, set = 0, binding = 0) uniform Constants {
+  mat4 mvp;
+} constants;
+#else
+layout(std140, push_constant) uniform Constants {
+  mat4 mvp;
+} constants;
+#endif
+
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+    vec4 position = vec4(inPosition, 1.0);
+    vec3 world = vec3(dot(inModelRow0, position), dot(inModelRow1, position),
+                      dot(inModelRow2, position));
+    gl_Position = constants.mvp * vec4(world, 1.0);
+    fragColor = inColor;
+}
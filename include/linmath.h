@@ -2,6 +2,32 @@
 #define LINMATH_H
 
 #include <math.h>
+#include <stddef.h>
+
+/* The matrix kernels below use SSE, AVX2 or NEON when the compiler targets
+ * them, and keep their scalar versions under a _scalar suffix to test and
+ * benchmark against. Define LINMATH_NO_SIMD to use the scalar ones always. */
+#if !defined(LINMATH_NO_SIMD) && (defined(__SSE__) || defined(_M_X64))
+#define LINMATH_SSE
+#include <xmmintrin.h>
+#if defined(__AVX2__)
+#define LINMATH_AVX2
+#include <immintrin.h>
+#endif
+#elif !defined(LINMATH_NO_SIMD) && defined(__ARM_NEON)
+#define LINMATH_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(LINMATH_AVX2)
+#define LINMATH_SIMD_NAME "avx2"
+#elif defined(LINMATH_SSE)
+#define LINMATH_SIMD_NAME "sse"
+#elif defined(LINMATH_NEON)
+#define LINMATH_SIMD_NAME "neon"
+#else
+#define LINMATH_SIMD_NAME "scalar"
+#endif
 
 #define PI 3.14159265359f
 
@@ -160,7 +186,8 @@ static inline void mat4x4_scale_aniso(mat4x4 M, mat4x4 a, float x, float y,
     M[3][i] = a[3][i];
   }
 }
-static inline void mat4x4_mul(mat4x4 M, const mat4x4 a, const mat4x4 b) {
+static inline void mat4x4_mul_scalar(mat4x4 M, const mat4x4 a,
+                                     const mat4x4 b) {
   mat4x4 temp;
   int k, r, c;
   for (c = 0; c < 4; ++c)
@@ -172,7 +199,8 @@ static inline void mat4x4_mul(mat4x4 M, const mat4x4 a, const mat4x4 b) {
     }
   mat4x4_dup(M, temp);
 }
-static inline void mat4x4_mul_vec4(vec4 r, const mat4x4 M, const vec4 v) {
+static inline void mat4x4_mul_vec4_scalar(vec4 r, const mat4x4 M,
+                                          const vec4 v) {
   int i, j;
   for (j = 0; j < 4; ++j) {
     r[j] = 0.0f;
@@ -181,6 +209,183 @@ static inline void mat4x4_mul_vec4(vec4 r, const mat4x4 M, const vec4 v) {
     }
   }
 }
+
+/* Every kernel is a sum of the matrix' columns, each scaled by one
+ * component of the vector, so the columns are loaded once and the
+ * components are broadcast. Results are only stored once everything has
+ * been loaded, so outputs may alias inputs. */
+#if defined(LINMATH_SSE)
+static inline __m128 mat4x4_sse_combine(const __m128 c0, const __m128 c1,
+                                        const __m128 c2, const __m128 c3,
+                                        const __m128 v) {
+  __m128 x = _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0));
+  __m128 y = _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1));
+  __m128 z = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2));
+  __m128 w = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+  return (_mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, x), _mm_mul_ps(c1, y)),
+                     _mm_add_ps(_mm_mul_ps(c2, z), _mm_mul_ps(c3, w))));
+}
+#elif defined(LINMATH_NEON)
+static inline float32x4_t mat4x4_neon_combine(const float32x4_t c0,
+                                              const float32x4_t c1,
+                                              const float32x4_t c2,
+                                              const float32x4_t c3,
+                                              const float *v) {
+  float32x4_t r = vmulq_n_f32(c0, v[0]);
+  r = vmlaq_n_f32(r, c1, v[1]);
+  r = vmlaq_n_f32(r, c2, v[2]);
+  return (vmlaq_n_f32(r, c3, v[3]));
+}
+#endif
+
+static inline void mat4x4_mul(mat4x4 M, const mat4x4 a, const mat4x4 b) {
+#if defined(LINMATH_SSE)
+  __m128 a0 = _mm_loadu_ps(a[0]);
+  __m128 a1 = _mm_loadu_ps(a[1]);
+  __m128 a2 = _mm_loadu_ps(a[2]);
+  __m128 a3 = _mm_loadu_ps(a[3]);
+  __m128 r0 = mat4x4_sse_combine(a0, a1, a2, a3, _mm_loadu_ps(b[0]));
+  __m128 r1 = mat4x4_sse_combine(a0, a1, a2, a3, _mm_loadu_ps(b[1]));
+  __m128 r2 = mat4x4_sse_combine(a0, a1, a2, a3, _mm_loadu_ps(b[2]));
+  __m128 r3 = mat4x4_sse_combine(a0, a1, a2, a3, _mm_loadu_ps(b[3]));
+  _mm_storeu_ps(M[0], r0);
+  _mm_storeu_ps(M[1], r1);
+  _mm_storeu_ps(M[2], r2);
+  _mm_storeu_ps(M[3], r3);
+#elif defined(LINMATH_NEON)
+  float32x4_t a0 = vld1q_f32(a[0]);
+  float32x4_t a1 = vld1q_f32(a[1]);
+  float32x4_t a2 = vld1q_f32(a[2]);
+  float32x4_t a3 = vld1q_f32(a[3]);
+  float32x4_t r0 = mat4x4_neon_combine(a0, a1, a2, a3, b[0]);
+  float32x4_t r1 = mat4x4_neon_combine(a0, a1, a2, a3, b[1]);
+  float32x4_t r2 = mat4x4_neon_combine(a0, a1, a2, a3, b[2]);
+  float32x4_t r3 = mat4x4_neon_combine(a0, a1, a2, a3, b[3]);
+  vst1q_f32(M[0], r0);
+  vst1q_f32(M[1], r1);
+  vst1q_f32(M[2], r2);
+  vst1q_f32(M[3], r3);
+#else
+  mat4x4_mul_scalar(M, a, b);
+#endif
+}
+static inline void mat4x4_mul_vec4(vec4 r, const mat4x4 M, const vec4 v) {
+#if defined(LINMATH_SSE)
+  __m128 result =
+      mat4x4_sse_combine(_mm_loadu_ps(M[0]), _mm_loadu_ps(M[1]),
+                         _mm_loadu_ps(M[2]), _mm_loadu_ps(M[3]),
+                         _mm_loadu_ps(v));
+  _mm_storeu_ps(r, result);
+#elif defined(LINMATH_NEON)
+  float32x4_t result =
+      mat4x4_neon_combine(vld1q_f32(M[0]), vld1q_f32(M[1]), vld1q_f32(M[2]),
+                          vld1q_f32(M[3]), v);
+  vst1q_f32(r, result);
+#else
+  vec4 temp;
+  mat4x4_mul_vec4_scalar(temp, M, v);
+  vec4_dup(r, temp);
+#endif
+}
+
+/* Batch transforms of `count` vectors by one matrix. `r` and `v` must
+ * either not overlap or be the same array. */
+static inline void mat4x4_mul_vec4_batch_scalar(vec4 *r, const mat4x4 M,
+                                                const vec4 *v,
+                                                const size_t count) {
+  size_t n;
+  vec4 temp;
+  for (n = 0; n < count; ++n) {
+    mat4x4_mul_vec4_scalar(temp, M, v[n]);
+    vec4_dup(r[n], temp);
+  }
+}
+static inline void mat4x4_mul_vec4_batch(vec4 *r, const mat4x4 M,
+                                         const vec4 *v, const size_t count) {
+#if defined(LINMATH_SSE)
+  __m128 c0 = _mm_loadu_ps(M[0]);
+  __m128 c1 = _mm_loadu_ps(M[1]);
+  __m128 c2 = _mm_loadu_ps(M[2]);
+  __m128 c3 = _mm_loadu_ps(M[3]);
+  size_t n = 0;
+#if defined(LINMATH_AVX2)
+  /* two vectors at a time, one in each 128 bit lane */
+  __m256 d0 = _mm256_broadcast_ps(&c0);
+  __m256 d1 = _mm256_broadcast_ps(&c1);
+  __m256 d2 = _mm256_broadcast_ps(&c2);
+  __m256 d3 = _mm256_broadcast_ps(&c3);
+  for (; n + 2 <= count; n += 2) {
+    __m256 p = _mm256_loadu_ps(v[n]);
+    __m256 x = _mm256_permute_ps(p, _MM_SHUFFLE(0, 0, 0, 0));
+    __m256 y = _mm256_permute_ps(p, _MM_SHUFFLE(1, 1, 1, 1));
+    __m256 z = _mm256_permute_ps(p, _MM_SHUFFLE(2, 2, 2, 2));
+    __m256 w = _mm256_permute_ps(p, _MM_SHUFFLE(3, 3, 3, 3));
+    __m256 xy = _mm256_add_ps(_mm256_mul_ps(d0, x), _mm256_mul_ps(d1, y));
+    __m256 zw = _mm256_add_ps(_mm256_mul_ps(d2, z), _mm256_mul_ps(d3, w));
+    _mm256_storeu_ps(r[n], _mm256_add_ps(xy, zw));
+  }
+#endif
+  for (; n < count; ++n) {
+    __m128 p = _mm_loadu_ps(v[n]);
+    _mm_storeu_ps(r[n], mat4x4_sse_combine(c0, c1, c2, c3, p));
+  }
+#elif defined(LINMATH_NEON)
+  float32x4_t c0 = vld1q_f32(M[0]);
+  float32x4_t c1 = vld1q_f32(M[1]);
+  float32x4_t c2 = vld1q_f32(M[2]);
+  float32x4_t c3 = vld1q_f32(M[3]);
+  size_t n;
+  for (n = 0; n < count; ++n) {
+    vst1q_f32(r[n], mat4x4_neon_combine(c0, c1, c2, c3, v[n]));
+  }
+#else
+  mat4x4_mul_vec4_batch_scalar(r, M, v, count);
+#endif
+}
+
+/* Transforms `count` points, i.e. vec3s with an implicit w of 1, into vec4s */
+static inline void mat4x4_mul_vec3_batch_scalar(vec4 *r, const mat4x4 M,
+                                                const vec3 *v,
+                                                const size_t count) {
+  size_t n;
+  for (n = 0; n < count; ++n) {
+    vec4 point = {v[n][0], v[n][1], v[n][2], 1.0f};
+    mat4x4_mul_vec4_scalar(r[n], M, point);
+  }
+}
+static inline void mat4x4_mul_vec3_batch(vec4 *r, const mat4x4 M,
+                                         const vec3 *v, const size_t count) {
+#if defined(LINMATH_SSE)
+  __m128 c0 = _mm_loadu_ps(M[0]);
+  __m128 c1 = _mm_loadu_ps(M[1]);
+  __m128 c2 = _mm_loadu_ps(M[2]);
+  __m128 c3 = _mm_loadu_ps(M[3]);
+  size_t n;
+  /* a vec3 is broadcast a component at a time, loading 4 floats could read
+   * past the end of the array */
+  for (n = 0; n < count; ++n) {
+    __m128 x = _mm_set1_ps(v[n][0]);
+    __m128 y = _mm_set1_ps(v[n][1]);
+    __m128 z = _mm_set1_ps(v[n][2]);
+    __m128 xw = _mm_add_ps(_mm_mul_ps(c0, x), c3);
+    __m128 yz = _mm_add_ps(_mm_mul_ps(c1, y), _mm_mul_ps(c2, z));
+    _mm_storeu_ps(r[n], _mm_add_ps(xw, yz));
+  }
+#elif defined(LINMATH_NEON)
+  float32x4_t c0 = vld1q_f32(M[0]);
+  float32x4_t c1 = vld1q_f32(M[1]);
+  float32x4_t c2 = vld1q_f32(M[2]);
+  float32x4_t c3 = vld1q_f32(M[3]);
+  size_t n;
+  for (n = 0; n < count; ++n) {
+    float32x4_t result = vmlaq_n_f32(c3, c0, v[n][0]);
+    result = vmlaq_n_f32(result, c1, v[n][1]);
+    vst1q_f32(r[n], vmlaq_n_f32(result, c2, v[n][2]));
+  }
+#else
+  mat4x4_mul_vec3_batch_scalar(r, M, v, count);
+#endif
+}
 static inline void mat4x4_translate(mat4x4 T, float x, float y, float z) {
   mat4x4_identity(T);
   T[3][0] = x;
@@ -385,7 +590,7 @@ static inline void mat4x4_perspective(mat4x4 m, float y_fov, float aspect,
   m[3][2] = -((2.0f * f * n) / (f - n));
   m[3][3] = 0.0f;
 }
-static inline void mat4x4_look_at(mat4x4 m, const vec3 eye, const vec3 center, const vec3 up) {
+static inline void mat4x4_look_at_scalar(mat4x4 m, const vec3 eye, const vec3 center, const vec3 up) {
   /* Adapted from Android's OpenGL Matrix.java.                        */
   /* See the OpenGL GLUT documentation for gluLookAt for a description */
   /* of the algorithm. We implement it in a straightforward way:       */
@@ -425,6 +630,43 @@ static inline void mat4x4_look_at(mat4x4 m, const vec3 eye, const vec3 center, c
 
   mat4x4_translate_in_place(m, -eye[0], -eye[1], -eye[2]);
 }
+static inline void mat4x4_look_at(mat4x4 m, const vec3 eye, const vec3 center,
+                                  const vec3 up) {
+  vec3 f;
+  vec3_sub(f, center, eye);
+  vec3_norm(f, f);
+
+  vec3 s;
+  vec3_mul_cross(s, f, up);
+  vec3_norm(s, s);
+
+  vec3 t;
+  vec3_mul_cross(t, s, f);
+
+  m[0][0] = s[0];
+  m[0][1] = t[0];
+  m[0][2] = -f[0];
+  m[0][3] = 0.0f;
+
+  m[1][0] = s[1];
+  m[1][1] = t[1];
+  m[1][2] = -f[1];
+  m[1][3] = 0.0f;
+
+  m[2][0] = s[2];
+  m[2][1] = t[2];
+  m[2][2] = -f[2];
+  m[2][3] = 0.0f;
+
+  /* translating by -eye in place is the rotation applied to -eye, done as
+   * one transform instead of a dot product per row */
+  vec4 translation = {-eye[0], -eye[1], -eye[2], 1.0f};
+  m[3][0] = 0.0f;
+  m[3][1] = 0.0f;
+  m[3][2] = 0.0f;
+  m[3][3] = 1.0f;
+  mat4x4_mul_vec4(m[3], (const vec4 *)m, translation);
+}
 
 typedef float quat[4];
 static inline void quat_identity(quat q) {
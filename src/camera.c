@@ -47,8 +47,8 @@ void resizeCamera(Camera *camera, const VkExtent2D dimensions) {
   calculate_projection_matrix(camera->projection, dimensions);
 }
 
-void updateCamera(Camera *camera, GLFWwindow *pWindow) {
-  float movscale = 0.01f;
+void updateCamera(Camera *camera, GLFWwindow *pWindow, const float deltaTime) {
+  float movscale = CAMERA_MOVE_SPEED * deltaTime;
 
   if (glfwGetKey(pWindow, GLFW_KEY_W) == GLFW_PRESS) {
       vec3 delta_pos;
@@ -82,7 +82,7 @@ void updateCamera(Camera *camera, GLFWwindow *pWindow) {
       vec3_add(camera->pos, camera->pos, delta_pos);
   }
 
-  float rotscale = 0.02f;
+  float rotscale = CAMERA_TURN_SPEED * deltaTime;
 
   if (glfwGetKey(pWindow, GLFW_KEY_UP) == GLFW_PRESS) {
     camera->pitch += rotscale;
@@ -105,6 +105,69 @@ void updateCamera(Camera *camera, GLFWwindow *pWindow) {
   camera->basis = new_CameraBasis(camera->pitch, camera->yaw);
 }
 
+CameraClock new_CameraClock(const Camera *camera, const double fixedStep,
+                            const double time) {
+  CameraClock clock;
+  clock.fixedStep = fixedStep;
+  clock.lastTime = time;
+  clock.accumulator = 0.0;
+  clock.previous = *camera;
+  return clock;
+}
+
+void advanceCamera(Camera *camera, CameraClock *pClock, GLFWwindow *pWindow,
+                   const double time) {
+  double frameTime = fmin(time - pClock->lastTime, CAMERA_MAX_FRAME_TIME);
+  pClock->lastTime = time;
+
+  if (pClock->fixedStep <= 0.0) {
+    pClock->previous = *camera;
+    updateCamera(camera, pWindow, (float)frameTime);
+    return;
+  }
+
+  // the same steps are taken no matter how the time is split into frames
+  pClock->accumulator += frameTime;
+  while (pClock->accumulator >= pClock->fixedStep) {
+    pClock->previous = *camera;
+    updateCamera(camera, pWindow, (float)pClock->fixedStep);
+    pClock->accumulator -= pClock->fixedStep;
+  }
+}
+
+void getInterpolatedMvpCamera(mat4x4 mvp, const Camera *camera,
+                              const CameraClock *pClock) {
+  if (pClock->fixedStep <= 0.0) {
+    getMvpCamera(mvp, camera);
+    return;
+  }
+
+  // how far into the next fixed update this frame is
+  float alpha = (float)(pClock->accumulator / pClock->fixedStep);
+  const Camera *previous = &pClock->previous;
+
+  Camera blended = *camera;
+  vec3 delta_pos;
+  vec3_sub(delta_pos, camera->pos, previous->pos);
+  vec3_scale(delta_pos, delta_pos, alpha);
+  vec3_add(blended.pos, previous->pos, delta_pos);
+  blended.pitch = previous->pitch + alpha * (camera->pitch - previous->pitch);
+  blended.yaw = previous->yaw + alpha * (camera->yaw - previous->yaw);
+  blended.basis = new_CameraBasis(blended.pitch, blended.yaw);
+
+  getMvpCamera(mvp, &blended);
+}
+
+void orbitCamera(Camera *camera, const float radius, const float yaw,
+                 const float pitch) {
+  camera->yaw = yaw;
+  camera->pitch = fmaxf(fminf(pitch, RADIANS(89.0f)), RADIANS(-89.0f));
+  camera->basis = new_CameraBasis(camera->pitch, camera->yaw);
+
+  // front points away from where the camera looks, so this faces the origin
+  vec3_scale(camera->pos, camera->basis.front, radius);
+}
+
 void getMvpCamera(mat4x4 mvp, const Camera *camera) {
     // the place we're looking at is in the opposite direction as front
     vec3 look_pos;
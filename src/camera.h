@@ -7,6 +7,13 @@
 
 #include <linmath.h>
 
+// units per second the camera moves, and radians per second it turns
+#define CAMERA_MOVE_SPEED 0.6f
+#define CAMERA_TURN_SPEED 1.2f
+// the most time a single advanceCamera integrates, so that a long stall (a
+// resize, a breakpoint) doesn't fling the camera or run thousands of steps
+#define CAMERA_MAX_FRAME_TIME 0.25
+
 // A set of 3 vectors forming a right handed orthonormal basis for the camera
 typedef struct {
   vec3 front;
@@ -27,10 +34,41 @@ typedef struct {
   mat4x4 projection;
 } Camera;
 
+// Drives a camera's updates from a monotonic clock
+typedef struct {
+  // seconds per fixed update, 0 integrates each frame's whole time at once
+  double fixedStep;
+  // when the camera was last advanced
+  double lastTime;
+  // time not yet integrated by a fixed update
+  double accumulator;
+  // the camera as it was before the latest fixed update, which frames are
+  // interpolated from
+  Camera previous;
+} CameraClock;
+
 Camera new_Camera(const vec3 pos, const VkExtent2D dimensions);
 
 void resizeCamera(Camera *camera, const VkExtent2D dimensions);
-void updateCamera(Camera *camera, GLFWwindow *pWindow);
+// moves the camera by the keys held down, as if held for `deltaTime` seconds
+void updateCamera(Camera *camera, GLFWwindow *pWindow, const float deltaTime);
+
+// starts a clock at `time` (from getTime), with updates `fixedStep` seconds
+// apart or, if 0, once per frame
+CameraClock new_CameraClock(const Camera *camera, const double fixedStep,
+                            const double time);
+// updates the camera for everything that happened between the last call and
+// `time`, in as many fixed updates as fit
+void advanceCamera(Camera *camera, CameraClock *pClock, GLFWwindow *pWindow,
+                   const double time);
+// like getMvpCamera, but blends the last two fixed updates by the time left
+// over, so motion stays smooth when frames and updates don't line up
+void getInterpolatedMvpCamera(mat4x4 mvp, const Camera *camera,
+                              const CameraClock *pClock);
+// places the camera `radius` away from the origin, looking at it, for
+// scripted runs that mustn't depend on input
+void orbitCamera(Camera *camera, const float radius, const float yaw,
+                 const float pitch);
 void getMvpCamera(mat4x4 mvp, const Camera *camera);
 
 #endif // SRC_CAMERA_H_
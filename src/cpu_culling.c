@@ -0,0 +1,293 @@
+#include "cpu_culling.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "camera.h"
+#include "gpu_culling.h"
+#include "utils.h"
+
+// a register's worth of floats, which is also the alignment the arrays get
+#define CPU_CULL_BATCH_BYTES (CPU_CULL_BATCH_SIZE * sizeof(float))
+
+// where benchCpuCulling scatters its spheres, the camera sits in the middle
+#define CPU_CULL_BENCH_EXTENT 100.0f
+#define CPU_CULL_BENCH_MAX_RADIUS 1.0f
+
+static float *new_CullArray(const uint32_t count) {
+  // aligned_alloc wants a multiple of the alignment, which padding gives
+  return (aligned_alloc(CPU_CULL_BATCH_BYTES, count * sizeof(float)));
+}
+
+ErrVal new_CpuCuller(CpuCuller *pCuller, const uint32_t objectCount) {
+  pCuller->objectCount = objectCount;
+  // always at least one batch, so nothing is allocated with size 0
+  pCuller->paddedCount = (objectCount / CPU_CULL_BATCH_SIZE + 1) *
+                         CPU_CULL_BATCH_SIZE;
+  pCuller->pCentersX = new_CullArray(pCuller->paddedCount);
+  pCuller->pCentersY = new_CullArray(pCuller->paddedCount);
+  pCuller->pCentersZ = new_CullArray(pCuller->paddedCount);
+  pCuller->pRadii = new_CullArray(pCuller->paddedCount);
+  pCuller->pVisible = malloc(pCuller->paddedCount * sizeof(uint32_t));
+  pCuller->visibleCount = 0;
+  if (pCuller->pCentersX == NULL || pCuller->pCentersY == NULL ||
+      pCuller->pCentersZ == NULL || pCuller->pRadii == NULL ||
+      pCuller->pVisible == NULL) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "failed to create CPU culler: %s",
+                   strerror(errno));
+    PANIC();
+  }
+
+  // a sphere with an infinitely negative radius is behind every plane, so the
+  // padding can be tested along with the rest and never passes
+  for (uint32_t i = 0; i < pCuller->paddedCount; i++) {
+    pCuller->pCentersX[i] = 0.0f;
+    pCuller->pCentersY[i] = 0.0f;
+    pCuller->pCentersZ[i] = 0.0f;
+    pCuller->pRadii[i] = -INFINITY;
+  }
+  return (ERR_OK);
+}
+
+void delete_CpuCuller(CpuCuller *pCuller) {
+  free(pCuller->pCentersX);
+  free(pCuller->pCentersY);
+  free(pCuller->pCentersZ);
+  free(pCuller->pRadii);
+  free(pCuller->pVisible);
+  pCuller->pCentersX = NULL;
+  pCuller->pCentersY = NULL;
+  pCuller->pCentersZ = NULL;
+  pCuller->pRadii = NULL;
+  pCuller->pVisible = NULL;
+  pCuller->objectCount = 0;
+  pCuller->paddedCount = 0;
+  pCuller->visibleCount = 0;
+}
+
+void setCpuCullerSphere(CpuCuller *pCuller, const uint32_t index,
+                        const vec4 sphere) {
+  pCuller->pCentersX[index] = sphere[0];
+  pCuller->pCentersY[index] = sphere[1];
+  pCuller->pCentersZ[index] = sphere[2];
+  pCuller->pRadii[index] = sphere[3];
+}
+
+void cullCpuCuller_scalar(CpuCuller *pCuller, const mat4x4 mvp) {
+  vec4 pPlanes[6];
+  getFrustumPlanes(pPlanes, mvp);
+
+  uint32_t visibleCount = 0;
+  for (uint32_t i = 0; i < pCuller->objectCount; i++) {
+    uint32_t visible = 1;
+    for (uint32_t p = 0; p < 6; p++) {
+      float distance = pPlanes[p][0] * pCuller->pCentersX[i] +
+                       pPlanes[p][1] * pCuller->pCentersY[i] +
+                       pPlanes[p][2] * pCuller->pCentersZ[i] + pPlanes[p][3];
+      if (distance < -pCuller->pRadii[i]) {
+        visible = 0;
+        break;
+      }
+    }
+    // written either way, only kept if visible
+    pCuller->pVisible[visibleCount] = i;
+    visibleCount += visible;
+  }
+  pCuller->visibleCount = visibleCount;
+}
+
+// appends the objects of a batch whose bit is set in `mask`, without a branch
+// per object, which would mispredict whenever the frustum edge goes through
+// the batch
+static inline uint32_t appendVisibleBatch(uint32_t *pVisible,
+                                          uint32_t visibleCount,
+                                          const uint32_t firstObject,
+                                          const uint32_t mask) {
+  for (uint32_t lane = 0; lane < CPU_CULL_BATCH_SIZE; lane++) {
+    pVisible[visibleCount] = firstObject + lane;
+    visibleCount += (mask >> lane) & 1;
+  }
+  return (visibleCount);
+}
+
+void cullCpuCuller(CpuCuller *pCuller, const mat4x4 mvp) {
+#if defined(LINMATH_SSE) || defined(LINMATH_NEON)
+  vec4 pPlanes[6];
+  getFrustumPlanes(pPlanes, mvp);
+
+  uint32_t visibleCount = 0;
+#if defined(LINMATH_AVX2)
+  __m256 pPlaneX[6], pPlaneY[6], pPlaneZ[6], pPlaneW[6];
+  for (uint32_t p = 0; p < 6; p++) {
+    pPlaneX[p] = _mm256_set1_ps(pPlanes[p][0]);
+    pPlaneY[p] = _mm256_set1_ps(pPlanes[p][1]);
+    pPlaneZ[p] = _mm256_set1_ps(pPlanes[p][2]);
+    pPlaneW[p] = _mm256_set1_ps(pPlanes[p][3]);
+  }
+  for (uint32_t i = 0; i < pCuller->paddedCount; i += CPU_CULL_BATCH_SIZE) {
+    __m256 x = _mm256_load_ps(&pCuller->pCentersX[i]);
+    __m256 y = _mm256_load_ps(&pCuller->pCentersY[i]);
+    __m256 z = _mm256_load_ps(&pCuller->pCentersZ[i]);
+    __m256 radius = _mm256_load_ps(&pCuller->pRadii[i]);
+    // a sphere survives if it is at most its radius behind every plane
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (uint32_t p = 0; p < 6; p++) {
+      __m256 distance = _mm256_add_ps(
+          _mm256_add_ps(_mm256_mul_ps(pPlaneX[p], x),
+                        _mm256_mul_ps(pPlaneY[p], y)),
+          _mm256_add_ps(_mm256_mul_ps(pPlaneZ[p], z),
+                        _mm256_add_ps(pPlaneW[p], radius)));
+      inside = _mm256_and_ps(
+          inside, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_GE_OQ));
+    }
+    uint32_t mask = (uint32_t)_mm256_movemask_ps(inside);
+    visibleCount = appendVisibleBatch(pCuller->pVisible, visibleCount, i, mask);
+  }
+#elif defined(LINMATH_SSE)
+  __m128 pPlaneX[6], pPlaneY[6], pPlaneZ[6], pPlaneW[6];
+  for (uint32_t p = 0; p < 6; p++) {
+    pPlaneX[p] = _mm_set1_ps(pPlanes[p][0]);
+    pPlaneY[p] = _mm_set1_ps(pPlanes[p][1]);
+    pPlaneZ[p] = _mm_set1_ps(pPlanes[p][2]);
+    pPlaneW[p] = _mm_set1_ps(pPlanes[p][3]);
+  }
+  for (uint32_t i = 0; i < pCuller->paddedCount; i += CPU_CULL_BATCH_SIZE) {
+    __m128 x = _mm_load_ps(&pCuller->pCentersX[i]);
+    __m128 y = _mm_load_ps(&pCuller->pCentersY[i]);
+    __m128 z = _mm_load_ps(&pCuller->pCentersZ[i]);
+    __m128 radius = _mm_load_ps(&pCuller->pRadii[i]);
+    // a sphere survives if it is at most its radius behind every plane
+    __m128 inside = _mm_cmpeq_ps(_mm_setzero_ps(), _mm_setzero_ps());
+    for (uint32_t p = 0; p < 6; p++) {
+      __m128 distance =
+          _mm_add_ps(_mm_add_ps(_mm_mul_ps(pPlaneX[p], x),
+                                _mm_mul_ps(pPlaneY[p], y)),
+                     _mm_add_ps(_mm_mul_ps(pPlaneZ[p], z),
+                                _mm_add_ps(pPlaneW[p], radius)));
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, _mm_setzero_ps()));
+    }
+    uint32_t mask = (uint32_t)_mm_movemask_ps(inside);
+    visibleCount = appendVisibleBatch(pCuller->pVisible, visibleCount, i, mask);
+  }
+#else
+  // NEON has no movemask, each lane's bit is picked out and summed instead
+  const uint32_t pLaneBits[4] = {1, 2, 4, 8};
+  uint32x4_t laneBits = vld1q_u32(pLaneBits);
+  float32x4_t pPlaneX[6], pPlaneY[6], pPlaneZ[6], pPlaneW[6];
+  for (uint32_t p = 0; p < 6; p++) {
+    pPlaneX[p] = vdupq_n_f32(pPlanes[p][0]);
+    pPlaneY[p] = vdupq_n_f32(pPlanes[p][1]);
+    pPlaneZ[p] = vdupq_n_f32(pPlanes[p][2]);
+    pPlaneW[p] = vdupq_n_f32(pPlanes[p][3]);
+  }
+  for (uint32_t i = 0; i < pCuller->paddedCount; i += CPU_CULL_BATCH_SIZE) {
+    float32x4_t x = vld1q_f32(&pCuller->pCentersX[i]);
+    float32x4_t y = vld1q_f32(&pCuller->pCentersY[i]);
+    float32x4_t z = vld1q_f32(&pCuller->pCentersZ[i]);
+    float32x4_t radius = vld1q_f32(&pCuller->pRadii[i]);
+    uint32x4_t inside = vdupq_n_u32(UINT32_MAX);
+    for (uint32_t p = 0; p < 6; p++) {
+      float32x4_t distance = vaddq_f32(pPlaneW[p], radius);
+      distance = vmlaq_f32(distance, pPlaneX[p], x);
+      distance = vmlaq_f32(distance, pPlaneY[p], y);
+      distance = vmlaq_f32(distance, pPlaneZ[p], z);
+      inside = vandq_u32(inside, vcgeq_f32(distance, vdupq_n_f32(0.0f)));
+    }
+    uint32x4_t bits = vandq_u32(inside, laneBits);
+    uint32_t mask = vgetq_lane_u32(bits, 0) | vgetq_lane_u32(bits, 1) |
+                    vgetq_lane_u32(bits, 2) | vgetq_lane_u32(bits, 3);
+    visibleCount = appendVisibleBatch(pCuller->pVisible, visibleCount, i, mask);
+  }
+#endif
+  pCuller->visibleCount = visibleCount;
+#else
+  cullCpuCuller_scalar(pCuller, mvp);
+#endif
+}
+
+void recordCpuCulledDraws(const CpuCuller *pCuller,
+                          const VkCommandBuffer commandBuffer,
+                          const uint32_t indexCount) {
+  uint32_t i = 0;
+  while (i < pCuller->visibleCount) {
+    uint32_t firstInstance = pCuller->pVisible[i];
+    uint32_t runLength = 1;
+    while (i + runLength < pCuller->visibleCount &&
+           pCuller->pVisible[i + runLength] == firstInstance + runLength) {
+      runLength++;
+    }
+    vkCmdDrawIndexed(commandBuffer, indexCount, runLength, 0, 0,
+                     firstInstance);
+    i += runLength;
+  }
+}
+
+// xorshift, so every run of the bench culls the same spheres
+static float nextBenchRandom(uint32_t *pState) {
+  *pState ^= *pState << 13;
+  *pState ^= *pState >> 17;
+  *pState ^= *pState << 5;
+  return ((float)(*pState >> 8) / (float)(1u << 24));
+}
+
+// returns the average time of one cull, in seconds
+static double benchCpuCuller(CpuCuller *pCuller, const mat4x4 mvp,
+                             const bool simd) {
+  double startTime = 0.0;
+  for (uint32_t i = 0; i < CPU_CULL_BENCH_WARMUP + CPU_CULL_BENCH_ITERATIONS;
+       i++) {
+    if (i == CPU_CULL_BENCH_WARMUP) {
+      startTime = getTime();
+    }
+    if (simd) {
+      cullCpuCuller(pCuller, mvp);
+    } else {
+      cullCpuCuller_scalar(pCuller, mvp);
+    }
+  }
+  return ((getTime() - startTime) / CPU_CULL_BENCH_ITERATIONS);
+}
+
+void benchCpuCulling(void) {
+  CpuCuller culler;
+  new_CpuCuller(&culler, CPU_CULL_BENCH_OBJECTS);
+
+  uint32_t randomState = 0x12345678;
+  for (uint32_t i = 0; i < CPU_CULL_BENCH_OBJECTS; i++) {
+    vec4 sphere;
+    for (uint32_t j = 0; j < 3; j++) {
+      sphere[j] = CPU_CULL_BENCH_EXTENT *
+                  (2.0f * nextBenchRandom(&randomState) - 1.0f);
+    }
+    sphere[3] = CPU_CULL_BENCH_MAX_RADIUS * nextBenchRandom(&randomState);
+    setCpuCullerSphere(&culler, i, sphere);
+  }
+
+  // the window's default camera, whose far plane cuts through the spheres
+  Camera camera = new_Camera((vec3){0.0f, 0.0f, 0.0f},
+                             (VkExtent2D){.width = 1280, .height = 720});
+  mat4x4 mvp;
+  getMvpCamera(mvp, &camera);
+
+  double scalarTime = benchCpuCuller(&culler, mvp, false);
+  uint32_t scalarVisibleCount = culler.visibleCount;
+  double simdTime = benchCpuCuller(&culler, mvp, true);
+  if (culler.visibleCount != scalarVisibleCount) {
+    LOG_ERROR_ARGS(ERR_LEVEL_WARN,
+                   "CPU culling kept %u objects with %s, %u without",
+                   culler.visibleCount, LINMATH_SIMD_NAME, scalarVisibleCount);
+  }
+
+  printf("cpu cull objects: %u  visible: %u\n", culler.objectCount,
+         culler.visibleCount);
+  printf("cpu cull scalar: %8.3f ms  %s: %8.3f ms  speedup: %5.2fx  "
+         "%.2f ns/object\n",
+         scalarTime * 1000.0, LINMATH_SIMD_NAME, simdTime * 1000.0,
+         simdTime > 0.0 ? scalarTime / simdTime : 0.0,
+         simdTime * 1e9 / culler.objectCount);
+
+  delete_CpuCuller(&culler);
+}
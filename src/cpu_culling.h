@@ -0,0 +1,83 @@
+///
+/// Copyright 2019 Govind Pimpale
+/// cpu_culling.h
+///
+/// Per object visibility on the CPU, for devices or paths that can't cull on
+/// the GPU. Bounding spheres are kept as separate arrays of centres and radii,
+/// so that each frustum plane is tested against a whole SIMD register of
+/// spheres at once, and the survivors are packed into a list of object
+/// indices that the draws are recorded from.
+///
+
+#ifndef SRC_CPU_CULLING_H_
+#define SRC_CPU_CULLING_H_
+
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include <linmath.h>
+
+#include "errors.h"
+
+// spheres tested together, the arrays are padded to a multiple of it
+#if defined(LINMATH_AVX2)
+#define CPU_CULL_BATCH_SIZE 8
+#else
+#define CPU_CULL_BATCH_SIZE 4
+#endif
+
+// objects culled by benchCpuCulling, and how often
+#define CPU_CULL_BENCH_OBJECTS 1000000
+#define CPU_CULL_BENCH_WARMUP 5
+#define CPU_CULL_BENCH_ITERATIONS 50
+
+typedef struct {
+  uint32_t objectCount;
+  // objectCount rounded up to CPU_CULL_BATCH_SIZE, the padding never passes
+  uint32_t paddedCount;
+  // world space bounding spheres, one element per object
+  float *pCentersX;
+  float *pCentersY;
+  float *pCentersZ;
+  float *pRadii;
+  // indices of the objects that passed the last cull, in increasing order
+  uint32_t *pVisible;
+  uint32_t visibleCount;
+} CpuCuller;
+
+/// Creates a culler for `objectCount` objects, whose spheres start out empty
+/// --- POSTCONDITIONS ---
+/// * returns error status
+/// --- CLEANUP ---
+/// * call delete_CpuCuller
+ErrVal new_CpuCuller(CpuCuller *pCuller, const uint32_t objectCount);
+
+void delete_CpuCuller(CpuCuller *pCuller);
+
+/// Sets the world space bounding sphere of object `index`, xyz being the
+/// centre and w the radius
+void setCpuCullerSphere(CpuCuller *pCuller, const uint32_t index,
+                        const vec4 sphere);
+
+/// Culls every object against the frustum of `mvp`, which maps world space
+/// to clip space, and leaves the survivors in `pVisible`
+void cullCpuCuller(CpuCuller *pCuller, const mat4x4 mvp);
+
+/// cullCpuCuller, one sphere and one plane at a time
+void cullCpuCuller_scalar(CpuCuller *pCuller, const mat4x4 mvp);
+
+/// Draws the objects that passed the last cull, merging runs of consecutive
+/// objects into a single instanced draw
+/// --- PRECONDITIONS ---
+/// * an instanced pipeline, the mesh and the object's instance buffer are
+/// bound
+void recordCpuCulledDraws(const CpuCuller *pCuller,
+                          const VkCommandBuffer commandBuffer,
+                          const uint32_t indexCount);
+
+/// Culls CPU_CULL_BENCH_OBJECTS spheres scattered around a camera with and
+/// without SIMD, and prints the time each cull took
+void benchCpuCulling(void);
+
+#endif /* SRC_CPU_CULLING_H_ */
@@ -0,0 +1,206 @@
+#include "deletion_queue.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vulkan_utils.h"
+
+#define DELETION_QUEUE_INITIAL_CAPACITY 16
+
+// makes room for `count` more deletions in the current frame
+static DeletionQueueFrame *reserveDeferredDeletions(DeletionQueue *pQueue,
+                                                    const uint32_t count) {
+  DeletionQueueFrame *pFrame = &pQueue->pFrames[pQueue->currentFrame];
+  uint32_t capacity = pFrame->deletionCapacity == 0
+                          ? DELETION_QUEUE_INITIAL_CAPACITY
+                          : pFrame->deletionCapacity;
+  while (capacity < pFrame->deletionCount + count) {
+    capacity *= 2;
+  }
+  if (capacity != pFrame->deletionCapacity) {
+    DeferredDeletion *pDeletions =
+        realloc(pFrame->pDeletions, capacity * sizeof(DeferredDeletion));
+    if (pDeletions == NULL) {
+      LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "failed to defer deletion: %s",
+                     strerror(errno));
+      PANIC();
+    }
+    pFrame->pDeletions = pDeletions;
+    pFrame->deletionCapacity = capacity;
+  }
+  return (pFrame);
+}
+
+static void pushDeferredDeletion(DeletionQueue *pQueue,
+                                 const DeferredDeletion deletion) {
+  DeletionQueueFrame *pFrame = reserveDeferredDeletions(pQueue, 1);
+  pFrame->pDeletions[pFrame->deletionCount++] = deletion;
+}
+
+static void destroyDeferredDeletions(DeletionQueue *pQueue,
+                                     DeletionQueueFrame *pFrame) {
+  for (uint32_t i = 0; i < pFrame->deletionCount; i++) {
+    DeferredDeletion *pDeletion = &pFrame->pDeletions[i];
+    switch (pDeletion->kind) {
+    case DEFERRED_DELETION_KIND_BUFFER:
+      delete_Buffer(&pDeletion->resource.buffer, pQueue->device);
+      break;
+    case DEFERRED_DELETION_KIND_IMAGE:
+      delete_Image(&pDeletion->resource.image, pQueue->device);
+      break;
+    case DEFERRED_DELETION_KIND_IMAGE_VIEW:
+      delete_ImageView(&pDeletion->resource.imageView, pQueue->device);
+      break;
+    case DEFERRED_DELETION_KIND_FRAMEBUFFER:
+      delete_Framebuffer(&pDeletion->resource.framebuffer, pQueue->device);
+      break;
+    case DEFERRED_DELETION_KIND_SWAPCHAIN:
+      delete_Swapchain(&pDeletion->resource.swapchain, pQueue->device);
+      break;
+    case DEFERRED_DELETION_KIND_PIPELINE:
+      delete_Pipeline(&pDeletion->resource.pipeline, pQueue->device);
+      break;
+    case DEFERRED_DELETION_KIND_DEVICE_MEMORY:
+      delete_DeviceMemory(&pDeletion->resource.allocation, pQueue->pAllocator);
+      break;
+    case DEFERRED_DELETION_KIND_COMMAND_BUFFER:
+      delete_CommandBuffers(&pDeletion->resource.commandBuffer.commandBuffer, 1,
+                            pDeletion->resource.commandBuffer.commandPool,
+                            pQueue->device);
+      break;
+    case DEFERRED_DELETION_KIND_DESCRIPTOR_POOL:
+      delete_DescriptorPool(&pDeletion->resource.descriptorPool,
+                            pQueue->device);
+      break;
+    }
+  }
+  pFrame->deletionCount = 0;
+}
+
+ErrVal new_DeletionQueue(DeletionQueue *pQueue, const uint32_t frameCount,
+                         const VkDevice device, DeviceAllocator *pAllocator) {
+  pQueue->device = device;
+  pQueue->pAllocator = pAllocator;
+  pQueue->frameCount = frameCount;
+  pQueue->currentFrame = 0;
+  pQueue->pFrames = calloc(frameCount, sizeof(DeletionQueueFrame));
+  if (pQueue->pFrames == NULL) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "failed to create deletion queue: %s",
+                   strerror(errno));
+    PANIC();
+  }
+  return (ERR_OK);
+}
+
+void delete_DeletionQueue(DeletionQueue *pQueue) {
+  // destroy in the order things were deleted, oldest frame first
+  for (uint32_t i = 1; i <= pQueue->frameCount; i++) {
+    DeletionQueueFrame *pFrame =
+        &pQueue->pFrames[(pQueue->currentFrame + i) % pQueue->frameCount];
+    destroyDeferredDeletions(pQueue, pFrame);
+    free(pFrame->pDeletions);
+  }
+  free(pQueue->pFrames);
+  pQueue->pFrames = NULL;
+}
+
+void beginDeletionQueueFrame(DeletionQueue *pQueue, const uint32_t frameIndex) {
+  destroyDeferredDeletions(pQueue, &pQueue->pFrames[frameIndex]);
+  pQueue->currentFrame = frameIndex;
+}
+
+void deferDeleteBuffer(DeletionQueue *pQueue, VkBuffer *pBuffer) {
+  DeferredDeletion deletion = {.kind = DEFERRED_DELETION_KIND_BUFFER};
+  deletion.resource.buffer = *pBuffer;
+  pushDeferredDeletion(pQueue, deletion);
+  *pBuffer = VK_NULL_HANDLE;
+}
+
+void deferDeleteImage(DeletionQueue *pQueue, VkImage *pImage) {
+  DeferredDeletion deletion = {.kind = DEFERRED_DELETION_KIND_IMAGE};
+  deletion.resource.image = *pImage;
+  pushDeferredDeletion(pQueue, deletion);
+  *pImage = VK_NULL_HANDLE;
+}
+
+void deferDeleteImageView(DeletionQueue *pQueue, VkImageView *pImageView) {
+  DeferredDeletion deletion = {.kind = DEFERRED_DELETION_KIND_IMAGE_VIEW};
+  deletion.resource.imageView = *pImageView;
+  pushDeferredDeletion(pQueue, deletion);
+  *pImageView = VK_NULL_HANDLE;
+}
+
+void deferDeleteFramebuffer(DeletionQueue *pQueue,
+                            VkFramebuffer *pFramebuffer) {
+  DeferredDeletion deletion = {.kind = DEFERRED_DELETION_KIND_FRAMEBUFFER};
+  deletion.resource.framebuffer = *pFramebuffer;
+  pushDeferredDeletion(pQueue, deletion);
+  *pFramebuffer = VK_NULL_HANDLE;
+}
+
+void deferDeleteSwapchain(DeletionQueue *pQueue, VkSwapchainKHR *pSwapchain) {
+  DeferredDeletion deletion = {.kind = DEFERRED_DELETION_KIND_SWAPCHAIN};
+  deletion.resource.swapchain = *pSwapchain;
+  pushDeferredDeletion(pQueue, deletion);
+  *pSwapchain = VK_NULL_HANDLE;
+}
+
+void deferDeletePipeline(DeletionQueue *pQueue, VkPipeline *pPipeline) {
+  DeferredDeletion deletion = {.kind = DEFERRED_DELETION_KIND_PIPELINE};
+  deletion.resource.pipeline = *pPipeline;
+  pushDeferredDeletion(pQueue, deletion);
+  *pPipeline = VK_NULL_HANDLE;
+}
+
+void deferDeleteDeviceMemory(DeletionQueue *pQueue,
+                             DeviceAllocation *pAllocation) {
+  DeferredDeletion deletion = {.kind = DEFERRED_DELETION_KIND_DEVICE_MEMORY};
+  deletion.resource.allocation = *pAllocation;
+  pushDeferredDeletion(pQueue, deletion);
+  *pAllocation = (DeviceAllocation){0};
+}
+
+void deferDeleteCommandBuffer(DeletionQueue *pQueue,
+                              const VkCommandPool commandPool,
+                              VkCommandBuffer *pCommandBuffer) {
+  DeferredDeletion deletion = {.kind = DEFERRED_DELETION_KIND_COMMAND_BUFFER};
+  deletion.resource.commandBuffer.commandPool = commandPool;
+  deletion.resource.commandBuffer.commandBuffer = *pCommandBuffer;
+  pushDeferredDeletion(pQueue, deletion);
+  *pCommandBuffer = VK_NULL_HANDLE;
+}
+
+void deferDeleteDescriptorPool(DeletionQueue *pQueue,
+                               VkDescriptorPool *pDescriptorPool) {
+  DeferredDeletion deletion = {.kind = DEFERRED_DELETION_KIND_DESCRIPTOR_POOL};
+  deletion.resource.descriptorPool = *pDescriptorPool;
+  pushDeferredDeletion(pQueue, deletion);
+  *pDescriptorPool = VK_NULL_HANDLE;
+}
+
+// the room for every handle is made before any of them are taken, so that
+// the whole batch is queued without reallocating in between
+void deferDeleteSwapchainImageViews(DeletionQueue *pQueue,
+                                    VkImageView *pImageViews,
+                                    const uint32_t imageCount) {
+  DeletionQueueFrame *pFrame = reserveDeferredDeletions(pQueue, imageCount);
+  for (uint32_t i = 0; i < imageCount; i++) {
+    DeferredDeletion *pDeletion = &pFrame->pDeletions[pFrame->deletionCount++];
+    pDeletion->kind = DEFERRED_DELETION_KIND_IMAGE_VIEW;
+    pDeletion->resource.imageView = pImageViews[i];
+    pImageViews[i] = VK_NULL_HANDLE;
+  }
+}
+
+void deferDeleteSwapchainFramebuffers(DeletionQueue *pQueue,
+                                      VkFramebuffer *pFramebuffers,
+                                      const uint32_t imageCount) {
+  DeletionQueueFrame *pFrame = reserveDeferredDeletions(pQueue, imageCount);
+  for (uint32_t i = 0; i < imageCount; i++) {
+    DeferredDeletion *pDeletion = &pFrame->pDeletions[pFrame->deletionCount++];
+    pDeletion->kind = DEFERRED_DELETION_KIND_FRAMEBUFFER;
+    pDeletion->resource.framebuffer = pFramebuffers[i];
+    pFramebuffers[i] = VK_NULL_HANDLE;
+  }
+}
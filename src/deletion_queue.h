@@ -0,0 +1,118 @@
+///
+/// Copyright 2019 Govind Pimpale
+/// deletion_queue.h
+///
+/// Defers the destruction of resources that frames in flight may still be
+/// using. Each frame in flight has its own list, which everything deleted
+/// while it is the current frame goes onto, and which is only destroyed once
+/// that frame's fence has signaled again. Since a fence signals after every
+/// earlier submit to the queue has completed too, nothing on the list can
+/// still be in use by then, and nothing has to wait for the device to idle.
+///
+
+#ifndef SRC_DELETION_QUEUE_H_
+#define SRC_DELETION_QUEUE_H_
+
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "errors.h"
+#include "memory_allocator.h"
+
+typedef enum {
+  DEFERRED_DELETION_KIND_BUFFER,
+  DEFERRED_DELETION_KIND_IMAGE,
+  DEFERRED_DELETION_KIND_IMAGE_VIEW,
+  DEFERRED_DELETION_KIND_FRAMEBUFFER,
+  DEFERRED_DELETION_KIND_SWAPCHAIN,
+  DEFERRED_DELETION_KIND_PIPELINE,
+  DEFERRED_DELETION_KIND_DEVICE_MEMORY,
+  DEFERRED_DELETION_KIND_COMMAND_BUFFER,
+  DEFERRED_DELETION_KIND_DESCRIPTOR_POOL,
+} DeferredDeletionKind;
+
+typedef struct {
+  DeferredDeletionKind kind;
+  union {
+    VkBuffer buffer;
+    VkImage image;
+    VkImageView imageView;
+    VkFramebuffer framebuffer;
+    VkSwapchainKHR swapchain;
+    VkPipeline pipeline;
+    DeviceAllocation allocation;
+    struct {
+      VkCommandPool commandPool;
+      VkCommandBuffer commandBuffer;
+    } commandBuffer;
+    VkDescriptorPool descriptorPool;
+  } resource;
+} DeferredDeletion;
+
+// Everything deleted while one frame in flight was current
+typedef struct {
+  DeferredDeletion *pDeletions;
+  uint32_t deletionCount;
+  uint32_t deletionCapacity;
+} DeletionQueueFrame;
+
+typedef struct {
+  VkDevice device;
+  DeviceAllocator *pAllocator;
+  DeletionQueueFrame *pFrames;
+  uint32_t frameCount;
+  uint32_t currentFrame;
+} DeletionQueue;
+
+/// Creates a deletion queue for `frameCount` frames in flight
+/// --- PRECONDITIONS ---
+/// * `pAllocator` is the allocator deferred device memory came from
+/// --- POSTCONDITIONS ---
+/// * returns error status
+/// --- CLEANUP ---
+/// * call delete_DeletionQueue
+ErrVal new_DeletionQueue(DeletionQueue *pQueue, const uint32_t frameCount,
+                         const VkDevice device, DeviceAllocator *pAllocator);
+
+/// Destroys everything still queued, then frees the queue
+/// --- PRECONDITIONS ---
+/// * no frame is in flight, e.g. the device is idle
+void delete_DeletionQueue(DeletionQueue *pQueue);
+
+/// Destroys what was deleted the last time `frameIndex` was current, then
+/// makes it the current frame
+/// --- PRECONDITIONS ---
+/// * the last submit of that frame has completed, e.g. its fence has
+/// signaled
+void beginDeletionQueueFrame(DeletionQueue *pQueue, const uint32_t frameIndex);
+
+/// Each of these queues the resource for destruction, like the matching
+/// delete_* call, and sets the handle to VK_NULL_HANDLE right away
+/// --- PRECONDITIONS ---
+/// * the resource won't be used by any submit after the current frame's
+void deferDeleteBuffer(DeletionQueue *pQueue, VkBuffer *pBuffer);
+void deferDeleteImage(DeletionQueue *pQueue, VkImage *pImage);
+void deferDeleteImageView(DeletionQueue *pQueue, VkImageView *pImageView);
+void deferDeleteFramebuffer(DeletionQueue *pQueue,
+                            VkFramebuffer *pFramebuffer);
+void deferDeleteSwapchain(DeletionQueue *pQueue, VkSwapchainKHR *pSwapchain);
+void deferDeletePipeline(DeletionQueue *pQueue, VkPipeline *pPipeline);
+/// `*pAllocation` is zeroed, and its range is only reused once destroyed
+void deferDeleteDeviceMemory(DeletionQueue *pQueue,
+                             DeviceAllocation *pAllocation);
+/// `commandPool` is only used from the thread that begins frames
+void deferDeleteCommandBuffer(DeletionQueue *pQueue,
+                              const VkCommandPool commandPool,
+                              VkCommandBuffer *pCommandBuffer);
+void deferDeleteDescriptorPool(DeletionQueue *pQueue,
+                               VkDescriptorPool *pDescriptorPool);
+
+void deferDeleteSwapchainImageViews(DeletionQueue *pQueue,
+                                    VkImageView *pImageViews,
+                                    const uint32_t imageCount);
+void deferDeleteSwapchainFramebuffers(DeletionQueue *pQueue,
+                                      VkFramebuffer *pFramebuffers,
+                                      const uint32_t imageCount);
+
+#endif /* SRC_DELETION_QUEUE_H_ */
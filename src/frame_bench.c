@@ -0,0 +1,151 @@
+#include "frame_bench.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int compareDoubles(const void *a, const void *b) {
+  double da = *(const double *)a;
+  double db = *(const double *)b;
+  return ((da > db) - (da < db));
+}
+
+void new_FrameBench(FrameBench *pBench, const uint32_t frameCount) {
+  pBench->frameCount = frameCount;
+  pBench->warmupCount = 0;
+  pBench->recordedCount = 0;
+  pBench->lastPresentTime = 0.0;
+  pBench->startAllocationCount = 0;
+  pBench->endAllocationCount = 0;
+  pBench->pCpuFrameTimes = malloc((frameCount + 1) * sizeof(double));
+  pBench->pPresentIntervals = malloc((frameCount + 1) * sizeof(double));
+  if (pBench->pCpuFrameTimes == NULL || pBench->pPresentIntervals == NULL) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "failed to create frame bench: %s",
+                   strerror(errno));
+    PANIC();
+  }
+}
+
+void delete_FrameBench(FrameBench *pBench) {
+  free(pBench->pCpuFrameTimes);
+  free(pBench->pPresentIntervals);
+  pBench->pCpuFrameTimes = NULL;
+  pBench->pPresentIntervals = NULL;
+}
+
+void recordFrameBenchFrame(FrameBench *pBench, const double cpuFrameTime,
+                           const double presentTime,
+                           const uint64_t allocationCount) {
+  if (pBench->warmupCount < FRAME_BENCH_WARMUP_FRAMES) {
+    pBench->warmupCount++;
+    pBench->startAllocationCount = allocationCount;
+  } else if (pBench->recordedCount < pBench->frameCount) {
+    uint32_t frame = pBench->recordedCount++;
+    pBench->pCpuFrameTimes[frame] = cpuFrameTime;
+    pBench->pPresentIntervals[frame] = presentTime - pBench->lastPresentTime;
+    pBench->endAllocationCount = allocationCount;
+  }
+  pBench->lastPresentTime = presentTime;
+}
+
+bool isFrameBenchDone(const FrameBench *pBench) {
+  return (pBench->recordedCount == pBench->frameCount);
+}
+
+void getFrameBenchStats(FrameBenchStats *pStats, const double *pSamples,
+                        const uint32_t sampleCount) {
+  *pStats = (FrameBenchStats){0};
+  if (sampleCount == 0) {
+    return;
+  }
+
+  double *pSorted = malloc(sampleCount * sizeof(double));
+  if (pSorted == NULL) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "failed to sort frame times: %s",
+                   strerror(errno));
+    PANIC();
+  }
+  memcpy(pSorted, pSamples, sampleCount * sizeof(double));
+  qsort(pSorted, sampleCount, sizeof(double), compareDoubles);
+
+  double sum = 0.0;
+  for (uint32_t i = 0; i < sampleCount; i++) {
+    sum += pSorted[i];
+  }
+  uint32_t p99Rank = (uint32_t)(((uint64_t)sampleCount * 99 + 99) / 100);
+  pStats->minMs = pSorted[0] * 1000.0;
+  pStats->avgMs = sum / sampleCount * 1000.0;
+  pStats->p99Ms = pSorted[p99Rank - 1] * 1000.0;
+  pStats->maxMs = pSorted[sampleCount - 1] * 1000.0;
+  free(pSorted);
+}
+
+static void writeStatsJson(FILE *fp, const char *name,
+                           const FrameBenchStats *pStats) {
+  fprintf(fp, "  \"%s\": {\n", name);
+  fprintf(fp, "    \"min\": %.4f,\n", pStats->minMs);
+  fprintf(fp, "    \"avg\": %.4f,\n", pStats->avgMs);
+  fprintf(fp, "    \"p99\": %.4f,\n", pStats->p99Ms);
+  fprintf(fp, "    \"max\": %.4f\n", pStats->maxMs);
+  fprintf(fp, "  },\n");
+}
+
+ErrVal writeFrameBenchJson(const FrameBench *pBench,
+                           const FrameBenchScene *pScene,
+                           const GpuProfilerStats *pGpuStats,
+                           const char *path) {
+  FILE *fp = fopen(path, "w");
+  if (fp == NULL) {
+    LOG_ERROR_ARGS(ERR_LEVEL_WARN, "could not open %s: %s", path,
+                   strerror(errno));
+    return (ERR_UNKNOWN);
+  }
+
+  FrameBenchStats cpuStats;
+  getFrameBenchStats(&cpuStats, pBench->pCpuFrameTimes, pBench->recordedCount);
+  FrameBenchStats presentStats;
+  getFrameBenchStats(&presentStats, pBench->pPresentIntervals,
+                     pBench->recordedCount);
+  uint64_t allocations =
+      pBench->endAllocationCount - pBench->startAllocationCount;
+
+  fprintf(fp, "{\n");
+  fprintf(fp, "  \"scene\": {\n");
+  fprintf(fp, "    \"vertices\": %u,\n", pScene->vertexCount);
+  fprintf(fp, "    \"indices\": %u,\n", pScene->indexCount);
+  fprintf(fp, "    \"instances\": %u,\n", pScene->instanceCount);
+  fprintf(fp, "    \"width\": %u,\n", pScene->width);
+  fprintf(fp, "    \"height\": %u,\n", pScene->height);
+  fprintf(fp, "    \"headless\": %s,\n", pScene->headless ? "true" : "false");
+  fprintf(fp, "    \"present_mode\": \"%s\"\n", pScene->presentMode);
+  fprintf(fp, "  },\n");
+  fprintf(fp, "  \"frames\": %u,\n", pBench->recordedCount);
+  writeStatsJson(fp, "cpu_frame_ms", &cpuStats);
+  writeStatsJson(fp, "present_interval_ms", &presentStats);
+  if (pGpuStats != NULL) {
+    // the profiler only keeps the latest GPU_PROFILER_HISTORY_SIZE samples
+    fprintf(fp, "  \"gpu_frame_ms\": {\n");
+    fprintf(fp, "    \"samples\": %u,\n", pGpuStats->sampleCount);
+    fprintf(fp, "    \"min\": %.4f,\n", (double)pGpuStats->minMs);
+    fprintf(fp, "    \"avg\": %.4f,\n", (double)pGpuStats->avgMs);
+    fprintf(fp, "    \"p99\": %.4f\n", (double)pGpuStats->p99Ms);
+    fprintf(fp, "  },\n");
+  } else {
+    fprintf(fp, "  \"gpu_frame_ms\": null,\n");
+  }
+  fprintf(fp, "  \"device_allocations_per_frame\": %.4f\n",
+          pBench->recordedCount == 0
+              ? 0.0
+              : (double)allocations / pBench->recordedCount);
+  fprintf(fp, "}\n");
+
+  // fclose flushes, so it can fail too
+  bool written = !ferror(fp);
+  written = (fclose(fp) == 0) && written;
+  if (!written) {
+    LOG_ERROR_ARGS(ERR_LEVEL_WARN, "could not write %s", path);
+    return (ERR_UNKNOWN);
+  }
+  return (ERR_OK);
+}
@@ -0,0 +1,87 @@
+///
+/// Copyright 2019 Govind Pimpale
+/// frame_bench.h
+///
+/// Collects per frame timings over a scripted run and writes them out as
+/// JSON, one value per line, so that two runs can be compared with a plain
+/// diff.
+///
+
+#ifndef SRC_FRAME_BENCH_H_
+#define SRC_FRAME_BENCH_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "errors.h"
+#include "gpu_profiler.h"
+
+// frames rendered before timing starts, so that caches and clocks settle
+#define FRAME_BENCH_WARMUP_FRAMES 60
+
+// What was rendered, recorded alongside the timings
+typedef struct {
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  uint32_t instanceCount;
+  uint32_t width;
+  uint32_t height;
+  bool headless;
+  const char *presentMode;
+} FrameBenchScene;
+
+typedef struct {
+  uint32_t frameCount;
+  uint32_t warmupCount;
+  uint32_t recordedCount;
+  // seconds spent building and submitting each frame
+  double *pCpuFrameTimes;
+  // seconds between each present and the one before it
+  double *pPresentIntervals;
+  double lastPresentTime;
+  uint64_t startAllocationCount;
+  uint64_t endAllocationCount;
+} FrameBench;
+
+typedef struct {
+  double minMs;
+  double avgMs;
+  double p99Ms;
+  double maxMs;
+} FrameBenchStats;
+
+/// Creates a bench that records `frameCount` frames
+/// --- CLEANUP ---
+/// * call delete_FrameBench
+void new_FrameBench(FrameBench *pBench, const uint32_t frameCount);
+
+void delete_FrameBench(FrameBench *pBench);
+
+/// Records a frame, the first FRAME_BENCH_WARMUP_FRAMES and any past
+/// `frameCount` are only used as reference points
+/// --- PRECONDITIONS ---
+/// * `presentTime` is when the frame was presented, or submitted when there
+/// is nothing to present
+/// * `allocationCount` is the allocator's lifetime allocation count
+void recordFrameBenchFrame(FrameBench *pBench, const double cpuFrameTime,
+                           const double presentTime,
+                           const uint64_t allocationCount);
+
+/// Returns true once every frame has been recorded
+bool isFrameBenchDone(const FrameBench *pBench);
+
+/// Computes min, average, nearest rank 99th percentile and max, in ms
+void getFrameBenchStats(FrameBenchStats *pStats, const double *pSamples,
+                        const uint32_t sampleCount);
+
+/// Writes the scene and the statistics of the recorded frames to `path`
+/// --- PRECONDITIONS ---
+/// * `pGpuStats` is NULL if GPU time wasn't measured
+/// --- POSTCONDITIONS ---
+/// * returns error status
+ErrVal writeFrameBenchJson(const FrameBench *pBench,
+                           const FrameBenchScene *pScene,
+                           const GpuProfilerStats *pGpuStats,
+                           const char *path);
+
+#endif /* SRC_FRAME_BENCH_H_ */
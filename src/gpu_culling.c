@@ -0,0 +1,218 @@
+#include "gpu_culling.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vulkan_utils.h"
+
+// the object buffer and the frame's draw buffer
+#define GPU_CULL_BINDING_COUNT 2
+
+bool isGpuCullingSupported(const VkPhysicalDevice physicalDevice) {
+  VkPhysicalDeviceVulkan12Features supportedFeatures12 = {0};
+  supportedFeatures12.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+  VkPhysicalDeviceFeatures2 supportedFeatures = {0};
+  supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  supportedFeatures.pNext = &supportedFeatures12;
+  vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures);
+  return (supportedFeatures12.drawIndirectCount &&
+          supportedFeatures.features.multiDrawIndirect &&
+          supportedFeatures.features.drawIndirectFirstInstance);
+}
+
+void getFrustumPlanes(vec4 pFrustumPlanes[6], const mat4x4 mvp) {
+  // Gribb and Hartmann: each plane is the last row of the matrix plus or
+  // minus one of the others. linmath is column major, so row r is mvp[c][r]
+  for (uint32_t i = 0; i < 6; i++) {
+    uint32_t row = i / 2;
+    float sign = (i % 2 == 0) ? 1.0f : -1.0f;
+    for (uint32_t col = 0; col < 4; col++) {
+      pFrustumPlanes[i][col] = mvp[col][3] + sign * mvp[col][row];
+    }
+    float length = sqrtf(pFrustumPlanes[i][0] * pFrustumPlanes[i][0] +
+                         pFrustumPlanes[i][1] * pFrustumPlanes[i][1] +
+                         pFrustumPlanes[i][2] * pFrustumPlanes[i][2]);
+    if (length > 0.0f) {
+      vec4_scale(pFrustumPlanes[i], pFrustumPlanes[i], 1.0f / length);
+    }
+  }
+}
+
+ErrVal new_GpuCuller(                    //
+    GpuCuller *pCuller,                  //
+    const VkBuffer objectBuffer,         //
+    const uint32_t objectCount,          //
+    const uint32_t indexCount,           //
+    const vec4 boundingSphere,           //
+    const VkShaderModule shaderModule,   //
+    const VkPipelineCache pipelineCache, //
+    const uint32_t frameCount,           //
+    const VkDevice device,               //
+    DeviceAllocator *pAllocator          //
+) {
+  pCuller->device = device;
+  pCuller->frameCount = frameCount;
+  pCuller->currentFrame = 0;
+  memset(&pCuller->constants, 0, sizeof(GpuCullConstants));
+  for (uint32_t i = 0; i < 4; i++) {
+    pCuller->constants.boundingSphere[i] = boundingSphere[i];
+  }
+  pCuller->constants.objectCount = objectCount;
+  pCuller->constants.indexCount = indexCount;
+
+  pCuller->pDrawBuffers = calloc(frameCount, sizeof(VkBuffer));
+  pCuller->pDrawBufferAllocations =
+      calloc(frameCount, sizeof(DeviceAllocation));
+  pCuller->pDescriptorSets = calloc(frameCount, sizeof(VkDescriptorSet));
+  if (pCuller->pDrawBuffers == NULL ||
+      pCuller->pDrawBufferAllocations == NULL ||
+      pCuller->pDescriptorSets == NULL) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "failed to create GPU culler: %s",
+                   strerror(errno));
+    PANIC();
+  }
+
+  ErrVal retVal = new_ComputeStorageDescriptorSetLayout(
+      &pCuller->descriptorSetLayout, GPU_CULL_BINDING_COUNT, device);
+  if (retVal != ERR_OK) {
+    LOG_ERROR(ERR_LEVEL_ERROR, "failed to create GPU culler descriptor layout");
+    return (retVal);
+  }
+  retVal = new_ComputePipelineLayout(&pCuller->pipelineLayout,
+                                     pCuller->descriptorSetLayout,
+                                     sizeof(GpuCullConstants), device);
+  if (retVal != ERR_OK) {
+    LOG_ERROR(ERR_LEVEL_ERROR, "failed to create GPU culler pipeline layout");
+    return (retVal);
+  }
+  retVal = new_ComputePipeline(&pCuller->pipeline, pCuller->pipelineLayout,
+                               shaderModule, pipelineCache, device);
+  if (retVal != ERR_OK) {
+    LOG_ERROR(ERR_LEVEL_ERROR, "failed to create GPU culler pipeline");
+    return (retVal);
+  }
+  retVal = new_DescriptorPool(&pCuller->descriptorPool,
+                              VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                              frameCount * GPU_CULL_BINDING_COUNT, device);
+  if (retVal != ERR_OK) {
+    LOG_ERROR(ERR_LEVEL_ERROR, "failed to create GPU culler descriptor pool");
+    return (retVal);
+  }
+
+  // the count, padded out to GPU_CULL_DRAW_COMMAND_OFFSET, then one command
+  // for each object in case every one of them is visible
+  VkDeviceSize drawBufferSize =
+      GPU_CULL_DRAW_COMMAND_OFFSET +
+      (VkDeviceSize)objectCount * sizeof(VkDrawIndexedIndirectCommand);
+  for (uint32_t i = 0; i < frameCount; i++) {
+    retVal = new_Buffer_DeviceMemory(
+        &pCuller->pDrawBuffers[i], &pCuller->pDrawBufferAllocations[i],
+        drawBufferSize, pAllocator, device,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (retVal != ERR_OK) {
+      LOG_ERROR(ERR_LEVEL_ERROR, "failed to create GPU culler draw buffer");
+      return (retVal);
+    }
+
+    VkBuffer pComputeBuffers[GPU_CULL_BINDING_COUNT] = {
+        objectBuffer, pCuller->pDrawBuffers[i]};
+    retVal = new_ComputeBufferDescriptorSet(
+        &pCuller->pDescriptorSets[i], GPU_CULL_BINDING_COUNT, pComputeBuffers,
+        pCuller->descriptorSetLayout, pCuller->descriptorPool, device);
+    if (retVal != ERR_OK) {
+      LOG_ERROR(ERR_LEVEL_ERROR, "failed to create GPU culler descriptor set");
+      return (retVal);
+    }
+  }
+  return (ERR_OK);
+}
+
+void delete_GpuCuller(GpuCuller *pCuller, DeviceAllocator *pAllocator) {
+  for (uint32_t i = 0; i < pCuller->frameCount; i++) {
+    delete_Buffer(&pCuller->pDrawBuffers[i], pCuller->device);
+    delete_DeviceMemory(&pCuller->pDrawBufferAllocations[i], pAllocator);
+  }
+  // the sets go away with their pool
+  delete_DescriptorPool(&pCuller->descriptorPool, pCuller->device);
+  delete_Pipeline(&pCuller->pipeline, pCuller->device);
+  delete_PipelineLayout(&pCuller->pipelineLayout, pCuller->device);
+  delete_DescriptorSetLayout(&pCuller->descriptorSetLayout, pCuller->device);
+  free(pCuller->pDrawBuffers);
+  free(pCuller->pDrawBufferAllocations);
+  free(pCuller->pDescriptorSets);
+  pCuller->pDrawBuffers = NULL;
+  pCuller->pDrawBufferAllocations = NULL;
+  pCuller->pDescriptorSets = NULL;
+}
+
+void beginGpuCullerFrame(GpuCuller *pCuller, const uint32_t frameIndex,
+                         const mat4x4 mvp) {
+  pCuller->currentFrame = frameIndex;
+  getFrustumPlanes(pCuller->constants.pFrustumPlanes, mvp);
+}
+
+void recordGpuCulling(const GpuCuller *pCuller,
+                      const VkCommandBuffer commandBuffer) {
+  VkBuffer drawBuffer = pCuller->pDrawBuffers[pCuller->currentFrame];
+
+  /* Start the draw count at zero, the shader appends to it */
+  vkCmdFillBuffer(commandBuffer, drawBuffer, 0, sizeof(uint32_t), 0);
+
+  VkBufferMemoryBarrier resetBarrier = {0};
+  resetBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  resetBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  resetBarrier.dstAccessMask =
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  resetBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  resetBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  resetBarrier.buffer = drawBuffer;
+  resetBarrier.offset = 0;
+  resetBarrier.size = sizeof(uint32_t);
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 1,
+                       &resetBarrier, 0, NULL);
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    pCuller->pipeline);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          pCuller->pipelineLayout, 0, 1,
+                          &pCuller->pDescriptorSets[pCuller->currentFrame], 0,
+                          NULL);
+  vkCmdPushConstants(commandBuffer, pCuller->pipelineLayout,
+                     VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GpuCullConstants),
+                     &pCuller->constants);
+  uint32_t groupCount =
+      (pCuller->constants.objectCount + GPU_CULL_WORKGROUP_SIZE - 1) /
+      GPU_CULL_WORKGROUP_SIZE;
+  vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+
+  /* The commands and their count are read as indirect arguments */
+  VkBufferMemoryBarrier drawBarrier = {0};
+  drawBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  drawBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  drawBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+  drawBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  drawBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  drawBarrier.buffer = drawBuffer;
+  drawBarrier.offset = 0;
+  drawBarrier.size = VK_WHOLE_SIZE;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 0, NULL, 1,
+                       &drawBarrier, 0, NULL);
+}
+
+void recordGpuCulledDraw(const GpuCuller *pCuller,
+                         const VkCommandBuffer commandBuffer) {
+  VkBuffer drawBuffer = pCuller->pDrawBuffers[pCuller->currentFrame];
+  vkCmdDrawIndexedIndirectCount(commandBuffer, drawBuffer,
+                                GPU_CULL_DRAW_COMMAND_OFFSET, drawBuffer, 0,
+                                pCuller->constants.objectCount,
+                                sizeof(VkDrawIndexedIndirectCommand));
+}
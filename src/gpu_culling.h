@@ -0,0 +1,114 @@
+///
+/// Copyright 2019 Govind Pimpale
+/// gpu_culling.h
+///
+/// Moves per object visibility onto the GPU. A compute pass tests each
+/// object's bounding sphere against the view frustum and appends a
+/// VkDrawIndexedIndirectCommand for every survivor, then the render pass
+/// draws whatever was appended with vkCmdDrawIndexedIndirectCount. The CPU
+/// records the same handful of commands no matter how many objects there are.
+///
+
+#ifndef SRC_GPU_CULLING_H_
+#define SRC_GPU_CULLING_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include <linmath.h>
+
+#include "errors.h"
+#include "memory_allocator.h"
+
+// must match local_size_x in cull.comp
+#define GPU_CULL_WORKGROUP_SIZE 64
+
+// the draw count sits in front of the draw commands in each draw buffer
+#define GPU_CULL_DRAW_COMMAND_OFFSET 16
+
+// must match the push constants in cull.comp
+typedef struct {
+  vec4 pFrustumPlanes[6];
+  // xyz is the centre and w the radius, before the object's transform
+  vec4 boundingSphere;
+  uint32_t objectCount;
+  uint32_t indexCount;
+} GpuCullConstants;
+
+typedef struct {
+  VkDevice device;
+  VkDescriptorSetLayout descriptorSetLayout;
+  VkDescriptorPool descriptorPool;
+  VkPipelineLayout pipelineLayout;
+  VkPipeline pipeline;
+  // one draw buffer and descriptor set per frame in flight
+  uint32_t frameCount;
+  uint32_t currentFrame;
+  VkBuffer *pDrawBuffers;
+  DeviceAllocation *pDrawBufferAllocations;
+  VkDescriptorSet *pDescriptorSets;
+  GpuCullConstants constants;
+} GpuCuller;
+
+/// Returns whether `physicalDevice` has the features GPU culling draws with
+/// (drawIndirectCount, multiDrawIndirect and drawIndirectFirstInstance)
+bool isGpuCullingSupported(const VkPhysicalDevice physicalDevice);
+
+/// Extracts the six frustum planes of `mvp`, normalized so that a point's
+/// signed distance to a plane p is dot(p.xyz, point) + p.w
+void getFrustumPlanes(vec4 pFrustumPlanes[6], const mat4x4 mvp);
+
+/// Creates a new GPU culler
+/// --- PRECONDITIONS ---
+/// * `device` was created with every feature isGpuCullingSupported checks
+/// * `objectBuffer` holds `objectCount` InstanceTransforms and was created with
+/// VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+/// * `objectCount` is at most 65535 * GPU_CULL_WORKGROUP_SIZE
+/// * `boundingSphere` bounds the mesh, which has `indexCount` indices
+/// * `shaderModule` was created from cull.comp
+/// --- POSTCONDITIONS ---
+/// * returns error status
+/// --- CLEANUP ---
+/// * call delete_GpuCuller
+ErrVal new_GpuCuller(                    //
+    GpuCuller *pCuller,                  //
+    const VkBuffer objectBuffer,         //
+    const uint32_t objectCount,          //
+    const uint32_t indexCount,           //
+    const vec4 boundingSphere,           //
+    const VkShaderModule shaderModule,   //
+    const VkPipelineCache pipelineCache, //
+    const uint32_t frameCount,           //
+    const VkDevice device,               //
+    DeviceAllocator *pAllocator          //
+);
+
+/// Frees the culler's resources, none of its frames may be in flight
+void delete_GpuCuller(GpuCuller *pCuller, DeviceAllocator *pAllocator);
+
+/// Starts a frame, culling against the frustum of `mvp`
+/// --- PRECONDITIONS ---
+/// * the last frame recorded with `frameIndex` has completed
+void beginGpuCullerFrame(GpuCuller *pCuller, const uint32_t frameIndex,
+                         const mat4x4 mvp);
+
+/// Records the culling pass for the current frame
+/// --- PRECONDITIONS ---
+/// * `commandBuffer` is recording on a queue family with compute support,
+/// outside of a render pass
+/// --- POSTCONDITIONS ---
+/// * the frame's draw buffer is ready for recordGpuCulledDraw
+void recordGpuCulling(const GpuCuller *pCuller,
+                      const VkCommandBuffer commandBuffer);
+
+/// Draws the objects that survived the current frame's culling pass
+/// --- PRECONDITIONS ---
+/// * recordGpuCulling was recorded earlier into `commandBuffer`
+/// * an instanced pipeline, the mesh and the object buffer (at binding 1) are
+/// bound
+void recordGpuCulledDraw(const GpuCuller *pCuller,
+                         const VkCommandBuffer commandBuffer);
+
+#endif /* SRC_GPU_CULLING_H_ */
@@ -0,0 +1,206 @@
+#include "gpu_profiler.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vulkan_utils.h"
+
+// every scope is a begin and an end timestamp
+#define GPU_PROFILER_FRAME_QUERY_COUNT (2 * GPU_PROFILER_MAX_FRAME_SCOPES)
+
+static int compareFloats(const void *a, const void *b) {
+  float fa = *(const float *)a;
+  float fb = *(const float *)b;
+  return ((fa > fb) - (fa < fb));
+}
+
+ErrVal new_GpuProfiler(GpuProfiler *pProfiler, const uint32_t frameCount,
+                       const uint32_t queueFamilyIndex,
+                       const VkPhysicalDevice physicalDevice,
+                       const VkDevice device) {
+  uint32_t queueFamilyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount,
+                                           NULL);
+  VkQueueFamilyProperties *pFamilyProperties =
+      malloc(queueFamilyCount * sizeof(VkQueueFamilyProperties));
+  if (pFamilyProperties == NULL) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "failed to create GPU profiler: %s",
+                   strerror(errno));
+    PANIC();
+  }
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount,
+                                           pFamilyProperties);
+  uint32_t validBits = queueFamilyIndex < queueFamilyCount
+                           ? pFamilyProperties[queueFamilyIndex]
+                                 .timestampValidBits
+                           : 0;
+  free(pFamilyProperties);
+  if (validBits == 0) {
+    LOG_ERROR(ERR_LEVEL_WARN,
+              "failed to create GPU profiler: queue has no timestamps");
+    return (ERR_NOTSUPPORTED);
+  }
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+  pProfiler->device = device;
+  pProfiler->timestampPeriod = properties.limits.timestampPeriod;
+  pProfiler->timestampMask =
+      validBits >= 64 ? UINT64_MAX : (UINT64_C(1) << validBits) - 1;
+  pProfiler->frameCount = frameCount;
+  pProfiler->currentFrame = 0;
+  pProfiler->scopeCount = 0;
+
+  pProfiler->pFrames = calloc(frameCount, sizeof(GpuProfilerFrame));
+  if (pProfiler->pFrames == NULL) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "failed to create GPU profiler: %s",
+                   strerror(errno));
+    PANIC();
+  }
+
+  VkQueryPoolCreateInfo createInfo = {0};
+  createInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  createInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  createInfo.queryCount = GPU_PROFILER_FRAME_QUERY_COUNT;
+  for (uint32_t i = 0; i < frameCount; i++) {
+    VkResult ret = vkCreateQueryPool(device, &createInfo, NULL,
+                                     &pProfiler->pFrames[i].queryPool);
+    if (ret != VK_SUCCESS) {
+      LOG_ERROR_ARGS(ERR_LEVEL_ERROR, "failed to create query pool: %s",
+                     vkstrerror(ret));
+      return (ERR_UNKNOWN);
+    }
+  }
+  return (ERR_OK);
+}
+
+void delete_GpuProfiler(GpuProfiler *pProfiler) {
+  for (uint32_t i = 0; i < pProfiler->frameCount; i++) {
+    vkDestroyQueryPool(pProfiler->device, pProfiler->pFrames[i].queryPool,
+                       NULL);
+  }
+  free(pProfiler->pFrames);
+  pProfiler->pFrames = NULL;
+}
+
+uint32_t getGpuProfilerScope(GpuProfiler *pProfiler, const char *name) {
+  for (uint32_t i = 0; i < pProfiler->scopeCount; i++) {
+    if (strcmp(pProfiler->pScopes[i].name, name) == 0) {
+      return (i);
+    }
+  }
+  if (pProfiler->scopeCount == GPU_PROFILER_MAX_SCOPES) {
+    LOG_ERROR_ARGS(ERR_LEVEL_WARN, "too many GPU profiler scopes for %s",
+                   name);
+    return (GPU_PROFILER_MAX_SCOPES - 1);
+  }
+  GpuProfilerScope *pScope = &pProfiler->pScopes[pProfiler->scopeCount];
+  pScope->name = name;
+  pScope->sampleCount = 0;
+  pScope->nextSample = 0;
+  return (pProfiler->scopeCount++);
+}
+
+void beginGpuProfilerFrame(GpuProfiler *pProfiler, const uint32_t frameIndex) {
+  GpuProfilerFrame *pFrame = &pProfiler->pFrames[frameIndex];
+  if (pFrame->scopeCount != 0) {
+    uint64_t pTimestamps[GPU_PROFILER_FRAME_QUERY_COUNT];
+    // no wait flag, so a result that isn't there yet is VK_NOT_READY
+    VkResult ret = vkGetQueryPoolResults(
+        pProfiler->device, pFrame->queryPool, 0, 2 * pFrame->scopeCount,
+        sizeof(pTimestamps), pTimestamps, sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT);
+    if (ret == VK_SUCCESS) {
+      for (uint32_t i = 0; i < pFrame->scopeCount; i++) {
+        uint64_t ticks = (pTimestamps[2 * i + 1] - pTimestamps[2 * i]) &
+                         pProfiler->timestampMask;
+        GpuProfilerScope *pScope = &pProfiler->pScopes[pFrame->pScopeIds[i]];
+        pScope->pSamples[pScope->nextSample] =
+            (float)((double)ticks * pProfiler->timestampPeriod / 1e6);
+        pScope->nextSample =
+            (pScope->nextSample + 1) % GPU_PROFILER_HISTORY_SIZE;
+        if (pScope->sampleCount < GPU_PROFILER_HISTORY_SIZE) {
+          pScope->sampleCount++;
+        }
+      }
+    } else if (ret != VK_NOT_READY) {
+      LOG_ERROR_ARGS(ERR_LEVEL_WARN, "failed to read GPU timestamps: %s",
+                     vkstrerror(ret));
+    }
+  }
+  pFrame->scopeCount = 0;
+  pProfiler->currentFrame = frameIndex;
+}
+
+void recordGpuProfilerReset(GpuProfiler *pProfiler,
+                            const VkCommandBuffer commandBuffer) {
+  GpuProfilerFrame *pFrame = &pProfiler->pFrames[pProfiler->currentFrame];
+  vkCmdResetQueryPool(commandBuffer, pFrame->queryPool, 0,
+                      GPU_PROFILER_FRAME_QUERY_COUNT);
+}
+
+uint32_t beginGpuProfilerScope(GpuProfiler *pProfiler,
+                               const VkCommandBuffer commandBuffer,
+                               const uint32_t scopeId) {
+  GpuProfilerFrame *pFrame = &pProfiler->pFrames[pProfiler->currentFrame];
+  if (pFrame->scopeCount == GPU_PROFILER_MAX_FRAME_SCOPES) {
+    return (GPU_PROFILER_MAX_FRAME_SCOPES);
+  }
+  uint32_t scope = pFrame->scopeCount++;
+  pFrame->pScopeIds[scope] = scopeId;
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                      pFrame->queryPool, 2 * scope);
+  return (scope);
+}
+
+void endGpuProfilerScope(GpuProfiler *pProfiler,
+                         const VkCommandBuffer commandBuffer,
+                         const uint32_t scope) {
+  if (scope >= GPU_PROFILER_MAX_FRAME_SCOPES) {
+    return;
+  }
+  GpuProfilerFrame *pFrame = &pProfiler->pFrames[pProfiler->currentFrame];
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                      pFrame->queryPool, 2 * scope + 1);
+}
+
+void getGpuProfilerStats(GpuProfilerStats *pStats,
+                         const GpuProfiler *pProfiler, const uint32_t scopeId) {
+  const GpuProfilerScope *pScope = &pProfiler->pScopes[scopeId];
+  pStats->sampleCount = pScope->sampleCount;
+  pStats->minMs = 0.0f;
+  pStats->avgMs = 0.0f;
+  pStats->p99Ms = 0.0f;
+  if (pScope->sampleCount == 0) {
+    return;
+  }
+
+  float pSorted[GPU_PROFILER_HISTORY_SIZE];
+  memcpy(pSorted, pScope->pSamples, pScope->sampleCount * sizeof(float));
+  qsort(pSorted, pScope->sampleCount, sizeof(float), compareFloats);
+
+  double sum = 0.0;
+  for (uint32_t i = 0; i < pScope->sampleCount; i++) {
+    sum += pSorted[i];
+  }
+  // nearest rank: the smallest sample at or above 99% of them
+  uint32_t p99Rank = (pScope->sampleCount * 99 + 99) / 100;
+  pStats->minMs = pSorted[0];
+  pStats->avgMs = (float)(sum / pScope->sampleCount);
+  pStats->p99Ms = pSorted[p99Rank - 1];
+}
+
+void logGpuProfilerStats(const GpuProfiler *pProfiler) {
+  for (uint32_t i = 0; i < pProfiler->scopeCount; i++) {
+    GpuProfilerStats stats;
+    getGpuProfilerStats(&stats, pProfiler, i);
+    LOG_ERROR_ARGS(ERR_LEVEL_INFO,
+                   "gpu time %s: min %.3f ms, avg %.3f ms, p99 %.3f ms over "
+                   "%u samples",
+                   pProfiler->pScopes[i].name, (double)stats.minMs,
+                   (double)stats.avgMs, (double)stats.p99Ms,
+                   stats.sampleCount);
+  }
+}
@@ -0,0 +1,126 @@
+///
+/// Copyright 2019 Govind Pimpale
+/// gpu_profiler.h
+///
+/// Measures how long recorded work takes on the GPU with timestamp queries.
+/// Work is bracketed by named scopes, and each frame in flight has its own
+/// query pool so that a frame's results are only read back once its fence
+/// has signaled, at which point they are ready and reading never stalls.
+/// Each scope keeps a rolling window of samples to report min, average and
+/// 99th percentile times from.
+///
+
+#ifndef SRC_GPU_PROFILER_H_
+#define SRC_GPU_PROFILER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "errors.h"
+
+// most distinct scopes a profiler can track
+#define GPU_PROFILER_MAX_SCOPES 16
+// most scopes that can be recorded into a single frame
+#define GPU_PROFILER_MAX_FRAME_SCOPES 32
+// samples per scope that the statistics are computed over
+#define GPU_PROFILER_HISTORY_SIZE 128
+
+typedef struct {
+  const char *name;
+  // ring of the latest durations, in milliseconds
+  float pSamples[GPU_PROFILER_HISTORY_SIZE];
+  uint32_t sampleCount;
+  uint32_t nextSample;
+} GpuProfilerScope;
+
+typedef struct {
+  VkQueryPool queryPool;
+  // the scope each pair of queries belongs to, in the order they were written
+  uint32_t pScopeIds[GPU_PROFILER_MAX_FRAME_SCOPES];
+  uint32_t scopeCount;
+} GpuProfilerFrame;
+
+typedef struct {
+  VkDevice device;
+  // nanoseconds per timestamp tick
+  float timestampPeriod;
+  uint64_t timestampMask;
+  GpuProfilerFrame *pFrames;
+  uint32_t frameCount;
+  uint32_t currentFrame;
+  GpuProfilerScope pScopes[GPU_PROFILER_MAX_SCOPES];
+  uint32_t scopeCount;
+} GpuProfiler;
+
+typedef struct {
+  uint32_t sampleCount;
+  float minMs;
+  float avgMs;
+  float p99Ms;
+} GpuProfilerStats;
+
+/// Creates a new GPU profiler
+/// --- PRECONDITIONS ---
+/// * `device` was created from `physicalDevice` with a queue from
+/// `queueFamilyIndex`, which the profiled command buffers are submitted to
+/// --- POSTCONDITIONS ---
+/// * returns error status
+/// * returns ERR_NOTSUPPORTED if that queue family can't write timestamps
+/// --- CLEANUP ---
+/// * call delete_GpuProfiler
+ErrVal new_GpuProfiler(GpuProfiler *pProfiler, const uint32_t frameCount,
+                       const uint32_t queueFamilyIndex,
+                       const VkPhysicalDevice physicalDevice,
+                       const VkDevice device);
+
+/// Frees the profiler's resources, none of its frames may be in flight
+void delete_GpuProfiler(GpuProfiler *pProfiler);
+
+/// Returns the id of the scope called `name`, adding it if it is new
+/// --- PRECONDITIONS ---
+/// * `name` outlives the profiler
+/// --- POSTCONDITIONS ---
+/// * once GPU_PROFILER_MAX_SCOPES are in use, new names all share the last
+/// scope
+uint32_t getGpuProfilerScope(GpuProfiler *pProfiler, const char *name);
+
+/// Collects the results of the last frame recorded with `frameIndex`, then
+/// makes it the frame being recorded
+/// --- PRECONDITIONS ---
+/// * the last submit of that frame has completed, e.g. its fence has
+/// signaled
+/// --- POSTCONDITIONS ---
+/// * never blocks, results that somehow aren't available are dropped
+void beginGpuProfilerFrame(GpuProfiler *pProfiler, const uint32_t frameIndex);
+
+/// Resets the current frame's queries
+/// --- PRECONDITIONS ---
+/// * `commandBuffer` is recording, outside of a render pass, and no scope
+/// has been recorded into it yet
+void recordGpuProfilerReset(GpuProfiler *pProfiler,
+                            const VkCommandBuffer commandBuffer);
+
+/// Starts timing `scopeId`
+/// --- POSTCONDITIONS ---
+/// * returns the handle to end the scope with
+/// * past GPU_PROFILER_MAX_FRAME_SCOPES, nothing is recorded and the handle
+/// is ignored by endGpuProfilerScope
+uint32_t beginGpuProfilerScope(GpuProfiler *pProfiler,
+                               const VkCommandBuffer commandBuffer,
+                               const uint32_t scopeId);
+
+/// Stops timing the scope `scope` was returned for
+void endGpuProfilerScope(GpuProfiler *pProfiler,
+                         const VkCommandBuffer commandBuffer,
+                         const uint32_t scope);
+
+/// Computes statistics over the recent samples of `scopeId`
+void getGpuProfilerStats(GpuProfilerStats *pStats,
+                         const GpuProfiler *pProfiler, const uint32_t scopeId);
+
+/// Logs the statistics of every scope at info level
+void logGpuProfilerStats(const GpuProfiler *pProfiler);
+
+#endif /* SRC_GPU_PROFILER_H_ */
@@ -0,0 +1,120 @@
+#include "instancing.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+void setInstanceTransform(InstanceTransform *pInstance, const mat4x4 model) {
+  // linmath is column major, the shader wants rows
+  for (uint32_t row = 0; row < 3; row++) {
+    for (uint32_t col = 0; col < 4; col++) {
+      pInstance->rows[row][col] = model[col][row];
+    }
+  }
+}
+
+void fillInstanceGrid(InstanceTransform *pInstances,
+                      const uint32_t instanceCount, const float spacing,
+                      const mat4x4 meshTransform) {
+  // smallest cube that holds every instance
+  uint32_t side = 1;
+  while ((uint64_t)side * side * side < instanceCount) {
+    side++;
+  }
+  float origin = -0.5f * spacing * (float)(side - 1);
+
+  for (uint32_t i = 0; i < instanceCount; i++) {
+    uint32_t x = i % side;
+    uint32_t y = (i / side) % side;
+    uint32_t z = i / (side * side);
+    mat4x4 translation;
+    mat4x4_translate(translation, origin + spacing * (float)x,
+                     origin + spacing * (float)y,
+                     origin + spacing * (float)z);
+    mat4x4 model;
+    mat4x4_mul(model, translation, meshTransform);
+    setInstanceTransform(&pInstances[i], model);
+  }
+}
+
+void setInstanceGridCpuCuller(CpuCuller *pCuller, const float spacing,
+                              const mat4x4 meshTransform,
+                              const vec4 boundingSphere) {
+  InstanceTransform *pInstances =
+      malloc(pCuller->objectCount * sizeof(InstanceTransform));
+  if (pInstances == NULL) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "failed to bound instances: %s",
+                   strerror(errno));
+    PANIC();
+  }
+  fillInstanceGrid(pInstances, pCuller->objectCount, spacing, meshTransform);
+
+  vec4 localCenter = {boundingSphere[0], boundingSphere[1], boundingSphere[2],
+                      1.0f};
+  for (uint32_t i = 0; i < pCuller->objectCount; i++) {
+    vec4 *pRows = pInstances[i].rows;
+    vec4 sphere;
+    for (uint32_t row = 0; row < 3; row++) {
+      sphere[row] = vec4_mul_inner(pRows[row], localCenter);
+    }
+    // the sphere grows with the longest axis of the transform
+    float maxScale = 0.0f;
+    for (uint32_t col = 0; col < 3; col++) {
+      float scale = pRows[0][col] * pRows[0][col] +
+                    pRows[1][col] * pRows[1][col] +
+                    pRows[2][col] * pRows[2][col];
+      maxScale = scale > maxScale ? scale : maxScale;
+    }
+    sphere[3] = boundingSphere[3] * sqrtf(maxScale);
+    setCpuCullerSphere(pCuller, i, sphere);
+  }
+  free(pInstances);
+}
+
+ErrVal new_InstanceGridBuffer(           //
+    VkBuffer *pBuffer,                   //
+    DeviceAllocation *pBufferAllocation, //
+    const uint32_t instanceCount,        //
+    const float spacing,                 //
+    const mat4x4 meshTransform,          //
+    const VkDevice device,               //
+    DeviceAllocator *pAllocator,         //
+    TransferQueue *pTransferQueue        //
+) {
+  InstanceTransform *pInstances =
+      malloc(instanceCount * sizeof(InstanceTransform));
+  if (pInstances == NULL) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "failed to create instance buffer: %s",
+                   strerror(errno));
+    PANIC();
+  }
+  fillInstanceGrid(pInstances, instanceCount, spacing, meshTransform);
+
+  // instance data is just another vertex buffer, which GPU culling also
+  // reads as a storage buffer
+  VkDeviceSize bufferSize = instanceCount * sizeof(InstanceTransform);
+  ErrVal retVal = new_Buffer_DeviceMemory(
+      pBuffer, pBufferAllocation, bufferSize, pAllocator, device,
+      VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  if (retVal != ERR_OK) {
+    LOG_ERROR(ERR_LEVEL_ERROR, "failed to create instance buffer");
+    free(pInstances);
+    return (retVal);
+  }
+  retVal = stageTransferUpload(pTransferQueue, *pBuffer, 0, pInstances,
+                               bufferSize);
+  // staging has its own copy by now
+  free(pInstances);
+  if (retVal != ERR_OK) {
+    LOG_ERROR(ERR_LEVEL_ERROR,
+              "failed to create instance buffer: could not stage upload");
+    delete_Buffer(pBuffer, device);
+    delete_DeviceMemory(pBufferAllocation, pAllocator);
+    return (retVal);
+  }
+  return (ERR_OK);
+}
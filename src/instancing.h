@@ -0,0 +1,61 @@
+///
+/// Copyright 2019 Govind Pimpale
+/// instancing.h
+///
+/// Helpers for filling the per instance buffers read by the instanced vertex
+/// display pipeline.
+///
+
+#ifndef SRC_INSTANCING_H_
+#define SRC_INSTANCING_H_
+
+#include <stdint.h>
+
+#include <linmath.h>
+
+#include "cpu_culling.h"
+#include "errors.h"
+#include "vulkan_utils.h"
+
+/// Stores the affine part of `model` into `*pInstance`
+void setInstanceTransform(InstanceTransform *pInstance, const mat4x4 model);
+
+/// Lays out `instanceCount` copies of a mesh on a cubic grid centred on the
+/// origin, `spacing` units apart
+/// --- PRECONDITIONS ---
+/// * `pInstances` points to space for `instanceCount` transforms
+/// * `meshTransform` is applied to the mesh before it is placed, e.g. its
+/// dequantization matrix
+void fillInstanceGrid(InstanceTransform *pInstances,
+                      const uint32_t instanceCount, const float spacing,
+                      const mat4x4 meshTransform);
+
+/// Bounds each instance of fillInstanceGrid's layout for CPU culling, with
+/// `boundingSphere` moved by the instance's transform the way cull.comp does
+/// --- PRECONDITIONS ---
+/// * `pCuller` was created with the grid's instance count
+void setInstanceGridCpuCuller(CpuCuller *pCuller, const float spacing,
+                              const mat4x4 meshTransform,
+                              const vec4 boundingSphere);
+
+/// Creates an instance buffer holding fillInstanceGrid's layout
+/// The buffer can be bound as a vertex buffer or a storage buffer
+/// --- PRECONDITIONS ---
+/// * `pTransferQueue` was created for `device`
+/// --- POSTCONDITIONS ---
+/// * returns error status
+/// * on success, the transforms are copied in by the next submitTransferQueue
+/// --- CLEANUP ---
+/// * call delete_Buffer, then delete_DeviceMemory on the allocation
+ErrVal new_InstanceGridBuffer(           //
+    VkBuffer *pBuffer,                   //
+    DeviceAllocation *pBufferAllocation, //
+    const uint32_t instanceCount,        //
+    const float spacing,                 //
+    const mat4x4 meshTransform,          //
+    const VkDevice device,               //
+    DeviceAllocator *pAllocator,         //
+    TransferQueue *pTransferQueue        //
+);
+
+#endif /* SRC_INSTANCING_H_ */
@@ -0,0 +1,188 @@
+#include "linmath_bench.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <linmath.h>
+
+#include "errors.h"
+#include "utils.h"
+
+// every result is summed into this, so that no timed loop is optimized away
+static volatile float benchSink;
+
+static void printLinmathBench(const char *name, const double scalarNs,
+                              const double simdNs) {
+  printf("linmath %-25s scalar: %8.3f ns  %s: %8.3f ns  speedup: %5.2fx\n",
+         name, scalarNs, LINMATH_SIMD_NAME, simdNs,
+         simdNs > 0.0 ? scalarNs / simdNs : 0.0);
+}
+
+// a small rotation, which keeps chained products from blowing up
+static void getBenchRotation(mat4x4 rotation) {
+  mat4x4 identity;
+  mat4x4_identity(identity);
+  mat4x4_rotate_Z(rotation, identity, 0.001f);
+}
+
+static double benchMat4x4Mul(const bool simd) {
+  mat4x4 rotation;
+  getBenchRotation(rotation);
+  mat4x4 product;
+  mat4x4_identity(product);
+
+  double startTime = getTime();
+  if (simd) {
+    for (uint32_t i = 0; i < LINMATH_BENCH_ITERATIONS; i++) {
+      mat4x4_mul(product, product, rotation);
+    }
+  } else {
+    for (uint32_t i = 0; i < LINMATH_BENCH_ITERATIONS; i++) {
+      mat4x4_mul_scalar(product, product, rotation);
+    }
+  }
+  double time = getTime() - startTime;
+  benchSink += product[0][0];
+  return (time * 1e9 / LINMATH_BENCH_ITERATIONS);
+}
+
+static double benchMat4x4MulVec4(const bool simd) {
+  mat4x4 rotation;
+  getBenchRotation(rotation);
+  vec4 v = {1.0f, 0.0f, 0.0f, 1.0f};
+  vec4 r;
+
+  double startTime = getTime();
+  if (simd) {
+    for (uint32_t i = 0; i < LINMATH_BENCH_ITERATIONS; i++) {
+      mat4x4_mul_vec4(r, rotation, v);
+      vec4_dup(v, r);
+    }
+  } else {
+    for (uint32_t i = 0; i < LINMATH_BENCH_ITERATIONS; i++) {
+      mat4x4_mul_vec4_scalar(r, rotation, v);
+      vec4_dup(v, r);
+    }
+  }
+  double time = getTime() - startTime;
+  benchSink += v[0];
+  return (time * 1e9 / LINMATH_BENCH_ITERATIONS);
+}
+
+static double benchMat4x4LookAt(const bool simd) {
+  vec3 center = {0.0f, 0.0f, 0.0f};
+  vec3 up = {0.0f, 1.0f, 0.0f};
+  mat4x4 view;
+  float sum = 0.0f;
+
+  double startTime = getTime();
+  if (simd) {
+    for (uint32_t i = 0; i < LINMATH_BENCH_ITERATIONS; i++) {
+      vec3 eye = {1e-6f * (float)i, 1.0f, 5.0f};
+      mat4x4_look_at(view, eye, center, up);
+      sum += view[3][0];
+    }
+  } else {
+    for (uint32_t i = 0; i < LINMATH_BENCH_ITERATIONS; i++) {
+      vec3 eye = {1e-6f * (float)i, 1.0f, 5.0f};
+      mat4x4_look_at_scalar(view, eye, center, up);
+      sum += view[3][0];
+    }
+  }
+  double time = getTime() - startTime;
+  benchSink += sum;
+  return (time * 1e9 / LINMATH_BENCH_ITERATIONS);
+}
+
+// the batch benchmarks return the time per vector
+static double benchMat4x4MulVec4Batch(const bool simd, const vec4 *pVectors,
+                                      vec4 *pResults) {
+  mat4x4 rotation;
+  getBenchRotation(rotation);
+  float sum = 0.0f;
+
+  double startTime = getTime();
+  if (simd) {
+    for (uint32_t i = 0; i < LINMATH_BENCH_BATCHES; i++) {
+      mat4x4_mul_vec4_batch(pResults, rotation, pVectors,
+                            LINMATH_BENCH_BATCH_SIZE);
+      sum += pResults[i % LINMATH_BENCH_BATCH_SIZE][0];
+    }
+  } else {
+    for (uint32_t i = 0; i < LINMATH_BENCH_BATCHES; i++) {
+      mat4x4_mul_vec4_batch_scalar(pResults, rotation, pVectors,
+                                   LINMATH_BENCH_BATCH_SIZE);
+      sum += pResults[i % LINMATH_BENCH_BATCH_SIZE][0];
+    }
+  }
+  double time = getTime() - startTime;
+  benchSink += sum;
+  return (time * 1e9 / ((double)LINMATH_BENCH_BATCHES *
+                        LINMATH_BENCH_BATCH_SIZE));
+}
+
+static double benchMat4x4MulVec3Batch(const bool simd, const vec3 *pPoints,
+                                      vec4 *pResults) {
+  mat4x4 rotation;
+  getBenchRotation(rotation);
+  float sum = 0.0f;
+
+  double startTime = getTime();
+  if (simd) {
+    for (uint32_t i = 0; i < LINMATH_BENCH_BATCHES; i++) {
+      mat4x4_mul_vec3_batch(pResults, rotation, pPoints,
+                            LINMATH_BENCH_BATCH_SIZE);
+      sum += pResults[i % LINMATH_BENCH_BATCH_SIZE][0];
+    }
+  } else {
+    for (uint32_t i = 0; i < LINMATH_BENCH_BATCHES; i++) {
+      mat4x4_mul_vec3_batch_scalar(pResults, rotation, pPoints,
+                                   LINMATH_BENCH_BATCH_SIZE);
+      sum += pResults[i % LINMATH_BENCH_BATCH_SIZE][0];
+    }
+  }
+  double time = getTime() - startTime;
+  benchSink += sum;
+  return (time * 1e9 / ((double)LINMATH_BENCH_BATCHES *
+                        LINMATH_BENCH_BATCH_SIZE));
+}
+
+void benchLinmath(void) {
+  vec4 *pVectors = malloc(LINMATH_BENCH_BATCH_SIZE * sizeof(vec4));
+  vec3 *pPoints = malloc(LINMATH_BENCH_BATCH_SIZE * sizeof(vec3));
+  vec4 *pResults = malloc(LINMATH_BENCH_BATCH_SIZE * sizeof(vec4));
+  if (pVectors == NULL || pPoints == NULL || pResults == NULL) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "failed to create linmath bench: %s",
+                   strerror(errno));
+    PANIC();
+  }
+  for (uint32_t i = 0; i < LINMATH_BENCH_BATCH_SIZE; i++) {
+    float x = (float)i / LINMATH_BENCH_BATCH_SIZE;
+    pVectors[i][0] = x;
+    pVectors[i][1] = 1.0f - x;
+    pVectors[i][2] = 0.5f * x;
+    pVectors[i][3] = 1.0f;
+    vec3_dup(pPoints[i], pVectors[i]);
+  }
+
+  printLinmathBench("mat4x4_mul", benchMat4x4Mul(false),
+                    benchMat4x4Mul(true));
+  printLinmathBench("mat4x4_mul_vec4", benchMat4x4MulVec4(false),
+                    benchMat4x4MulVec4(true));
+  printLinmathBench("mat4x4_look_at", benchMat4x4LookAt(false),
+                    benchMat4x4LookAt(true));
+  printLinmathBench("mat4x4_mul_vec4_batch/vec",
+                    benchMat4x4MulVec4Batch(false, pVectors, pResults),
+                    benchMat4x4MulVec4Batch(true, pVectors, pResults));
+  printLinmathBench("mat4x4_mul_vec3_batch/vec",
+                    benchMat4x4MulVec3Batch(false, pPoints, pResults),
+                    benchMat4x4MulVec3Batch(true, pPoints, pResults));
+
+  free(pVectors);
+  free(pPoints);
+  free(pResults);
+}
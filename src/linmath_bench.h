@@ -0,0 +1,22 @@
+///
+/// Copyright 2019 Govind Pimpale
+/// linmath_bench.h
+///
+/// Microbenchmarks of the SIMD matrix kernels in linmath.h against their
+/// scalar versions. Nothing here needs a device, so they run before any
+/// Vulkan setup.
+///
+
+#ifndef SRC_LINMATH_BENCH_H_
+#define SRC_LINMATH_BENCH_H_
+
+// single matrix operations timed per kernel
+#define LINMATH_BENCH_ITERATIONS 10000000
+// vectors in each batch, and batches timed per kernel
+#define LINMATH_BENCH_BATCH_SIZE 4096
+#define LINMATH_BENCH_BATCHES 2000
+
+/// Times each kernel with and without SIMD and prints the time per call
+void benchLinmath(void);
+
+#endif /* SRC_LINMATH_BENCH_H_ */
@@ -1,4 +1,6 @@
 #include <errno.h>
+#include <inttypes.h>
+#include <math.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -11,6 +13,23 @@
 #define APPNAME "Vulkan Triangle"
 
 #include "camera.h"
+#include "cpu_culling.h"
+#include "deletion_queue.h"
+#include "frame_bench.h"
+#include "gpu_culling.h"
+#include "gpu_profiler.h"
+#include "instancing.h"
+#include "linmath_bench.h"
+#include "mesh.h"
+#include "offscreen.h"
+#include "parallel_recorder.h"
+#include "pipeline_cache.h"
+#include "pipeline_layouts.h"
+#include "pipeline_variants.h"
+#include "prerecorded_frames.h"
+#include "shader_blob.h"
+#include "shader_reloader.h"
+#include "spirv_analysis.h"
 #include "utils.h"
 #include "vulkan_utils.h"
 
@@ -18,7 +37,44 @@
 
 #define WINDOW_HEIGHT 500
 #define WINDOW_WIDTH 500
-#define MAX_FRAMES_IN_FLIGHT 2
+// frames the CPU may get ahead of the GPU, --frames-in-flight changes it
+#define DEFAULT_FRAMES_IN_FLIGHT 2
+#define MAX_FRAMES_IN_FLIGHT 8
+#define TRANSFER_STAGING_SIZE (16 * 1024 * 1024)
+#define PIPELINE_CACHE_PATH "pipeline.cache"
+// frames averaged into each input latency report
+#define LATENCY_REPORT_FRAMES 120
+// frames between logs of the GPU timings
+#define GPU_TIMING_REPORT_FRAMES 600
+// offscreen images cycled through by --headless unless asked otherwise
+#define HEADLESS_IMAGE_COUNT 3
+
+// distance between instances in the instanced grid
+#define INSTANCE_SPACING 2.0f
+// the packed mesh lies within [-1, 1] on every axis
+#define PACKED_MESH_BOUNDING_RADIUS 1.7320508f
+// frames rendered before and while timing each step of --bench-instances
+#define INSTANCE_BENCH_WARMUP_FRAMES 30
+#define INSTANCE_BENCH_FRAMES 200
+// the scripted camera of --bench-frames circles the scene from just outside
+// it, turning a fixed step each frame so every run renders the same frames
+#define BENCH_ORBIT_MARGIN 3.0f
+#define BENCH_ORBIT_PITCH 0.5f
+#define BENCH_ORBIT_STEP 0.01f
+// draws --bench-record records, one per instance, unless --instances follows
+#define RECORD_BENCH_DRAWS 100000
+
+static const uint32_t pBenchInstanceCounts[] = {1,     10,     100,    1000,
+                                                10000, 100000, 1000000};
+static const uint32_t benchInstanceStepCount =
+    sizeof(pBenchInstanceCounts) / sizeof(pBenchInstanceCounts[0]);
+
+// the present modes --present-mode accepts and P cycles through
+static const VkPresentModeKHR pSelectablePresentModes[] = {
+    VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+    VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR};
+static const uint32_t selectablePresentModeCount =
+    sizeof(pSelectablePresentModes) / sizeof(pSelectablePresentModes[0]);
 
 static uint32_t vertexCount = 6;
 static Vertex vertexData[] = {
@@ -30,8 +86,182 @@ static Vertex vertexData[] = {
     (Vertex){.position = {1.0, 0.0, 1.0}, .color = {0.0, 0.0, 1.0}},
 };
 
-int main(void) {
-  glfwInit();
+// checksums the frame `frame` read back into the offscreen swapchain, and
+// writes it out too if there is a prefix to write it to
+static uint64_t readBackHeadlessFrame(
+    const OffscreenSwapchain *pOffscreenSwapchain, const uint64_t frame,
+    const char *dumpPrefix) {
+  uint32_t imageIndex = (uint32_t)(frame % pOffscreenSwapchain->imageCount);
+  if (dumpPrefix != NULL) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s%06" PRIu64 ".ppm", dumpPrefix, frame);
+    writeOffscreenPpm(pOffscreenSwapchain, imageIndex, path);
+  }
+  return (getOffscreenChecksum(pOffscreenSwapchain, imageIndex));
+}
+
+int main(int argc, char **argv) {
+  /* Instancing is opt in, it needs shader_instanced.vert.spv */
+  bool instanced = false;
+  /* GPU culling draws the instances, it needs cull.comp.spv too */
+  bool gpuCull = false;
+  /* CPU culling tests the instances' bounds before their draws are recorded */
+  bool cpuCull = false;
+  bool benchCull = false;
+  bool benchInstances = false;
+  uint32_t instanceCount = 1;
+  /* FIFO and one image more than the minimum unless asked otherwise */
+  uint32_t presentModeSelection = 0;
+  uint32_t requestedSwapchainImageCount = 0;
+  /* Headless renders a fixed number of frames offscreen, with no window */
+  bool headless = false;
+  uint64_t headlessFrameCount = 0;
+  const char *dumpPrefix = NULL;
+  /* A bench renders a scripted scene and writes its timings out as JSON */
+  uint32_t benchFrameCount = 0;
+  const char *benchJsonPath = "bench.json";
+  uint32_t gridVertexCount = 0;
+  VkExtent2D windowExtent = {.width = WINDOW_WIDTH, .height = WINDOW_HEIGHT};
+  uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT;
+  /* Worker threads record a draw per instance, 0 records on this thread */
+  uint32_t recordThreadCount = 0;
+  bool benchRecord = false;
+  /* A static scene only records each swapchain image's commands once */
+  bool staticScene = false;
+  bool benchLinmathKernels = false;
+  /* Analysis prints the static cost of a SPIR-V file and exits */
+  const char *analyzedSpirvPath = NULL;
+  /* Hot reload rebuilds the pipeline when the GLSL changes, it needs
+   * glslangValidator */
+  bool hotReload = false;
+  /* Debug colours draw a specialized fragment shader once it has compiled */
+  bool debugColors = false;
+  /* Lighting shades faces by their slope, also through a specialization */
+  bool lighting = false;
+  /* Camera updates per second, 0 updates once per frame by the frame's time */
+  double cameraRate = 0.0;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--instances") == 0 && i + 1 < argc) {
+      instanced = true;
+      instanceCount = (uint32_t)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--bench-instances") == 0) {
+      instanced = true;
+      benchInstances = true;
+      instanceCount = pBenchInstanceCounts[0];
+    } else if (strcmp(argv[i], "--present-mode") == 0 && i + 1 < argc) {
+      i++;
+      bool found = false;
+      for (uint32_t j = 0; j < selectablePresentModeCount; j++) {
+        if (strcmp(argv[i],
+                   getPresentModeName(pSelectablePresentModes[j])) == 0) {
+          presentModeSelection = j;
+          found = true;
+        }
+      }
+      if (!found) {
+        LOG_ERROR_ARGS(ERR_LEVEL_WARN, "unknown present mode: %s", argv[i]);
+      }
+    } else if (strcmp(argv[i], "--swapchain-images") == 0 && i + 1 < argc) {
+      requestedSwapchainImageCount = (uint32_t)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--gpu-cull") == 0) {
+      instanced = true;
+      gpuCull = true;
+    } else if (strcmp(argv[i], "--cpu-cull") == 0) {
+      instanced = true;
+      cpuCull = true;
+    } else if (strcmp(argv[i], "--bench-cull") == 0) {
+      benchCull = true;
+    } else if (strcmp(argv[i], "--headless") == 0 && i + 1 < argc) {
+      headless = true;
+      headlessFrameCount = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--dump-ppm") == 0 && i + 1 < argc) {
+      dumpPrefix = argv[++i];
+    } else if (strcmp(argv[i], "--bench-frames") == 0 && i + 1 < argc) {
+      benchFrameCount = (uint32_t)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--bench-json") == 0 && i + 1 < argc) {
+      benchJsonPath = argv[++i];
+    } else if (strcmp(argv[i], "--grid-vertices") == 0 && i + 1 < argc) {
+      gridVertexCount = (uint32_t)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc) {
+      framesInFlight = (uint32_t)strtoul(argv[++i], NULL, 10);
+      if (framesInFlight == 0 || framesInFlight > MAX_FRAMES_IN_FLIGHT) {
+        LOG_ERROR_ARGS(ERR_LEVEL_WARN, "frames in flight must be 1 to %u",
+                       MAX_FRAMES_IN_FLIGHT);
+        framesInFlight = framesInFlight == 0 ? 1 : MAX_FRAMES_IN_FLIGHT;
+      }
+    } else if (strcmp(argv[i], "--record-threads") == 0 && i + 1 < argc) {
+      instanced = true;
+      recordThreadCount = (uint32_t)strtoul(argv[++i], NULL, 10);
+      if (recordThreadCount > PARALLEL_RECORDER_MAX_WORKERS) {
+        LOG_ERROR_ARGS(ERR_LEVEL_WARN, "record threads must be 0 to %u",
+                       PARALLEL_RECORDER_MAX_WORKERS);
+        recordThreadCount = PARALLEL_RECORDER_MAX_WORKERS;
+      }
+    } else if (strcmp(argv[i], "--bench-record") == 0) {
+      instanced = true;
+      benchRecord = true;
+      instanceCount = RECORD_BENCH_DRAWS;
+    } else if (strcmp(argv[i], "--static-scene") == 0) {
+      staticScene = true;
+    } else if (strcmp(argv[i], "--camera-rate") == 0 && i + 1 < argc) {
+      cameraRate = strtod(argv[++i], NULL);
+      if (cameraRate < 0.0) {
+        LOG_ERROR(ERR_LEVEL_WARN, "camera rate can't be negative");
+        cameraRate = 0.0;
+      }
+    } else if (strcmp(argv[i], "--hot-reload") == 0) {
+      hotReload = true;
+    } else if (strcmp(argv[i], "--debug-colors") == 0) {
+      debugColors = true;
+    } else if (strcmp(argv[i], "--lighting") == 0) {
+      lighting = true;
+    } else if (strcmp(argv[i], "--analyze-spirv") == 0 && i + 1 < argc) {
+      analyzedSpirvPath = argv[++i];
+    } else if (strcmp(argv[i], "--bench-linmath") == 0) {
+      benchLinmathKernels = true;
+    } else if (strcmp(argv[i], "--resolution") == 0 && i + 1 < argc) {
+      i++;
+      if (sscanf(argv[i], "%ux%u", &windowExtent.width,
+                 &windowExtent.height) != 2 ||
+          windowExtent.width == 0 || windowExtent.height == 0) {
+        LOG_ERROR_ARGS(ERR_LEVEL_WARN, "bad resolution: %s", argv[i]);
+        windowExtent =
+            (VkExtent2D){.width = WINDOW_WIDTH, .height = WINDOW_HEIGHT};
+      }
+    } else {
+      LOG_ERROR_ARGS(ERR_LEVEL_WARN, "unknown argument: %s", argv[i]);
+    }
+  }
+
+  /* The math and culling microbenchmarks need no window or device */
+  if (benchLinmathKernels) {
+    benchLinmath();
+    return (EXIT_SUCCESS);
+  }
+  if (benchCull) {
+    benchCpuCulling();
+    return (EXIT_SUCCESS);
+  }
+  if (analyzedSpirvPath != NULL) {
+    return (reportSpirvFile(analyzedSpirvPath) ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+
+  if (staticScene &&
+      (gpuCull || cpuCull || recordThreadCount != 0 || benchRecord)) {
+    LOG_ERROR(ERR_LEVEL_WARN, "culling and threaded recording change the "
+                              "commands every frame, not prerecording them");
+    staticScene = false;
+  }
+  if ((debugColors || lighting) && hotReload) {
+    LOG_ERROR(ERR_LEVEL_WARN, "reloaded shaders aren't specialized, not "
+                              "drawing debug colours or lighting");
+    debugColors = false;
+    lighting = false;
+  }
+
+  if (!headless) {
+    glfwInit();
+  }
 
   const uint32_t validationLayerCount = 1;
   const char *ppValidationLayerNames[1] = {"VK_LAYER_KHRONOS_validation"};
@@ -39,7 +269,7 @@ int main(void) {
   /* Create instance */
   VkInstance instance;
   new_Instance(&instance, validationLayerCount, ppValidationLayerNames, 0, NULL,
-               true, true, APPNAME);
+               !headless, true, APPNAME);
 
   /* Enable vulkan logging to stdout */
   VkDebugUtilsMessengerEXT callback;
@@ -50,42 +280,74 @@ int main(void) {
   getPhysicalDevice(&physicalDevice, instance);
 
   /* Create window and surface */
-  GLFWwindow *pWindow;
-  new_GlfwWindow(&pWindow, APPNAME,
-                 (VkExtent2D){.width = WINDOW_WIDTH, .height = WINDOW_HEIGHT});
-  VkSurfaceKHR surface;
-  new_SurfaceFromGLFW(&surface, pWindow, instance);
+  GLFWwindow *pWindow = NULL;
+  VkSurfaceKHR surface = VK_NULL_HANDLE;
+  if (!headless) {
+    new_GlfwWindow(&pWindow, APPNAME, windowExtent);
+    new_SurfaceFromGLFW(&surface, pWindow, instance);
+  }
 
   /* find queues on graphics device */
   uint32_t graphicsIndex;
   uint32_t computeIndex;
   uint32_t presentIndex;
+  uint32_t transferIndex;
   {
+    // culling is recorded with the frame, so graphics needs compute too
     uint32_t ret1 = getQueueFamilyIndexByCapability(
-        &graphicsIndex, physicalDevice, VK_QUEUE_GRAPHICS_BIT);
+        &graphicsIndex, physicalDevice,
+        VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
     uint32_t ret2 = getQueueFamilyIndexByCapability(
         &computeIndex, physicalDevice, VK_QUEUE_COMPUTE_BIT);
-    uint32_t ret3 =
-        getPresentQueueFamilyIndex(&presentIndex, physicalDevice, surface);
+    // nothing is presented headless, so any queue will do
+    uint32_t ret3 = VK_SUCCESS;
+    presentIndex = graphicsIndex;
+    if (!headless) {
+      ret3 = getPresentQueueFamilyIndex(&presentIndex, physicalDevice, surface);
+    }
+    uint32_t ret4 = getTransferQueueFamilyIndex(&transferIndex, physicalDevice);
     /* Panic if indices are unavailable */
-    if (ret1 != VK_SUCCESS || ret2 != VK_SUCCESS || ret3 != VK_SUCCESS) {
+    if (ret1 != VK_SUCCESS || ret2 != VK_SUCCESS || ret3 != VK_SUCCESS ||
+        ret4 != VK_SUCCESS) {
       LOG_ERROR(ERR_LEVEL_FATAL, "unable to acquire indices\n");
       PANIC();
     }
   }
 
   /* Set extent (for now just window width and height) */
-  VkExtent2D swapchainExtent;
-  getExtentWindow(&swapchainExtent, pWindow);
+  VkExtent2D swapchainExtent = windowExtent;
+  if (!headless) {
+    getExtentWindow(&swapchainExtent, pWindow);
+  }
 
   /* we want to use swapchains to reduce tearing */
-  const uint32_t deviceExtensionCount = 1;
+  const uint32_t deviceExtensionCount = headless ? 0 : 1;
   const char *ppDeviceExtensionNames[] = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 
   /*create device */
   VkDevice device;
-  new_Device(&device, physicalDevice, graphicsIndex, deviceExtensionCount,
-             ppDeviceExtensionNames);
+  const uint32_t pQueueFamilyIndices[] = {graphicsIndex, computeIndex,
+                                          presentIndex, transferIndex};
+  if (new_Device(&device, physicalDevice, 4, pQueueFamilyIndices,
+                 deviceExtensionCount, ppDeviceExtensionNames) != ERR_OK) {
+    LOG_ERROR(ERR_LEVEL_FATAL, "unable to create device\n");
+    PANIC();
+  }
+
+  if (gpuCull && !isGpuCullingSupported(physicalDevice)) {
+    LOG_ERROR(ERR_LEVEL_WARN,
+              "GPU culling not supported, drawing every instance instead");
+    gpuCull = false;
+  }
+  if (gpuCull && recordThreadCount != 0) {
+    LOG_ERROR(ERR_LEVEL_WARN,
+              "GPU culling draws indirectly, recording on the main thread");
+    recordThreadCount = 0;
+  }
+  if (gpuCull && cpuCull) {
+    LOG_ERROR(ERR_LEVEL_WARN, "GPU culling replaces CPU culling");
+    cpuCull = false;
+  }
 
   VkQueue graphicsQueue;
   getQueue(&graphicsQueue, device, graphicsIndex);
@@ -94,72 +356,249 @@ int main(void) {
   VkQueue presentQueue;
   getQueue(&presentQueue, device, presentIndex);
 
+  /* Time the GPU side of each frame, if the graphics queue can */
+  // prerecorded frames would reuse the queries of the frame they were
+  // recorded in, so they go untimed
+  GpuProfiler profiler;
+  GpuProfiler *pProfiler = NULL;
+  if (!staticScene &&
+      new_GpuProfiler(&profiler, framesInFlight, graphicsIndex,
+                      physicalDevice, device) == ERR_OK) {
+    pProfiler = &profiler;
+  }
+
+  /* Compiled pipelines are kept on disk between runs */
+  VkPipelineCache pipelineCache;
+  size_t pipelineCacheLoadedSize;
+  new_PipelineCache(&pipelineCache, &pipelineCacheLoadedSize,
+                    PIPELINE_CACHE_PATH, physicalDevice, device);
+
+  /* All buffers and images are carved out of this allocator's blocks */
+  DeviceAllocator allocator;
+  new_DeviceAllocator(&allocator, physicalDevice, device);
+
+  /* Resources replaced while frames are in flight are destroyed through this */
+  DeletionQueue deletionQueue;
+  new_DeletionQueue(&deletionQueue, framesInFlight, device, &allocator);
+
   /* We can create command buffers from the command pool */
   VkCommandPool commandPool;
   new_CommandPool(&commandPool, device, graphicsIndex);
 
   /* get preferred format of screen*/
-  VkSurfaceFormatKHR surfaceFormat;
-  getPreferredSurfaceFormat(&surfaceFormat, physicalDevice, surface);
+  VkSurfaceFormatKHR surfaceFormat = {0};
+  if (headless) {
+    surfaceFormat.format = OFFSCREEN_FORMAT;
+  } else {
+    getPreferredSurfaceFormat(&surfaceFormat, physicalDevice, surface);
+  }
 
   /* Create swap chain */
-  VkSwapchainKHR swapchain;
+  VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+  VkSwapchainKHR swapchain = VK_NULL_HANDLE;
   uint32_t swapchainImageCount;
-  new_Swapchain(&swapchain, &swapchainImageCount, VK_NULL_HANDLE, surfaceFormat,
-                physicalDevice, device, surface, swapchainExtent, graphicsIndex,
-                presentIndex);
+  VkImage *pSwapchainImages = NULL;
+  VkImageView *pSwapchainImageViews = NULL;
+  OffscreenSwapchain offscreenSwapchain = {0};
+  if (headless) {
+    // an image is only reused once the frame that rendered it has completed
+    swapchainImageCount = requestedSwapchainImageCount == 0
+                              ? HEADLESS_IMAGE_COUNT
+                              : requestedSwapchainImageCount;
+    // and read back before it is rendered to again, so one per frame in
+    // flight is needed at least
+    if (swapchainImageCount < framesInFlight) {
+      swapchainImageCount = framesInFlight;
+    }
+    new_OffscreenSwapchain(&offscreenSwapchain, swapchainImageCount,
+                           swapchainExtent, &allocator, device);
+    // the views are owned by the offscreen swapchain
+    pSwapchainImageViews = offscreenSwapchain.pImageViews;
+    LOG_ERROR_ARGS(ERR_LEVEL_INFO, "headless with %u offscreen images",
+                   swapchainImageCount);
+  } else {
+    getPresentMode(&presentMode, pSelectablePresentModes[presentModeSelection],
+                   physicalDevice, surface);
+    new_Swapchain(&swapchain, &swapchainImageCount, VK_NULL_HANDLE,
+                  surfaceFormat, physicalDevice, device, surface,
+                  swapchainExtent, graphicsIndex, presentIndex, presentMode,
+                  requestedSwapchainImageCount);
+    LOG_ERROR_ARGS(ERR_LEVEL_INFO, "present mode %s with %u swapchain images",
+                   getPresentModeName(presentMode), swapchainImageCount);
 
-  // there are swapchainImageCount swapchainImages
-  VkImage *pSwapchainImages = malloc(swapchainImageCount * sizeof(VkImage));
-  getSwapchainImages(pSwapchainImages, swapchainImageCount, device, swapchain);
+    // there are swapchainImageCount swapchainImages
+    pSwapchainImages = malloc(swapchainImageCount * sizeof(VkImage));
+    getSwapchainImages(pSwapchainImages, swapchainImageCount, device,
+                       swapchain);
 
-  // there are swapchainImageCount swapchainImageViews
-  VkImageView *pSwapchainImageViews =
-      malloc(swapchainImageCount * sizeof(VkImageView));
-  new_SwapchainImageViews(pSwapchainImageViews, pSwapchainImages,
-                          swapchainImageCount, device, surfaceFormat.format);
+    // there are swapchainImageCount swapchainImageViews
+    pSwapchainImageViews = malloc(swapchainImageCount * sizeof(VkImageView));
+    new_SwapchainImageViews(pSwapchainImageViews, pSwapchainImages,
+                            swapchainImageCount, device, surfaceFormat.format);
+  }
 
   /* Create depth buffer */
-  VkDeviceMemory depthImageMemory;
+  DeviceAllocation depthImageAllocation;
   VkImage depthImage;
-  new_DepthImage(&depthImage, &depthImageMemory, swapchainExtent,
-                 physicalDevice, device);
+  new_DepthImage(&depthImage, &depthImageAllocation, swapchainExtent,
+                 &allocator, device);
   VkImageView depthImageView;
   new_DepthImageView(&depthImageView, device, depthImage);
 
+  const char *fragShaderPath = "assets/shaders/shader.frag.spv";
+  ShaderInterface fragInterface;
   VkShaderModule fragShaderModule;
-  {
-    uint32_t *fragShaderFileContents;
-    uint32_t fragShaderFileLength;
-    readShaderFile("assets/shaders/shader.frag.spv", &fragShaderFileLength,
-                   &fragShaderFileContents);
-    new_ShaderModule(&fragShaderModule, device, fragShaderFileLength,
-                     fragShaderFileContents);
-    free(fragShaderFileContents);
+  if (new_ShaderModuleFromFile(&fragShaderModule, &fragInterface,
+                               fragShaderPath, device) != ERR_OK) {
+    PANIC();
   }
 
+  // the camera comes from push constants, or a uniform buffer when static
+  const char *vertShaderPath = "assets/shaders/shader.vert.spv";
+  if (instanced && staticScene) {
+    vertShaderPath = "assets/shaders/shader_instanced_uniform.vert.spv";
+  } else if (instanced) {
+    vertShaderPath = "assets/shaders/shader_instanced.vert.spv";
+  } else if (staticScene) {
+    vertShaderPath = "assets/shaders/shader_uniform.vert.spv";
+  }
+  // the pipeline's layout and vertex input come from what the shaders declare
+  ShaderInterface graphicsInterface;
   VkShaderModule vertShaderModule;
-  {
-    uint32_t *vertShaderFileContents;
-    uint32_t vertShaderFileLength;
-    readShaderFile("assets/shaders/shader.vert.spv", &vertShaderFileLength,
-                   &vertShaderFileContents);
-    new_ShaderModule(&vertShaderModule, device, vertShaderFileLength,
-                     vertShaderFileContents);
-    free(vertShaderFileContents);
+  if (new_ShaderModuleFromFile(&vertShaderModule, &graphicsInterface,
+                               vertShaderPath, device) != ERR_OK ||
+      mergeShaderInterface(&graphicsInterface, &fragInterface) != ERR_OK) {
+    PANIC();
   }
 
   /* Create graphics pipeline */
   VkRenderPass renderPass;
-  new_VertexDisplayRenderPass(&renderPass, device, surfaceFormat.format);
+  new_VertexDisplayRenderPass(&renderPass, device, surfaceFormat.format,
+                              headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                                       : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
 
+  // the recording code still supplies the camera itself, so check the
+  // shaders take it the way it is given
+  const ReflectedBinding *pCameraBinding =
+      findReflectedBinding(&graphicsInterface, 0, 0);
+  if (staticScene ? pCameraBinding == NULL ||
+                        pCameraBinding->descriptorType !=
+                            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER
+                  : graphicsInterface.pushConstantSize < sizeof(mat4x4) ||
+                        graphicsInterface.pushConstantStages !=
+                            VK_SHADER_STAGE_VERTEX_BIT) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "%s doesn't read the camera as a %s",
+                   vertShaderPath,
+                   staticScene ? "uniform buffer" : "push constant");
+    PANIC();
+  }
+
+  // layouts are shared by every pipeline whose shaders declare the same
+  PipelineLayoutCache layoutCache;
+  new_PipelineLayoutCache(&layoutCache, device);
+  VkDescriptorSetLayout cameraDescriptorSetLayout = VK_NULL_HANDLE;
   VkPipelineLayout graphicsPipelineLayout;
-  new_VertexDisplayPipelineLayout(&graphicsPipelineLayout, device);
+  if (getReflectedPipelineLayout(&graphicsPipelineLayout, &layoutCache,
+                                 &graphicsInterface) != ERR_OK ||
+      (staticScene && getReflectedDescriptorSetLayout(
+                          &cameraDescriptorSetLayout, &layoutCache,
+                          &graphicsInterface, 0) != ERR_OK)) {
+    PANIC();
+  }
 
+  // time every pipeline built at startup, to see what the cache saves
+  double pipelineCreationTime = getTime();
   VkPipeline graphicsPipeline;
-  new_VertexDisplayPipeline(&graphicsPipeline, device, vertShaderModule,
-                            fragShaderModule, swapchainExtent, renderPass,
-                            graphicsPipelineLayout);
+  ErrVal pipelineRetVal;
+  if (instanced) {
+    pipelineRetVal = new_InstancedVertexDisplayPipeline(
+        &graphicsPipeline, device, pipelineCache, vertShaderModule,
+        fragShaderModule, renderPass, graphicsPipelineLayout,
+        &graphicsInterface, VERTEX_FORMAT_PACKED);
+  } else {
+    pipelineRetVal = new_VertexDisplayPipeline(
+        &graphicsPipeline, device, pipelineCache, vertShaderModule,
+        fragShaderModule, renderPass, graphicsPipelineLayout,
+        &graphicsInterface, VERTEX_FORMAT_PACKED);
+  }
+  if (pipelineRetVal != ERR_OK) {
+    PANIC();
+  }
+  pipelineCreationTime = getTime() - pipelineCreationTime;
+
+  // rebuilt pipelines are swapped in between frames
+  ShaderReloader shaderReloader;
+  ShaderReloader *pShaderReloader = NULL;
+  if (hotReload &&
+      new_ShaderReloader(&shaderReloader, vertShaderPath, fragShaderPath,
+                         instanced, renderPass, graphicsPipelineLayout,
+                         &graphicsInterface, pipelineCache,
+                         device) == ERR_OK) {
+    pShaderReloader = &shaderReloader;
+  }
+
+  // specializations compile on worker threads, frames draw the plain
+  // pipeline until theirs is ready
+  PipelineVariantBuilder variantBuilder;
+  PipelineVariantBuilder *pVariantBuilder = NULL;
+  uint32_t drawVariant = 0;
+  if (debugColors || lighting) {
+    new_PipelineVariantBuilder(&variantBuilder, graphicsPipeline,
+                               vertShaderModule, fragShaderModule, instanced,
+                               renderPass, graphicsPipelineLayout,
+                               &graphicsInterface, pipelineCache, device);
+    pVariantBuilder = &variantBuilder;
+
+    // every vertex format with every combination of the fragment shader's
+    // constants goes through the cache, only the one asked for is drawn
+    VkSpecializationMapEntry pFragEntries[2] = {0};
+    pFragEntries[0].constantID = SPEC_CONSTANT_DEBUG_VERTEX_COLOR;
+    pFragEntries[0].offset = 0;
+    pFragEntries[0].size = sizeof(VkBool32);
+    pFragEntries[1].constantID = SPEC_CONSTANT_LIGHTING;
+    pFragEntries[1].offset = sizeof(VkBool32);
+    pFragEntries[1].size = sizeof(VkBool32);
+    const VertexFormat pVertexFormats[] = {VERTEX_FORMAT_FLOAT,
+                                           VERTEX_FORMAT_PACKED};
+    for (uint32_t format = 0; format < 2; format++) {
+      for (uint32_t constants = 0; constants < 4; constants++) {
+        VkBool32 pFragConstants[2];
+        pFragConstants[0] = (constants & 1) ? VK_TRUE : VK_FALSE;
+        pFragConstants[1] = (constants & 2) ? VK_TRUE : VK_FALSE;
+        // that one is graphicsPipeline itself
+        if (pVertexFormats[format] == VERTEX_FORMAT_PACKED && constants == 0) {
+          continue;
+        }
+        VkSpecializationInfo fragSpecialization = {0};
+        fragSpecialization.mapEntryCount = 2;
+        fragSpecialization.pMapEntries = pFragEntries;
+        fragSpecialization.dataSize = sizeof(pFragConstants);
+        fragSpecialization.pData = pFragConstants;
+        uint32_t variant;
+        if (addPipelineVariant(pVariantBuilder, &variant,
+                               pVertexFormats[format], NULL,
+                               &fragSpecialization) != ERR_OK) {
+          PANIC();
+        }
+        // the vertex buffer is always packed
+        if (pVertexFormats[format] == VERTEX_FORMAT_PACKED &&
+            pFragConstants[0] == (debugColors ? VK_TRUE : VK_FALSE) &&
+            pFragConstants[1] == (lighting ? VK_TRUE : VK_FALSE)) {
+          drawVariant = variant;
+        }
+      }
+    }
+
+    ErrVal workerRetVal = startPipelineVariantWorkers(pVariantBuilder);
+    if (workerRetVal != ERR_OK && pVariantBuilder->threadCount == 0) {
+      delete_PipelineVariantBuilder(pVariantBuilder);
+      pVariantBuilder = NULL;
+    } else if (headless || benchFrameCount != 0) {
+      // runs that are compared against each other draw it from the first
+      // frame
+      waitPipelineVariants(pVariantBuilder);
+    }
+  }
 
   VkFramebuffer *pSwapchainFramebuffers =
       malloc(swapchainImageCount * sizeof(VkFramebuffer));
@@ -167,37 +606,303 @@ int main(void) {
                             swapchainExtent, swapchainImageCount,
                             depthImageView, pSwapchainImageViews);
 
+  /* Geometry is uploaded on the transfer queue while we render */
+  VkPipelineStageFlags uploadStageMask = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+  VkAccessFlags uploadAccessMask =
+      VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+  if (gpuCull) {
+    // the culling pass reads the instances first
+    uploadStageMask |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    uploadAccessMask |= VK_ACCESS_SHADER_READ_BIT;
+  }
+  TransferQueue transferQueue;
+  new_TransferQueue(&transferQueue, device, transferIndex, graphicsIndex,
+                    uploadStageMask, uploadAccessMask, TRANSFER_STAGING_SIZE,
+                    &allocator);
+
+  /* A generated grid stands in for the built in mesh to scale the scene */
+  const Vertex *pSceneVertices = vertexData;
+  uint32_t sceneVertexCount = vertexCount;
+  Vertex *pGridVertices = NULL;
+  if (gridVertexCount != 0) {
+    new_GridTriangleList(&pGridVertices, &sceneVertexCount, gridVertexCount);
+    pSceneVertices = pGridVertices;
+  }
+
+  /* Weld the duplicated vertices and reorder for the vertex cache */
+  IndexedMesh mesh;
+  if (new_IndexedMesh(&mesh, pSceneVertices, sceneVertexCount) != ERR_OK) {
+    PANIC();
+  }
+  free(pGridVertices);
+  float acmrBefore = getAcmr(mesh.pIndices, mesh.indexCount,
+                             MESH_ACMR_CACHE_SIZE);
+  optimizeIndexedMesh(&mesh);
+  float acmrAfter = getAcmr(mesh.pIndices, mesh.indexCount,
+                            MESH_ACMR_CACHE_SIZE);
+  LOG_ERROR_ARGS(ERR_LEVEL_INFO,
+                 "mesh: %u vertices welded to %u, ACMR %.3f before, %.3f after",
+                 sceneVertexCount, mesh.vertexCount, (double)acmrBefore,
+                 (double)acmrAfter);
+
+  /* Halve the vertex size, the shader gets positions relative to the bounds */
+  PackedVertex *pPackedVertices =
+      malloc(mesh.vertexCount * sizeof(PackedVertex));
+  if (pPackedVertices == NULL) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "failed to pack vertices: %s",
+                   strerror(errno));
+    PANIC();
+  }
+  mat4x4 meshDequantization;
+  quantizeVertices(pPackedVertices, meshDequantization, mesh.pVertices,
+                   mesh.vertexCount);
+
   VkBuffer vertexBuffer;
-  VkDeviceMemory vertexBufferMemory;
-  new_VertexBuffer(&vertexBuffer, &vertexBufferMemory, vertexData, vertexCount,
-                   device, physicalDevice, commandPool, graphicsQueue);
+  DeviceAllocation vertexBufferAllocation;
+  new_VertexBuffer(&vertexBuffer, &vertexBufferAllocation, pPackedVertices,
+                   mesh.vertexCount * sizeof(PackedVertex), device, &allocator,
+                   &transferQueue);
+  // the upload has been copied into staging memory already
+  free(pPackedVertices);
+
+  VkBuffer indexBuffer;
+  DeviceAllocation indexBufferAllocation;
+  new_IndexBuffer(&indexBuffer, &indexBufferAllocation, mesh.pIndices,
+                  mesh.indexCount, device, &allocator, &transferQueue);
+
+  // instances carry the dequantization in their transforms
+  VkBuffer instanceBuffer = VK_NULL_HANDLE;
+  DeviceAllocation instanceBufferAllocation = {0};
+  if (instanced) {
+    new_InstanceGridBuffer(&instanceBuffer, &instanceBufferAllocation,
+                           instanceCount, INSTANCE_SPACING, meshDequantization,
+                           device, &allocator, &transferQueue);
+  }
+
+  // the first frame's submit waits on this, nothing else has to
+  TransferTicket uploadTicket;
+  submitTransferQueue(&transferQueue, &uploadTicket);
+
+  const vec4 meshBoundingSphere = {0.0f, 0.0f, 0.0f,
+                                   PACKED_MESH_BOUNDING_RADIUS};
+  CpuCuller cpuCuller;
+  if (cpuCull) {
+    new_CpuCuller(&cpuCuller, instanceCount);
+    setInstanceGridCpuCuller(&cpuCuller, INSTANCE_SPACING, meshDequantization,
+                             meshBoundingSphere);
+  }
+
+  VkShaderModule cullShaderModule = VK_NULL_HANDLE;
+  GpuCuller culler;
+  if (gpuCull) {
+    if (new_ShaderModuleFromFile(&cullShaderModule, NULL,
+                                 "assets/shaders/cull.comp.spv",
+                                 device) != ERR_OK) {
+      PANIC();
+    }
+    double cullerCreationTime = getTime();
+    new_GpuCuller(&culler, instanceBuffer, instanceCount, mesh.indexCount,
+                  meshBoundingSphere, cullShaderModule, pipelineCache,
+                  framesInFlight, device, &allocator);
+    pipelineCreationTime += getTime() - cullerCreationTime;
+  }
+
+  LOG_ERROR_ARGS(ERR_LEVEL_INFO,
+                 "pipeline creation: %.3f ms, %zu bytes of pipeline cache "
+                 "loaded",
+                 pipelineCreationTime * 1000.0, pipelineCacheLoadedSize);
+
+  logDeviceAllocatorStats(&allocator);
+
+  /* Secondaries are recorded by the workers and executed in the render pass */
+  ParallelRecorder recorder;
+  ParallelRecorder *pRecorder = NULL;
+  if (recordThreadCount != 0 && !benchRecord &&
+      new_ParallelRecorder(&recorder, recordThreadCount, framesInFlight,
+                           graphicsIndex, device) == ERR_OK) {
+    pRecorder = &recorder;
+  }
 
   VkCommandBuffer pVertexDisplayCommandBuffers[MAX_FRAMES_IN_FLIGHT];
-  new_CommandBuffers(pVertexDisplayCommandBuffers, MAX_FRAMES_IN_FLIGHT, commandPool, device);
+  new_CommandBuffers(pVertexDisplayCommandBuffers, framesInFlight, commandPool, device);
+
+  // one command buffer and camera uniform buffer per swapchain image
+  PrerecordedFrames prerecordedFrames = {0};
+  if (staticScene) {
+    new_PrerecordedFrames(&prerecordedFrames, swapchainImageCount,
+                          cameraDescriptorSetLayout, commandPool, &allocator,
+                          device);
+  }
 
   // Create image synchronization primitives
   VkSemaphore pImageAvailableSemaphores[MAX_FRAMES_IN_FLIGHT];
-  new_Semaphores(pImageAvailableSemaphores, MAX_FRAMES_IN_FLIGHT, device);
+  new_Semaphores(pImageAvailableSemaphores, framesInFlight, device);
   VkSemaphore pRenderFinishedSemaphores[MAX_FRAMES_IN_FLIGHT];
-  new_Semaphores(pRenderFinishedSemaphores, MAX_FRAMES_IN_FLIGHT, device);
+  new_Semaphores(pRenderFinishedSemaphores, framesInFlight, device);
   VkFence pInFlightFences[MAX_FRAMES_IN_FLIGHT];
-  new_Fences(pInFlightFences, MAX_FRAMES_IN_FLIGHT, device,
+  new_Fences(pInFlightFences, framesInFlight, device,
              true); // fences start off signaled
 
+  // the fence of the frame that last rendered to each swapchain image, so
+  // that with more frames in flight than images, an image still being
+  // rendered to isn't recorded into again
+  VkFence *pImageFences = calloc(swapchainImageCount, sizeof(VkFence));
+
   // create camera
   vec3 loc = {0.0f, 0.0f, 0.0f};
   Camera camera = new_Camera(loc, swapchainExtent);
+  // moves it by the time passed rather than the frames rendered
+  CameraClock cameraClock = new_CameraClock(
+      &camera, cameraRate > 0.0 ? 1.0 / cameraRate : 0.0, getTime());
 
   // this number counts which frame we're on
-  // up to MAX_FRAMES_IN_FLIGHT, at whcich points it resets to 0
+  // up to framesInFlight, at whcich points it resets to 0
   uint32_t currentFrame = 0;
 
+  // progress through --bench-instances
+  uint32_t benchStep = 0;
+  uint32_t benchFrame = 0;
+  double benchStartTime = 0.0;
+
+  // input to frame completion latency, the time from polling the input a
+  // frame is built from to seeing its fence signaled
+  double pFrameInputTimes[MAX_FRAMES_IN_FLIGHT] = {0};
+  double latencySum = 0.0;
+  double latencyMax = 0.0;
+  uint32_t latencyCount = 0;
+
+  uint64_t frameNumber = 0;
+
+  // P switches to the next present mode, which needs a new swapchain
+  bool presentModeKeyDown = false;
+  bool presentModeChanged = false;
+
+  // the headless frame each frame in flight rendered, read back once its
+  // fence signals, and a hash over every frame read back so far
+  uint64_t pHeadlessFrames[MAX_FRAMES_IN_FLIGHT];
+  for (uint32_t i = 0; i < framesInFlight; i++) {
+    pHeadlessFrames[i] = UINT64_MAX;
+  }
+  uint64_t headlessFrame = 0;
+  uint64_t lastChecksum = 0;
+  uint64_t combinedChecksum = UINT64_C(14695981039346656037);
+  double headlessStartTime = getTime();
+
+  bool benchDone = false;
+
+  // time recording the draws with more and more workers, and render nothing
+  if (benchRecord) {
+    ParallelDrawJob job = {0};
+    job.renderPass = renderPass;
+    job.framebuffer = pSwapchainFramebuffers[0];
+    job.pipelineLayout = graphicsPipelineLayout;
+    job.pipeline = graphicsPipeline;
+    job.extent = swapchainExtent;
+    job.vertexBuffer = vertexBuffer;
+    job.indexBuffer = indexBuffer;
+    job.indexCount = mesh.indexCount;
+    job.instanceBuffer = instanceBuffer;
+    job.drawCount = instanceCount;
+    getMvpCamera(job.transform, &camera);
+    uint32_t maxWorkerCount =
+        recordThreadCount != 0 ? recordThreadCount : getProcessorCount();
+    if (maxWorkerCount > PARALLEL_RECORDER_MAX_WORKERS) {
+      maxWorkerCount = PARALLEL_RECORDER_MAX_WORKERS;
+    }
+    benchParallelRecording(&job, maxWorkerCount, graphicsIndex, device);
+    benchDone = true;
+  }
+
+  FrameBench frameBench = {0};
+  uint32_t scriptedFrame = 0;
+  float benchOrbitRadius = BENCH_ORBIT_MARGIN;
+  if (benchFrameCount != 0) {
+    new_FrameBench(&frameBench, benchFrameCount);
+    if (instanced) {
+      benchOrbitRadius += INSTANCE_SPACING * cbrtf((float)instanceCount);
+    }
+  }
+
+  VkPipeline drawPipeline = graphicsPipeline;
+
   /*wait till close*/
-  while (!glfwWindowShouldClose(pWindow)) {
-    glfwPollEvents();
+  while (!benchDone && (headless ? headlessFrame < headlessFrameCount
+                                 : !glfwWindowShouldClose(pWindow))) {
+    if (!headless) {
+      glfwPollEvents();
+      if (glfwGetKey(pWindow, GLFW_KEY_P) == GLFW_PRESS) {
+        if (!presentModeKeyDown) {
+          presentModeSelection =
+              (presentModeSelection + 1) % selectablePresentModeCount;
+          presentModeChanged = true;
+        }
+        presentModeKeyDown = true;
+      } else {
+        presentModeKeyDown = false;
+      }
+    }
+    double inputTime = getTime();
 
     // wait for last frame to finish
     waitAndResetFence(pInFlightFences[currentFrame], device);
+    beginDeletionQueueFrame(&deletionQueue, currentFrame);
+
+    // frames still in flight keep the pipeline they were recorded with
+    VkPipeline reloadedPipeline;
+    if (pShaderReloader != NULL &&
+        takeReloadedPipeline(pShaderReloader, &reloadedPipeline)) {
+      deferDeletePipeline(&deletionQueue, &graphicsPipeline);
+      graphicsPipeline = reloadedPipeline;
+      drawPipeline = graphicsPipeline;
+      if (staticScene) {
+        invalidatePrerecordedFrames(&prerecordedFrames);
+      }
+    }
+    // checked without waiting, until the variant replaces the fallback
+    if (pVariantBuilder != NULL && drawPipeline == graphicsPipeline) {
+      drawPipeline = getPipelineVariant(pVariantBuilder, drawVariant);
+      if (drawPipeline != graphicsPipeline && staticScene) {
+        invalidatePrerecordedFrames(&prerecordedFrames);
+      }
+    }
+    // the CPU's share of the frame starts once it isn't waiting on the GPU
+    double cpuStartTime = getTime();
+
+    if (pHeadlessFrames[currentFrame] != UINT64_MAX) {
+      lastChecksum = readBackHeadlessFrame(
+          &offscreenSwapchain, pHeadlessFrames[currentFrame], dumpPrefix);
+      combinedChecksum =
+          (combinedChecksum ^ lastChecksum) * UINT64_C(1099511628211);
+      pHeadlessFrames[currentFrame] = UINT64_MAX;
+    }
+
+    if (!headless && pFrameInputTimes[currentFrame] != 0.0) {
+      double latency = getTime() - pFrameInputTimes[currentFrame];
+      latencySum += latency;
+      if (latency > latencyMax) {
+        latencyMax = latency;
+      }
+      latencyCount++;
+      if (latencyCount == LATENCY_REPORT_FRAMES) {
+        printf("present mode: %-12s  images: %u  input latency: avg %7.3f ms"
+               "  max %7.3f ms\n",
+               getPresentModeName(presentMode), swapchainImageCount,
+               latencySum / latencyCount * 1000.0, latencyMax * 1000.0);
+        latencySum = 0.0;
+        latencyMax = 0.0;
+        latencyCount = 0;
+      }
+    }
+    pFrameInputTimes[currentFrame] = inputTime;
+
+    // the fence has signaled, so this frame's timestamps are ready
+    if (pProfiler != NULL) {
+      beginGpuProfilerFrame(pProfiler, currentFrame);
+      frameNumber++;
+      if (frameNumber % GPU_TIMING_REPORT_FRAMES == 0) {
+        logGpuProfilerStats(pProfiler);
+      }
+    }
 
     // the imageIndex is the index of the swapchain framebuffer that is
     // available next
@@ -205,39 +910,60 @@ int main(void) {
     // this function will return immediately,
     //  so we use the semaphore to tell us when the image is actually available,
     //  (ready for rendering to)
-    ErrVal result =
-        getNextSwapchainImage(&imageIndex, swapchain, device,
-                              pImageAvailableSemaphores[currentFrame]);
+    // a changed present mode is handled like a resize, but before acquiring
+    // so that no acquired image is thrown away
+    ErrVal result = ERR_OUTOFDATE;
+    if (headless) {
+      // offscreen images are cycled through in order and never go stale
+      imageIndex = (uint32_t)(headlessFrame % swapchainImageCount);
+      result = ERR_OK;
+    } else if (!presentModeChanged) {
+      result = getNextSwapchainImage(&imageIndex, swapchain, device,
+                                     pImageAvailableSemaphores[currentFrame]);
+    }
 
-    // if the window is resized
+    // if the window is resized or the present mode changed
     if (result == ERR_OUTOFDATE) {
-      vkDeviceWaitIdle(device);
-
-      delete_SwapchainFramebuffers(pSwapchainFramebuffers, swapchainImageCount,
-                                   device);
+      // frames in flight may still use these, so they are only destroyed
+      // once this frame's fence signals next, rather than waiting for idle
+      deferDeleteSwapchainFramebuffers(&deletionQueue, pSwapchainFramebuffers,
+                                       swapchainImageCount);
       free(pSwapchainFramebuffers);
-      delete_Pipeline(&graphicsPipeline, device);
-      delete_PipelineLayout(&graphicsPipelineLayout, device);
-      delete_RenderPass(&renderPass, device);
-      delete_SwapchainImageViews(pSwapchainImageViews, swapchainImageCount,
-                                 device);
+      deferDeleteSwapchainImageViews(&deletionQueue, pSwapchainImageViews,
+                                     swapchainImageCount);
       free(pSwapchainImageViews);
       free(pSwapchainImages);
-      delete_Swapchain(&swapchain, device);
 
       // delete depth buffer
-      delete_ImageView(&depthImageView, device);
-      delete_Image(&depthImage, device);
-      delete_DeviceMemory(&depthImageMemory, device);
+      deferDeleteImageView(&deletionQueue, &depthImageView);
+      deferDeleteImage(&deletionQueue, &depthImage);
+      deferDeleteDeviceMemory(&deletionQueue, &depthImageAllocation);
 
       // get new window size
       getExtentWindow(&swapchainExtent, pWindow);
       resizeCamera(&camera, swapchainExtent);
 
       /* recreate swap chain */
-      new_Swapchain(&swapchain, &swapchainImageCount, swapchain, surfaceFormat,
-                    physicalDevice, device, surface, swapchainExtent,
-                    graphicsIndex, presentIndex);
+      if (presentModeChanged) {
+        getPresentMode(&presentMode,
+                       pSelectablePresentModes[presentModeSelection],
+                       physicalDevice, surface);
+        presentModeChanged = false;
+        // don't mix the old mode's latencies into the new one's report
+        latencySum = 0.0;
+        latencyMax = 0.0;
+        latencyCount = 0;
+      }
+      // the old swapchain is retired by the new one and destroyed later
+      VkSwapchainKHR oldSwapchain = swapchain;
+      new_Swapchain(&swapchain, &swapchainImageCount, oldSwapchain,
+                    surfaceFormat, physicalDevice, device, surface,
+                    swapchainExtent, graphicsIndex, presentIndex, presentMode,
+                    requestedSwapchainImageCount);
+      deferDeleteSwapchain(&deletionQueue, &oldSwapchain);
+      LOG_ERROR_ARGS(ERR_LEVEL_INFO,
+                     "present mode %s with %u swapchain images",
+                     getPresentModeName(presentMode), swapchainImageCount);
 
       pSwapchainImages = malloc(swapchainImageCount * sizeof(VkImage));
       getSwapchainImages(pSwapchainImages, swapchainImageCount, device,
@@ -249,71 +975,266 @@ int main(void) {
                               surfaceFormat.format);
 
       // Create depth image
-      new_DepthImage(&depthImage, &depthImageMemory, swapchainExtent,
-                     physicalDevice, device);
+      new_DepthImage(&depthImage, &depthImageAllocation, swapchainExtent,
+                     &allocator, device);
       new_DepthImageView(&depthImageView, device, depthImage);
 
-      /* Create graphics pipeline */
-      new_VertexDisplayRenderPass(&renderPass, device, surfaceFormat.format);
-      new_VertexDisplayPipelineLayout(&graphicsPipelineLayout, device);
-      new_VertexDisplayPipeline(&graphicsPipeline, device, vertShaderModule,
-                                fragShaderModule, swapchainExtent, renderPass,
-                                graphicsPipelineLayout);
+      // the render pass and pipeline don't depend on the extent, since the
+      // surface format stays the same and the viewport is dynamic state
       pSwapchainFramebuffers =
           malloc(swapchainImageCount * sizeof(VkFramebuffer));
       new_SwapchainFramebuffers(pSwapchainFramebuffers, device, renderPass,
                                 swapchainExtent, swapchainImageCount,
                                 depthImageView, pSwapchainImageViews);
 
+      // none of the new images has been rendered to yet
+      free(pImageFences);
+      pImageFences = calloc(swapchainImageCount, sizeof(VkFence));
+
+      // the old images' commands may still be executing
+      if (staticScene) {
+        deferDeletePrerecordedFrames(&prerecordedFrames, &deletionQueue);
+        new_PrerecordedFrames(&prerecordedFrames, swapchainImageCount,
+                              cameraDescriptorSetLayout, commandPool,
+                              &allocator, device);
+      }
+
       // finally we can retry getting the swapchain
       getNextSwapchainImage(&imageIndex, swapchain, device,
                             pImageAvailableSemaphores[currentFrame]);
     }
 
-    // update camera
-    updateCamera(&camera, pWindow);
+    // an earlier frame may still be rendering to this image, unless it was
+    // this frame's last use, whose fence has just been waited on
+    if (pImageFences[imageIndex] != VK_NULL_HANDLE &&
+        pImageFences[imageIndex] != pInFlightFences[currentFrame]) {
+      waitForFence(pImageFences[imageIndex], device);
+    }
+    pImageFences[imageIndex] = pInFlightFences[currentFrame];
+
+    // update camera, headless frames all see the same view, and the scripted
+    // path steps per frame so that every run renders the same frames
     mat4x4 mvp;
-    getMvpCamera(mvp, &camera);
+    if (benchFrameCount != 0) {
+      orbitCamera(&camera, benchOrbitRadius,
+                  BENCH_ORBIT_STEP * (float)scriptedFrame, BENCH_ORBIT_PITCH);
+      scriptedFrame++;
+      getMvpCamera(mvp, &camera);
+    } else if (!headless) {
+      advanceCamera(&camera, &cameraClock, pWindow, inputTime);
+      getInterpolatedMvpCamera(mvp, &camera, &cameraClock);
+    } else {
+      getMvpCamera(mvp, &camera);
+    }
+    if (!instanced) {
+      mat4x4_mul(mvp, mvp, meshDequantization);
+    }
+    if (gpuCull) {
+      beginGpuCullerFrame(&culler, currentFrame, mvp);
+    }
+    if (cpuCull) {
+      cullCpuCuller(&cpuCuller, mvp);
+    }
+    if (pRecorder != NULL) {
+      beginParallelRecorderFrame(pRecorder, currentFrame);
+    }
+
+    // headless frames are copied back to be checksummed
+    VkImage readbackImage = VK_NULL_HANDLE;
+    VkBuffer readbackBuffer = VK_NULL_HANDLE;
+    if (headless) {
+      readbackImage = offscreenSwapchain.pImages[imageIndex];
+      readbackBuffer = offscreenSwapchain.pReadbackBuffers[imageIndex];
+    }
+
+    // a static scene's commands are only recorded again when invalidated or
+    // when they have to take ownership of uploads, which can't be done twice
+    VkCommandBuffer commandBuffer = pVertexDisplayCommandBuffers[currentFrame];
+    VkDescriptorSet cameraDescriptorSet = VK_NULL_HANDLE;
+    TransferQueue *pFrameTransferQueue = &transferQueue;
+    bool record = true;
+    if (staticScene) {
+      setPrerecordedFrameCamera(&prerecordedFrames, imageIndex, mvp);
+      commandBuffer = prerecordedFrames.pCommandBuffers[imageIndex];
+      cameraDescriptorSet = prerecordedFrames.pDescriptorSets[imageIndex];
+      bool acquiring = hasTransferQueueAcquires(&transferQueue);
+      if (!acquiring) {
+        pFrameTransferQueue = NULL;
+      }
+      record = acquiring || !prerecordedFrames.pRecorded[imageIndex];
+      prerecordedFrames.pRecorded[imageIndex] = !acquiring;
+    }
 
     // record buffer
-    recordVertexDisplayCommandBuffer(                //
-        pVertexDisplayCommandBuffers[currentFrame],  //
-        pSwapchainFramebuffers[imageIndex],          //
-        vertexBuffer,                                //
-        vertexCount,                                 //
-        renderPass,                                  //
-        graphicsPipelineLayout,                      //
-        graphicsPipeline,                            //
-        swapchainExtent,                             //
-        mvp,                                         //
-        (VkClearColorValue){.float32 = {0, 0, 0, 0}} //
-    );
+    TransferTicket transferWaitTicket = 0;
+    if (record) {
+      VertexDisplayFrame frame = {0};
+      frame.renderPass = renderPass;
+      frame.framebuffer = pSwapchainFramebuffers[imageIndex];
+      frame.pipelineLayout = graphicsPipelineLayout;
+      frame.pipeline = drawPipeline;
+      frame.extent = swapchainExtent;
+      frame.clearColor = (VkClearColorValue){.float32 = {0, 0, 0, 0}};
+      frame.vertexBuffer = vertexBuffer;
+      frame.indexBuffer = indexBuffer;
+      frame.indexCount = mesh.indexCount;
+      frame.instanceBuffer = instanceBuffer;
+      frame.instanceCount = instanceCount;
+      memcpy(frame.cameraTransform, mvp, sizeof(mat4x4));
+      frame.cameraDescriptorSet = cameraDescriptorSet;
+      frame.readbackImage = readbackImage;
+      frame.readbackBuffer = readbackBuffer;
+      frame.pCuller = gpuCull ? &culler : NULL;
+      frame.pCpuCuller = cpuCull ? &cpuCuller : NULL;
+      frame.pProfiler = pProfiler;
+      frame.pRecorder = pRecorder;
+      recordVertexDisplayCommandBuffer(commandBuffer, pFrameTransferQueue,
+                                       &transferWaitTicket, &frame);
+    }
 
     drawFrame(                                      //
-        pVertexDisplayCommandBuffers[currentFrame], //
+        commandBuffer,                              //
         swapchain,                                  //
         imageIndex,                                 //
         pImageAvailableSemaphores[currentFrame],    //
         pRenderFinishedSemaphores[currentFrame],    //
         pInFlightFences[currentFrame],              //
+        &transferQueue,                             //
+        transferWaitTicket,                         //
         graphicsQueue,                              //
         presentQueue                                //
     );
 
+    if (headless) {
+      pHeadlessFrames[currentFrame] = headlessFrame;
+      headlessFrame++;
+    }
+
+    if (benchFrameCount != 0) {
+      // headless, the submit is the closest thing to a present
+      double presentTime = getTime();
+      recordFrameBenchFrame(&frameBench, presentTime - cpuStartTime,
+                            presentTime, allocator.lifetimeAllocationCount);
+      if (isFrameBenchDone(&frameBench)) {
+        benchDone = true;
+      }
+    }
+
     // increment frame
-    currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    currentFrame = (currentFrame + 1) % framesInFlight;
+
+    if (benchInstances) {
+      benchFrame++;
+      if (benchFrame == INSTANCE_BENCH_WARMUP_FRAMES) {
+        benchStartTime = getTime();
+      } else if (benchFrame ==
+                 INSTANCE_BENCH_WARMUP_FRAMES + INSTANCE_BENCH_FRAMES) {
+        double frameTime =
+            (getTime() - benchStartTime) / INSTANCE_BENCH_FRAMES;
+        printf("instances: %8u  frame: %8.3f ms  throughput: %10.3f M/s\n",
+               instanceCount, frameTime * 1000.0,
+               instanceCount / frameTime / 1e6);
+
+        benchStep++;
+        benchFrame = 0;
+        if (benchStep == benchInstanceStepCount) {
+          benchDone = true;
+        } else {
+          // swap in the next instance count, frames in flight keep reading
+          // the old instances until they are done
+          deferDeleteBuffer(&deletionQueue, &instanceBuffer);
+          deferDeleteDeviceMemory(&deletionQueue, &instanceBufferAllocation);
+          instanceCount = pBenchInstanceCounts[benchStep];
+          new_InstanceGridBuffer(&instanceBuffer, &instanceBufferAllocation,
+                                 instanceCount, INSTANCE_SPACING,
+                                 meshDequantization, device, &allocator,
+                                 &transferQueue);
+          submitTransferQueue(&transferQueue, &uploadTicket);
+          if (staticScene) {
+            invalidatePrerecordedFrames(&prerecordedFrames);
+          }
+          if (cpuCull) {
+            delete_CpuCuller(&cpuCuller);
+            new_CpuCuller(&cpuCuller, instanceCount);
+            setInstanceGridCpuCuller(&cpuCuller, INSTANCE_SPACING,
+                                     meshDequantization, meshBoundingSphere);
+          }
+          if (gpuCull) {
+            // the culler is rebuilt whole, a stall is fine between steps
+            vkDeviceWaitIdle(device);
+            delete_GpuCuller(&culler, &allocator);
+            new_GpuCuller(&culler, instanceBuffer, instanceCount,
+                          mesh.indexCount, meshBoundingSphere,
+                          cullShaderModule, pipelineCache,
+                          framesInFlight, device, &allocator);
+          }
+        }
+      }
+    }
   }
 
   /*cleanup*/
   vkDeviceWaitIdle(device);
+
+  if (headless) {
+    // the frames still in flight, oldest first
+    for (uint32_t i = 0; i < framesInFlight; i++) {
+      uint32_t frame = (currentFrame + i) % framesInFlight;
+      if (pHeadlessFrames[frame] != UINT64_MAX) {
+        lastChecksum = readBackHeadlessFrame(
+            &offscreenSwapchain, pHeadlessFrames[frame], dumpPrefix);
+        combinedChecksum =
+            (combinedChecksum ^ lastChecksum) * UINT64_C(1099511628211);
+      }
+    }
+    double headlessTime = getTime() - headlessStartTime;
+    printf("headless: %" PRIu64 " frames in %.3f s (%.1f fps), checksum %016"
+           PRIx64 ", combined %016" PRIx64 "\n",
+           headlessFrame, headlessTime,
+           headlessTime > 0.0 ? headlessFrame / headlessTime : 0.0,
+           lastChecksum, combinedChecksum);
+  }
+
+  if (benchFrameCount != 0) {
+    GpuProfilerStats gpuStats;
+    if (pProfiler != NULL) {
+      getGpuProfilerStats(&gpuStats, pProfiler,
+                          getGpuProfilerScope(pProfiler, "frame"));
+    }
+    FrameBenchScene scene = {0};
+    scene.vertexCount = mesh.vertexCount;
+    scene.indexCount = mesh.indexCount;
+    scene.instanceCount = instanceCount;
+    scene.width = swapchainExtent.width;
+    scene.height = swapchainExtent.height;
+    scene.headless = headless;
+    scene.presentMode = headless ? "none" : getPresentModeName(presentMode);
+    writeFrameBenchJson(&frameBench, &scene,
+                        pProfiler == NULL ? NULL : &gpuStats, benchJsonPath);
+    delete_FrameBench(&frameBench);
+  }
+
+  if (pShaderReloader != NULL) {
+    delete_ShaderReloader(pShaderReloader);
+  }
+  if (pVariantBuilder != NULL) {
+    delete_PipelineVariantBuilder(pVariantBuilder);
+  }
   delete_ShaderModule(&fragShaderModule, device);
   delete_ShaderModule(&vertShaderModule, device);
 
-  delete_Fences(pInFlightFences, MAX_FRAMES_IN_FLIGHT, device);
-  delete_Semaphores(pRenderFinishedSemaphores, MAX_FRAMES_IN_FLIGHT, device);
-  delete_Semaphores(pImageAvailableSemaphores, MAX_FRAMES_IN_FLIGHT, device);
+  free(pImageFences);
+  delete_Fences(pInFlightFences, framesInFlight, device);
+  delete_Semaphores(pRenderFinishedSemaphores, framesInFlight, device);
+  delete_Semaphores(pImageAvailableSemaphores, framesInFlight, device);
 
-  delete_CommandBuffers(pVertexDisplayCommandBuffers, MAX_FRAMES_IN_FLIGHT,
+  if (pRecorder != NULL) {
+    delete_ParallelRecorder(pRecorder);
+  }
+  if (staticScene) {
+    delete_PrerecordedFrames(&prerecordedFrames, &allocator);
+  }
+  delete_CommandBuffers(pVertexDisplayCommandBuffers, framesInFlight,
                         commandPool, device);
   delete_CommandPool(&commandPool, device);
 
@@ -321,22 +1242,53 @@ int main(void) {
                                device);
   free(pSwapchainFramebuffers);
   delete_Pipeline(&graphicsPipeline, device);
-  delete_PipelineLayout(&graphicsPipelineLayout, device);
+  delete_PipelineLayoutCache(&layoutCache);
   delete_Buffer(&vertexBuffer, device);
-  delete_DeviceMemory(&vertexBufferMemory, device);
+  delete_DeviceMemory(&vertexBufferAllocation, &allocator);
+  if (gpuCull) {
+    delete_GpuCuller(&culler, &allocator);
+    delete_ShaderModule(&cullShaderModule, device);
+  }
+  if (cpuCull) {
+    delete_CpuCuller(&cpuCuller);
+  }
+  if (instanced) {
+    delete_Buffer(&instanceBuffer, device);
+    delete_DeviceMemory(&instanceBufferAllocation, &allocator);
+  }
+  delete_Buffer(&indexBuffer, device);
+  delete_DeviceMemory(&indexBufferAllocation, &allocator);
+  delete_IndexedMesh(&mesh);
+  delete_TransferQueue(&transferQueue, &allocator);
   delete_RenderPass(&renderPass, device);
-  delete_SwapchainImageViews(pSwapchainImageViews, swapchainImageCount, device);
-  free(pSwapchainImageViews);
-  free(pSwapchainImages);
-  delete_Swapchain(&swapchain, device);
+  if (headless) {
+    delete_OffscreenSwapchain(&offscreenSwapchain, &allocator, device);
+  } else {
+    delete_SwapchainImageViews(pSwapchainImageViews, swapchainImageCount,
+                               device);
+    free(pSwapchainImageViews);
+    free(pSwapchainImages);
+    delete_Swapchain(&swapchain, device);
+  }
   delete_ImageView(&depthImageView, device);
   delete_Image(&depthImage, device);
-  delete_DeviceMemory(&depthImageMemory, device);
+  delete_DeviceMemory(&depthImageAllocation, &allocator);
+  delete_DeletionQueue(&deletionQueue);
+  delete_DeviceAllocator(&allocator);
+  if (pProfiler != NULL) {
+    delete_GpuProfiler(pProfiler);
+  }
+  savePipelineCache(pipelineCache, PIPELINE_CACHE_PATH, device);
+  delete_PipelineCache(&pipelineCache, device);
   delete_Device(&device);
-  delete_Surface(&surface, instance);
+  if (!headless) {
+    delete_Surface(&surface, instance);
+  }
   delete_DebugCallback(&callback, instance);
   delete_Instance(&instance);
 
-  glfwTerminate();
+  if (!headless) {
+    glfwTerminate();
+  }
   return (EXIT_SUCCESS);
 }
@@ -0,0 +1,476 @@
+#include "memory_allocator.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vulkan/vulkan.h>
+
+#include "vulkan_utils.h"
+
+static VkDeviceSize alignUp(const VkDeviceSize value,
+                            const VkDeviceSize alignment) {
+  return ((value + alignment - 1) / alignment) * alignment;
+}
+
+// true if the last byte of resource A and the first byte of resource B land on
+// the same page of size `pageSize` (which must be a power of two)
+static bool onSamePage(const VkDeviceSize aOffset, const VkDeviceSize aSize,
+                       const VkDeviceSize bOffset,
+                       const VkDeviceSize pageSize) {
+  VkDeviceSize aEndPage = (aOffset + aSize - 1) & ~(pageSize - 1);
+  VkDeviceSize bStartPage = bOffset & ~(pageSize - 1);
+  return (aEndPage == bStartPage);
+}
+
+static bool isHostVisible(const DeviceAllocator *pAllocator,
+                          const uint32_t memoryTypeIndex) {
+  return (pAllocator->memoryProperties.memoryTypes[memoryTypeIndex]
+              .propertyFlags &
+          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+}
+
+static bool isHostCoherent(const DeviceAllocator *pAllocator,
+                           const uint32_t memoryTypeIndex) {
+  return (pAllocator->memoryProperties.memoryTypes[memoryTypeIndex]
+              .propertyFlags &
+          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+}
+
+static uint32_t getTotalBlockCount(const DeviceAllocator *pAllocator) {
+  uint32_t total = 0;
+  for (uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; i++) {
+    total += pAllocator->pPools[i].blockCount;
+  }
+  return (total);
+}
+
+// makes room for `count` more ranges
+static void reserveRanges(DeviceMemoryBlock *pBlock, const uint32_t count) {
+  uint32_t newCapacity = pBlock->rangeCapacity;
+  while (pBlock->rangeCount + count > newCapacity) {
+    newCapacity *= 2;
+  }
+  if (newCapacity == pBlock->rangeCapacity) {
+    return;
+  }
+  DeviceMemoryRange *pNewRanges =
+      realloc(pBlock->pRanges, newCapacity * sizeof(DeviceMemoryRange));
+  if (pNewRanges == NULL) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "failed to grow memory block: %s",
+                   strerror(errno));
+    PANIC();
+  }
+  pBlock->pRanges = pNewRanges;
+  pBlock->rangeCapacity = newCapacity;
+}
+
+// inserts `range` at `index`, shifting later ranges up, there has to be room
+// for it, see reserveRanges
+static void insertRange(DeviceMemoryBlock *pBlock, const uint32_t index,
+                        const DeviceMemoryRange range) {
+  memmove(&pBlock->pRanges[index + 1], &pBlock->pRanges[index],
+          (pBlock->rangeCount - index) * sizeof(DeviceMemoryRange));
+  pBlock->pRanges[index] = range;
+  pBlock->rangeCount++;
+}
+
+static void removeRange(DeviceMemoryBlock *pBlock, const uint32_t index) {
+  memmove(&pBlock->pRanges[index], &pBlock->pRanges[index + 1],
+          (pBlock->rangeCount - index - 1) * sizeof(DeviceMemoryRange));
+  pBlock->rangeCount--;
+}
+
+static ErrVal new_DeviceMemoryBlock(DeviceMemoryBlock **ppBlock,
+                                    const VkDeviceSize size,
+                                    const uint32_t memoryTypeIndex,
+                                    const DeviceAllocator *pAllocator) {
+  if (getTotalBlockCount(pAllocator) >= pAllocator->maxMemoryAllocationCount) {
+    LOG_ERROR_ARGS(ERR_LEVEL_ERROR,
+                   "failed to allocate memory block: would exceed "
+                   "maxMemoryAllocationCount (%u)",
+                   pAllocator->maxMemoryAllocationCount);
+    return (ERR_ALLOCFAIL);
+  }
+
+  DeviceMemoryBlock *pBlock = malloc(sizeof(DeviceMemoryBlock));
+  if (pBlock == NULL) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "failed to allocate memory block: %s",
+                   strerror(errno));
+    PANIC();
+  }
+
+  VkMemoryAllocateInfo allocateInfo = {0};
+  allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocateInfo.allocationSize = size;
+  allocateInfo.memoryTypeIndex = memoryTypeIndex;
+  VkResult allocateResult = vkAllocateMemory(pAllocator->device, &allocateInfo,
+                                             NULL, &pBlock->memory);
+  if (allocateResult != VK_SUCCESS) {
+    LOG_ERROR_ARGS(ERR_LEVEL_ERROR, "failed to allocate memory block: %s",
+                   vkstrerror(allocateResult));
+    free(pBlock);
+    return (ERR_ALLOCFAIL);
+  }
+
+  pBlock->pMapped = NULL;
+  if (isHostVisible(pAllocator, memoryTypeIndex)) {
+    VkResult mapResult = vkMapMemory(pAllocator->device, pBlock->memory, 0,
+                                     VK_WHOLE_SIZE, 0, &pBlock->pMapped);
+    if (mapResult != VK_SUCCESS) {
+      LOG_ERROR_ARGS(ERR_LEVEL_ERROR, "failed to map memory block: %s",
+                     vkstrerror(mapResult));
+      vkFreeMemory(pAllocator->device, pBlock->memory, NULL);
+      free(pBlock);
+      return (ERR_MEMORY);
+    }
+  }
+
+  pBlock->size = size;
+  pBlock->rangeCapacity = 16;
+  pBlock->pRanges = malloc(pBlock->rangeCapacity * sizeof(DeviceMemoryRange));
+  if (pBlock->pRanges == NULL) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "failed to allocate memory block: %s",
+                   strerror(errno));
+    PANIC();
+  }
+  pBlock->pRanges[0] = (DeviceMemoryRange){
+      .offset = 0, .size = size, .kind = DEVICE_ALLOCATION_KIND_FREE};
+  pBlock->rangeCount = 1;
+  pBlock->allocationCount = 0;
+
+  *ppBlock = pBlock;
+  return (ERR_OK);
+}
+
+static void delete_DeviceMemoryBlock(DeviceMemoryBlock **ppBlock,
+                                     const VkDevice device) {
+  DeviceMemoryBlock *pBlock = *ppBlock;
+  if (pBlock->pMapped != NULL) {
+    vkUnmapMemory(device, pBlock->memory);
+  }
+  vkFreeMemory(device, pBlock->memory, NULL);
+  free(pBlock->pRanges);
+  free(pBlock);
+  *ppBlock = NULL;
+}
+
+// Tries to fit an allocation in `pBlock`.
+// Returns true and sets `*pOffset` on success.
+static bool findRangeInBlock(VkDeviceSize *pOffset, uint32_t *pRangeIndex,
+                             const DeviceMemoryBlock *pBlock,
+                             const VkDeviceSize size,
+                             const VkDeviceSize alignment,
+                             const DeviceAllocationKind kind,
+                             const VkDeviceSize granularity) {
+  for (uint32_t i = 0; i < pBlock->rangeCount; i++) {
+    const DeviceMemoryRange *pRange = &pBlock->pRanges[i];
+    if (pRange->kind != DEVICE_ALLOCATION_KIND_FREE || pRange->size < size) {
+      continue;
+    }
+
+    VkDeviceSize offset = alignUp(pRange->offset, alignment);
+
+    // free ranges are always merged, so our neighbours are in use.
+    // if the previous one is of a different kind and shares a page with us,
+    // push our start to the next page
+    if (granularity > 1 && i > 0) {
+      const DeviceMemoryRange *pPrev = &pBlock->pRanges[i - 1];
+      if (pPrev->kind != kind &&
+          onSamePage(pPrev->offset, pPrev->size, offset, granularity)) {
+        offset = alignUp(offset, granularity);
+      }
+    }
+
+    if (offset + size > pRange->offset + pRange->size) {
+      continue;
+    }
+
+    // we can't move the next resource, so just skip this range if we'd collide
+    if (granularity > 1 && i + 1 < pBlock->rangeCount) {
+      const DeviceMemoryRange *pNext = &pBlock->pRanges[i + 1];
+      if (pNext->kind != kind &&
+          onSamePage(offset, size, pNext->offset, granularity)) {
+        continue;
+      }
+    }
+
+    *pOffset = offset;
+    *pRangeIndex = i;
+    return (true);
+  }
+  return (false);
+}
+
+// Splits the free range at `rangeIndex` so that [offset, offset+size) is used
+static void claimRange(DeviceMemoryBlock *pBlock, const uint32_t rangeIndex,
+                       const VkDeviceSize offset, const VkDeviceSize size,
+                       const DeviceAllocationKind kind) {
+  // the range may be split in three, growing the array once up front also
+  // keeps -fanalyzer from losing track of it
+  reserveRanges(pBlock, 2);
+  DeviceMemoryRange freeRange = pBlock->pRanges[rangeIndex];
+  VkDeviceSize padding = offset - freeRange.offset;
+  VkDeviceSize remaining = freeRange.size - padding - size;
+
+  uint32_t index = rangeIndex;
+  if (padding > 0) {
+    pBlock->pRanges[index].size = padding;
+    index++;
+    insertRange(pBlock, index,
+                (DeviceMemoryRange){
+                    .offset = offset, .size = size, .kind = kind});
+  } else {
+    pBlock->pRanges[index] =
+        (DeviceMemoryRange){.offset = offset, .size = size, .kind = kind};
+  }
+
+  if (remaining > 0) {
+    insertRange(pBlock, index + 1,
+                (DeviceMemoryRange){.offset = offset + size,
+                                    .size = remaining,
+                                    .kind = DEVICE_ALLOCATION_KIND_FREE});
+  }
+  pBlock->allocationCount++;
+}
+
+ErrVal new_DeviceAllocator(DeviceAllocator *pAllocator,
+                           const VkPhysicalDevice physicalDevice,
+                           const VkDevice device) {
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+  pAllocator->device = device;
+  pAllocator->physicalDevice = physicalDevice;
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice,
+                                      &pAllocator->memoryProperties);
+  pAllocator->bufferImageGranularity =
+      properties.limits.bufferImageGranularity;
+  pAllocator->nonCoherentAtomSize = properties.limits.nonCoherentAtomSize;
+  pAllocator->maxMemoryAllocationCount =
+      properties.limits.maxMemoryAllocationCount;
+  pAllocator->blockSize = DEVICE_MEMORY_BLOCK_SIZE;
+  pAllocator->lifetimeAllocationCount = 0;
+
+  for (uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; i++) {
+    pAllocator->pPools[i].ppBlocks = NULL;
+    pAllocator->pPools[i].blockCount = 0;
+  }
+  return (ERR_OK);
+}
+
+void delete_DeviceAllocator(DeviceAllocator *pAllocator) {
+  for (uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; i++) {
+    DeviceMemoryPool *pPool = &pAllocator->pPools[i];
+    for (uint32_t j = 0; j < pPool->blockCount; j++) {
+      if (pPool->ppBlocks[j]->allocationCount != 0) {
+        LOG_ERROR_ARGS(ERR_LEVEL_WARN,
+                       "memory block still has %u live allocations",
+                       pPool->ppBlocks[j]->allocationCount);
+      }
+      delete_DeviceMemoryBlock(&pPool->ppBlocks[j], pAllocator->device);
+    }
+    free(pPool->ppBlocks);
+    pPool->ppBlocks = NULL;
+    pPool->blockCount = 0;
+  }
+}
+
+ErrVal allocateDeviceMemory(DeviceAllocation *pAllocation,
+                            DeviceAllocator *pAllocator,
+                            const VkMemoryRequirements requirements,
+                            const VkMemoryPropertyFlags properties,
+                            const DeviceAllocationKind kind) {
+  uint32_t memoryTypeIndex;
+  ErrVal memoryTypeRetVal =
+      getMemoryTypeIndex(&memoryTypeIndex, requirements.memoryTypeBits,
+                         properties, pAllocator->physicalDevice);
+  if (memoryTypeRetVal != ERR_OK) {
+    LOG_ERROR(ERR_LEVEL_ERROR, "failed to get type of memory to allocate");
+    return (ERR_MEMORY);
+  }
+
+  // keep non coherent allocations on their own atoms so a flush never spills
+  // into a neighbour
+  VkDeviceSize alignment = requirements.alignment;
+  VkDeviceSize size = requirements.size;
+  if (isHostVisible(pAllocator, memoryTypeIndex) &&
+      !isHostCoherent(pAllocator, memoryTypeIndex)) {
+    if (alignment < pAllocator->nonCoherentAtomSize) {
+      alignment = pAllocator->nonCoherentAtomSize;
+    }
+    size = alignUp(size, pAllocator->nonCoherentAtomSize);
+  }
+
+  DeviceMemoryPool *pPool = &pAllocator->pPools[memoryTypeIndex];
+  DeviceMemoryBlock *pBlock = NULL;
+  VkDeviceSize offset = 0;
+  uint32_t rangeIndex = 0;
+
+  // big resources get a dedicated block, everything else shares
+  bool dedicated = size > pAllocator->blockSize / 2;
+  if (!dedicated) {
+    for (uint32_t i = 0; i < pPool->blockCount; i++) {
+      if (findRangeInBlock(&offset, &rangeIndex, pPool->ppBlocks[i], size,
+                           alignment, kind,
+                           pAllocator->bufferImageGranularity)) {
+        pBlock = pPool->ppBlocks[i];
+        break;
+      }
+    }
+  }
+
+  if (pBlock == NULL) {
+    VkDeviceSize blockSize = dedicated ? size : pAllocator->blockSize;
+    DeviceMemoryBlock **ppNewBlocks = realloc(
+        pPool->ppBlocks, (pPool->blockCount + 1) * sizeof(DeviceMemoryBlock *));
+    if (ppNewBlocks == NULL) {
+      LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "failed to grow memory pool: %s",
+                     strerror(errno));
+      PANIC();
+    }
+    pPool->ppBlocks = ppNewBlocks;
+
+    ErrVal blockRetVal =
+        new_DeviceMemoryBlock(&pBlock, blockSize, memoryTypeIndex, pAllocator);
+    if (blockRetVal != ERR_OK) {
+      return (blockRetVal);
+    }
+    pPool->ppBlocks[pPool->blockCount] = pBlock;
+    pPool->blockCount++;
+
+    // a new block is one free range, so this always succeeds
+    findRangeInBlock(&offset, &rangeIndex, pBlock, size, alignment, kind,
+                     pAllocator->bufferImageGranularity);
+  }
+
+  claimRange(pBlock, rangeIndex, offset, size, kind);
+  pAllocator->lifetimeAllocationCount++;
+
+  pAllocation->memory = pBlock->memory;
+  pAllocation->offset = offset;
+  pAllocation->size = size;
+  pAllocation->memoryTypeIndex = memoryTypeIndex;
+  pAllocation->pBlock = pBlock;
+  pAllocation->pMapped =
+      pBlock->pMapped == NULL ? NULL : (uint8_t *)pBlock->pMapped + offset;
+  return (ERR_OK);
+}
+
+void freeDeviceMemory(DeviceAllocation *pAllocation,
+                      DeviceAllocator *pAllocator) {
+  DeviceMemoryBlock *pBlock = pAllocation->pBlock;
+  if (pBlock == NULL) {
+    return;
+  }
+
+  // ranges are sorted, so binary search for ours
+  uint32_t lo = 0;
+  uint32_t hi = pBlock->rangeCount;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (pBlock->pRanges[mid].offset < pAllocation->offset) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if (lo == pBlock->rangeCount ||
+      pBlock->pRanges[lo].offset != pAllocation->offset ||
+      pBlock->pRanges[lo].kind == DEVICE_ALLOCATION_KIND_FREE) {
+    LOG_ERROR(ERR_LEVEL_ERROR, "tried to free memory that was not allocated");
+    return;
+  }
+
+  uint32_t index = lo;
+  pBlock->pRanges[index].kind = DEVICE_ALLOCATION_KIND_FREE;
+
+  // merge with the next range
+  if (index + 1 < pBlock->rangeCount &&
+      pBlock->pRanges[index + 1].kind == DEVICE_ALLOCATION_KIND_FREE) {
+    pBlock->pRanges[index].size += pBlock->pRanges[index + 1].size;
+    removeRange(pBlock, index + 1);
+  }
+  // merge with the previous range
+  if (index > 0 &&
+      pBlock->pRanges[index - 1].kind == DEVICE_ALLOCATION_KIND_FREE) {
+    pBlock->pRanges[index - 1].size += pBlock->pRanges[index].size;
+    removeRange(pBlock, index);
+  }
+  pBlock->allocationCount--;
+
+  // give empty blocks back to the driver, but keep one around per memory type
+  // so that allocating and freeing in a loop doesn't thrash
+  DeviceMemoryPool *pPool = &pAllocator->pPools[pAllocation->memoryTypeIndex];
+  if (pBlock->allocationCount == 0 &&
+      (pPool->blockCount > 1 || pBlock->size != pAllocator->blockSize)) {
+    for (uint32_t i = 0; i < pPool->blockCount; i++) {
+      if (pPool->ppBlocks[i] == pBlock) {
+        delete_DeviceMemoryBlock(&pPool->ppBlocks[i], pAllocator->device);
+        pPool->ppBlocks[i] = pPool->ppBlocks[pPool->blockCount - 1];
+        pPool->blockCount--;
+        break;
+      }
+    }
+  }
+
+  *pAllocation = (DeviceAllocation){0};
+}
+
+ErrVal flushDeviceMemory(const DeviceAllocation *pAllocation,
+                         const DeviceAllocator *pAllocator) {
+  if (isHostCoherent(pAllocator, pAllocation->memoryTypeIndex)) {
+    return (ERR_OK);
+  }
+  // allocations of non coherent types are already atom aligned
+  VkMappedMemoryRange range = {0};
+  range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+  range.memory = pAllocation->memory;
+  range.offset = pAllocation->offset;
+  range.size = pAllocation->size;
+  VkResult res = vkFlushMappedMemoryRanges(pAllocator->device, 1, &range);
+  if (res != VK_SUCCESS) {
+    LOG_ERROR_ARGS(ERR_LEVEL_ERROR, "failed to flush mapped memory: %s",
+                   vkstrerror(res));
+    return (ERR_MEMORY);
+  }
+  return (ERR_OK);
+}
+
+void getDeviceAllocatorStats(DeviceAllocatorStats *pStats,
+                             const DeviceAllocator *pAllocator) {
+  *pStats = (DeviceAllocatorStats){0};
+  pStats->lifetimeAllocationCount = pAllocator->lifetimeAllocationCount;
+  for (uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; i++) {
+    const DeviceMemoryPool *pPool = &pAllocator->pPools[i];
+    for (uint32_t j = 0; j < pPool->blockCount; j++) {
+      const DeviceMemoryBlock *pBlock = pPool->ppBlocks[j];
+      pStats->blockCount++;
+      pStats->blockBytes += pBlock->size;
+      pStats->allocationCount += pBlock->allocationCount;
+      for (uint32_t k = 0; k < pBlock->rangeCount; k++) {
+        const DeviceMemoryRange *pRange = &pBlock->pRanges[k];
+        if (pRange->kind == DEVICE_ALLOCATION_KIND_FREE) {
+          if (pRange->size > pStats->largestFreeRange) {
+            pStats->largestFreeRange = pRange->size;
+          }
+        } else {
+          pStats->allocationBytes += pRange->size;
+        }
+      }
+    }
+  }
+}
+
+void logDeviceAllocatorStats(const DeviceAllocator *pAllocator) {
+  DeviceAllocatorStats stats;
+  getDeviceAllocatorStats(&stats, pAllocator);
+  LOG_ERROR_ARGS(ERR_LEVEL_INFO,
+                 "device memory: %u allocations in %u blocks, %" PRIu64
+                 " of %" PRIu64 " bytes used, largest free range %" PRIu64,
+                 stats.allocationCount, stats.blockCount,
+                 (uint64_t)stats.allocationBytes, (uint64_t)stats.blockBytes,
+                 (uint64_t)stats.largestFreeRange);
+}
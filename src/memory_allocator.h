@@ -0,0 +1,154 @@
+///
+/// Copyright 2019 Govind Pimpale
+/// memory_allocator.h
+///
+/// Sub-allocates buffers and images out of large VkDeviceMemory blocks, so
+/// that we don't pay for one vkAllocateMemory per resource and don't run
+/// into maxMemoryAllocationCount.
+///
+
+#ifndef SRC_MEMORY_ALLOCATOR_H_
+#define SRC_MEMORY_ALLOCATOR_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "errors.h"
+
+// size of a VkDeviceMemory block that suballocations are carved from
+// requests larger than half a block get a block of their own
+#define DEVICE_MEMORY_BLOCK_SIZE ((VkDeviceSize)64 * 1024 * 1024)
+
+// What kind of resource lives in a range of a block.
+// Linear and optimal resources must not share a bufferImageGranularity page.
+typedef enum {
+  DEVICE_ALLOCATION_KIND_FREE = 0,
+  DEVICE_ALLOCATION_KIND_LINEAR = 1,
+  DEVICE_ALLOCATION_KIND_OPTIMAL = 2,
+} DeviceAllocationKind;
+
+// A contiguous range of a block, either free or in use
+typedef struct {
+  VkDeviceSize offset;
+  VkDeviceSize size;
+  DeviceAllocationKind kind;
+} DeviceMemoryRange;
+
+// A single VkDeviceMemory allocation
+typedef struct {
+  VkDeviceMemory memory;
+  VkDeviceSize size;
+  // the whole block stays mapped for its lifetime if it is host visible
+  void *pMapped;
+  // sorted by offset, adjacent free ranges are always merged
+  DeviceMemoryRange *pRanges;
+  uint32_t rangeCount;
+  uint32_t rangeCapacity;
+  uint32_t allocationCount;
+} DeviceMemoryBlock;
+
+// All the blocks of one memory type
+typedef struct {
+  DeviceMemoryBlock **ppBlocks;
+  uint32_t blockCount;
+} DeviceMemoryPool;
+
+typedef struct {
+  VkDevice device;
+  VkPhysicalDevice physicalDevice;
+  VkPhysicalDeviceMemoryProperties memoryProperties;
+  VkDeviceSize bufferImageGranularity;
+  VkDeviceSize nonCoherentAtomSize;
+  uint32_t maxMemoryAllocationCount;
+  VkDeviceSize blockSize;
+  // every allocateDeviceMemory that succeeded, including freed ones
+  uint64_t lifetimeAllocationCount;
+  // one pool per memory type index
+  DeviceMemoryPool pPools[VK_MAX_MEMORY_TYPES];
+} DeviceAllocator;
+
+// A suballocation handed out by allocateDeviceMemory
+typedef struct {
+  VkDeviceMemory memory;
+  VkDeviceSize offset;
+  VkDeviceSize size;
+  // pointer to `offset` inside the block mapping, NULL if not host visible
+  void *pMapped;
+  uint32_t memoryTypeIndex;
+  DeviceMemoryBlock *pBlock;
+} DeviceAllocation;
+
+typedef struct {
+  uint32_t blockCount;
+  uint32_t allocationCount;
+  // bytes reserved from the driver through vkAllocateMemory
+  VkDeviceSize blockBytes;
+  // bytes handed out to resources, excluding alignment padding
+  VkDeviceSize allocationBytes;
+  VkDeviceSize largestFreeRange;
+  uint64_t lifetimeAllocationCount;
+} DeviceAllocatorStats;
+
+/// Creates a new allocator for `device`
+/// --- PRECONDITIONS ---
+/// * `pAllocator` is a valid pointer
+/// * `device` has been created from `physicalDevice`
+/// --- POSTCONDITIONS ---
+/// * returns error status
+/// * on success, `*pAllocator` is an allocator with no blocks
+/// --- CLEANUP ---
+/// * call delete_DeviceAllocator once every allocation has been freed
+ErrVal new_DeviceAllocator(                //
+    DeviceAllocator *pAllocator,           //
+    const VkPhysicalDevice physicalDevice, //
+    const VkDevice device                  //
+);
+
+/// Frees every block owned by the allocator
+/// --- PRECONDITIONS ---
+/// * `pAllocator` was created with new_DeviceAllocator
+/// --- POSTCONDITIONS ---
+/// * all VkDeviceMemory owned by `pAllocator` has been freed
+/// * any outstanding DeviceAllocation is no longer valid
+void delete_DeviceAllocator(DeviceAllocator *pAllocator);
+
+/// Carves out a range satisfying `requirements` from a block of the memory
+/// type chosen by getMemoryTypeIndex
+/// --- PRECONDITIONS ---
+/// * `pAllocation` is a valid pointer
+/// * `kind` is DEVICE_ALLOCATION_KIND_LINEAR or DEVICE_ALLOCATION_KIND_OPTIMAL
+/// --- POSTCONDITIONS ---
+/// * returns error status
+/// * on success, `*pAllocation` describes a range of `requirements.size`
+/// bytes aligned to `requirements.alignment`
+/// --- CLEANUP ---
+/// * call freeDeviceMemory
+ErrVal allocateDeviceMemory(                    //
+    DeviceAllocation *pAllocation,              //
+    DeviceAllocator *pAllocator,                //
+    const VkMemoryRequirements requirements,    //
+    const VkMemoryPropertyFlags properties,     //
+    const DeviceAllocationKind kind             //
+);
+
+/// Returns a range to the block it came from
+/// --- PRECONDITIONS ---
+/// * `pAllocation` was allocated from `pAllocator` with allocateDeviceMemory
+/// --- POSTCONDITIONS ---
+/// * the range may be reused by later allocations
+/// * `*pAllocation` is zeroed
+void freeDeviceMemory(DeviceAllocation *pAllocation,
+                      DeviceAllocator *pAllocator);
+
+/// Flushes host writes to a non coherent allocation, a no-op for coherent ones
+ErrVal flushDeviceMemory(const DeviceAllocation *pAllocation,
+                         const DeviceAllocator *pAllocator);
+
+void getDeviceAllocatorStats(DeviceAllocatorStats *pStats,
+                             const DeviceAllocator *pAllocator);
+
+void logDeviceAllocatorStats(const DeviceAllocator *pAllocator);
+
+#endif /* SRC_MEMORY_ALLOCATOR_H_ */
@@ -0,0 +1,415 @@
+#include "mesh.h"
+
+#include <errno.h>
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Scoring constants from Tom Forsyth's "Linear-Speed Vertex Cache
+// Optimisation"
+#define FORSYTH_CACHE_DECAY_POWER 1.5f
+#define FORSYTH_LAST_TRIANGLE_SCORE 0.75f
+#define FORSYTH_VALENCE_BOOST_SCALE 2.0f
+#define FORSYTH_VALENCE_BOOST_POWER 0.5f
+
+#define NO_TRIANGLE UINT32_MAX
+#define EMPTY_SLOT UINT32_MAX
+
+// never returns NULL, an empty allocation still gets a pointer to free
+__attribute__((returns_nonnull)) static void *
+mallocOrPanic(const size_t size) {
+  void *ptr = malloc(size == 0 ? 1 : size);
+  if (ptr == NULL) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "failed to allocate mesh memory: %s",
+                   strerror(errno));
+    PANIC();
+  }
+  return (ptr);
+}
+
+static uint32_t hashVertex(const Vertex *pVertex) {
+  // FNV-1a over the raw bytes, welding is bitwise exact
+  const uint8_t *pBytes = (const uint8_t *)pVertex;
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < sizeof(Vertex); i++) {
+    hash ^= pBytes[i];
+    hash *= 16777619u;
+  }
+  return (hash);
+}
+
+ErrVal new_IndexedMesh(IndexedMesh *pMesh, const Vertex *pVertices,
+                       const uint32_t vertexCount) {
+  if (vertexCount % 3 != 0) {
+    LOG_ERROR(ERR_LEVEL_ERROR,
+              "failed to create mesh: vertex count is not a multiple of 3");
+    return (ERR_BADARGS);
+  }
+  if (vertexCount > MESH_MAX_VERTICES) {
+    LOG_ERROR_ARGS(ERR_LEVEL_ERROR,
+                   "failed to create mesh: %u vertices, at most %u can be "
+                   "welded",
+                   vertexCount, MESH_MAX_VERTICES);
+    return (ERR_BADARGS);
+  }
+
+  // open addressed table of indices into pMesh->pVertices, at most half full
+  uint64_t tableSize = 1;
+  while (tableSize < (uint64_t)vertexCount * 2) {
+    tableSize *= 2;
+  }
+  uint32_t *pTable = mallocOrPanic((size_t)tableSize * sizeof(uint32_t));
+  for (uint64_t i = 0; i < tableSize; i++) {
+    pTable[i] = EMPTY_SLOT;
+  }
+
+  pMesh->pVertices = mallocOrPanic(vertexCount * sizeof(Vertex));
+  pMesh->pIndices = mallocOrPanic(vertexCount * sizeof(uint32_t));
+  pMesh->vertexCount = 0;
+  pMesh->indexCount = vertexCount;
+
+  for (uint32_t i = 0; i < vertexCount; i++) {
+    uint32_t slot = hashVertex(&pVertices[i]) & (tableSize - 1);
+    while (pTable[slot] != EMPTY_SLOT &&
+           memcmp(&pMesh->pVertices[pTable[slot]], &pVertices[i],
+                  sizeof(Vertex)) != 0) {
+      slot = (slot + 1) & (tableSize - 1);
+    }
+    if (pTable[slot] == EMPTY_SLOT) {
+      pTable[slot] = pMesh->vertexCount;
+      pMesh->pVertices[pMesh->vertexCount] = pVertices[i];
+      pMesh->vertexCount++;
+    }
+    pMesh->pIndices[i] = pTable[slot];
+  }
+
+  free(pTable);
+  return (ERR_OK);
+}
+
+void delete_IndexedMesh(IndexedMesh *pMesh) {
+  free(pMesh->pVertices);
+  free(pMesh->pIndices);
+  pMesh->pVertices = NULL;
+  pMesh->pIndices = NULL;
+  pMesh->vertexCount = 0;
+  pMesh->indexCount = 0;
+}
+
+static Vertex getGridVertex(const uint32_t x, const uint32_t z,
+                            const uint32_t side) {
+  float u = (float)x / (float)side;
+  float v = (float)z / (float)side;
+  Vertex vertex;
+  vertex.position[0] = 2.0f * u - 1.0f;
+  vertex.position[1] = 0.25f * sinf(6.2831853f * u) * cosf(6.2831853f * v);
+  vertex.position[2] = 2.0f * v - 1.0f;
+  vertex.color[0] = u;
+  vertex.color[1] = v;
+  vertex.color[2] = 1.0f - u;
+  return (vertex);
+}
+
+void new_GridTriangleList(Vertex **ppVertices, uint32_t *pVertexCount,
+                          const uint32_t minVertexCount) {
+  // a side of n quads has (n + 1)^2 distinct vertices
+  uint32_t side = 1;
+  while (side < MESH_GRID_MAX_SIDE &&
+         (uint64_t)(side + 1) * (side + 1) < minVertexCount) {
+    side++;
+  }
+
+  *pVertexCount = 6 * side * side;
+  Vertex *pVertices = mallocOrPanic(*pVertexCount * sizeof(Vertex));
+  uint32_t i = 0;
+  for (uint32_t z = 0; z < side; z++) {
+    for (uint32_t x = 0; x < side; x++) {
+      pVertices[i++] = getGridVertex(x, z, side);
+      pVertices[i++] = getGridVertex(x, z + 1, side);
+      pVertices[i++] = getGridVertex(x + 1, z, side);
+      pVertices[i++] = getGridVertex(x + 1, z, side);
+      pVertices[i++] = getGridVertex(x, z + 1, side);
+      pVertices[i++] = getGridVertex(x + 1, z + 1, side);
+    }
+  }
+  *ppVertices = pVertices;
+}
+
+static float getVertexScore(const int32_t cachePosition,
+                            const uint32_t remainingTriangles) {
+  if (remainingTriangles == 0) {
+    // nothing left to draw with this vertex
+    return (-1.0f);
+  }
+
+  float score = 0.0f;
+  if (cachePosition >= 0 && cachePosition < 3) {
+    // used by the last triangle, deliberately below the next few entries so
+    // that we don't keep fanning around the same vertex
+    score = FORSYTH_LAST_TRIANGLE_SCORE;
+  } else if (cachePosition >= 3) {
+    float scaler = 1.0f / (MESH_OPTIMIZER_CACHE_SIZE - 3);
+    score = 1.0f - (float)(cachePosition - 3) * scaler;
+    score = powf(score, FORSYTH_CACHE_DECAY_POWER);
+  }
+
+  // favour vertices with few triangles left so that they get finished off
+  score += FORSYTH_VALENCE_BOOST_SCALE *
+           powf((float)remainingTriangles, -FORSYTH_VALENCE_BOOST_POWER);
+  return (score);
+}
+
+static void optimizeTriangleOrder(uint32_t *pIndices, const uint32_t indexCount,
+                                  const uint32_t vertexCount) {
+  uint32_t triangleCount = indexCount / 3;
+  if (triangleCount == 0) {
+    return;
+  }
+
+  // triangles using each vertex, as ranges of pAdjacency
+  uint32_t *pRemaining = mallocOrPanic(vertexCount * sizeof(uint32_t));
+  uint32_t *pOffsets = mallocOrPanic((vertexCount + 1) * sizeof(uint32_t));
+  uint32_t *pAdjacency = mallocOrPanic(indexCount * sizeof(uint32_t));
+  memset(pRemaining, 0, vertexCount * sizeof(uint32_t));
+  for (uint32_t i = 0; i < indexCount; i++) {
+    pRemaining[pIndices[i]]++;
+  }
+  pOffsets[0] = 0;
+  for (uint32_t v = 0; v < vertexCount; v++) {
+    pOffsets[v + 1] = pOffsets[v] + pRemaining[v];
+    pRemaining[v] = 0;
+  }
+  for (uint32_t i = 0; i < indexCount; i++) {
+    uint32_t v = pIndices[i];
+    pAdjacency[pOffsets[v] + pRemaining[v]] = i / 3;
+    pRemaining[v]++;
+  }
+
+  int32_t *pCachePositions = mallocOrPanic(vertexCount * sizeof(int32_t));
+  float *pVertexScores = mallocOrPanic(vertexCount * sizeof(float));
+  // cleared too, -fanalyzer can't tell that every index is below vertexCount
+  memset(pVertexScores, 0, vertexCount * sizeof(float));
+  for (uint32_t v = 0; v < vertexCount; v++) {
+    pCachePositions[v] = -1;
+    pVertexScores[v] = getVertexScore(-1, pRemaining[v]);
+  }
+
+  float *pTriangleScores = mallocOrPanic(triangleCount * sizeof(float));
+  bool *pEmitted = mallocOrPanic(triangleCount * sizeof(bool));
+  uint32_t bestTriangle = NO_TRIANGLE;
+  for (uint32_t t = 0; t < triangleCount; t++) {
+    pEmitted[t] = false;
+    pTriangleScores[t] = pVertexScores[pIndices[3 * t]] +
+                         pVertexScores[pIndices[3 * t + 1]] +
+                         pVertexScores[pIndices[3 * t + 2]];
+    if (bestTriangle == NO_TRIANGLE ||
+        pTriangleScores[t] > pTriangleScores[bestTriangle]) {
+      bestTriangle = t;
+    }
+  }
+
+  uint32_t *pOutIndices = mallocOrPanic(indexCount * sizeof(uint32_t));
+  // the cache may overflow by up to 3 while it is being updated
+  uint32_t pCache[MESH_OPTIMIZER_CACHE_SIZE + 3];
+  uint32_t pNewCache[MESH_OPTIMIZER_CACHE_SIZE + 3];
+  uint32_t cacheCount = 0;
+
+  for (uint32_t emitted = 0; emitted < triangleCount; emitted++) {
+    if (bestTriangle == NO_TRIANGLE) {
+      // nothing in the cache left to draw, fall back to a full scan
+      for (uint32_t t = 0; t < triangleCount; t++) {
+        if (!pEmitted[t] &&
+            (bestTriangle == NO_TRIANGLE ||
+             pTriangleScores[t] > pTriangleScores[bestTriangle])) {
+          bestTriangle = t;
+        }
+      }
+    }
+
+    const uint32_t *pTriangle = &pIndices[3 * bestTriangle];
+    memcpy(&pOutIndices[3 * emitted], pTriangle, 3 * sizeof(uint32_t));
+    pEmitted[bestTriangle] = true;
+
+    // unlink the triangle from its vertices
+    for (uint32_t k = 0; k < 3; k++) {
+      uint32_t v = pTriangle[k];
+      uint32_t *pList = &pAdjacency[pOffsets[v]];
+      for (uint32_t j = 0; j < pRemaining[v]; j++) {
+        if (pList[j] == bestTriangle) {
+          pList[j] = pList[pRemaining[v] - 1];
+          break;
+        }
+      }
+      pRemaining[v]--;
+    }
+
+    // the triangle's vertices move to the front, everything else shifts back
+    uint32_t newCacheCount = 0;
+    for (uint32_t k = 0; k < 3; k++) {
+      // degenerate triangles repeat a vertex, it only needs one entry
+      if (k == 0 || (pTriangle[k] != pTriangle[0] &&
+                     (k == 1 || pTriangle[k] != pTriangle[1]))) {
+        pNewCache[newCacheCount++] = pTriangle[k];
+      }
+    }
+    for (uint32_t i = 0; i < cacheCount; i++) {
+      uint32_t v = pCache[i];
+      if (v != pTriangle[0] && v != pTriangle[1] && v != pTriangle[2]) {
+        pNewCache[newCacheCount++] = v;
+      }
+    }
+
+    // rescore every vertex whose position changed, including the ones that
+    // just fell out of the cache
+    for (uint32_t i = 0; i < newCacheCount; i++) {
+      uint32_t v = pNewCache[i];
+      pCachePositions[v] = i < MESH_OPTIMIZER_CACHE_SIZE ? (int32_t)i : -1;
+      pVertexScores[v] = getVertexScore(pCachePositions[v], pRemaining[v]);
+    }
+
+    // the next triangle is picked from the ones touching the cache
+    bestTriangle = NO_TRIANGLE;
+    for (uint32_t i = 0; i < newCacheCount; i++) {
+      uint32_t v = pNewCache[i];
+      for (uint32_t j = 0; j < pRemaining[v]; j++) {
+        uint32_t t = pAdjacency[pOffsets[v] + j];
+        pTriangleScores[t] = pVertexScores[pIndices[3 * t]] +
+                             pVertexScores[pIndices[3 * t + 1]] +
+                             pVertexScores[pIndices[3 * t + 2]];
+        if (bestTriangle == NO_TRIANGLE ||
+            pTriangleScores[t] > pTriangleScores[bestTriangle]) {
+          bestTriangle = t;
+        }
+      }
+    }
+
+    cacheCount = newCacheCount < MESH_OPTIMIZER_CACHE_SIZE
+                     ? newCacheCount
+                     : MESH_OPTIMIZER_CACHE_SIZE;
+    memcpy(pCache, pNewCache, cacheCount * sizeof(uint32_t));
+  }
+
+  memcpy(pIndices, pOutIndices, indexCount * sizeof(uint32_t));
+
+  free(pOutIndices);
+  free(pEmitted);
+  free(pTriangleScores);
+  free(pVertexScores);
+  free(pCachePositions);
+  free(pAdjacency);
+  free(pOffsets);
+  free(pRemaining);
+}
+
+static void optimizeVertexOrder(IndexedMesh *pMesh) {
+  uint32_t *pRemap = mallocOrPanic(pMesh->vertexCount * sizeof(uint32_t));
+  for (uint32_t v = 0; v < pMesh->vertexCount; v++) {
+    pRemap[v] = EMPTY_SLOT;
+  }
+
+  Vertex *pVertices = mallocOrPanic(pMesh->vertexCount * sizeof(Vertex));
+  uint32_t nextVertex = 0;
+  for (uint32_t i = 0; i < pMesh->indexCount; i++) {
+    uint32_t v = pMesh->pIndices[i];
+    if (pRemap[v] == EMPTY_SLOT) {
+      pRemap[v] = nextVertex;
+      pVertices[nextVertex] = pMesh->pVertices[v];
+      nextVertex++;
+    }
+    pMesh->pIndices[i] = pRemap[v];
+  }
+
+  free(pMesh->pVertices);
+  free(pRemap);
+  pMesh->pVertices = pVertices;
+  // vertices no triangle referenced are dropped
+  pMesh->vertexCount = nextVertex;
+}
+
+void optimizeIndexedMesh(IndexedMesh *pMesh) {
+  optimizeTriangleOrder(pMesh->pIndices, pMesh->indexCount,
+                        pMesh->vertexCount);
+  optimizeVertexOrder(pMesh);
+}
+
+static int16_t quantizeSnorm16(const float value) {
+  float clamped = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+  return ((int16_t)lrintf(clamped * 32767.0f));
+}
+
+static uint8_t quantizeUnorm8(const float value) {
+  float clamped = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+  return ((uint8_t)lrintf(clamped * 255.0f));
+}
+
+void quantizeVertices(PackedVertex *pPackedVertices, mat4x4 dequantization,
+                      const Vertex *pVertices, const uint32_t vertexCount) {
+  vec3 boundsMin = {FLT_MAX, FLT_MAX, FLT_MAX};
+  vec3 boundsMax = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+  for (uint32_t i = 0; i < vertexCount; i++) {
+    for (uint32_t k = 0; k < 3; k++) {
+      boundsMin[k] = fminf(boundsMin[k], pVertices[i].position[k]);
+      boundsMax[k] = fmaxf(boundsMax[k], pVertices[i].position[k]);
+    }
+  }
+
+  vec3 center = {0.0f, 0.0f, 0.0f};
+  vec3 halfExtent = {1.0f, 1.0f, 1.0f};
+  if (vertexCount > 0) {
+    for (uint32_t k = 0; k < 3; k++) {
+      center[k] = (boundsMin[k] + boundsMax[k]) * 0.5f;
+      // a flat axis still needs a nonzero scale
+      float extent = (boundsMax[k] - boundsMin[k]) * 0.5f;
+      halfExtent[k] = extent > 0.0f ? extent : 1.0f;
+    }
+  }
+
+  for (uint32_t i = 0; i < vertexCount; i++) {
+    for (uint32_t k = 0; k < 3; k++) {
+      pPackedVertices[i].position[k] = quantizeSnorm16(
+          (pVertices[i].position[k] - center[k]) / halfExtent[k]);
+      pPackedVertices[i].color[k] = quantizeUnorm8(pVertices[i].color[k]);
+    }
+    pPackedVertices[i].position[3] = 0;
+    pPackedVertices[i].color[3] = 255;
+  }
+
+  // position = center + halfExtent * snorm
+  mat4x4_translate(dequantization, center[0], center[1], center[2]);
+  mat4x4_scale_aniso(dequantization, dequantization, halfExtent[0],
+                     halfExtent[1], halfExtent[2]);
+}
+
+float getAcmr(const uint32_t *pIndices, const uint32_t indexCount,
+              const uint32_t cacheSize) {
+  if (indexCount < 3 || cacheSize == 0) {
+    return (0.0f);
+  }
+
+  uint32_t *pCache = mallocOrPanic(cacheSize * sizeof(uint32_t));
+  uint32_t cacheCount = 0;
+  uint32_t cacheHead = 0;
+  uint32_t misses = 0;
+  for (uint32_t i = 0; i < indexCount; i++) {
+    bool hit = false;
+    for (uint32_t j = 0; j < cacheCount; j++) {
+      if (pCache[j] == pIndices[i]) {
+        hit = true;
+        break;
+      }
+    }
+    if (!hit) {
+      misses++;
+      pCache[cacheHead] = pIndices[i];
+      cacheHead = (cacheHead + 1) % cacheSize;
+      if (cacheCount < cacheSize) {
+        cacheCount++;
+      }
+    }
+  }
+  free(pCache);
+  return ((float)misses / (float)(indexCount / 3));
+}
@@ -0,0 +1,98 @@
+///
+/// Copyright 2019 Govind Pimpale
+/// mesh.h
+///
+/// CPU side preprocessing of triangle lists into indexed meshes.
+/// Duplicate vertices are welded together, and triangles are reordered with
+/// Forsyth's linear speed vertex cache optimisation so that the GPU's post
+/// transform cache gets reused instead of shading the same vertex again.
+///
+
+#ifndef SRC_MESH_H_
+#define SRC_MESH_H_
+
+#include <stdint.h>
+
+#include "errors.h"
+#include "vulkan_utils.h"
+
+// size of the LRU cache modelled when reordering triangles
+#define MESH_OPTIMIZER_CACHE_SIZE 32
+
+// size of the FIFO cache used when reporting ACMR, a conservative guess at
+// what real hardware has
+#define MESH_ACMR_CACHE_SIZE 16
+
+// the most vertices new_IndexedMesh welds, so that its hash table, twice
+// that size, can still be indexed with 32 bits
+#define MESH_MAX_VERTICES (UINT32_C(1) << 30)
+
+// keeps the unwelded triangle list of new_GridTriangleList, 6 vertices a quad,
+// within MESH_MAX_VERTICES
+#define MESH_GRID_MAX_SIDE 8192
+
+typedef struct {
+  Vertex *pVertices;
+  uint32_t vertexCount;
+  uint32_t *pIndices;
+  uint32_t indexCount;
+} IndexedMesh;
+
+/// Creates an indexed mesh from an unindexed triangle list
+/// --- PRECONDITIONS ---
+/// * `pMesh` is a valid pointer
+/// * `pVertices` points to `vertexCount` vertices, three per triangle
+/// --- POSTCONDITIONS ---
+/// * returns error status
+/// * returns ERR_BADARGS if `vertexCount` is not a multiple of 3 or is over
+/// MESH_MAX_VERTICES
+/// * on success, `*pMesh` holds each distinct vertex once, in order of first
+/// appearance, and one index per input vertex
+/// --- CLEANUP ---
+/// * call delete_IndexedMesh
+ErrVal new_IndexedMesh(IndexedMesh *pMesh, const Vertex *pVertices,
+                       const uint32_t vertexCount);
+
+void delete_IndexedMesh(IndexedMesh *pMesh);
+
+/// Tessellates the square [-1, 1] x [-1, 1] of the xz plane into a rippled
+/// grid of at least `minVertexCount` distinct vertices, as a triangle list
+/// --- PRECONDITIONS ---
+/// * `ppVertices` and `pVertexCount` are valid pointers
+/// --- POSTCONDITIONS ---
+/// * `*ppVertices` holds `*pVertexCount` vertices, three per triangle, which
+/// new_IndexedMesh welds back down to the grid points
+/// * the grid is capped at MESH_GRID_MAX_SIDE quads a side
+/// --- CLEANUP ---
+/// * call free on `*ppVertices`
+void new_GridTriangleList(Vertex **ppVertices, uint32_t *pVertexCount,
+                          const uint32_t minVertexCount);
+
+/// Reorders the mesh for the post transform vertex cache
+/// --- PRECONDITIONS ---
+/// * `pMesh` was created with new_IndexedMesh
+/// --- POSTCONDITIONS ---
+/// * the mesh draws the same triangles, in an order that reuses cached
+/// vertices
+/// * vertices are renumbered in order of first use so that vertex fetch runs
+/// mostly forwards through memory
+void optimizeIndexedMesh(IndexedMesh *pMesh);
+
+/// Quantizes `vertexCount` vertices against their bounding box
+/// --- PRECONDITIONS ---
+/// * `pPackedVertices` points to space for `vertexCount` vertices
+/// --- POSTCONDITIONS ---
+/// * `pPackedVertices` holds the vertices in VERTEX_FORMAT_PACKED
+/// * `dequantization` maps the [-1, 1] positions the shader sees back to the
+/// original positions, to be multiplied onto the right of the MVP
+/// * colors are clamped to [0, 1] and alpha is 1
+void quantizeVertices(PackedVertex *pPackedVertices, mat4x4 dequantization,
+                      const Vertex *pVertices, const uint32_t vertexCount);
+
+/// Returns the average cache miss ratio, the number of vertices shaded per
+/// triangle, with a FIFO cache of `cacheSize` entries
+/// 3.0 is the worst possible, and 0.5 is about the best for a regular grid
+float getAcmr(const uint32_t *pIndices, const uint32_t indexCount,
+              const uint32_t cacheSize);
+
+#endif /* SRC_MESH_H_ */
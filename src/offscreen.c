@@ -0,0 +1,154 @@
+#include "offscreen.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vulkan_utils.h"
+
+#define OFFSCREEN_PIXEL_SIZE 4
+
+ErrVal new_OffscreenSwapchain(OffscreenSwapchain *pOffscreenSwapchain,
+                              const uint32_t imageCount,
+                              const VkExtent2D extent,
+                              DeviceAllocator *pAllocator,
+                              const VkDevice device) {
+  pOffscreenSwapchain->extent = extent;
+  pOffscreenSwapchain->imageCount = imageCount;
+  pOffscreenSwapchain->pImages = calloc(imageCount, sizeof(VkImage));
+  pOffscreenSwapchain->pImageAllocations =
+      calloc(imageCount, sizeof(DeviceAllocation));
+  pOffscreenSwapchain->pImageViews = calloc(imageCount, sizeof(VkImageView));
+  pOffscreenSwapchain->pReadbackBuffers = calloc(imageCount, sizeof(VkBuffer));
+  pOffscreenSwapchain->pReadbackAllocations =
+      calloc(imageCount, sizeof(DeviceAllocation));
+  if (pOffscreenSwapchain->pImages == NULL ||
+      pOffscreenSwapchain->pImageAllocations == NULL ||
+      pOffscreenSwapchain->pImageViews == NULL ||
+      pOffscreenSwapchain->pReadbackBuffers == NULL ||
+      pOffscreenSwapchain->pReadbackAllocations == NULL) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "failed to create offscreen swapchain: %s",
+                   strerror(errno));
+    PANIC();
+  }
+
+  VkDeviceSize readbackSize = (VkDeviceSize)extent.width * extent.height *
+                              OFFSCREEN_PIXEL_SIZE;
+  for (uint32_t i = 0; i < imageCount; i++) {
+    ErrVal retVal = new_Image(
+        &pOffscreenSwapchain->pImages[i],
+        &pOffscreenSwapchain->pImageAllocations[i], extent, OFFSCREEN_FORMAT,
+        VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, pAllocator, device);
+    if (retVal != ERR_OK) {
+      LOG_ERROR(ERR_LEVEL_ERROR, "failed to create offscreen image");
+      return (retVal);
+    }
+    new_ImageView(&pOffscreenSwapchain->pImageViews[i], device,
+                  pOffscreenSwapchain->pImages[i], OFFSCREEN_FORMAT,
+                  VK_IMAGE_ASPECT_COLOR_BIT);
+
+    // the CPU reads every pixel back, so prefer cached memory
+    retVal = new_Buffer_DeviceMemory(
+        &pOffscreenSwapchain->pReadbackBuffers[i],
+        &pOffscreenSwapchain->pReadbackAllocations[i], readbackSize,
+        pAllocator, device, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
+            VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+    if (retVal != ERR_OK) {
+      retVal = new_Buffer_DeviceMemory(
+          &pOffscreenSwapchain->pReadbackBuffers[i],
+          &pOffscreenSwapchain->pReadbackAllocations[i], readbackSize,
+          pAllocator, device, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+              VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    }
+    if (retVal != ERR_OK) {
+      LOG_ERROR(ERR_LEVEL_ERROR, "failed to create offscreen readback buffer");
+      return (retVal);
+    }
+  }
+  return (ERR_OK);
+}
+
+void delete_OffscreenSwapchain(OffscreenSwapchain *pOffscreenSwapchain,
+                               DeviceAllocator *pAllocator,
+                               const VkDevice device) {
+  for (uint32_t i = 0; i < pOffscreenSwapchain->imageCount; i++) {
+    delete_Buffer(&pOffscreenSwapchain->pReadbackBuffers[i], device);
+    delete_DeviceMemory(&pOffscreenSwapchain->pReadbackAllocations[i],
+                        pAllocator);
+    delete_ImageView(&pOffscreenSwapchain->pImageViews[i], device);
+    delete_Image(&pOffscreenSwapchain->pImages[i], device);
+    delete_DeviceMemory(&pOffscreenSwapchain->pImageAllocations[i],
+                        pAllocator);
+  }
+  free(pOffscreenSwapchain->pImages);
+  free(pOffscreenSwapchain->pImageAllocations);
+  free(pOffscreenSwapchain->pImageViews);
+  free(pOffscreenSwapchain->pReadbackBuffers);
+  free(pOffscreenSwapchain->pReadbackAllocations);
+  pOffscreenSwapchain->pImages = NULL;
+  pOffscreenSwapchain->pImageAllocations = NULL;
+  pOffscreenSwapchain->pImageViews = NULL;
+  pOffscreenSwapchain->pReadbackBuffers = NULL;
+  pOffscreenSwapchain->pReadbackAllocations = NULL;
+}
+
+uint64_t getOffscreenChecksum(const OffscreenSwapchain *pOffscreenSwapchain,
+                              const uint32_t imageIndex) {
+  const uint8_t *pPixels =
+      pOffscreenSwapchain->pReadbackAllocations[imageIndex].pMapped;
+  size_t size = (size_t)pOffscreenSwapchain->extent.width *
+                pOffscreenSwapchain->extent.height * OFFSCREEN_PIXEL_SIZE;
+  uint64_t hash = UINT64_C(14695981039346656037);
+  for (size_t i = 0; i < size; i++) {
+    hash ^= pPixels[i];
+    hash *= UINT64_C(1099511628211);
+  }
+  return (hash);
+}
+
+ErrVal writeOffscreenPpm(const OffscreenSwapchain *pOffscreenSwapchain,
+                         const uint32_t imageIndex, const char *path) {
+  const uint8_t *pPixels =
+      pOffscreenSwapchain->pReadbackAllocations[imageIndex].pMapped;
+  uint32_t width = pOffscreenSwapchain->extent.width;
+  uint32_t height = pOffscreenSwapchain->extent.height;
+
+  uint8_t *pRow = malloc((size_t)width * 3);
+  if (pRow == NULL) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "failed to write PPM: %s",
+                   strerror(errno));
+    PANIC();
+  }
+  FILE *fp = fopen(path, "wb");
+  if (fp == NULL) {
+    LOG_ERROR_ARGS(ERR_LEVEL_WARN, "could not open %s: %s", path,
+                   strerror(errno));
+    free(pRow);
+    return (ERR_UNKNOWN);
+  }
+
+  bool written = fprintf(fp, "P6\n%u %u\n255\n", width, height) > 0;
+  for (uint32_t y = 0; y < height && written; y++) {
+    const uint8_t *pSrc = pPixels + (size_t)y * width * OFFSCREEN_PIXEL_SIZE;
+    for (uint32_t x = 0; x < width; x++) {
+      pRow[3 * x + 0] = pSrc[OFFSCREEN_PIXEL_SIZE * x + 0];
+      pRow[3 * x + 1] = pSrc[OFFSCREEN_PIXEL_SIZE * x + 1];
+      pRow[3 * x + 2] = pSrc[OFFSCREEN_PIXEL_SIZE * x + 2];
+    }
+    written = fwrite(pRow, 3, width, fp) == width;
+  }
+  written = (fclose(fp) == 0) && written;
+  free(pRow);
+  if (!written) {
+    LOG_ERROR_ARGS(ERR_LEVEL_WARN, "could not write %s", path);
+    return (ERR_UNKNOWN);
+  }
+  return (ERR_OK);
+}
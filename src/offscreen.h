@@ -0,0 +1,70 @@
+///
+/// Copyright 2019 Govind Pimpale
+/// offscreen.h
+///
+/// A stand in for the swapchain when there is no display. Frames are
+/// rendered into a ring of ordinary images that are cycled through like
+/// swapchain images, and each image has a host visible buffer that the frame
+/// is copied into, so that it can be checksummed or written out.
+///
+
+#ifndef SRC_OFFSCREEN_H_
+#define SRC_OFFSCREEN_H_
+
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "errors.h"
+#include "memory_allocator.h"
+
+// 8 bit RGBA, so that readbacks can be written out without conversion
+#define OFFSCREEN_FORMAT VK_FORMAT_R8G8B8A8_UNORM
+
+typedef struct {
+  VkExtent2D extent;
+  uint32_t imageCount;
+  VkImage *pImages;
+  DeviceAllocation *pImageAllocations;
+  VkImageView *pImageViews;
+  // tightly packed OFFSCREEN_FORMAT pixels of the last frame copied back
+  VkBuffer *pReadbackBuffers;
+  DeviceAllocation *pReadbackAllocations;
+} OffscreenSwapchain;
+
+/// Creates `imageCount` offscreen images and their readback buffers
+/// --- PRECONDITIONS ---
+/// * `pOffscreenSwapchain` is a valid pointer
+/// --- POSTCONDITIONS ---
+/// * returns error status
+/// * the images can be rendered to by a render pass made with
+/// new_VertexDisplayRenderPass for OFFSCREEN_FORMAT, with a final layout of
+/// VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+/// --- CLEANUP ---
+/// * call delete_OffscreenSwapchain
+ErrVal new_OffscreenSwapchain(OffscreenSwapchain *pOffscreenSwapchain,
+                              const uint32_t imageCount,
+                              const VkExtent2D extent,
+                              DeviceAllocator *pAllocator,
+                              const VkDevice device);
+
+void delete_OffscreenSwapchain(OffscreenSwapchain *pOffscreenSwapchain,
+                               DeviceAllocator *pAllocator,
+                               const VkDevice device);
+
+/// Returns a 64 bit FNV-1a hash of the pixels read back for `imageIndex`
+/// --- PRECONDITIONS ---
+/// * a frame rendered to `imageIndex` and copied back has completed
+uint64_t getOffscreenChecksum(const OffscreenSwapchain *pOffscreenSwapchain,
+                              const uint32_t imageIndex);
+
+/// Writes the pixels read back for `imageIndex` to `path` as a binary PPM
+/// --- PRECONDITIONS ---
+/// * a frame rendered to `imageIndex` and copied back has completed
+/// --- POSTCONDITIONS ---
+/// * returns error status
+/// * alpha is dropped
+ErrVal writeOffscreenPpm(const OffscreenSwapchain *pOffscreenSwapchain,
+                         const uint32_t imageIndex, const char *path);
+
+#endif /* SRC_OFFSCREEN_H_ */
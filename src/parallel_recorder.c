@@ -0,0 +1,282 @@
+#include "parallel_recorder.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+#include "vulkan_utils.h"
+
+static void recordDrawBucket(ParallelRecorder *pRecorder,
+                             const uint32_t workerIndex,
+                             const ParallelDrawJob *pJob) {
+  uint32_t slot =
+      pRecorder->currentFrame * pRecorder->workerCount + workerIndex;
+  VkCommandBuffer commandBuffer = pRecorder->pCommandBuffers[slot];
+
+  // the frame's last submit has completed, so its pool can be reset whole
+  vkResetCommandPool(pRecorder->device, pRecorder->pCommandPools[slot], 0);
+
+  VkCommandBufferInheritanceInfo inheritanceInfo = {0};
+  inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  inheritanceInfo.renderPass = pJob->renderPass;
+  inheritanceInfo.subpass = 0;
+  inheritanceInfo.framebuffer = pJob->framebuffer;
+
+  VkCommandBufferBeginInfo beginInfo = {0};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+                    VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+  beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+  VkResult beginRet = vkBeginCommandBuffer(commandBuffer, &beginInfo);
+  if (beginRet != VK_SUCCESS) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL,
+                   "failed to record into secondary command buffer: %s",
+                   vkstrerror(beginRet));
+    PANIC();
+  }
+
+  // nothing bound by the primary or another secondary carries over
+  recordVertexDisplayBindings(commandBuffer, pJob->pipelineLayout,
+                              pJob->pipeline, pJob->extent, pJob->transform,
+                              VK_NULL_HANDLE, pJob->vertexBuffer,
+                              pJob->indexBuffer, pJob->instanceBuffer);
+
+  uint32_t firstDraw = (uint32_t)((uint64_t)pJob->drawCount * workerIndex /
+                                  pRecorder->workerCount);
+  uint32_t endDraw = (uint32_t)((uint64_t)pJob->drawCount * (workerIndex + 1) /
+                                pRecorder->workerCount);
+  if (pJob->pInstances != NULL) {
+    for (uint32_t i = firstDraw; i < endDraw; i++) {
+      vkCmdDrawIndexed(commandBuffer, pJob->indexCount, 1, 0, 0,
+                       pJob->pInstances[i]);
+    }
+  } else {
+    for (uint32_t i = firstDraw; i < endDraw; i++) {
+      vkCmdDrawIndexed(commandBuffer, pJob->indexCount, 1, 0, 0, i);
+    }
+  }
+
+  VkResult endRet = vkEndCommandBuffer(commandBuffer);
+  if (endRet != VK_SUCCESS) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL,
+                   "failed to record secondary command buffer: %s",
+                   vkstrerror(endRet));
+    PANIC();
+  }
+}
+
+static void *runParallelRecordWorker(void *pArg) {
+  ParallelRecordWorker *pWorker = pArg;
+  ParallelRecorder *pRecorder = pWorker->pRecorder;
+  uint64_t seenGeneration = 0;
+
+  pthread_mutex_lock(&pRecorder->mutex);
+  while (true) {
+    while (!pRecorder->quit && pRecorder->jobGeneration == seenGeneration) {
+      pthread_cond_wait(&pRecorder->jobReady, &pRecorder->mutex);
+    }
+    if (pRecorder->quit) {
+      break;
+    }
+    seenGeneration = pRecorder->jobGeneration;
+    const ParallelDrawJob *pJob = pRecorder->pJob;
+    pthread_mutex_unlock(&pRecorder->mutex);
+
+    recordDrawBucket(pRecorder, pWorker->workerIndex, pJob);
+
+    pthread_mutex_lock(&pRecorder->mutex);
+    pRecorder->pendingWorkerCount--;
+    if (pRecorder->pendingWorkerCount == 0) {
+      pthread_cond_signal(&pRecorder->jobDone);
+    }
+  }
+  pthread_mutex_unlock(&pRecorder->mutex);
+  return (NULL);
+}
+
+// hands `pJob` to every worker and waits until all of them are done with it
+static void recordDrawBuckets(ParallelRecorder *pRecorder,
+                              const ParallelDrawJob *pJob) {
+  pthread_mutex_lock(&pRecorder->mutex);
+  pRecorder->pJob = pJob;
+  pRecorder->pendingWorkerCount = pRecorder->workerCount;
+  pRecorder->jobGeneration++;
+  pthread_cond_broadcast(&pRecorder->jobReady);
+  while (pRecorder->pendingWorkerCount != 0) {
+    pthread_cond_wait(&pRecorder->jobDone, &pRecorder->mutex);
+  }
+  pRecorder->pJob = NULL;
+  pthread_mutex_unlock(&pRecorder->mutex);
+}
+
+ErrVal new_ParallelRecorder(ParallelRecorder *pRecorder,
+                            const uint32_t workerCount,
+                            const uint32_t frameCount,
+                            const uint32_t queueFamilyIndex,
+                            const VkDevice device) {
+  if (workerCount == 0 || workerCount > PARALLEL_RECORDER_MAX_WORKERS) {
+    LOG_ERROR_ARGS(ERR_LEVEL_ERROR, "record workers must be 1 to %u",
+                   PARALLEL_RECORDER_MAX_WORKERS);
+    return (ERR_BADARGS);
+  }
+
+  pRecorder->device = device;
+  pRecorder->workerCount = workerCount;
+  pRecorder->frameCount = frameCount;
+  pRecorder->currentFrame = 0;
+  pRecorder->threadCount = 0;
+  pRecorder->jobGeneration = 0;
+  pRecorder->pendingWorkerCount = 0;
+  pRecorder->quit = false;
+  pRecorder->pJob = NULL;
+  pthread_mutex_init(&pRecorder->mutex, NULL);
+  pthread_cond_init(&pRecorder->jobReady, NULL);
+  pthread_cond_init(&pRecorder->jobDone, NULL);
+
+  uint32_t slotCount = workerCount * frameCount;
+  pRecorder->pCommandPools = calloc(slotCount, sizeof(VkCommandPool));
+  pRecorder->pCommandBuffers = calloc(slotCount, sizeof(VkCommandBuffer));
+  pRecorder->pWorkers = calloc(workerCount, sizeof(ParallelRecordWorker));
+  if (pRecorder->pCommandPools == NULL || pRecorder->pCommandBuffers == NULL ||
+      pRecorder->pWorkers == NULL) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "failed to create parallel recorder: %s",
+                   strerror(errno));
+    PANIC();
+  }
+
+  for (uint32_t i = 0; i < slotCount; i++) {
+    // everything in a pool is reset at once, buffers are never reset alone
+    VkCommandPoolCreateInfo poolInfo = {0};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = queueFamilyIndex;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    VkResult poolRet = vkCreateCommandPool(device, &poolInfo, NULL,
+                                           &pRecorder->pCommandPools[i]);
+    if (poolRet != VK_SUCCESS) {
+      LOG_ERROR_ARGS(ERR_LEVEL_ERROR, "failed to create command pool %s",
+                     vkstrerror(poolRet));
+      delete_ParallelRecorder(pRecorder);
+      return (ERR_UNKNOWN);
+    }
+
+    VkCommandBufferAllocateInfo allocateInfo = {0};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    allocateInfo.commandPool = pRecorder->pCommandPools[i];
+    allocateInfo.commandBufferCount = 1;
+    VkResult allocateRet = vkAllocateCommandBuffers(
+        device, &allocateInfo, &pRecorder->pCommandBuffers[i]);
+    if (allocateRet != VK_SUCCESS) {
+      LOG_ERROR_ARGS(ERR_LEVEL_ERROR,
+                     "failed to allocate secondary command buffer: %s",
+                     vkstrerror(allocateRet));
+      delete_ParallelRecorder(pRecorder);
+      return (ERR_UNKNOWN);
+    }
+  }
+
+  for (uint32_t i = 0; i < workerCount; i++) {
+    ParallelRecordWorker *pWorker = &pRecorder->pWorkers[i];
+    pWorker->pRecorder = pRecorder;
+    pWorker->workerIndex = i;
+    int threadRet = pthread_create(&pWorker->thread, NULL,
+                                   runParallelRecordWorker, pWorker);
+    if (threadRet != 0) {
+      LOG_ERROR_ARGS(ERR_LEVEL_ERROR, "failed to start record worker: %s",
+                     strerror(threadRet));
+      delete_ParallelRecorder(pRecorder);
+      return (ERR_UNKNOWN);
+    }
+    pRecorder->threadCount++;
+  }
+  return (ERR_OK);
+}
+
+void delete_ParallelRecorder(ParallelRecorder *pRecorder) {
+  pthread_mutex_lock(&pRecorder->mutex);
+  pRecorder->quit = true;
+  pthread_cond_broadcast(&pRecorder->jobReady);
+  pthread_mutex_unlock(&pRecorder->mutex);
+  for (uint32_t i = 0; i < pRecorder->threadCount; i++) {
+    pthread_join(pRecorder->pWorkers[i].thread, NULL);
+  }
+  pRecorder->threadCount = 0;
+
+  // destroying a pool frees its command buffers too
+  for (uint32_t i = 0; i < pRecorder->workerCount * pRecorder->frameCount;
+       i++) {
+    vkDestroyCommandPool(pRecorder->device, pRecorder->pCommandPools[i], NULL);
+  }
+  free(pRecorder->pCommandPools);
+  free(pRecorder->pCommandBuffers);
+  free(pRecorder->pWorkers);
+  pRecorder->pCommandPools = NULL;
+  pRecorder->pCommandBuffers = NULL;
+  pRecorder->pWorkers = NULL;
+
+  pthread_cond_destroy(&pRecorder->jobDone);
+  pthread_cond_destroy(&pRecorder->jobReady);
+  pthread_mutex_destroy(&pRecorder->mutex);
+}
+
+void beginParallelRecorderFrame(ParallelRecorder *pRecorder,
+                                const uint32_t frameIndex) {
+  pRecorder->currentFrame = frameIndex;
+}
+
+void recordParallelDraws(ParallelRecorder *pRecorder,
+                         const ParallelDrawJob *pJob,
+                         const VkCommandBuffer commandBuffer) {
+  recordDrawBuckets(pRecorder, pJob);
+  vkCmdExecuteCommands(
+      commandBuffer, pRecorder->workerCount,
+      &pRecorder->pCommandBuffers[pRecorder->currentFrame *
+                                  pRecorder->workerCount]);
+}
+
+ErrVal benchParallelRecording(const ParallelDrawJob *pJob,
+                              const uint32_t maxWorkerCount,
+                              const uint32_t queueFamilyIndex,
+                              const VkDevice device) {
+  double singleWorkerTime = 0.0;
+  uint32_t workerCount = 1;
+  while (true) {
+    ParallelRecorder recorder;
+    ErrVal ret = new_ParallelRecorder(&recorder, workerCount, 1,
+                                      queueFamilyIndex, device);
+    if (ret != ERR_OK) {
+      return (ret);
+    }
+    for (uint32_t i = 0; i < PARALLEL_RECORD_BENCH_WARMUP; i++) {
+      recordDrawBuckets(&recorder, pJob);
+    }
+    double startTime = getTime();
+    for (uint32_t i = 0; i < PARALLEL_RECORD_BENCH_ITERATIONS; i++) {
+      recordDrawBuckets(&recorder, pJob);
+    }
+    double recordTime =
+        (getTime() - startTime) / PARALLEL_RECORD_BENCH_ITERATIONS;
+    delete_ParallelRecorder(&recorder);
+
+    if (workerCount == 1) {
+      singleWorkerTime = recordTime;
+    }
+    printf("record threads: %3u  draws: %8u  record: %8.3f ms  speedup: "
+           "%5.2fx\n",
+           workerCount, pJob->drawCount, recordTime * 1000.0,
+           recordTime > 0.0 ? singleWorkerTime / recordTime : 0.0);
+
+    if (workerCount >= maxWorkerCount) {
+      break;
+    }
+    // doubling, but always ending on the requested count
+    workerCount *= 2;
+    if (workerCount > maxWorkerCount) {
+      workerCount = maxWorkerCount;
+    }
+  }
+  return (ERR_OK);
+}
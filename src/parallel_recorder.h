@@ -0,0 +1,129 @@
+///
+/// Copyright 2019 Govind Pimpale
+/// parallel_recorder.h
+///
+/// Records the draws of a frame on several threads. The draws are split into
+/// one contiguous bucket per worker, and each worker records its bucket into a
+/// secondary command buffer allocated from a command pool no other thread
+/// touches, so recording never has to lock a pool. The primary command buffer
+/// then only executes the secondaries inside the render pass. Every frame in
+/// flight has its own pools, which are reset whole once its fence signals.
+///
+
+#ifndef SRC_PARALLEL_RECORDER_H_
+#define SRC_PARALLEL_RECORDER_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include <linmath.h>
+
+#include "errors.h"
+
+// more workers than this stop paying for themselves long before
+#define PARALLEL_RECORDER_MAX_WORKERS 64
+
+// recordings thrown away before and timed in each step of the benchmark
+#define PARALLEL_RECORD_BENCH_WARMUP 5
+#define PARALLEL_RECORD_BENCH_ITERATIONS 50
+
+// Everything the draws of one frame are recorded from
+typedef struct {
+  VkRenderPass renderPass;
+  VkFramebuffer framebuffer;
+  VkPipelineLayout pipelineLayout;
+  VkPipeline pipeline;
+  VkExtent2D extent;
+  VkBuffer vertexBuffer;
+  VkBuffer indexBuffer;
+  uint32_t indexCount;
+  VkBuffer instanceBuffer;
+  // each instance gets a draw of its own, draw i drawing instance
+  // pInstances[i], or instance i when pInstances is NULL
+  uint32_t drawCount;
+  const uint32_t *pInstances;
+  mat4x4 transform;
+} ParallelDrawJob;
+
+struct ParallelRecorder;
+
+typedef struct {
+  struct ParallelRecorder *pRecorder;
+  uint32_t workerIndex;
+  pthread_t thread;
+} ParallelRecordWorker;
+
+typedef struct ParallelRecorder {
+  VkDevice device;
+  uint32_t workerCount;
+  uint32_t frameCount;
+  uint32_t currentFrame;
+  // workerCount pools and secondaries for each frame in flight, frame major
+  VkCommandPool *pCommandPools;
+  VkCommandBuffer *pCommandBuffers;
+  ParallelRecordWorker *pWorkers;
+  // workers that were started, and so have to be joined
+  uint32_t threadCount;
+  pthread_mutex_t mutex;
+  pthread_cond_t jobReady;
+  pthread_cond_t jobDone;
+  // bumped for each job, so a worker can tell it apart from a spurious wakeup
+  uint64_t jobGeneration;
+  uint32_t pendingWorkerCount;
+  bool quit;
+  const ParallelDrawJob *pJob;
+} ParallelRecorder;
+
+/// Creates a recorder with `workerCount` threads, for `frameCount` frames in
+/// flight
+/// --- PRECONDITIONS ---
+/// * `workerCount` is 1 to PARALLEL_RECORDER_MAX_WORKERS
+/// * `*pRecorder` isn't moved until it is deleted, the workers point to it
+/// --- POSTCONDITIONS ---
+/// * returns error status
+/// --- CLEANUP ---
+/// * call delete_ParallelRecorder
+ErrVal new_ParallelRecorder(ParallelRecorder *pRecorder,
+                            const uint32_t workerCount,
+                            const uint32_t frameCount,
+                            const uint32_t queueFamilyIndex,
+                            const VkDevice device);
+
+/// Stops the workers, then destroys the pools
+/// --- PRECONDITIONS ---
+/// * no frame that executes the secondaries is in flight
+void delete_ParallelRecorder(ParallelRecorder *pRecorder);
+
+/// Makes `frameIndex` the frame recorded into next
+/// --- PRECONDITIONS ---
+/// * the last submit of that frame has completed, e.g. its fence has
+/// signaled
+void beginParallelRecorderFrame(ParallelRecorder *pRecorder,
+                                const uint32_t frameIndex);
+
+/// Records the draws of `pJob` on every worker, and waits for them to finish
+/// before executing their secondaries in `commandBuffer`
+/// --- PRECONDITIONS ---
+/// * `commandBuffer` is inside subpass 0 of `pJob->renderPass`, begun with
+/// VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+/// * `pJob->instanceBuffer` holds every instance drawn and `pJob->pipeline` is
+/// instanced
+void recordParallelDraws(ParallelRecorder *pRecorder,
+                         const ParallelDrawJob *pJob,
+                         const VkCommandBuffer commandBuffer);
+
+/// Times recording the draws of `pJob` with 1 worker, then doubling up to
+/// `maxWorkerCount`, and prints how each step compares to a single worker
+/// --- PRECONDITIONS ---
+/// * as recordParallelDraws, nothing recorded is submitted
+/// --- POSTCONDITIONS ---
+/// * returns error status
+ErrVal benchParallelRecording(const ParallelDrawJob *pJob,
+                              const uint32_t maxWorkerCount,
+                              const uint32_t queueFamilyIndex,
+                              const VkDevice device);
+
+#endif /* SRC_PARALLEL_RECORDER_H_ */
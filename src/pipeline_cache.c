@@ -0,0 +1,163 @@
+#include "pipeline_cache.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+#include "vulkan_utils.h"
+
+// headerSize, headerVersion, vendorID, deviceID and then the cache UUID
+#define PIPELINE_CACHE_HEADER_SIZE (4 * sizeof(uint32_t) + VK_UUID_SIZE)
+
+// the header is always least significant byte first, whatever the host
+static uint32_t readHeaderWord(const uint8_t *pData) {
+  return ((uint32_t)pData[0] | (uint32_t)pData[1] << 8 |
+          (uint32_t)pData[2] << 16 | (uint32_t)pData[3] << 24);
+}
+
+static bool isPipelineCacheCompatible(const uint8_t *pData, const size_t size,
+                                      const VkPhysicalDevice physicalDevice) {
+  if (size < PIPELINE_CACHE_HEADER_SIZE) {
+    LOG_ERROR(ERR_LEVEL_INFO, "pipeline cache rejected: truncated header");
+    return (false);
+  }
+  uint32_t headerSize = readHeaderWord(pData);
+  uint32_t headerVersion = readHeaderWord(pData + 4);
+  uint32_t vendorID = readHeaderWord(pData + 8);
+  uint32_t deviceID = readHeaderWord(pData + 12);
+  const uint8_t *pUUID = pData + 16;
+  if (headerSize < PIPELINE_CACHE_HEADER_SIZE || headerSize > size ||
+      headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) {
+    LOG_ERROR(ERR_LEVEL_INFO, "pipeline cache rejected: bad header");
+    return (false);
+  }
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  if (vendorID != properties.vendorID || deviceID != properties.deviceID) {
+    LOG_ERROR(ERR_LEVEL_INFO,
+              "pipeline cache rejected: written for a different device");
+    return (false);
+  }
+  if (memcmp(pUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+    LOG_ERROR(ERR_LEVEL_INFO,
+              "pipeline cache rejected: written by a different driver");
+    return (false);
+  }
+  return (true);
+}
+
+ErrVal new_PipelineCache(VkPipelineCache *pPipelineCache, size_t *pLoadedSize,
+                         const char *path,
+                         const VkPhysicalDevice physicalDevice,
+                         const VkDevice device) {
+  *pLoadedSize = 0;
+  uint8_t *pData = NULL;
+  size_t size = 0;
+
+  FILE *fp = fopen(path, "rb");
+  if (fp != NULL) {
+    size = (size_t)getLength(fp);
+    pData = malloc(size == 0 ? 1 : size);
+    if (pData == NULL) {
+      LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "could not read pipeline cache: %s",
+                     strerror(errno));
+      fclose(fp);
+      PANIC();
+    }
+    if (fread(pData, 1, size, fp) != size) {
+      LOG_ERROR_ARGS(ERR_LEVEL_WARN, "could not read pipeline cache %s", path);
+      size = 0;
+    }
+    fclose(fp);
+  } else {
+    LOG_ERROR_ARGS(ERR_LEVEL_INFO, "no pipeline cache at %s, starting empty",
+                   path);
+  }
+
+  // a stale cache is harmless to the driver but useless to us, so drop it
+  if (size != 0 && !isPipelineCacheCompatible(pData, size, physicalDevice)) {
+    size = 0;
+  }
+
+  VkPipelineCacheCreateInfo createInfo = {0};
+  createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  createInfo.initialDataSize = size;
+  createInfo.pInitialData = size == 0 ? NULL : pData;
+  VkResult ret =
+      vkCreatePipelineCache(device, &createInfo, NULL, pPipelineCache);
+  free(pData);
+  if (ret != VK_SUCCESS) {
+    LOG_ERROR_ARGS(ERR_LEVEL_ERROR, "failed to create pipeline cache: %s",
+                   vkstrerror(ret));
+    return (ERR_UNKNOWN);
+  }
+  *pLoadedSize = size;
+  return (ERR_OK);
+}
+
+void delete_PipelineCache(VkPipelineCache *pPipelineCache,
+                          const VkDevice device) {
+  vkDestroyPipelineCache(device, *pPipelineCache, NULL);
+  *pPipelineCache = VK_NULL_HANDLE;
+}
+
+ErrVal savePipelineCache(const VkPipelineCache pipelineCache, const char *path,
+                         const VkDevice device) {
+  size_t size = 0;
+  VkResult ret = vkGetPipelineCacheData(device, pipelineCache, &size, NULL);
+  if (ret != VK_SUCCESS) {
+    LOG_ERROR_ARGS(ERR_LEVEL_ERROR, "failed to get pipeline cache size: %s",
+                   vkstrerror(ret));
+    return (ERR_UNKNOWN);
+  }
+  void *pData = malloc(size == 0 ? 1 : size);
+  if (pData == NULL) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "could not save pipeline cache: %s",
+                   strerror(errno));
+    PANIC();
+  }
+  ret = vkGetPipelineCacheData(device, pipelineCache, &size, pData);
+  if (ret != VK_SUCCESS) {
+    LOG_ERROR_ARGS(ERR_LEVEL_ERROR, "failed to get pipeline cache data: %s",
+                   vkstrerror(ret));
+    free(pData);
+    return (ERR_UNKNOWN);
+  }
+
+  /* Write next to the old cache, then swap it in with one rename */
+  size_t tmpPathLength = strlen(path) + sizeof(".tmp");
+  char *tmpPath = malloc(tmpPathLength);
+  if (tmpPath == NULL) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "could not save pipeline cache: %s",
+                   strerror(errno));
+    PANIC();
+  }
+  snprintf(tmpPath, tmpPathLength, "%s.tmp", path);
+
+  ErrVal retVal = ERR_OK;
+  FILE *fp = fopen(tmpPath, "wb");
+  if (fp == NULL) {
+    LOG_ERROR_ARGS(ERR_LEVEL_WARN, "could not open %s: %s", tmpPath,
+                   strerror(errno));
+    retVal = ERR_UNKNOWN;
+  } else {
+    bool written = fwrite(pData, 1, size, fp) == size;
+    // fclose flushes, so it can fail too
+    written = (fclose(fp) == 0) && written;
+    if (!written || rename(tmpPath, path) != 0) {
+      LOG_ERROR_ARGS(ERR_LEVEL_WARN, "could not save pipeline cache to %s: %s",
+                     path, strerror(errno));
+      remove(tmpPath);
+      retVal = ERR_UNKNOWN;
+    }
+  }
+
+  free(tmpPath);
+  free(pData);
+  return (retVal);
+}
@@ -0,0 +1,48 @@
+///
+/// Copyright 2019 Govind Pimpale
+/// pipeline_cache.h
+///
+/// Keeps compiled pipelines between runs. The cache is loaded from a file at
+/// startup, passed to every pipeline constructor, and written back on
+/// shutdown, so only the first launch on a given driver pays for compiling
+/// shaders to machine code.
+///
+
+#ifndef SRC_PIPELINE_CACHE_H_
+#define SRC_PIPELINE_CACHE_H_
+
+#include <stddef.h>
+
+#include <vulkan/vulkan.h>
+
+#include "errors.h"
+
+/// Creates a pipeline cache, seeded from the file at `path` if it holds a
+/// cache written by the same driver for the same device
+/// --- PRECONDITIONS ---
+/// * `pPipelineCache` is a valid pointer
+/// * `device` was created from `physicalDevice`
+/// --- POSTCONDITIONS ---
+/// * returns error status
+/// * `*pLoadedSize` is set to the number of bytes loaded from `path`, 0 if the
+/// file was missing, or was rejected as stale or corrupt
+/// * a missing or rejected file is not an error, the cache just starts empty
+/// --- CLEANUP ---
+/// * call savePipelineCache if it should be kept, then delete_PipelineCache
+ErrVal new_PipelineCache(VkPipelineCache *pPipelineCache, size_t *pLoadedSize,
+                         const char *path,
+                         const VkPhysicalDevice physicalDevice,
+                         const VkDevice device);
+
+void delete_PipelineCache(VkPipelineCache *pPipelineCache,
+                          const VkDevice device);
+
+/// Writes the contents of `pipelineCache` to `path`
+/// --- POSTCONDITIONS ---
+/// * returns error status
+/// * the data is written to a temporary file that is then renamed over
+/// `path`, so a crash mid write never leaves a truncated cache behind
+ErrVal savePipelineCache(const VkPipelineCache pipelineCache, const char *path,
+                         const VkDevice device);
+
+#endif /* SRC_PIPELINE_CACHE_H_ */
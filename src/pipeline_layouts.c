@@ -0,0 +1,144 @@
+#include "pipeline_layouts.h"
+
+#include "vulkan_utils.h"
+
+ErrVal new_PipelineLayoutCache(PipelineLayoutCache *pCache,
+                               const VkDevice device) {
+  pCache->device = device;
+  pCache->setLayoutCount = 0;
+  pCache->pipelineLayoutCount = 0;
+  pCache->hitCount = 0;
+  return (ERR_OK);
+}
+
+void delete_PipelineLayoutCache(PipelineLayoutCache *pCache) {
+  LOG_ERROR_ARGS(ERR_LEVEL_DEBUG,
+                 "layout cache: %u pipeline layouts, %u set layouts, %u "
+                 "shared",
+                 pCache->pipelineLayoutCount, pCache->setLayoutCount,
+                 pCache->hitCount);
+  for (uint32_t i = 0; i < pCache->pipelineLayoutCount; i++) {
+    delete_PipelineLayout(&pCache->pPipelineLayouts[i].layout, pCache->device);
+  }
+  for (uint32_t i = 0; i < pCache->setLayoutCount; i++) {
+    delete_DescriptorSetLayout(&pCache->pSetLayouts[i].layout,
+                               pCache->device);
+  }
+  pCache->pipelineLayoutCount = 0;
+  pCache->setLayoutCount = 0;
+}
+
+ErrVal getReflectedDescriptorSetLayout(VkDescriptorSetLayout *pLayout,
+                                       PipelineLayoutCache *pCache,
+                                       const ShaderInterface *pInterface,
+                                       const uint32_t set) {
+  uint64_t hash = hashShaderInterfaceLayout(pInterface, set);
+  for (uint32_t i = 0; i < pCache->setLayoutCount; i++) {
+    CachedDescriptorSetLayout *pCached = &pCache->pSetLayouts[i];
+    if (pCached->hash == hash &&
+        isShaderInterfaceLayoutEqual(&pCached->interface, pInterface, set)) {
+      pCache->hitCount++;
+      *pLayout = pCached->layout;
+      return (ERR_OK);
+    }
+  }
+  if (pCache->setLayoutCount == PIPELINE_LAYOUT_CACHE_CAPACITY) {
+    LOG_ERROR(ERR_LEVEL_ERROR, "descriptor set layout cache is full");
+    return (ERR_MEMORY);
+  }
+
+  VkDescriptorSetLayoutBinding pBindings[SPIRV_REFLECTION_MAX_BINDINGS];
+  uint32_t bindingCount = 0;
+  for (uint32_t i = 0; i < pInterface->bindingCount; i++) {
+    const ReflectedBinding *pBinding = &pInterface->pBindings[i];
+    if (pBinding->set != set) {
+      continue;
+    }
+    VkDescriptorSetLayoutBinding layoutBinding = {0};
+    layoutBinding.binding = pBinding->binding;
+    layoutBinding.descriptorType = pBinding->descriptorType;
+    layoutBinding.descriptorCount = pBinding->descriptorCount;
+    layoutBinding.stageFlags = pBinding->stageFlags;
+    layoutBinding.pImmutableSamplers = NULL;
+    pBindings[bindingCount++] = layoutBinding;
+  }
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo = {0};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.bindingCount = bindingCount;
+  layoutInfo.pBindings = pBindings;
+  CachedDescriptorSetLayout *pCached =
+      &pCache->pSetLayouts[pCache->setLayoutCount];
+  VkResult res = vkCreateDescriptorSetLayout(pCache->device, &layoutInfo, NULL,
+                                             &pCached->layout);
+  if (res != VK_SUCCESS) {
+    LOG_ERROR_ARGS(ERR_LEVEL_ERROR,
+                   "failed to create descriptor set layout: %s",
+                   vkstrerror(res));
+    return (ERR_UNKNOWN);
+  }
+  pCached->hash = hash;
+  pCached->interface = *pInterface;
+  pCached->set = set;
+  pCache->setLayoutCount++;
+  *pLayout = pCached->layout;
+  return (ERR_OK);
+}
+
+ErrVal getReflectedPipelineLayout(VkPipelineLayout *pLayout,
+                                  PipelineLayoutCache *pCache,
+                                  const ShaderInterface *pInterface) {
+  uint64_t hash = hashShaderInterfaceLayout(pInterface, UINT32_MAX);
+  for (uint32_t i = 0; i < pCache->pipelineLayoutCount; i++) {
+    CachedPipelineLayout *pCached = &pCache->pPipelineLayouts[i];
+    if (pCached->hash == hash && isShaderInterfaceLayoutEqual(
+                                     &pCached->interface, pInterface,
+                                     UINT32_MAX)) {
+      pCache->hitCount++;
+      *pLayout = pCached->layout;
+      return (ERR_OK);
+    }
+  }
+  if (pCache->pipelineLayoutCount == PIPELINE_LAYOUT_CACHE_CAPACITY) {
+    LOG_ERROR(ERR_LEVEL_ERROR, "pipeline layout cache is full");
+    return (ERR_MEMORY);
+  }
+
+  // sets the shaders skip still need a layout, an empty one
+  VkDescriptorSetLayout pSetLayouts[SPIRV_REFLECTION_MAX_SETS];
+  uint32_t setCount = getReflectedSetCount(pInterface);
+  for (uint32_t set = 0; set < setCount; set++) {
+    ErrVal retVal = getReflectedDescriptorSetLayout(&pSetLayouts[set], pCache,
+                                                    pInterface, set);
+    if (retVal != ERR_OK) {
+      return (retVal);
+    }
+  }
+
+  VkPushConstantRange pushConstantRange = {0};
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = pInterface->pushConstantSize;
+  pushConstantRange.stageFlags = pInterface->pushConstantStages;
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {0};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = setCount;
+  pipelineLayoutInfo.pSetLayouts = pSetLayouts;
+  pipelineLayoutInfo.pushConstantRangeCount =
+      pInterface->pushConstantSize == 0 ? 0 : 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+  CachedPipelineLayout *pCached =
+      &pCache->pPipelineLayouts[pCache->pipelineLayoutCount];
+  VkResult res = vkCreatePipelineLayout(pCache->device, &pipelineLayoutInfo,
+                                        NULL, &pCached->layout);
+  if (res != VK_SUCCESS) {
+    LOG_ERROR_ARGS(ERR_LEVEL_ERROR, "failed to create pipeline layout: %s",
+                   vkstrerror(res));
+    return (ERR_UNKNOWN);
+  }
+  pCached->hash = hash;
+  pCached->interface = *pInterface;
+  pCache->pipelineLayoutCount++;
+  *pLayout = pCached->layout;
+  return (ERR_OK);
+}
@@ -0,0 +1,79 @@
+///
+/// Copyright 2019 Govind Pimpale
+/// pipeline_layouts.h
+///
+/// Builds pipeline layouts from reflected shader interfaces, and hands out
+/// the same layout again for every interface that needs an identical one.
+/// Descriptor set layouts are shared the same way, set by set, so descriptor
+/// sets allocated for one pipeline can be bound with any other whose shaders
+/// declare that set alike, and pipelines with compatible interfaces share
+/// their layout.
+///
+
+#ifndef SRC_PIPELINE_LAYOUTS_H_
+#define SRC_PIPELINE_LAYOUTS_H_
+
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "errors.h"
+#include "spirv_reflection.h"
+
+// distinct layouts of each kind a cache can hold
+#define PIPELINE_LAYOUT_CACHE_CAPACITY 16
+
+typedef struct {
+  uint64_t hash;
+  // the interface the layout was built for, only its layout parts matter
+  ShaderInterface interface;
+  uint32_t set;
+  VkDescriptorSetLayout layout;
+} CachedDescriptorSetLayout;
+
+typedef struct {
+  uint64_t hash;
+  ShaderInterface interface;
+  VkPipelineLayout layout;
+} CachedPipelineLayout;
+
+typedef struct {
+  VkDevice device;
+  uint32_t setLayoutCount;
+  CachedDescriptorSetLayout pSetLayouts[PIPELINE_LAYOUT_CACHE_CAPACITY];
+  uint32_t pipelineLayoutCount;
+  CachedPipelineLayout pPipelineLayouts[PIPELINE_LAYOUT_CACHE_CAPACITY];
+  // layouts handed out without creating one
+  uint32_t hitCount;
+} PipelineLayoutCache;
+
+/// Creates an empty layout cache
+/// --- POSTCONDITIONS ---
+/// * returns error status
+/// --- CLEANUP ---
+/// * call delete_PipelineLayoutCache once no pipeline uses its layouts
+ErrVal new_PipelineLayoutCache(PipelineLayoutCache *pCache,
+                               const VkDevice device);
+
+/// Destroys every layout the cache handed out
+void delete_PipelineLayoutCache(PipelineLayoutCache *pCache);
+
+/// Gets the descriptor set layout for set `set` of `pInterface`
+/// --- POSTCONDITIONS ---
+/// * returns error status, ERR_MEMORY if the cache is full
+/// * the cache keeps ownership of `*pLayout`
+ErrVal getReflectedDescriptorSetLayout(VkDescriptorSetLayout *pLayout,
+                                       PipelineLayoutCache *pCache,
+                                       const ShaderInterface *pInterface,
+                                       const uint32_t set);
+
+/// Gets a pipeline layout with every descriptor set and the push constant
+/// range of `pInterface`
+/// --- POSTCONDITIONS ---
+/// * returns error status, ERR_MEMORY if the cache is full
+/// * the cache keeps ownership of `*pLayout`
+ErrVal getReflectedPipelineLayout(VkPipelineLayout *pLayout,
+                                  PipelineLayoutCache *pCache,
+                                  const ShaderInterface *pInterface);
+
+#endif /* SRC_PIPELINE_LAYOUTS_H_ */
@@ -0,0 +1,214 @@
+#include "pipeline_variants.h"
+
+#include <string.h>
+
+#include "utils.h"
+
+static bool copySpecialization(SpecializationCopy *pCopy,
+                               const VkSpecializationInfo *pInfo) {
+  if (pInfo->mapEntryCount > PIPELINE_VARIANT_MAX_CONSTANTS ||
+      pInfo->dataSize > sizeof(pCopy->pData)) {
+    return (false);
+  }
+  memcpy(pCopy->pMapEntries, pInfo->pMapEntries,
+         pInfo->mapEntryCount * sizeof(VkSpecializationMapEntry));
+  memcpy(pCopy->pData, pInfo->pData, pInfo->dataSize);
+  pCopy->info.mapEntryCount = pInfo->mapEntryCount;
+  pCopy->info.pMapEntries = pCopy->pMapEntries;
+  pCopy->info.dataSize = pInfo->dataSize;
+  pCopy->info.pData = pCopy->pData;
+  return (true);
+}
+
+static void *runPipelineVariantWorker(void *pArg) {
+  PipelineVariantBuilder *pBuilder = pArg;
+
+  pthread_mutex_lock(&pBuilder->mutex);
+  while (true) {
+    while (!pBuilder->quit && pBuilder->nextVariant == pBuilder->variantCount) {
+      pthread_cond_wait(&pBuilder->variantAdded, &pBuilder->mutex);
+    }
+    if (pBuilder->quit) {
+      break;
+    }
+    uint32_t variantIndex = pBuilder->nextVariant++;
+    PipelineVariant *pVariant = &pBuilder->pVariants[variantIndex];
+    pVariant->state = PIPELINE_VARIANT_COMPILING;
+    pthread_mutex_unlock(&pBuilder->mutex);
+
+    // the cache is synchronized internally, so every worker shares it
+    double compileStartTime = getTime();
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    ErrVal retVal = new_SpecializedVertexDisplayPipeline(
+        &pipeline, pBuilder->device, pBuilder->pipelineCache,
+        pBuilder->vertShaderModule, pBuilder->fragShaderModule,
+        pBuilder->renderPass, pBuilder->pipelineLayout, &pBuilder->interface,
+        pVariant->vertexFormat, pBuilder->instanced,
+        pVariant->pVertSpecialization, pVariant->pFragSpecialization);
+    double compileTime = getTime() - compileStartTime;
+
+    pthread_mutex_lock(&pBuilder->mutex);
+    if (retVal == ERR_OK) {
+      pVariant->pipeline = pipeline;
+      pVariant->state = PIPELINE_VARIANT_READY;
+    } else {
+      pVariant->state = PIPELINE_VARIANT_FAILED;
+      LOG_ERROR_ARGS(ERR_LEVEL_WARN,
+                     "pipeline variant %u failed, drawing without it",
+                     variantIndex);
+    }
+    pBuilder->doneCount++;
+    LOG_ERROR_ARGS(ERR_LEVEL_DEBUG,
+                   "pipeline variant %u: %.3f ms, %u of %u done after %.3f ms",
+                   variantIndex, compileTime * 1000.0, pBuilder->doneCount,
+                   pBuilder->variantCount,
+                   (getTime() - pBuilder->startTime) * 1000.0);
+    pthread_cond_broadcast(&pBuilder->variantDone);
+  }
+  pthread_mutex_unlock(&pBuilder->mutex);
+  return (NULL);
+}
+
+void new_PipelineVariantBuilder(
+    PipelineVariantBuilder *pBuilder, const VkPipeline fallbackPipeline,
+    const VkShaderModule vertShaderModule,
+    const VkShaderModule fragShaderModule, const bool instanced,
+    const VkRenderPass renderPass, const VkPipelineLayout pipelineLayout,
+    const ShaderInterface *pInterface, const VkPipelineCache pipelineCache,
+    const VkDevice device) {
+  pBuilder->device = device;
+  pBuilder->pipelineCache = pipelineCache;
+  pBuilder->renderPass = renderPass;
+  pBuilder->pipelineLayout = pipelineLayout;
+  pBuilder->interface = *pInterface;
+  pBuilder->vertShaderModule = vertShaderModule;
+  pBuilder->fragShaderModule = fragShaderModule;
+  pBuilder->instanced = instanced;
+  pBuilder->fallbackPipeline = fallbackPipeline;
+  pBuilder->threadCount = 0;
+  pBuilder->quit = false;
+  pBuilder->variantCount = 0;
+  pBuilder->nextVariant = 0;
+  pBuilder->doneCount = 0;
+  pBuilder->startTime = getTime();
+  pthread_mutex_init(&pBuilder->mutex, NULL);
+  pthread_cond_init(&pBuilder->variantAdded, NULL);
+  pthread_cond_init(&pBuilder->variantDone, NULL);
+}
+
+ErrVal startPipelineVariantWorkers(PipelineVariantBuilder *pBuilder) {
+  pthread_mutex_lock(&pBuilder->mutex);
+  uint32_t variantCount = pBuilder->variantCount;
+  pthread_mutex_unlock(&pBuilder->mutex);
+
+  // a worker per queued variant at most, and at most one per processor,
+  // getProcessorCount is at least 1
+  uint32_t workerCount = getProcessorCount();
+  if (workerCount > variantCount) {
+    workerCount = variantCount;
+  }
+  if (workerCount > PIPELINE_VARIANT_MAX_WORKERS) {
+    workerCount = PIPELINE_VARIANT_MAX_WORKERS;
+  }
+  if (workerCount == 0) {
+    workerCount = 1;
+  }
+
+  for (uint32_t i = 0; i < workerCount; i++) {
+    int threadRet = pthread_create(&pBuilder->pThreads[i], NULL,
+                                   runPipelineVariantWorker, pBuilder);
+    if (threadRet != 0) {
+      LOG_ERROR_ARGS(ERR_LEVEL_ERROR,
+                     "failed to start pipeline variant worker: %s",
+                     strerror(threadRet));
+      return (ERR_UNKNOWN);
+    }
+    pBuilder->threadCount++;
+  }
+  LOG_ERROR_ARGS(ERR_LEVEL_DEBUG,
+                 "compiling %u pipeline variants on %u workers", variantCount,
+                 workerCount);
+  return (ERR_OK);
+}
+
+void delete_PipelineVariantBuilder(PipelineVariantBuilder *pBuilder) {
+  pthread_mutex_lock(&pBuilder->mutex);
+  pBuilder->quit = true;
+  pthread_cond_broadcast(&pBuilder->variantAdded);
+  pthread_mutex_unlock(&pBuilder->mutex);
+  for (uint32_t i = 0; i < pBuilder->threadCount; i++) {
+    pthread_join(pBuilder->pThreads[i], NULL);
+  }
+  pBuilder->threadCount = 0;
+
+  for (uint32_t i = 0; i < pBuilder->variantCount; i++) {
+    if (pBuilder->pVariants[i].state == PIPELINE_VARIANT_READY) {
+      delete_Pipeline(&pBuilder->pVariants[i].pipeline, pBuilder->device);
+    }
+  }
+  pBuilder->variantCount = 0;
+
+  pthread_cond_destroy(&pBuilder->variantDone);
+  pthread_cond_destroy(&pBuilder->variantAdded);
+  pthread_mutex_destroy(&pBuilder->mutex);
+}
+
+ErrVal addPipelineVariant(PipelineVariantBuilder *pBuilder,
+                          uint32_t *pVariantIndex,
+                          const VertexFormat vertexFormat,
+                          const VkSpecializationInfo *pVertSpecialization,
+                          const VkSpecializationInfo *pFragSpecialization) {
+  pthread_mutex_lock(&pBuilder->mutex);
+  if (pBuilder->variantCount == PIPELINE_VARIANT_MAX_VARIANTS) {
+    pthread_mutex_unlock(&pBuilder->mutex);
+    LOG_ERROR(ERR_LEVEL_ERROR, "too many pipeline variants");
+    return (ERR_MEMORY);
+  }
+  PipelineVariant *pVariant = &pBuilder->pVariants[pBuilder->variantCount];
+  pVariant->vertexFormat = vertexFormat;
+  pVariant->pVertSpecialization = NULL;
+  pVariant->pFragSpecialization = NULL;
+  pVariant->state = PIPELINE_VARIANT_PENDING;
+  pVariant->pipeline = VK_NULL_HANDLE;
+  if ((pVertSpecialization != NULL &&
+       !copySpecialization(&pVariant->vertSpecialization,
+                           pVertSpecialization)) ||
+      (pFragSpecialization != NULL &&
+       !copySpecialization(&pVariant->fragSpecialization,
+                           pFragSpecialization))) {
+    pthread_mutex_unlock(&pBuilder->mutex);
+    LOG_ERROR(ERR_LEVEL_ERROR, "too many specialization constants");
+    return (ERR_BADARGS);
+  }
+  if (pVertSpecialization != NULL) {
+    pVariant->pVertSpecialization = &pVariant->vertSpecialization.info;
+  }
+  if (pFragSpecialization != NULL) {
+    pVariant->pFragSpecialization = &pVariant->fragSpecialization.info;
+  }
+  *pVariantIndex = pBuilder->variantCount++;
+  pthread_cond_signal(&pBuilder->variantAdded);
+  pthread_mutex_unlock(&pBuilder->mutex);
+  return (ERR_OK);
+}
+
+VkPipeline getPipelineVariant(PipelineVariantBuilder *pBuilder,
+                              const uint32_t variantIndex) {
+  // the lock is only ever held for bookkeeping, never across a compile
+  pthread_mutex_lock(&pBuilder->mutex);
+  VkPipeline pipeline = pBuilder->fallbackPipeline;
+  if (variantIndex < pBuilder->variantCount &&
+      pBuilder->pVariants[variantIndex].state == PIPELINE_VARIANT_READY) {
+    pipeline = pBuilder->pVariants[variantIndex].pipeline;
+  }
+  pthread_mutex_unlock(&pBuilder->mutex);
+  return (pipeline);
+}
+
+void waitPipelineVariants(PipelineVariantBuilder *pBuilder) {
+  pthread_mutex_lock(&pBuilder->mutex);
+  while (pBuilder->doneCount != pBuilder->variantCount) {
+    pthread_cond_wait(&pBuilder->variantDone, &pBuilder->mutex);
+  }
+  pthread_mutex_unlock(&pBuilder->mutex);
+}
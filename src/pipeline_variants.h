@@ -0,0 +1,147 @@
+///
+/// Copyright 2019 Govind Pimpale
+/// pipeline_variants.h
+///
+/// Compiles variants of the vertex display pipeline in the background. Each
+/// variant is a vertex format and a set of specialization constants for the
+/// shaders, and a pool of worker threads builds them through the shared
+/// pipeline cache while frames keep rendering. Looking a variant up never
+/// waits: until it is ready, the pipeline it specializes is returned instead.
+///
+
+#ifndef SRC_PIPELINE_VARIANTS_H_
+#define SRC_PIPELINE_VARIANTS_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "errors.h"
+#include "spirv_reflection.h"
+#include "vulkan_utils.h"
+
+#define PIPELINE_VARIANT_MAX_VARIANTS 32
+#define PIPELINE_VARIANT_MAX_WORKERS 16
+// constants per stage, each at most 8 bytes
+#define PIPELINE_VARIANT_MAX_CONSTANTS 8
+
+// the specialization constant ids of shader.frag
+#define SPEC_CONSTANT_DEBUG_VERTEX_COLOR 0
+#define SPEC_CONSTANT_LIGHTING 1
+
+typedef enum {
+  PIPELINE_VARIANT_PENDING = 0,
+  PIPELINE_VARIANT_COMPILING = 1,
+  PIPELINE_VARIANT_READY = 2,
+  PIPELINE_VARIANT_FAILED = 3,
+} PipelineVariantState;
+
+// A VkSpecializationInfo with storage of its own, so callers needn't keep
+// theirs alive until a worker gets to it
+typedef struct {
+  VkSpecializationInfo info;
+  VkSpecializationMapEntry pMapEntries[PIPELINE_VARIANT_MAX_CONSTANTS];
+  uint64_t pData[PIPELINE_VARIANT_MAX_CONSTANTS];
+} SpecializationCopy;
+
+typedef struct {
+  VertexFormat vertexFormat;
+  // NULL when a stage isn't specialized
+  const VkSpecializationInfo *pVertSpecialization;
+  const VkSpecializationInfo *pFragSpecialization;
+  SpecializationCopy vertSpecialization;
+  SpecializationCopy fragSpecialization;
+  PipelineVariantState state;
+  VkPipeline pipeline;
+} PipelineVariant;
+
+typedef struct {
+  VkDevice device;
+  VkPipelineCache pipelineCache;
+  VkRenderPass renderPass;
+  VkPipelineLayout pipelineLayout;
+  ShaderInterface interface;
+  VkShaderModule vertShaderModule;
+  VkShaderModule fragShaderModule;
+  bool instanced;
+  // drawn with in place of a variant that isn't ready
+  VkPipeline fallbackPipeline;
+  uint32_t threadCount;
+  pthread_t pThreads[PIPELINE_VARIANT_MAX_WORKERS];
+  // everything below is guarded by mutex, a worker only lets go of it to
+  // compile
+  pthread_mutex_t mutex;
+  pthread_cond_t variantAdded;
+  pthread_cond_t variantDone;
+  bool quit;
+  uint32_t variantCount;
+  // the first variant no worker has claimed yet
+  uint32_t nextVariant;
+  uint32_t doneCount;
+  double startTime;
+  PipelineVariant pVariants[PIPELINE_VARIANT_MAX_VARIANTS];
+} PipelineVariantBuilder;
+
+/// Sets up a builder for variants of the pipeline built from the given
+/// shaders and state, see new_SpecializedVertexDisplayPipeline. Nothing is
+/// compiled until startPipelineVariantWorkers
+/// --- PRECONDITIONS ---
+/// * `fallbackPipeline` was built from the same shaders and state
+/// * the shader modules, layout and render pass outlive the builder
+/// * `*pBuilder` isn't moved until it is deleted, the workers point to it
+/// --- CLEANUP ---
+/// * call delete_PipelineVariantBuilder
+void new_PipelineVariantBuilder(
+    PipelineVariantBuilder *pBuilder, const VkPipeline fallbackPipeline,
+    const VkShaderModule vertShaderModule,
+    const VkShaderModule fragShaderModule, const bool instanced,
+    const VkRenderPass renderPass, const VkPipelineLayout pipelineLayout,
+    const ShaderInterface *pInterface, const VkPipelineCache pipelineCache,
+    const VkDevice device);
+
+/// Starts the threads that compile the variants, one per variant queued so
+/// far but no more than there are processors or PIPELINE_VARIANT_MAX_WORKERS
+/// --- PRECONDITIONS ---
+/// * the workers haven't been started yet
+/// --- POSTCONDITIONS ---
+/// * returns error status, the workers that did start keep compiling even
+/// if starting another failed
+/// * variants queued afterwards are compiled by the same workers
+ErrVal startPipelineVariantWorkers(PipelineVariantBuilder *pBuilder);
+
+/// Stops the workers once their current compile is done, then destroys every
+/// variant they built
+/// --- PRECONDITIONS ---
+/// * no frame drawing with a variant is in flight
+void delete_PipelineVariantBuilder(PipelineVariantBuilder *pBuilder);
+
+/// Queues a variant for the workers to compile
+/// --- PRECONDITIONS ---
+/// * `pVertSpecialization` and `pFragSpecialization` are NULL or have at
+/// most PIPELINE_VARIANT_MAX_CONSTANTS entries and as many 8 byte words of
+/// data
+/// --- POSTCONDITIONS ---
+/// * returns error status, ERR_MEMORY once PIPELINE_VARIANT_MAX_VARIANTS are
+/// queued
+/// * `*pVariantIndex` identifies the variant to getPipelineVariant
+ErrVal addPipelineVariant(PipelineVariantBuilder *pBuilder,
+                          uint32_t *pVariantIndex,
+                          const VertexFormat vertexFormat,
+                          const VkSpecializationInfo *pVertSpecialization,
+                          const VkSpecializationInfo *pFragSpecialization);
+
+/// Returns the variant if it has compiled, else the fallback pipeline, and
+/// never waits for a compile
+VkPipeline getPipelineVariant(PipelineVariantBuilder *pBuilder,
+                              const uint32_t variantIndex);
+
+/// Waits until every variant queued so far has compiled or failed, e.g. so
+/// that a headless run renders the same frames every time
+/// --- PRECONDITIONS ---
+/// * startPipelineVariantWorkers has started at least one worker
+void waitPipelineVariants(PipelineVariantBuilder *pBuilder);
+
+#endif /* SRC_PIPELINE_VARIANTS_H_ */
@@ -0,0 +1,114 @@
+#include "prerecorded_frames.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vulkan_utils.h"
+
+ErrVal new_PrerecordedFrames(PrerecordedFrames *pFrames,
+                             const uint32_t imageCount,
+                             const VkDescriptorSetLayout descriptorSetLayout,
+                             const VkCommandPool commandPool,
+                             DeviceAllocator *pAllocator,
+                             const VkDevice device) {
+  pFrames->device = device;
+  pFrames->commandPool = commandPool;
+  pFrames->imageCount = imageCount;
+  pFrames->pUniformBuffers = calloc(imageCount, sizeof(VkBuffer));
+  pFrames->pUniformAllocations = calloc(imageCount, sizeof(DeviceAllocation));
+  pFrames->pDescriptorSets = calloc(imageCount, sizeof(VkDescriptorSet));
+  pFrames->pCommandBuffers = calloc(imageCount, sizeof(VkCommandBuffer));
+  pFrames->pRecorded = calloc(imageCount, sizeof(bool));
+  if (pFrames->pUniformBuffers == NULL ||
+      pFrames->pUniformAllocations == NULL ||
+      pFrames->pDescriptorSets == NULL || pFrames->pCommandBuffers == NULL ||
+      pFrames->pRecorded == NULL) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "failed to create prerecorded frames: %s",
+                   strerror(errno));
+    PANIC();
+  }
+
+  ErrVal retVal =
+      new_DescriptorPool(&pFrames->descriptorPool,
+                         VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, imageCount, device);
+  if (retVal != ERR_OK) {
+    LOG_ERROR(ERR_LEVEL_ERROR, "failed to create camera descriptor pool");
+    return (retVal);
+  }
+
+  for (uint32_t i = 0; i < imageCount; i++) {
+    // written every frame and read once per vertex, so host visible is fine
+    retVal = new_Buffer_DeviceMemory(
+        &pFrames->pUniformBuffers[i], &pFrames->pUniformAllocations[i],
+        sizeof(mat4x4), pAllocator, device, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if (retVal != ERR_OK) {
+      LOG_ERROR(ERR_LEVEL_ERROR, "failed to create camera uniform buffer");
+      return (retVal);
+    }
+    retVal = new_UniformBufferDescriptorSet(
+        &pFrames->pDescriptorSets[i], pFrames->pUniformBuffers[i],
+        descriptorSetLayout, pFrames->descriptorPool, device);
+    if (retVal != ERR_OK) {
+      LOG_ERROR(ERR_LEVEL_ERROR, "failed to create camera descriptor set");
+      return (retVal);
+    }
+  }
+
+  return (new_CommandBuffers(pFrames->pCommandBuffers, imageCount, commandPool,
+                             device));
+}
+
+static void freePrerecordedFrames(PrerecordedFrames *pFrames) {
+  free(pFrames->pUniformBuffers);
+  free(pFrames->pUniformAllocations);
+  free(pFrames->pDescriptorSets);
+  free(pFrames->pCommandBuffers);
+  free(pFrames->pRecorded);
+  pFrames->pUniformBuffers = NULL;
+  pFrames->pUniformAllocations = NULL;
+  pFrames->pDescriptorSets = NULL;
+  pFrames->pCommandBuffers = NULL;
+  pFrames->pRecorded = NULL;
+}
+
+void delete_PrerecordedFrames(PrerecordedFrames *pFrames,
+                              DeviceAllocator *pAllocator) {
+  delete_CommandBuffers(pFrames->pCommandBuffers, pFrames->imageCount,
+                        pFrames->commandPool, pFrames->device);
+  for (uint32_t i = 0; i < pFrames->imageCount; i++) {
+    delete_Buffer(&pFrames->pUniformBuffers[i], pFrames->device);
+    delete_DeviceMemory(&pFrames->pUniformAllocations[i], pAllocator);
+  }
+  // the sets go away with their pool
+  delete_DescriptorPool(&pFrames->descriptorPool, pFrames->device);
+  freePrerecordedFrames(pFrames);
+}
+
+void deferDeletePrerecordedFrames(PrerecordedFrames *pFrames,
+                                  DeletionQueue *pQueue) {
+  for (uint32_t i = 0; i < pFrames->imageCount; i++) {
+    deferDeleteCommandBuffer(pQueue, pFrames->commandPool,
+                             &pFrames->pCommandBuffers[i]);
+    deferDeleteBuffer(pQueue, &pFrames->pUniformBuffers[i]);
+    deferDeleteDeviceMemory(pQueue, &pFrames->pUniformAllocations[i]);
+  }
+  deferDeleteDescriptorPool(pQueue, &pFrames->descriptorPool);
+  freePrerecordedFrames(pFrames);
+}
+
+void invalidatePrerecordedFrames(PrerecordedFrames *pFrames) {
+  for (uint32_t i = 0; i < pFrames->imageCount; i++) {
+    pFrames->pRecorded[i] = false;
+  }
+}
+
+void setPrerecordedFrameCamera(PrerecordedFrames *pFrames,
+                               const uint32_t imageIndex,
+                               const mat4x4 cameraTransform) {
+  // the memory is coherent, so the write needs no flush
+  memcpy(pFrames->pUniformAllocations[imageIndex].pMapped, cameraTransform,
+         sizeof(mat4x4));
+}
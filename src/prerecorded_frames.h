@@ -0,0 +1,82 @@
+///
+/// Copyright 2019 Govind Pimpale
+/// prerecorded_frames.h
+///
+/// Keeps a command buffer recorded for each swapchain image, for scenes where
+/// nothing but the camera changes from frame to frame. The camera is read from
+/// a uniform buffer of the image's own, which is written right before the
+/// image's buffer is submitted again, so the commands themselves only have to
+/// be recorded once. They are recorded again when invalidated, e.g. when the
+/// scene's buffers are replaced, and the whole set is replaced together with
+/// the swapchain.
+///
+
+#ifndef SRC_PRERECORDED_FRAMES_H_
+#define SRC_PRERECORDED_FRAMES_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include <linmath.h>
+
+#include "deletion_queue.h"
+#include "errors.h"
+#include "memory_allocator.h"
+
+typedef struct {
+  VkDevice device;
+  VkCommandPool commandPool;
+  VkDescriptorPool descriptorPool;
+  uint32_t imageCount;
+  // one of each per swapchain image, none of which is touched while the
+  // frame that last rendered to the image is in flight
+  VkBuffer *pUniformBuffers;
+  DeviceAllocation *pUniformAllocations;
+  VkDescriptorSet *pDescriptorSets;
+  VkCommandBuffer *pCommandBuffers;
+  // whether each command buffer can be submitted as it is
+  bool *pRecorded;
+} PrerecordedFrames;
+
+/// Creates the uniform buffers and command buffers of `imageCount` images,
+/// none of which is recorded yet
+/// --- PRECONDITIONS ---
+/// * `descriptorSetLayout` has one uniform buffer at binding 0, as set 0 of
+/// shader_uniform.vert reflects to
+/// * `commandPool` was created with
+/// VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT
+/// --- POSTCONDITIONS ---
+/// * returns error status
+/// --- CLEANUP ---
+/// * call delete_PrerecordedFrames or deferDeletePrerecordedFrames
+ErrVal new_PrerecordedFrames(PrerecordedFrames *pFrames,
+                             const uint32_t imageCount,
+                             const VkDescriptorSetLayout descriptorSetLayout,
+                             const VkCommandPool commandPool,
+                             DeviceAllocator *pAllocator,
+                             const VkDevice device);
+
+/// --- PRECONDITIONS ---
+/// * no frame submitting one of the command buffers is in flight
+void delete_PrerecordedFrames(PrerecordedFrames *pFrames,
+                              DeviceAllocator *pAllocator);
+
+/// Hands everything to `pQueue`, to be destroyed once the frames in flight
+/// that may still use it have completed
+void deferDeletePrerecordedFrames(PrerecordedFrames *pFrames,
+                                  DeletionQueue *pQueue);
+
+/// Makes every image's command buffer be recorded again before its next
+/// submit, e.g. after the buffers it draws from changed
+void invalidatePrerecordedFrames(PrerecordedFrames *pFrames);
+
+/// Writes the camera the next frame rendered to `imageIndex` draws with
+/// --- PRECONDITIONS ---
+/// * the last frame rendered to `imageIndex` has completed
+void setPrerecordedFrameCamera(PrerecordedFrames *pFrames,
+                               const uint32_t imageIndex,
+                               const mat4x4 cameraTransform);
+
+#endif /* SRC_PRERECORDED_FRAMES_H_ */
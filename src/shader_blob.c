@@ -0,0 +1,183 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "shader_blob.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "spirv_analysis.h"
+#include "vulkan_utils.h"
+
+#ifdef EMBED_SHADERS
+// Links `file` into a section of its own, between name_start and name_end.
+// .incbin resolves the path from where the compiler runs, the repository root
+#define EMBED_SHADER(name, file)                                               \
+  __asm__(".pushsection .rodata.shaders, \"a\"\n"                              \
+          ".balign 4\n" #name "_start:\n"                                      \
+          ".incbin \"assets/shaders/" file "\"\n" #name "_end:\n"              \
+          ".popsection\n");                                                    \
+  extern const uint32_t name##_start[];                                        \
+  extern const char name##_end[]
+
+EMBED_SHADER(shader_frag, "shader.frag.spv");
+EMBED_SHADER(shader_vert, "shader.vert.spv");
+EMBED_SHADER(shader_uniform_vert, "shader_uniform.vert.spv");
+EMBED_SHADER(shader_instanced_vert, "shader_instanced.vert.spv");
+EMBED_SHADER(shader_instanced_uniform_vert,
+             "shader_instanced_uniform.vert.spv");
+EMBED_SHADER(cull_comp, "cull.comp.spv");
+
+typedef struct {
+  const char *path;
+  const uint32_t *pStart;
+  const char *pEnd;
+} EmbeddedShader;
+
+#define EMBEDDED_SHADER(name, file)                                            \
+  { "assets/shaders/" file, name##_start, name##_end }
+
+static const EmbeddedShader pEmbeddedShaders[] = {
+    EMBEDDED_SHADER(shader_frag, "shader.frag.spv"),
+    EMBEDDED_SHADER(shader_vert, "shader.vert.spv"),
+    EMBEDDED_SHADER(shader_uniform_vert, "shader_uniform.vert.spv"),
+    EMBEDDED_SHADER(shader_instanced_vert, "shader_instanced.vert.spv"),
+    EMBEDDED_SHADER(shader_instanced_uniform_vert,
+                    "shader_instanced_uniform.vert.spv"),
+    EMBEDDED_SHADER(cull_comp, "cull.comp.spv"),
+};
+
+static bool getEmbeddedShader(ShaderBlob *pBlob, const char *path) {
+  for (size_t i = 0;
+       i < sizeof(pEmbeddedShaders) / sizeof(pEmbeddedShaders[0]); i++) {
+    if (strcmp(pEmbeddedShaders[i].path, path) == 0) {
+      pBlob->pCode = pEmbeddedShaders[i].pStart;
+      pBlob->codeSize = (size_t)(pEmbeddedShaders[i].pEnd -
+                                 (const char *)pEmbeddedShaders[i].pStart);
+      pBlob->pMapping = NULL;
+      return (true);
+    }
+  }
+  return (false);
+}
+#endif
+
+bool isSpirv(const uint32_t *pCode, const size_t codeSize) {
+  return (codeSize >= SPIRV_HEADER_WORDS * sizeof(uint32_t) &&
+          codeSize % sizeof(uint32_t) == 0 && pCode[0] == SPIRV_MAGIC);
+}
+
+static ErrVal mapShaderFile(ShaderBlob *pBlob, const char *path) {
+  pBlob->pCode = NULL;
+  pBlob->codeSize = 0;
+  pBlob->pMapping = NULL;
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    LOG_ERROR_ARGS(ERR_LEVEL_ERROR, "could not open shader %s: %s", path,
+                   strerror(errno));
+    return (ERR_UNKNOWN);
+  }
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) != 0 || fileStat.st_size <= 0) {
+    LOG_ERROR_ARGS(ERR_LEVEL_ERROR, "could not read shader %s", path);
+    close(fd);
+    return (ERR_UNKNOWN);
+  }
+
+  // private and read only, the driver copies whatever it keeps
+  void *pMapping =
+      mmap(NULL, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping holds its own reference to the file
+  close(fd);
+  if (pMapping == MAP_FAILED) {
+    LOG_ERROR_ARGS(ERR_LEVEL_ERROR, "could not map shader %s: %s", path,
+                   strerror(errno));
+    return (ERR_MEMORY);
+  }
+
+  pBlob->pCode = pMapping;
+  pBlob->codeSize = (size_t)fileStat.st_size;
+  pBlob->pMapping = pMapping;
+  return (ERR_OK);
+}
+
+// a mapping is page aligned, and embedded shaders are aligned to a word
+static ErrVal checkShaderBlob(ShaderBlob *pBlob, const char *path) {
+  if (!isSpirv(pBlob->pCode, pBlob->codeSize)) {
+    LOG_ERROR_ARGS(ERR_LEVEL_ERROR, "%s is not SPIR-V", path);
+    delete_ShaderBlob(pBlob);
+    return (ERR_BADARGS);
+  }
+  return (ERR_OK);
+}
+
+ErrVal new_ShaderBlob(ShaderBlob *pBlob, const char *path) {
+#ifdef EMBED_SHADERS
+  if (getEmbeddedShader(pBlob, path)) {
+    return (checkShaderBlob(pBlob, path));
+  }
+  LOG_ERROR_ARGS(ERR_LEVEL_WARN, "shader %s isn't embedded, reading it",
+                 path);
+#endif
+  return (new_MappedShaderBlob(pBlob, path));
+}
+
+ErrVal new_MappedShaderBlob(ShaderBlob *pBlob, const char *path) {
+  ErrVal retVal = mapShaderFile(pBlob, path);
+  if (retVal != ERR_OK) {
+    return (retVal);
+  }
+  return (checkShaderBlob(pBlob, path));
+}
+
+void delete_ShaderBlob(ShaderBlob *pBlob) {
+  if (pBlob->pMapping != NULL) {
+    munmap(pBlob->pMapping, pBlob->codeSize);
+  }
+  pBlob->pCode = NULL;
+  pBlob->codeSize = 0;
+  pBlob->pMapping = NULL;
+}
+
+ErrVal new_ShaderModuleFromBlob(VkShaderModule *pShaderModule,
+                                ShaderInterface *pInterface,
+                                const ShaderBlob *pBlob, const char *name,
+                                const VkDevice device) {
+  SpirvCost cost;
+  ErrVal retVal = analyzeSpirv(&cost, pBlob->pCode, pBlob->codeSize);
+  if (retVal != ERR_OK) {
+    LOG_ERROR_ARGS(ERR_LEVEL_ERROR, "failed to analyze shader %s", name);
+    return (retVal);
+  }
+  if (!isSpirvCostAcceptable(&cost, name)) {
+    return (ERR_UNSAFE);
+  }
+  if (pInterface != NULL) {
+    retVal = reflectSpirv(pInterface, pBlob->pCode, pBlob->codeSize);
+    if (retVal != ERR_OK) {
+      LOG_ERROR_ARGS(ERR_LEVEL_ERROR, "failed to reflect shader %s", name);
+      return (retVal);
+    }
+  }
+  return (new_ShaderModule(pShaderModule, device, (uint32_t)pBlob->codeSize,
+                           pBlob->pCode));
+}
+
+ErrVal new_ShaderModuleFromFile(VkShaderModule *pShaderModule,
+                                ShaderInterface *pInterface, const char *path,
+                                const VkDevice device) {
+  ShaderBlob blob;
+  ErrVal retVal = new_ShaderBlob(&blob, path);
+  if (retVal != ERR_OK) {
+    return (retVal);
+  }
+  retVal = new_ShaderModuleFromBlob(pShaderModule, pInterface, &blob, path,
+                                    device);
+  // the driver is done with the code once the module exists
+  delete_ShaderBlob(&blob);
+  return (retVal);
+}
@@ -0,0 +1,83 @@
+///
+/// Copyright 2019 Govind Pimpale
+/// shader_blob.h
+///
+/// Loads SPIR-V without copying it. A .spv file is mapped read only and the
+/// mapping is handed to vkCreateShaderModule as it is. Built with
+/// EMBED_SHADERS, the shaders the renderer uses are linked into the binary
+/// instead, and loading them touches no files at all.
+///
+
+#ifndef SRC_SHADER_BLOB_H_
+#define SRC_SHADER_BLOB_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "errors.h"
+#include "spirv_reflection.h"
+
+// the first word of every SPIR-V module, in host byte order
+#define SPIRV_MAGIC 0x07230203u
+// magic, version, generator, bound and schema
+#define SPIRV_HEADER_WORDS 5
+
+typedef struct {
+  const uint32_t *pCode;
+  // in bytes, always a multiple of 4
+  size_t codeSize;
+  // the file mapping pCode points into, NULL for an embedded shader
+  void *pMapping;
+} ShaderBlob;
+
+/// Returns whether `pCode` looks like a SPIR-V module: word sized, with at
+/// least a header and the SPIR-V magic number first
+bool isSpirv(const uint32_t *pCode, const size_t codeSize);
+
+/// Loads the SPIR-V at `path`, from the embedded shaders if it is one of
+/// them, else by mapping the file
+/// --- POSTCONDITIONS ---
+/// * returns error status
+/// * on success, `pBlob->pCode` passes isSpirv
+/// --- CLEANUP ---
+/// * call delete_ShaderBlob
+ErrVal new_ShaderBlob(ShaderBlob *pBlob, const char *path);
+
+/// Loads the SPIR-V at `path` by mapping the file, even if it is embedded,
+/// e.g. to pick up a shader recompiled since the build
+/// --- POSTCONDITIONS ---
+/// * returns error status
+/// * on success, `pBlob->pCode` passes isSpirv
+/// --- CLEANUP ---
+/// * call delete_ShaderBlob
+ErrVal new_MappedShaderBlob(ShaderBlob *pBlob, const char *path);
+
+/// Unmaps the blob's file, the code may not be used afterwards
+void delete_ShaderBlob(ShaderBlob *pBlob);
+
+/// Creates a shader module from `pBlob` unless static analysis finds it would
+/// hang or swamp the GPU, see isSpirvCostAcceptable
+/// --- POSTCONDITIONS ---
+/// * returns error status, ERR_UNSAFE if the analysis rejected the module
+/// * unless `pInterface` is NULL, the module's interface is reflected into it
+/// --- CLEANUP ---
+/// * call delete_ShaderModule
+ErrVal new_ShaderModuleFromBlob(VkShaderModule *pShaderModule,
+                                ShaderInterface *pInterface,
+                                const ShaderBlob *pBlob, const char *name,
+                                const VkDevice device);
+
+/// Creates a shader module from the SPIR-V at `path`, see new_ShaderBlob and
+/// new_ShaderModuleFromBlob
+/// --- POSTCONDITIONS ---
+/// * returns error status
+/// --- CLEANUP ---
+/// * call delete_ShaderModule
+ErrVal new_ShaderModuleFromFile(VkShaderModule *pShaderModule,
+                                ShaderInterface *pInterface, const char *path,
+                                const VkDevice device);
+
+#endif /* SRC_SHADER_BLOB_H_ */
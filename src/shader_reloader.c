@@ -0,0 +1,324 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "shader_reloader.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "shader_blob.h"
+#include "utils.h"
+#include "vulkan_utils.h"
+
+// longest path under SHADER_DIRECTORY the reloader builds
+#define SHADER_PATH_LENGTH 4096
+
+extern char **environ;
+
+// must match compile.sh
+static const ShaderSource pShaderSources[] = {
+    {"shader.vert.spv", "shader.vert", NULL},
+    {"shader.frag.spv", "shader.frag", NULL},
+    {"shader_instanced.vert.spv", "shader_instanced.vert", NULL},
+    {"shader_uniform.vert.spv", "shader.vert", "-DCAMERA_UNIFORM"},
+    {"shader_instanced_uniform.vert.spv", "shader_instanced.vert",
+     "-DCAMERA_UNIFORM"},
+};
+
+static const ShaderSource *getShaderSource(const char *spirvPath) {
+  const char *spirvName = strrchr(spirvPath, '/');
+  spirvName = spirvName == NULL ? spirvPath : spirvName + 1;
+  for (size_t i = 0; i < sizeof(pShaderSources) / sizeof(pShaderSources[0]);
+       i++) {
+    if (strcmp(pShaderSources[i].spirvName, spirvName) == 0) {
+      return (&pShaderSources[i]);
+    }
+  }
+  return (NULL);
+}
+
+// runs the compiler on `pSource`, returns whether it succeeded
+static bool compileShaderSource(const ShaderSource *pSource) {
+  char sourcePath[SHADER_PATH_LENGTH];
+  char spirvPath[SHADER_PATH_LENGTH];
+  snprintf(sourcePath, sizeof(sourcePath), SHADER_DIRECTORY "/%s",
+           pSource->sourceName);
+  snprintf(spirvPath, sizeof(spirvPath), SHADER_DIRECTORY "/%s",
+           pSource->spirvName);
+
+  char compiler[] = SHADER_COMPILER;
+  char vulkanOption[] = "-V";
+  char outputOption[] = "-o";
+  char define[SHADER_PATH_LENGTH] = {0};
+  char *pArgs[7];
+  uint32_t argCount = 0;
+  pArgs[argCount++] = compiler;
+  pArgs[argCount++] = vulkanOption;
+  if (pSource->define != NULL) {
+    snprintf(define, sizeof(define), "%s", pSource->define);
+    pArgs[argCount++] = define;
+  }
+  pArgs[argCount++] = outputOption;
+  pArgs[argCount++] = spirvPath;
+  pArgs[argCount++] = sourcePath;
+  pArgs[argCount] = NULL;
+
+  pid_t pid;
+  int spawnRet = posix_spawnp(&pid, SHADER_COMPILER, NULL, NULL, pArgs,
+                              environ);
+  if (spawnRet != 0) {
+    LOG_ERROR_ARGS(ERR_LEVEL_ERROR, "could not run " SHADER_COMPILER ": %s",
+                   strerror(spawnRet));
+    return (false);
+  }
+  int status;
+  while (waitpid(pid, &status, 0) < 0) {
+    if (errno != EINTR) {
+      return (false);
+    }
+  }
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    LOG_ERROR_ARGS(ERR_LEVEL_WARN, "%s failed to compile, keeping the old "
+                                   "pipeline",
+                   pSource->sourceName);
+    return (false);
+  }
+  return (true);
+}
+
+static ErrVal new_ReloadedShaderModule(VkShaderModule *pShaderModule,
+                                       ShaderInterface *pInterface,
+                                       const ShaderSource *pSource,
+                                       const VkDevice device) {
+  char spirvPath[SHADER_PATH_LENGTH];
+  snprintf(spirvPath, sizeof(spirvPath), SHADER_DIRECTORY "/%s",
+           pSource->spirvName);
+  // the embedded shaders are the ones from the build, not the new ones
+  ShaderBlob blob;
+  ErrVal retVal = new_MappedShaderBlob(&blob, spirvPath);
+  if (retVal != ERR_OK) {
+    return (retVal);
+  }
+  retVal = new_ShaderModuleFromBlob(pShaderModule, pInterface, &blob,
+                                    spirvPath, device);
+  delete_ShaderBlob(&blob);
+  return (retVal);
+}
+
+static void rebuildPipeline(ShaderReloader *pReloader, const bool vertChanged,
+                            const bool fragChanged) {
+  double startTime = getTime();
+  if ((vertChanged && !compileShaderSource(pReloader->pVertSource)) ||
+      (fragChanged && !compileShaderSource(pReloader->pFragSource))) {
+    return;
+  }
+  double compileTime = getTime() - startTime;
+
+  ShaderInterface interface;
+  VkShaderModule vertShaderModule;
+  if (new_ReloadedShaderModule(&vertShaderModule, &interface,
+                               pReloader->pVertSource,
+                               pReloader->device) != ERR_OK) {
+    return;
+  }
+  ShaderInterface fragInterface;
+  VkShaderModule fragShaderModule;
+  if (new_ReloadedShaderModule(&fragShaderModule, &fragInterface,
+                               pReloader->pFragSource,
+                               pReloader->device) != ERR_OK) {
+    delete_ShaderModule(&vertShaderModule, pReloader->device);
+    return;
+  }
+
+  // the layout is shared with the frames in flight, so a shader that needs
+  // another one can't be swapped in
+  VkPipeline pipeline = VK_NULL_HANDLE;
+  ErrVal retVal = mergeShaderInterface(&interface, &fragInterface);
+  if (retVal == ERR_OK && !isShaderInterfaceLayoutEqual(
+                              &interface, &pReloader->interface, UINT32_MAX)) {
+    LOG_ERROR(ERR_LEVEL_WARN, "reloaded shaders need a different pipeline "
+                              "layout, restart to use them");
+    retVal = ERR_NOTSUPPORTED;
+  }
+  if (retVal == ERR_OK && pReloader->instanced) {
+    retVal = new_InstancedVertexDisplayPipeline(
+        &pipeline, pReloader->device, pReloader->pipelineCache,
+        vertShaderModule, fragShaderModule, pReloader->renderPass,
+        pReloader->pipelineLayout, &interface, VERTEX_FORMAT_PACKED);
+  } else if (retVal == ERR_OK) {
+    retVal = new_VertexDisplayPipeline(
+        &pipeline, pReloader->device, pReloader->pipelineCache,
+        vertShaderModule, fragShaderModule, pReloader->renderPass,
+        pReloader->pipelineLayout, &interface, VERTEX_FORMAT_PACKED);
+  }
+  // a pipeline doesn't need its modules once it is built
+  delete_ShaderModule(&fragShaderModule, pReloader->device);
+  delete_ShaderModule(&vertShaderModule, pReloader->device);
+  if (retVal != ERR_OK) {
+    LOG_ERROR(ERR_LEVEL_WARN, "reloaded shaders failed to build a pipeline");
+    return;
+  }
+
+  pthread_mutex_lock(&pReloader->mutex);
+  // the render loop never saw the last one, so nothing can be using it
+  if (pReloader->pendingPipeline != VK_NULL_HANDLE) {
+    delete_Pipeline(&pReloader->pendingPipeline, pReloader->device);
+  }
+  pReloader->pendingPipeline = pipeline;
+  pthread_mutex_unlock(&pReloader->mutex);
+
+  LOG_ERROR_ARGS(ERR_LEVEL_INFO,
+                 "shaders reloaded: compile %.3f ms, pipeline %.3f ms",
+                 compileTime * 1000.0,
+                 (getTime() - startTime - compileTime) * 1000.0);
+}
+
+// drains the watch, noting whether either of the pipeline's sources was
+// written or moved into place
+static void readShaderEvents(ShaderReloader *pReloader, bool *pVertChanged,
+                             bool *pFragChanged) {
+  _Alignas(struct inotify_event) char pBuffer[4096];
+  ssize_t length;
+  while ((length = read(pReloader->watchFd, pBuffer, sizeof(pBuffer))) > 0) {
+    for (char *pPos = pBuffer; pPos < pBuffer + length;) {
+      const struct inotify_event *pEvent = (const struct inotify_event *)pPos;
+      if (pEvent->len != 0) {
+        if (strcmp(pEvent->name, pReloader->pVertSource->sourceName) == 0) {
+          *pVertChanged = true;
+        }
+        if (strcmp(pEvent->name, pReloader->pFragSource->sourceName) == 0) {
+          *pFragChanged = true;
+        }
+      }
+      pPos += sizeof(struct inotify_event) + pEvent->len;
+    }
+  }
+}
+
+static void *shaderReloaderThread(void *pArg) {
+  ShaderReloader *pReloader = pArg;
+  struct pollfd pFds[2] = {{0}};
+  pFds[0].fd = pReloader->watchFd;
+  pFds[0].events = POLLIN;
+  pFds[1].fd = pReloader->pWakeFds[0];
+  pFds[1].events = POLLIN;
+
+  while (true) {
+    if (poll(pFds, 2, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LOG_ERROR_ARGS(ERR_LEVEL_ERROR, "shader watch failed: %s",
+                     strerror(errno));
+      break;
+    }
+    if (pFds[1].revents != 0) {
+      break;
+    }
+
+    bool vertChanged = false;
+    bool fragChanged = false;
+    readShaderEvents(pReloader, &vertChanged, &fragChanged);
+    // whatever else the save does is folded into the same rebuild
+    while (poll(pFds, 1, SHADER_RELOAD_SETTLE_MS) > 0) {
+      readShaderEvents(pReloader, &vertChanged, &fragChanged);
+    }
+    if (vertChanged || fragChanged) {
+      rebuildPipeline(pReloader, vertChanged, fragChanged);
+    }
+  }
+  return (NULL);
+}
+
+ErrVal new_ShaderReloader(ShaderReloader *pReloader, const char *vertShaderPath,
+                          const char *fragShaderPath, const bool instanced,
+                          const VkRenderPass renderPass,
+                          const VkPipelineLayout pipelineLayout,
+                          const ShaderInterface *pInterface,
+                          const VkPipelineCache pipelineCache,
+                          const VkDevice device) {
+  pReloader->device = device;
+  pReloader->pipelineCache = pipelineCache;
+  pReloader->renderPass = renderPass;
+  pReloader->pipelineLayout = pipelineLayout;
+  pReloader->interface = *pInterface;
+  pReloader->instanced = instanced;
+  pReloader->pendingPipeline = VK_NULL_HANDLE;
+  pReloader->pVertSource = getShaderSource(vertShaderPath);
+  pReloader->pFragSource = getShaderSource(fragShaderPath);
+  if (pReloader->pVertSource == NULL || pReloader->pFragSource == NULL) {
+    LOG_ERROR(ERR_LEVEL_ERROR, "no known source to reload the shaders from");
+    return (ERR_NOTSUPPORTED);
+  }
+
+  pReloader->watchFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (pReloader->watchFd < 0) {
+    LOG_ERROR_ARGS(ERR_LEVEL_ERROR, "failed to watch shaders: %s",
+                   strerror(errno));
+    return (ERR_NOTSUPPORTED);
+  }
+  // editors either write the file in place or rename a new one over it
+  if (inotify_add_watch(pReloader->watchFd, SHADER_DIRECTORY,
+                        IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+    LOG_ERROR_ARGS(ERR_LEVEL_ERROR, "failed to watch " SHADER_DIRECTORY ": %s",
+                   strerror(errno));
+    close(pReloader->watchFd);
+    return (ERR_NOTSUPPORTED);
+  }
+  if (pipe(pReloader->pWakeFds) != 0) {
+    LOG_ERROR_ARGS(ERR_LEVEL_ERROR, "failed to watch shaders: %s",
+                   strerror(errno));
+    close(pReloader->watchFd);
+    return (ERR_UNKNOWN);
+  }
+
+  pthread_mutex_init(&pReloader->mutex, NULL);
+  if (pthread_create(&pReloader->thread, NULL, shaderReloaderThread,
+                     pReloader) != 0) {
+    LOG_ERROR(ERR_LEVEL_ERROR, "failed to start shader reloader thread");
+    pthread_mutex_destroy(&pReloader->mutex);
+    close(pReloader->pWakeFds[0]);
+    close(pReloader->pWakeFds[1]);
+    close(pReloader->watchFd);
+    return (ERR_UNKNOWN);
+  }
+
+  LOG_ERROR_ARGS(ERR_LEVEL_INFO, "reloading %s and %s on change",
+                 pReloader->pVertSource->sourceName,
+                 pReloader->pFragSource->sourceName);
+  return (ERR_OK);
+}
+
+void delete_ShaderReloader(ShaderReloader *pReloader) {
+  // a rebuild in progress finishes first
+  char wake = 0;
+  if (write(pReloader->pWakeFds[1], &wake, 1) != 1) {
+    LOG_ERROR(ERR_LEVEL_ERROR, "failed to wake shader reloader thread");
+  }
+  pthread_join(pReloader->thread, NULL);
+
+  close(pReloader->pWakeFds[0]);
+  close(pReloader->pWakeFds[1]);
+  close(pReloader->watchFd);
+  pthread_mutex_destroy(&pReloader->mutex);
+  if (pReloader->pendingPipeline != VK_NULL_HANDLE) {
+    delete_Pipeline(&pReloader->pendingPipeline, pReloader->device);
+  }
+}
+
+bool takeReloadedPipeline(ShaderReloader *pReloader, VkPipeline *pPipeline) {
+  pthread_mutex_lock(&pReloader->mutex);
+  bool reloaded = pReloader->pendingPipeline != VK_NULL_HANDLE;
+  if (reloaded) {
+    *pPipeline = pReloader->pendingPipeline;
+    pReloader->pendingPipeline = VK_NULL_HANDLE;
+  }
+  pthread_mutex_unlock(&pReloader->mutex);
+  return (reloaded);
+}
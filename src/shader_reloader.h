@@ -0,0 +1,87 @@
+///
+/// Copyright 2019 Govind Pimpale
+/// shader_reloader.h
+///
+/// Rebuilds the vertex display pipeline whenever the GLSL behind it changes.
+/// A worker thread watches the shader directory with inotify, recompiles the
+/// changed source the way compile.sh does and builds a new pipeline through
+/// the pipeline cache. The render loop picks the pipeline up between frames
+/// and retires the old one through the deletion queue, so nothing waits for
+/// the device and a shader edit shows up a few milliseconds after the save.
+///
+
+#ifndef SRC_SHADER_RELOADER_H_
+#define SRC_SHADER_RELOADER_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "errors.h"
+#include "spirv_reflection.h"
+
+// where the GLSL and the SPIR-V compiled from it live
+#define SHADER_DIRECTORY "assets/shaders"
+#define SHADER_COMPILER "glslangValidator"
+// how long the watcher waits for an editor to finish saving before it
+// recompiles, since a save can be several writes and renames
+#define SHADER_RELOAD_SETTLE_MS 50
+
+// How a SPIR-V file the renderer loads is compiled, as in compile.sh
+typedef struct {
+  const char *spirvName;
+  const char *sourceName;
+  // a -D option, or NULL
+  const char *define;
+} ShaderSource;
+
+typedef struct {
+  VkDevice device;
+  VkPipelineCache pipelineCache;
+  VkRenderPass renderPass;
+  VkPipelineLayout pipelineLayout;
+  // what pipelineLayout was built from, reloaded shaders have to fit it
+  ShaderInterface interface;
+  bool instanced;
+  const ShaderSource *pVertSource;
+  const ShaderSource *pFragSource;
+  // the inotify instance, and a pipe whose write end wakes the worker to quit
+  int watchFd;
+  int pWakeFds[2];
+  pthread_t thread;
+  // a pipeline built since the last takeReloadedPipeline, guarded by mutex
+  pthread_mutex_t mutex;
+  VkPipeline pendingPipeline;
+} ShaderReloader;
+
+/// Starts watching the sources of the SPIR-V at `vertShaderPath` and
+/// `fragShaderPath`
+/// --- PRECONDITIONS ---
+/// * the paths are ones compile.sh builds, in SHADER_DIRECTORY
+/// * `pipelineLayout` and `renderPass` are the ones the current vertex display
+/// pipeline was built with, and outlive the reloader
+/// * `pInterface` is the interface `pipelineLayout` was built from
+/// --- POSTCONDITIONS ---
+/// * returns error status, e.g. ERR_NOTSUPPORTED if a shader has no known
+/// source or the directory can't be watched
+/// --- CLEANUP ---
+/// * call delete_ShaderReloader
+ErrVal new_ShaderReloader(ShaderReloader *pReloader, const char *vertShaderPath,
+                          const char *fragShaderPath, const bool instanced,
+                          const VkRenderPass renderPass,
+                          const VkPipelineLayout pipelineLayout,
+                          const ShaderInterface *pInterface,
+                          const VkPipelineCache pipelineCache,
+                          const VkDevice device);
+
+/// Stops the worker and destroys any pipeline it built that wasn't taken
+void delete_ShaderReloader(ShaderReloader *pReloader);
+
+/// Hands over the newest pipeline built since the last call, if any
+/// --- POSTCONDITIONS ---
+/// * returns whether `*pPipeline` was set, in which case the caller owns it
+bool takeReloadedPipeline(ShaderReloader *pReloader, VkPipeline *pPipeline);
+
+#endif /* SRC_SHADER_RELOADER_H_ */
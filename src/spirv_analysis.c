@@ -0,0 +1,729 @@
+#include "spirv_analysis.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "shader_blob.h"
+#include "spirv_module.h"
+
+// the ways a loop condition can compare its induction variable to its bound
+typedef enum {
+  COMPARE_EQUAL,
+  COMPARE_NOT_EQUAL,
+  COMPARE_LESS,
+  COMPARE_LESS_EQUAL,
+  COMPARE_GREATER,
+  COMPARE_GREATER_EQUAL,
+} Compare;
+
+// what a loop condition compares, integers wrap around at the ends of their
+// range and floats stop changing once the step is below their precision
+typedef enum {
+  COMPARE_SIGNED,
+  COMPARE_UNSIGNED,
+  COMPARE_FLOAT,
+} CompareKind;
+
+#define UINT32_RANGE 4294967296.0
+
+typedef struct {
+  uint32_t firstInstruction;
+  // one past the OpFunctionEnd
+  uint32_t endInstruction;
+  uint32_t id;
+  double ownCost;
+  double ownImageOps;
+  // -1 while being resolved, 1 once `cost` includes every callee
+  int resolved;
+  double cost;
+  double imageOps;
+} FunctionInfo;
+
+// What the passes keep on top of the module's index
+typedef struct {
+  SpirvModule module;
+  // how many times an instruction runs per call of its function
+  double *pMultipliers;
+  FunctionInfo *pFunctions;
+  uint32_t functionCount;
+} AnalyzedModule;
+
+// whether an instruction does work at run time, rather than declaring
+// something or annotating the control flow
+static bool isExecuted(const uint32_t opcode) {
+  switch (opcode) {
+  case SPIRV_OP_LABEL:
+  case SPIRV_OP_VARIABLE:
+  case SPIRV_OP_LOOP_MERGE:
+  case SPIRV_OP_SELECTION_MERGE:
+  case SPIRV_OP_FUNCTION:
+  case SPIRV_OP_FUNCTION_END:
+  case SPIRV_OP_LINE:
+  case SPIRV_OP_NO_LINE:
+  case SPIRV_OP_NOP:
+  case SPIRV_OP_FUNCTION_PARAMETER:
+    return (false);
+  default:
+    return (true);
+  }
+}
+
+// reads a scalar constant, returns whether `id` is one
+static bool getConstant(const SpirvModule *pModule, const uint32_t id,
+                        double *pValue) {
+  uint32_t bits;
+  uint32_t typeDef;
+  if (!getSpirvConstant(pModule, id, &bits, &typeDef)) {
+    return (false);
+  }
+  uint32_t typeOpcode = getSpirvOpcode(pModule, typeDef);
+  uint32_t typeWidth = getSpirvWord(pModule, typeDef, 2);
+  if (typeOpcode == SPIRV_OP_TYPE_FLOAT && typeWidth == 32) {
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    *pValue = value;
+    return (true);
+  }
+  if (typeOpcode == SPIRV_OP_TYPE_INT && typeWidth == 32) {
+    // word 3 is the signedness
+    *pValue = getSpirvWord(pModule, typeDef, 3) ? (double)(int32_t)bits
+                                                : (double)bits;
+    return (true);
+  }
+  return (false);
+}
+
+static bool getCompare(const uint32_t opcode, Compare *pCompare,
+                       CompareKind *pKind) {
+  if (opcode < SPIRV_OP_IEQUAL || opcode > SPIRV_OP_FUNORD_GREATER_THAN_EQUAL) {
+    return (false);
+  }
+  // OpIEqual, OpINotEqual, then unsigned and signed pairs of each ordering,
+  // then ordered and unordered pairs of equal, not equal and each ordering
+  static const Compare pIntegerCompares[10] = {
+      COMPARE_EQUAL,         COMPARE_NOT_EQUAL,     COMPARE_GREATER,
+      COMPARE_GREATER,       COMPARE_GREATER_EQUAL, COMPARE_GREATER_EQUAL,
+      COMPARE_LESS,          COMPARE_LESS,          COMPARE_LESS_EQUAL,
+      COMPARE_LESS_EQUAL};
+  static const Compare pFloatCompares[6] = {
+      COMPARE_EQUAL,   COMPARE_NOT_EQUAL,  COMPARE_LESS,
+      COMPARE_GREATER, COMPARE_LESS_EQUAL, COMPARE_GREATER_EQUAL};
+  uint32_t index = opcode - SPIRV_OP_IEQUAL;
+  *pCompare = index < 10 ? pIntegerCompares[index]
+                         : pFloatCompares[(index - 10) / 2];
+  // the unsigned orderings come first in each pair
+  if (index >= 10) {
+    *pKind = COMPARE_FLOAT;
+  } else if (index >= 2 && index % 2 == 0) {
+    *pKind = COMPARE_UNSIGNED;
+  } else {
+    *pKind = COMPARE_SIGNED;
+  }
+  return (true);
+}
+
+// `value` as a comparison of `kind` sees it, a constant of the other
+// signedness is reinterpreted
+static double toCompareRange(const double value, const CompareKind kind) {
+  if (kind == COMPARE_UNSIGNED && value < 0.0) {
+    return (value + UINT32_RANGE);
+  }
+  if (kind == COMPARE_SIGNED && value >= UINT32_RANGE / 2.0) {
+    return (value - UINT32_RANGE);
+  }
+  return (value);
+}
+
+static Compare negateCompare(const Compare compare) {
+  switch (compare) {
+  case COMPARE_EQUAL:
+    return (COMPARE_NOT_EQUAL);
+  case COMPARE_NOT_EQUAL:
+    return (COMPARE_EQUAL);
+  case COMPARE_LESS:
+    return (COMPARE_GREATER_EQUAL);
+  case COMPARE_LESS_EQUAL:
+    return (COMPARE_GREATER);
+  case COMPARE_GREATER:
+    return (COMPARE_LESS_EQUAL);
+  default:
+    return (COMPARE_LESS);
+  }
+}
+
+// the same comparison with its operands swapped
+static Compare swapCompare(const Compare compare) {
+  switch (compare) {
+  case COMPARE_LESS:
+    return (COMPARE_GREATER);
+  case COMPARE_LESS_EQUAL:
+    return (COMPARE_GREATER_EQUAL);
+  case COMPARE_GREATER:
+    return (COMPARE_LESS);
+  case COMPARE_GREATER_EQUAL:
+    return (COMPARE_LESS_EQUAL);
+  default:
+    return (compare);
+  }
+}
+
+// If `valueId` is `inductionId` plus or minus a constant, where the
+// induction is either a load of `variableId` or the value itself, returns
+// true and the signed step
+static bool getInductionStep(const SpirvModule *pModule, const uint32_t valueId,
+                             const uint32_t inductionId,
+                             const uint32_t variableId, double *pStep) {
+  uint32_t def = getSpirvDef(pModule, valueId);
+  if (def == SPIRV_NO_INSTRUCTION) {
+    return (false);
+  }
+  uint32_t opcode = getSpirvOpcode(pModule, def);
+  if (opcode != SPIRV_OP_IADD && opcode != SPIRV_OP_FADD &&
+      opcode != SPIRV_OP_ISUB && opcode != SPIRV_OP_FSUB) {
+    return (false);
+  }
+  bool add = opcode == SPIRV_OP_IADD || opcode == SPIRV_OP_FADD;
+  for (uint32_t operand = 3; operand <= 4; operand++) {
+    uint32_t baseId = getSpirvWord(pModule, def, operand);
+    uint32_t stepId = getSpirvWord(pModule, def, operand == 3 ? 4 : 3);
+    // only a subtraction's second operand can be the step
+    if (!add && operand == 4) {
+      break;
+    }
+    uint32_t baseDef = getSpirvDef(pModule, baseId);
+    bool isInduction =
+        baseId == inductionId ||
+        (variableId != 0 && baseDef != SPIRV_NO_INSTRUCTION &&
+         getSpirvOpcode(pModule, baseDef) == SPIRV_OP_LOAD &&
+         getSpirvWord(pModule, baseDef, 3) == variableId);
+    double step;
+    if (isInduction && getConstant(pModule, stepId, &step)) {
+      *pStep = add ? step : -step;
+      return (true);
+    }
+  }
+  return (false);
+}
+
+// the instruction of OpLabel `id`, SPIRV_NO_INSTRUCTION if none
+static uint32_t getLabel(const SpirvModule *pModule, const uint32_t id) {
+  uint32_t def = getSpirvDef(pModule, id);
+  if (getSpirvOpcode(pModule, def) != SPIRV_OP_LABEL) {
+    return (SPIRV_NO_INSTRUCTION);
+  }
+  return (def);
+}
+
+// Works out whether the loop whose OpLoopMerge is instruction `mergeIndex`
+// ends. The loop is taken to be every block from its header up to its merge
+// block, which is how structured control flow is laid out in practice
+static SpirvLoop analyzeLoop(const SpirvModule *pModule,
+                             const uint32_t headerIndex,
+                             const uint32_t mergeIndex, uint32_t *pEnd) {
+  SpirvLoop loop = {0};
+  loop.headerId = getSpirvWord(pModule, headerIndex, 1);
+  loop.bound = SPIRV_LOOP_UNKNOWN;
+  uint32_t mergeId = getSpirvWord(pModule, mergeIndex, 1);
+  uint32_t end = getLabel(pModule, mergeId);
+  if (end == SPIRV_NO_INSTRUCTION || end <= headerIndex) {
+    *pEnd = headerIndex;
+    return (loop);
+  }
+  *pEnd = end;
+
+  // the first conditional branch out of the loop is taken as its exit test,
+  // a loop with no way out at all never ends
+  uint32_t exitIndex = UINT32_MAX;
+  bool hasOtherExit = false;
+  for (uint32_t i = headerIndex; i < end; i++) {
+    uint32_t opcode = getSpirvOpcode(pModule, i);
+    if (opcode == SPIRV_OP_BRANCH_CONDITIONAL && exitIndex == UINT32_MAX &&
+        (getSpirvWord(pModule, i, 2) == mergeId ||
+         getSpirvWord(pModule, i, 3) == mergeId)) {
+      exitIndex = i;
+    } else if ((opcode == SPIRV_OP_BRANCH &&
+                getSpirvWord(pModule, i, 1) == mergeId) ||
+               opcode == SPIRV_OP_BRANCH_CONDITIONAL ||
+               opcode == SPIRV_OP_SWITCH || opcode == SPIRV_OP_RETURN ||
+               opcode == SPIRV_OP_RETURN_VALUE || opcode == SPIRV_OP_KILL ||
+               opcode == SPIRV_OP_TERMINATE_INVOCATION) {
+      hasOtherExit = hasOtherExit || opcode != SPIRV_OP_BRANCH_CONDITIONAL;
+    }
+  }
+  if (exitIndex == UINT32_MAX) {
+    loop.bound = hasOtherExit ? SPIRV_LOOP_UNKNOWN : SPIRV_LOOP_UNBOUNDED;
+    return (loop);
+  }
+
+  // the loop keeps going while `induction compare bound` holds
+  uint32_t conditionDef =
+      getSpirvDef(pModule, getSpirvWord(pModule, exitIndex, 1));
+  Compare compare = COMPARE_NOT_EQUAL;
+  CompareKind kind = COMPARE_FLOAT;
+  if (conditionDef == SPIRV_NO_INSTRUCTION ||
+      !getCompare(getSpirvOpcode(pModule, conditionDef), &compare, &kind)) {
+    return (loop);
+  }
+  if (getSpirvWord(pModule, exitIndex, 2) == mergeId) {
+    compare = negateCompare(compare);
+  }
+
+  // one side is a load of a function variable or a phi in the header, the
+  // other has to stay the same throughout the loop
+  uint32_t inductionId = 0;
+  uint32_t variableId = 0;
+  uint32_t boundId = 0;
+  for (uint32_t operand = 3; operand <= 4 && inductionId == 0; operand++) {
+    uint32_t id = getSpirvWord(pModule, conditionDef, operand);
+    uint32_t def = getSpirvDef(pModule, id);
+    if (def == SPIRV_NO_INSTRUCTION || def < headerIndex || def >= end) {
+      continue;
+    }
+    uint32_t opcode = getSpirvOpcode(pModule, def);
+    if (opcode == SPIRV_OP_LOAD || opcode == SPIRV_OP_PHI) {
+      inductionId = id;
+      variableId = opcode == SPIRV_OP_LOAD ? getSpirvWord(pModule, def, 3) : 0;
+      boundId = getSpirvWord(pModule, conditionDef, operand == 3 ? 4 : 3);
+      if (operand == 4) {
+        compare = swapCompare(compare);
+      }
+    }
+  }
+  uint32_t boundDef = getSpirvDef(pModule, boundId);
+  if (inductionId == 0 ||
+      (boundDef != SPIRV_NO_INSTRUCTION && boundDef >= headerIndex &&
+       boundDef < end)) {
+    return (loop);
+  }
+
+  // every update inside the loop must add the same constant, and the value
+  // before the loop is read from the last store or the phi
+  double step = 0.0;
+  bool stepped = false;
+  double start = 0.0;
+  bool startKnown = false;
+  if (variableId != 0) {
+    for (uint32_t i = headerIndex; i < end; i++) {
+      if (getSpirvOpcode(pModule, i) != SPIRV_OP_STORE ||
+          getSpirvWord(pModule, i, 1) != variableId) {
+        continue;
+      }
+      double storeStep;
+      if (!getInductionStep(pModule, getSpirvWord(pModule, i, 2), inductionId,
+                            variableId, &storeStep) ||
+          (stepped && storeStep != step)) {
+        return (loop);
+      }
+      step = storeStep;
+      stepped = true;
+    }
+    for (uint32_t i = getSpirvDef(pModule, variableId); i < headerIndex; i++) {
+      if (getSpirvOpcode(pModule, i) == SPIRV_OP_STORE &&
+          getSpirvWord(pModule, i, 1) == variableId) {
+        startKnown = getConstant(pModule, getSpirvWord(pModule, i, 2), &start);
+      }
+    }
+  } else {
+    uint32_t phi = getSpirvDef(pModule, inductionId);
+    if (getSpirvWordCount(pModule, phi) != 7) {
+      return (loop);
+    }
+    for (uint32_t pair = 3; pair < 7; pair += 2) {
+      uint32_t parent = getLabel(pModule, getSpirvWord(pModule, phi, pair + 1));
+      uint32_t valueId = getSpirvWord(pModule, phi, pair);
+      if (parent >= headerIndex && parent < end) {
+        if (!getInductionStep(pModule, valueId, inductionId, 0, &step)) {
+          return (loop);
+        }
+        stepped = true;
+      } else {
+        startKnown = getConstant(pModule, valueId, &start);
+      }
+    }
+  }
+
+  double bound = 0.0;
+  bool boundKnown = getConstant(pModule, boundId, &bound);
+  start = toCompareRange(start, kind);
+  bound = toCompareRange(bound, kind);
+  // a condition that already fails never enters the loop
+  if (startKnown && boundKnown) {
+    bool enters = (compare == COMPARE_LESS && start < bound) ||
+                  (compare == COMPARE_LESS_EQUAL && start <= bound) ||
+                  (compare == COMPARE_GREATER && start > bound) ||
+                  (compare == COMPARE_GREATER_EQUAL && start >= bound) ||
+                  (compare == COMPARE_EQUAL && start == bound) ||
+                  (compare == COMPARE_NOT_EQUAL && start != bound);
+    if (!enters) {
+      loop.bound = SPIRV_LOOP_BOUNDED;
+      return (loop);
+    }
+  }
+
+  // without an update, or with one heading away from the bound, nothing ever
+  // changes the outcome of the test
+  bool towards;
+  switch (compare) {
+  case COMPARE_LESS:
+  case COMPARE_LESS_EQUAL:
+    towards = stepped && step > 0.0;
+    break;
+  case COMPARE_GREATER:
+  case COMPARE_GREATER_EQUAL:
+    towards = stepped && step < 0.0;
+    break;
+  case COMPARE_EQUAL:
+    towards = stepped && step != 0.0;
+    break;
+  default:
+    // stepping past the bound without hitting it goes on forever
+    return (loop);
+  }
+  if (!towards) {
+    // a branch that leaves by another way may still end it
+    loop.bound = hasOtherExit ? SPIRV_LOOP_UNKNOWN : SPIRV_LOOP_UNBOUNDED;
+    return (loop);
+  }
+  if (kind == COMPARE_FLOAT) {
+    return (loop);
+  }
+
+  // an integer only gets past the bound if the step that takes it there
+  // doesn't wrap around first, e.g. an unsigned `i >= 0` always holds. An
+  // unknown bound is taken to be the worst one
+  if (compare != COMPARE_EQUAL) {
+    double minValue = kind == COMPARE_UNSIGNED ? 0.0 : -UINT32_RANGE / 2.0;
+    double maxValue = minValue + UINT32_RANGE - 1.0;
+    double worstBound = boundKnown ? bound
+                        : step > 0.0 ? maxValue
+                                     : minValue;
+    // the first value after the last one to pass the test
+    double exitValue;
+    switch (compare) {
+    case COMPARE_LESS:
+      exitValue = worstBound - 1.0 + step;
+      break;
+    case COMPARE_GREATER:
+      exitValue = worstBound + 1.0 + step;
+      break;
+    default:
+      exitValue = worstBound + step;
+      break;
+    }
+    if (exitValue > maxValue || exitValue < minValue) {
+      loop.bound = boundKnown && !hasOtherExit ? SPIRV_LOOP_UNBOUNDED
+                                               : SPIRV_LOOP_UNKNOWN;
+      return (loop);
+    }
+  }
+
+  loop.bound = SPIRV_LOOP_BOUNDED;
+  if (compare == COMPARE_EQUAL) {
+    loop.tripCount = 1.0;
+  } else if (startKnown && boundKnown) {
+    double trips = ceil((bound - start) / step);
+    if ((compare == COMPARE_LESS_EQUAL || compare == COMPARE_GREATER_EQUAL) &&
+        start + trips * step == bound) {
+      trips += 1.0;
+    }
+    loop.tripCount = fmax(trips, 1.0);
+  }
+  return (loop);
+}
+
+static void analyzeLoops(AnalyzedModule *pAnalyzed, SpirvCost *pCost,
+                         const FunctionInfo *pFunction) {
+  const SpirvModule *pModule = &pAnalyzed->module;
+  uint32_t headerIndex = UINT32_MAX;
+  for (uint32_t i = pFunction->firstInstruction;
+       i < pFunction->endInstruction; i++) {
+    uint32_t opcode = getSpirvOpcode(pModule, i);
+    if (opcode == SPIRV_OP_LABEL) {
+      headerIndex = i;
+    } else if (opcode == SPIRV_OP_LOOP_MERGE && headerIndex != UINT32_MAX) {
+      uint32_t end;
+      SpirvLoop loop = analyzeLoop(pModule, headerIndex, i, &end);
+      if (pCost->loopCount < SPIRV_ANALYSIS_MAX_LOOPS) {
+        pCost->pLoops[pCost->loopCount] = loop;
+      }
+      pCost->loopCount++;
+      if (loop.bound == SPIRV_LOOP_UNKNOWN) {
+        pCost->unknownLoopCount++;
+      } else if (loop.bound == SPIRV_LOOP_UNBOUNDED) {
+        pCost->unboundedLoopCount++;
+      }
+
+      // nested loops multiply
+      double trips = loop.tripCount != 0.0 ? loop.tripCount
+                                           : SPIRV_ASSUMED_LOOP_TRIPS;
+      for (uint32_t j = headerIndex; j < end; j++) {
+        pAnalyzed->pMultipliers[j] *= trips;
+      }
+    }
+  }
+}
+
+// the most values defined and not yet used for the last time, at any point
+// of the function in module order
+static uint32_t getMaxLiveValues(const SpirvModule *pModule,
+                                 const FunctionInfo *pFunction,
+                                 uint32_t *pLastUses, int32_t *pChanges) {
+  uint32_t first = pFunction->firstInstruction;
+  uint32_t count = pFunction->endInstruction - first;
+  for (uint32_t i = 0; i <= count; i++) {
+    pChanges[i] = 0;
+  }
+  for (uint32_t i = first; i < pFunction->endInstruction; i++) {
+    // every operand word that names a value of this function is a use,
+    // a literal that happens to match an id only lengthens a range
+    for (uint32_t word = 1; word < getSpirvWordCount(pModule, i); word++) {
+      uint32_t def = getSpirvDef(pModule, getSpirvWord(pModule, i, word));
+      if (def != SPIRV_NO_INSTRUCTION && def >= first && def < i) {
+        pLastUses[def - first] = i;
+      }
+    }
+    pLastUses[i - first] = i;
+  }
+  for (uint32_t i = first; i < pFunction->endInstruction; i++) {
+    uint32_t opcode = getSpirvOpcode(pModule, i);
+    if (getSpirvResultId(pModule, i) == 0 || opcode == SPIRV_OP_LABEL ||
+        opcode == SPIRV_OP_VARIABLE) {
+      continue;
+    }
+    pChanges[i - first]++;
+    pChanges[pLastUses[i - first] + 1 - first]--;
+  }
+  int32_t live = 0;
+  int32_t maxLive = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    live += pChanges[i];
+    maxLive = live > maxLive ? live : maxLive;
+  }
+  return ((uint32_t)maxLive);
+}
+
+static FunctionInfo *getFunction(AnalyzedModule *pAnalyzed,
+                                 const uint32_t id) {
+  for (uint32_t i = 0; i < pAnalyzed->functionCount; i++) {
+    if (pAnalyzed->pFunctions[i].id == id) {
+      return (&pAnalyzed->pFunctions[i]);
+    }
+  }
+  return (NULL);
+}
+
+// adds the cost of every call to the function's own, SPIR-V has no recursion
+// so a cycle is a malformed module
+static bool resolveFunctionCost(AnalyzedModule *pAnalyzed,
+                                FunctionInfo *pFunction) {
+  const SpirvModule *pModule = &pAnalyzed->module;
+  if (pFunction->resolved == 1) {
+    return (true);
+  }
+  if (pFunction->resolved == -1) {
+    return (false);
+  }
+  pFunction->resolved = -1;
+  pFunction->cost = pFunction->ownCost;
+  pFunction->imageOps = pFunction->ownImageOps;
+  for (uint32_t i = pFunction->firstInstruction;
+       i < pFunction->endInstruction; i++) {
+    if (getSpirvOpcode(pModule, i) != SPIRV_OP_FUNCTION_CALL) {
+      continue;
+    }
+    FunctionInfo *pCallee = getFunction(pAnalyzed, getSpirvWord(pModule, i, 3));
+    if (pCallee == NULL || !resolveFunctionCost(pAnalyzed, pCallee)) {
+      return (false);
+    }
+    pFunction->cost += pAnalyzed->pMultipliers[i] * pCallee->cost;
+    pFunction->imageOps += pAnalyzed->pMultipliers[i] * pCallee->imageOps;
+  }
+  pFunction->resolved = 1;
+  return (true);
+}
+
+// finds the functions, every instruction starts out running once per call
+static void indexFunctions(AnalyzedModule *pAnalyzed) {
+  const SpirvModule *pModule = &pAnalyzed->module;
+  // zeroed, so that nothing is read before the loop below fills it in
+  pAnalyzed->pMultipliers = calloc(pModule->instructionCount, sizeof(double));
+  pAnalyzed->pFunctions =
+      calloc(pModule->instructionCount, sizeof(FunctionInfo));
+  if (pAnalyzed->pMultipliers == NULL || pAnalyzed->pFunctions == NULL) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "failed to analyze SPIR-V: %s",
+                   strerror(errno));
+    PANIC();
+  }
+
+  // new_SpirvModule has checked that every function is ended
+  FunctionInfo *pFunction = NULL;
+  for (uint32_t i = 0; i < pModule->instructionCount; i++) {
+    pAnalyzed->pMultipliers[i] = 1.0;
+    uint32_t opcode = getSpirvOpcode(pModule, i);
+    if (opcode == SPIRV_OP_FUNCTION) {
+      pFunction = &pAnalyzed->pFunctions[pAnalyzed->functionCount++];
+      pFunction->firstInstruction = i;
+      pFunction->id = getSpirvWord(pModule, i, 2);
+    } else if (opcode == SPIRV_OP_FUNCTION_END && pFunction != NULL) {
+      pFunction->endInstruction = i + 1;
+      pFunction = NULL;
+    }
+  }
+}
+
+const char *getSpirvExecutionModelName(const uint32_t executionModel) {
+  switch (executionModel) {
+  case SPIRV_EXECUTION_MODEL_VERTEX:
+    return ("vertex");
+  case SPIRV_EXECUTION_MODEL_FRAGMENT:
+    return ("fragment");
+  case SPIRV_EXECUTION_MODEL_GLCOMPUTE:
+    return ("compute");
+  default:
+    return ("other");
+  }
+}
+
+ErrVal analyzeSpirv(SpirvCost *pCost, const uint32_t *pCode,
+                    const size_t codeSize) {
+  memset(pCost, 0, sizeof(SpirvCost));
+  AnalyzedModule analyzed = {0};
+  const SpirvModule *pModule = &analyzed.module;
+  ErrVal retVal = new_SpirvModule(&analyzed.module, pCode, codeSize);
+  if (retVal != ERR_OK) {
+    return (retVal);
+  }
+  pCost->idBound = pModule->idBound;
+  indexFunctions(&analyzed);
+
+  uint32_t entryPointId = 0;
+  uint32_t *pLastUses = malloc(pModule->instructionCount * sizeof(uint32_t));
+  int32_t *pChanges = malloc((pModule->instructionCount + 1) * sizeof(int32_t));
+  if (pLastUses == NULL || pChanges == NULL) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "failed to analyze SPIR-V: %s",
+                   strerror(errno));
+    PANIC();
+  }
+  for (uint32_t i = 0; i < pModule->instructionCount; i++) {
+    if (getSpirvOpcode(pModule, i) == SPIRV_OP_ENTRY_POINT &&
+        entryPointId == 0) {
+      pCost->executionModel = getSpirvWord(pModule, i, 1);
+      entryPointId = getSpirvWord(pModule, i, 2);
+    }
+  }
+
+  for (uint32_t f = 0; f < analyzed.functionCount; f++) {
+    FunctionInfo *pFunction = &analyzed.pFunctions[f];
+    analyzeLoops(&analyzed, pCost, pFunction);
+    for (uint32_t i = pFunction->firstInstruction;
+         i < pFunction->endInstruction; i++) {
+      uint32_t opcode = getSpirvOpcode(pModule, i);
+      if (opcode == SPIRV_OP_VARIABLE) {
+        pCost->functionVariableCount++;
+      }
+      if (!isExecuted(opcode)) {
+        continue;
+      }
+      pCost->instructionCount++;
+      pFunction->ownCost += analyzed.pMultipliers[i];
+      if (opcode >= SPIRV_OP_IMAGE_SAMPLE_FIRST &&
+          opcode <= SPIRV_OP_IMAGE_READ) {
+        pFunction->ownImageOps += analyzed.pMultipliers[i];
+      }
+    }
+    uint32_t maxLiveValues =
+        getMaxLiveValues(pModule, pFunction, pLastUses, pChanges);
+    if (maxLiveValues > pCost->maxLiveValues) {
+      pCost->maxLiveValues = maxLiveValues;
+    }
+  }
+
+  FunctionInfo *pEntryPoint = getFunction(&analyzed, entryPointId);
+  if (pEntryPoint == NULL || !resolveFunctionCost(&analyzed, pEntryPoint)) {
+    LOG_ERROR(ERR_LEVEL_ERROR, "SPIR-V entry point can't be followed");
+    retVal = ERR_BADARGS;
+  } else {
+    pCost->estimatedInstructions = pEntryPoint->cost;
+    pCost->estimatedImageOps = pEntryPoint->imageOps;
+  }
+
+  free(pLastUses);
+  free(pChanges);
+  free(analyzed.pMultipliers);
+  free(analyzed.pFunctions);
+  delete_SpirvModule(&analyzed.module);
+  return (retVal);
+}
+
+bool isSpirvCostAcceptable(const SpirvCost *pCost, const char *name) {
+  bool acceptable = true;
+  if (pCost->unboundedLoopCount != 0) {
+    LOG_ERROR_ARGS(ERR_LEVEL_ERROR,
+                   "%s has %u loop(s) that never end, rejecting it", name,
+                   pCost->unboundedLoopCount);
+    acceptable = false;
+  }
+  if (pCost->estimatedInstructions > SPIRV_COST_REJECT) {
+    LOG_ERROR_ARGS(ERR_LEVEL_ERROR,
+                   "%s runs about %.0f instructions per invocation, "
+                   "rejecting it",
+                   name, pCost->estimatedInstructions);
+    acceptable = false;
+  }
+  if (pCost->unknownLoopCount != 0) {
+    LOG_ERROR_ARGS(ERR_LEVEL_WARN,
+                   "%s has %u loop(s) that can't be shown to end", name,
+                   pCost->unknownLoopCount);
+  }
+  if (pCost->executionModel == SPIRV_EXECUTION_MODEL_FRAGMENT &&
+      pCost->estimatedInstructions > SPIRV_FRAGMENT_COST_WARN) {
+    LOG_ERROR_ARGS(ERR_LEVEL_WARN,
+                   "%s is an expensive fragment shader, about %.0f "
+                   "instructions per fragment",
+                   name, pCost->estimatedInstructions);
+  }
+  return (acceptable);
+}
+
+bool reportSpirvFile(const char *path) {
+  ShaderBlob blob;
+  if (new_MappedShaderBlob(&blob, path) != ERR_OK) {
+    return (false);
+  }
+  SpirvCost cost;
+  bool acceptable = false;
+  if (analyzeSpirv(&cost, blob.pCode, blob.codeSize) == ERR_OK) {
+    printSpirvCost(&cost, path);
+    acceptable = isSpirvCostAcceptable(&cost, path);
+  }
+  delete_ShaderBlob(&blob);
+  return (acceptable);
+}
+
+void printSpirvCost(const SpirvCost *pCost, const char *name) {
+  static const char *pBoundNames[] = {"bounded", "unknown", "unbounded"};
+  printf("%s: %s shader, %u ids\n", name,
+         getSpirvExecutionModelName(pCost->executionModel), pCost->idBound);
+  printf("  instructions: %u static, %.0f per invocation, %.0f image ops\n",
+         pCost->instructionCount, pCost->estimatedInstructions,
+         pCost->estimatedImageOps);
+  printf("  register pressure: %u live values at most, %u function "
+         "variables\n",
+         pCost->maxLiveValues, pCost->functionVariableCount);
+  printf("  loops: %u, %u unknown, %u unbounded\n", pCost->loopCount,
+         pCost->unknownLoopCount, pCost->unboundedLoopCount);
+  for (uint32_t i = 0; i < pCost->loopCount && i < SPIRV_ANALYSIS_MAX_LOOPS;
+       i++) {
+    const SpirvLoop *pLoop = &pCost->pLoops[i];
+    if (pLoop->tripCount != 0.0) {
+      printf("    loop at %%%u: %s, %.0f iterations\n", pLoop->headerId,
+             pBoundNames[pLoop->bound], pLoop->tripCount);
+    } else {
+      printf("    loop at %%%u: %s\n", pLoop->headerId,
+             pBoundNames[pLoop->bound]);
+    }
+  }
+}
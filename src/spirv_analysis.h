@@ -0,0 +1,99 @@
+///
+/// Copyright 2019 Govind Pimpale
+/// spirv_analysis.h
+///
+/// A static look at a SPIR-V module before it goes near the device. It
+/// estimates how many instructions an invocation of the entry point runs,
+/// works out whether each loop provably ends, and gives the number of values
+/// live at once as a stand-in for register pressure. A loop that can't end
+/// hangs the GPU until the driver resets it, so modules with one are
+/// rejected when they are loaded.
+///
+
+#ifndef SRC_SPIRV_ANALYSIS_H_
+#define SRC_SPIRV_ANALYSIS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "errors.h"
+
+// loops whose details are kept, any more are only counted
+#define SPIRV_ANALYSIS_MAX_LOOPS 32
+// iterations charged for a loop whose trip count isn't known
+#define SPIRV_ASSUMED_LOOP_TRIPS 16.0
+// estimated instructions per invocation over which a fragment shader is
+// reported as expensive, and over which any shader is rejected
+#define SPIRV_FRAGMENT_COST_WARN 2048.0
+#define SPIRV_COST_REJECT 1000000.0
+
+// SPIR-V execution models
+#define SPIRV_EXECUTION_MODEL_VERTEX 0
+#define SPIRV_EXECUTION_MODEL_FRAGMENT 4
+#define SPIRV_EXECUTION_MODEL_GLCOMPUTE 5
+
+typedef enum {
+  // the induction variable steps toward the exit condition
+  SPIRV_LOOP_BOUNDED = 0,
+  // the exit depends on something the analysis doesn't follow
+  SPIRV_LOOP_UNKNOWN = 1,
+  // once entered, the loop never exits
+  SPIRV_LOOP_UNBOUNDED = 2,
+} SpirvLoopBound;
+
+typedef struct {
+  // the id of the loop's header block
+  uint32_t headerId;
+  SpirvLoopBound bound;
+  // iterations, when bounded and the start and end are constants, else 0
+  double tripCount;
+} SpirvLoop;
+
+typedef struct {
+  // of the first entry point
+  uint32_t executionModel;
+  uint32_t idBound;
+  // instructions in every function body, each counted once
+  uint32_t instructionCount;
+  // instructions one invocation of the entry point runs, with loops charged
+  // by their trip count and calls by the callee's cost
+  double estimatedInstructions;
+  // image sample, fetch, gather and read instructions per invocation
+  double estimatedImageOps;
+  // the most values any function has defined and not yet used for the last
+  // time, and its function scope variables
+  uint32_t maxLiveValues;
+  uint32_t functionVariableCount;
+  uint32_t loopCount;
+  uint32_t unknownLoopCount;
+  uint32_t unboundedLoopCount;
+  SpirvLoop pLoops[SPIRV_ANALYSIS_MAX_LOOPS];
+} SpirvCost;
+
+/// Returns the name of an execution model, e.g. "fragment"
+const char *getSpirvExecutionModelName(const uint32_t executionModel);
+
+/// Analyses the module in `pCode`
+/// --- PRECONDITIONS ---
+/// * `pCode` passes isSpirv
+/// --- POSTCONDITIONS ---
+/// * returns error status, ERR_BADARGS if the module is malformed
+ErrVal analyzeSpirv(SpirvCost *pCost, const uint32_t *pCode,
+                    const size_t codeSize);
+
+/// Logs why `pCost` should keep its module off the device, if it should,
+/// and warns about anything merely suspicious
+/// --- POSTCONDITIONS ---
+/// * returns whether the module may be used
+bool isSpirvCostAcceptable(const SpirvCost *pCost, const char *name);
+
+/// Prints every figure in `pCost`, for the standalone analysis
+void printSpirvCost(const SpirvCost *pCost, const char *name);
+
+/// Analyses and prints the SPIR-V file at `path`
+/// --- POSTCONDITIONS ---
+/// * returns whether it loaded and would be accepted
+bool reportSpirvFile(const char *path);
+
+#endif /* SRC_SPIRV_ANALYSIS_H_ */
@@ -0,0 +1,174 @@
+#include "spirv_module.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "shader_blob.h"
+
+static bool hasResultType(const uint32_t opcode) {
+  switch (opcode) {
+  case SPIRV_OP_LABEL:
+  case SPIRV_OP_STORE:
+  case SPIRV_OP_COPY_MEMORY:
+  case SPIRV_OP_IMAGE_WRITE:
+  case SPIRV_OP_EMIT_VERTEX:
+  case SPIRV_OP_END_PRIMITIVE:
+  case SPIRV_OP_CONTROL_BARRIER:
+  case SPIRV_OP_MEMORY_BARRIER:
+  case SPIRV_OP_ATOMIC_STORE:
+  case SPIRV_OP_LOOP_MERGE:
+  case SPIRV_OP_SELECTION_MERGE:
+  case SPIRV_OP_BRANCH:
+  case SPIRV_OP_BRANCH_CONDITIONAL:
+  case SPIRV_OP_SWITCH:
+  case SPIRV_OP_KILL:
+  case SPIRV_OP_RETURN:
+  case SPIRV_OP_RETURN_VALUE:
+  case SPIRV_OP_UNREACHABLE:
+  case SPIRV_OP_LIFETIME_START:
+  case SPIRV_OP_LIFETIME_STOP:
+  case SPIRV_OP_FUNCTION_END:
+  case SPIRV_OP_LINE:
+  case SPIRV_OP_NO_LINE:
+  case SPIRV_OP_NOP:
+  case SPIRV_OP_TERMINATE_INVOCATION:
+    return (false);
+  default:
+    return (true);
+  }
+}
+
+// splits the module into instructions and records where each id is defined
+static ErrVal indexSpirvModule(SpirvModule *pModule) {
+  pModule->instructionCount = 0;
+  for (uint32_t offset = SPIRV_HEADER_WORDS; offset < pModule->wordCount;) {
+    uint32_t wordCount = pModule->pCode[offset] >> 16;
+    if (wordCount == 0 || offset + wordCount > pModule->wordCount) {
+      return (ERR_BADARGS);
+    }
+    pModule->instructionCount++;
+    offset += wordCount;
+  }
+
+  // zeroed, so that nothing is read before the loop below fills it in
+  pModule->pOffsets = calloc(pModule->instructionCount, sizeof(uint32_t));
+  pModule->pDefs = calloc(pModule->idBound, sizeof(uint32_t));
+  if (pModule->pOffsets == NULL || pModule->pDefs == NULL) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "failed to index SPIR-V: %s",
+                   strerror(errno));
+    PANIC();
+  }
+  for (uint32_t id = 0; id < pModule->idBound; id++) {
+    pModule->pDefs[id] = SPIRV_NO_INSTRUCTION;
+  }
+
+  uint32_t offset = SPIRV_HEADER_WORDS;
+  bool inFunction = false;
+  for (uint32_t i = 0; i < pModule->instructionCount; i++) {
+    pModule->pOffsets[i] = offset;
+    offset += pModule->pCode[offset] >> 16;
+
+    uint32_t opcode = getSpirvOpcode(pModule, i);
+    if (opcode == SPIRV_OP_FUNCTION) {
+      inFunction = true;
+    } else if (opcode == SPIRV_OP_FUNCTION_END) {
+      inFunction = false;
+    }
+
+    // outside functions, types and constants put their id first or second
+    uint32_t id = 0;
+    if (inFunction) {
+      id = getSpirvResultId(pModule, i);
+    } else if (opcode >= 19 && opcode <= 39) {
+      // OpTypeVoid to OpTypeForwardPointer, the result is word 1
+      id = getSpirvWord(pModule, i, 1);
+    } else if ((opcode >= 41 && opcode <= 52) ||
+               opcode == SPIRV_OP_VARIABLE) {
+      // constants, spec constants and global variables
+      id = getSpirvWord(pModule, i, 2);
+    } else if (opcode == SPIRV_OP_EXT_INST_IMPORT) {
+      id = getSpirvWord(pModule, i, 1);
+    }
+    if (id != 0 && id < pModule->idBound) {
+      pModule->pDefs[id] = i;
+    }
+  }
+  if (inFunction) {
+    return (ERR_BADARGS);
+  }
+  return (ERR_OK);
+}
+
+ErrVal new_SpirvModule(SpirvModule *pModule, const uint32_t *pCode,
+                       const size_t codeSize) {
+  pModule->pCode = pCode;
+  pModule->wordCount = (uint32_t)(codeSize / sizeof(uint32_t));
+  pModule->idBound = pCode[3];
+  pModule->instructionCount = 0;
+  pModule->pOffsets = NULL;
+  pModule->pDefs = NULL;
+
+  ErrVal retVal = indexSpirvModule(pModule);
+  if (retVal != ERR_OK) {
+    LOG_ERROR(ERR_LEVEL_ERROR, "malformed SPIR-V module");
+    delete_SpirvModule(pModule);
+  }
+  return (retVal);
+}
+
+void delete_SpirvModule(SpirvModule *pModule) {
+  free(pModule->pOffsets);
+  free(pModule->pDefs);
+  pModule->pOffsets = NULL;
+  pModule->pDefs = NULL;
+  pModule->instructionCount = 0;
+}
+
+uint32_t getSpirvOpcode(const SpirvModule *pModule, const uint32_t index) {
+  if (index >= pModule->instructionCount) {
+    return (SPIRV_OP_NOP);
+  }
+  return (pModule->pCode[pModule->pOffsets[index]] & 0xFFFFu);
+}
+
+uint32_t getSpirvWordCount(const SpirvModule *pModule, const uint32_t index) {
+  if (index >= pModule->instructionCount) {
+    return (0);
+  }
+  return (pModule->pCode[pModule->pOffsets[index]] >> 16);
+}
+
+uint32_t getSpirvWord(const SpirvModule *pModule, const uint32_t index,
+                      const uint32_t word) {
+  if (word >= getSpirvWordCount(pModule, index)) {
+    return (0);
+  }
+  return (pModule->pCode[pModule->pOffsets[index] + word]);
+}
+
+uint32_t getSpirvDef(const SpirvModule *pModule, const uint32_t id) {
+  return (id < pModule->idBound ? pModule->pDefs[id] : SPIRV_NO_INSTRUCTION);
+}
+
+uint32_t getSpirvResultId(const SpirvModule *pModule, const uint32_t index) {
+  uint32_t opcode = getSpirvOpcode(pModule, index);
+  if (opcode == SPIRV_OP_LABEL) {
+    return (getSpirvWord(pModule, index, 1));
+  }
+  return (hasResultType(opcode) ? getSpirvWord(pModule, index, 2) : 0);
+}
+
+bool getSpirvConstant(const SpirvModule *pModule, const uint32_t id,
+                      uint32_t *pBits, uint32_t *pTypeDef) {
+  uint32_t def = getSpirvDef(pModule, id);
+  if (getSpirvOpcode(pModule, def) != SPIRV_OP_CONSTANT ||
+      getSpirvWordCount(pModule, def) != 4) {
+    return (false);
+  }
+  *pBits = getSpirvWord(pModule, def, 3);
+  if (pTypeDef != NULL) {
+    *pTypeDef = getSpirvDef(pModule, getSpirvWord(pModule, def, 1));
+  }
+  return (true);
+}
@@ -0,0 +1,133 @@
+///
+/// Copyright 2019 Govind Pimpale
+/// spirv_module.h
+///
+/// Splits a SPIR-V module into its instructions and records which one
+/// defines each id. Both the static analysis and the reflection read modules
+/// through this, so the module is walked and checked in one place.
+///
+
+#ifndef SRC_SPIRV_MODULE_H_
+#define SRC_SPIRV_MODULE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "errors.h"
+
+// the opcodes read by the analysis and the reflection, from the SPIR-V
+// specification
+#define SPIRV_OP_NOP 0
+#define SPIRV_OP_LINE 8
+#define SPIRV_OP_EXT_INST_IMPORT 11
+#define SPIRV_OP_ENTRY_POINT 15
+#define SPIRV_OP_TYPE_INT 21
+#define SPIRV_OP_TYPE_FLOAT 22
+#define SPIRV_OP_TYPE_VECTOR 23
+#define SPIRV_OP_TYPE_MATRIX 24
+#define SPIRV_OP_TYPE_IMAGE 25
+#define SPIRV_OP_TYPE_SAMPLER 26
+#define SPIRV_OP_TYPE_SAMPLED_IMAGE 27
+#define SPIRV_OP_TYPE_ARRAY 28
+#define SPIRV_OP_TYPE_RUNTIME_ARRAY 29
+#define SPIRV_OP_TYPE_STRUCT 30
+#define SPIRV_OP_TYPE_POINTER 32
+#define SPIRV_OP_CONSTANT 43
+#define SPIRV_OP_FUNCTION 54
+#define SPIRV_OP_FUNCTION_PARAMETER 55
+#define SPIRV_OP_FUNCTION_END 56
+#define SPIRV_OP_FUNCTION_CALL 57
+#define SPIRV_OP_VARIABLE 59
+#define SPIRV_OP_LOAD 61
+#define SPIRV_OP_STORE 62
+#define SPIRV_OP_COPY_MEMORY 63
+#define SPIRV_OP_DECORATE 71
+#define SPIRV_OP_MEMBER_DECORATE 72
+#define SPIRV_OP_IMAGE_SAMPLE_FIRST 87
+#define SPIRV_OP_IMAGE_READ 98
+#define SPIRV_OP_IMAGE_WRITE 99
+#define SPIRV_OP_IADD 128
+#define SPIRV_OP_FADD 129
+#define SPIRV_OP_ISUB 130
+#define SPIRV_OP_FSUB 131
+#define SPIRV_OP_IEQUAL 170
+#define SPIRV_OP_FUNORD_GREATER_THAN_EQUAL 191
+#define SPIRV_OP_EMIT_VERTEX 218
+#define SPIRV_OP_END_PRIMITIVE 219
+#define SPIRV_OP_CONTROL_BARRIER 224
+#define SPIRV_OP_MEMORY_BARRIER 225
+#define SPIRV_OP_ATOMIC_STORE 228
+#define SPIRV_OP_PHI 245
+#define SPIRV_OP_LOOP_MERGE 246
+#define SPIRV_OP_SELECTION_MERGE 247
+#define SPIRV_OP_LABEL 248
+#define SPIRV_OP_BRANCH 249
+#define SPIRV_OP_BRANCH_CONDITIONAL 250
+#define SPIRV_OP_SWITCH 251
+#define SPIRV_OP_KILL 252
+#define SPIRV_OP_RETURN 253
+#define SPIRV_OP_RETURN_VALUE 254
+#define SPIRV_OP_UNREACHABLE 255
+#define SPIRV_OP_LIFETIME_START 256
+#define SPIRV_OP_LIFETIME_STOP 257
+#define SPIRV_OP_NO_LINE 317
+#define SPIRV_OP_TERMINATE_INVOCATION 4416
+
+// stands in for an instruction where there is none, e.g. the definition of
+// an id nothing defines
+#define SPIRV_NO_INSTRUCTION UINT32_MAX
+
+// Instructions are numbered in module order
+typedef struct {
+  const uint32_t *pCode;
+  uint32_t wordCount;
+  uint32_t idBound;
+  uint32_t instructionCount;
+  // word offset of each instruction
+  uint32_t *pOffsets;
+  // instruction that defines each id, SPIRV_NO_INSTRUCTION if none
+  uint32_t *pDefs;
+} SpirvModule;
+
+/// Indexes the module in `pCode`
+/// --- PRECONDITIONS ---
+/// * `pCode` passes isSpirv and outlives `pModule`
+/// --- POSTCONDITIONS ---
+/// * returns error status, ERR_BADARGS if an instruction runs past the end
+/// of the module or a function is never ended
+/// --- CLEANUP ---
+/// * call delete_SpirvModule, on success only
+ErrVal new_SpirvModule(SpirvModule *pModule, const uint32_t *pCode,
+                       const size_t codeSize);
+
+void delete_SpirvModule(SpirvModule *pModule);
+
+/// Returns the opcode of instruction `index`, 0 (OpNop) if there is no such
+/// instruction
+uint32_t getSpirvOpcode(const SpirvModule *pModule, const uint32_t index);
+
+/// Returns how many words instruction `index` takes, opcode included, 0 if
+/// there is no such instruction
+uint32_t getSpirvWordCount(const SpirvModule *pModule, const uint32_t index);
+
+/// Returns word `word` of instruction `index`, 0 if the instruction is shorter
+/// or there is no such instruction
+uint32_t getSpirvWord(const SpirvModule *pModule, const uint32_t index,
+                      const uint32_t word);
+
+/// Returns the instruction defining `id`, SPIRV_NO_INSTRUCTION if none
+uint32_t getSpirvDef(const SpirvModule *pModule, const uint32_t id);
+
+/// Returns the result id of instruction `index` in a function body, 0 if it
+/// has none
+uint32_t getSpirvResultId(const SpirvModule *pModule, const uint32_t index);
+
+/// Reads the 32 bit literal of a scalar OpConstant
+/// --- POSTCONDITIONS ---
+/// * returns whether `id` is one, and if so `*pBits` is its literal and,
+/// unless `pTypeDef` is NULL, `*pTypeDef` the instruction defining its type
+bool getSpirvConstant(const SpirvModule *pModule, const uint32_t id,
+                      uint32_t *pBits, uint32_t *pTypeDef);
+
+#endif /* SRC_SPIRV_MODULE_H_ */
@@ -0,0 +1,563 @@
+#include "spirv_reflection.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "shader_blob.h"
+#include "spirv_module.h"
+
+// the decorations and enumerants the reflection reads, from the SPIR-V
+// specification
+#define DECORATION_BLOCK 2
+#define DECORATION_BUFFER_BLOCK 3
+#define DECORATION_ARRAY_STRIDE 6
+#define DECORATION_MATRIX_STRIDE 7
+#define DECORATION_BUILT_IN 11
+#define DECORATION_LOCATION 30
+#define DECORATION_BINDING 33
+#define DECORATION_DESCRIPTOR_SET 34
+#define DECORATION_OFFSET 35
+
+#define STORAGE_CLASS_UNIFORM_CONSTANT 0
+#define STORAGE_CLASS_INPUT 1
+#define STORAGE_CLASS_UNIFORM 2
+#define STORAGE_CLASS_PUSH_CONSTANT 9
+#define STORAGE_CLASS_STORAGE_BUFFER 12
+
+#define DIM_BUFFER 5
+#define DIM_SUBPASS_DATA 6
+
+// FNV-1a, as for the readback hashes
+#define FNV_OFFSET_BASIS UINT64_C(14695981039346656037)
+#define FNV_PRIME UINT64_C(1099511628211)
+
+// the decorations of one id the reflection needs
+typedef struct {
+  uint32_t location;
+  uint32_t set;
+  uint32_t binding;
+  uint32_t arrayStride;
+  bool hasLocation;
+  bool isBuiltIn;
+  bool isBlock;
+  bool isBufferBlock;
+} Decorations;
+
+// looks up a decoration of a struct member, which are few enough to search
+static bool getMemberDecoration(const SpirvModule *pModule,
+                                const uint32_t structId, const uint32_t member,
+                                const uint32_t decoration, uint32_t *pValue) {
+  for (uint32_t i = 0; i < pModule->instructionCount; i++) {
+    uint32_t opcode = getSpirvOpcode(pModule, i);
+    if (opcode == SPIRV_OP_FUNCTION) {
+      break;
+    }
+    if (opcode == SPIRV_OP_MEMBER_DECORATE &&
+        getSpirvWord(pModule, i, 1) == structId &&
+        getSpirvWord(pModule, i, 2) == member &&
+        getSpirvWord(pModule, i, 3) == decoration) {
+      *pValue = getSpirvWord(pModule, i, 4);
+      return (true);
+    }
+  }
+  return (false);
+}
+
+// the size of a type in a push constant block, as laid out by its offset and
+// stride decorations, 0 if it can't be worked out
+static uint32_t getTypeSize(const SpirvModule *pModule,
+                            const Decorations *pDecorations,
+                            const uint32_t typeId,
+                            const uint32_t matrixStride) {
+  uint32_t def = getSpirvDef(pModule, typeId);
+  switch (getSpirvOpcode(pModule, def)) {
+  case SPIRV_OP_TYPE_INT:
+  case SPIRV_OP_TYPE_FLOAT:
+    return (getSpirvWord(pModule, def, 2) / 8);
+  case SPIRV_OP_TYPE_VECTOR: {
+    uint32_t componentSize =
+        getTypeSize(pModule, pDecorations, getSpirvWord(pModule, def, 2), 0);
+    return (componentSize * getSpirvWord(pModule, def, 3));
+  }
+  case SPIRV_OP_TYPE_MATRIX: {
+    uint32_t columnSize =
+        getTypeSize(pModule, pDecorations, getSpirvWord(pModule, def, 2), 0);
+    uint32_t stride = matrixStride != 0 ? matrixStride : columnSize;
+    return (stride * getSpirvWord(pModule, def, 3));
+  }
+  case SPIRV_OP_TYPE_ARRAY: {
+    uint32_t length;
+    if (!getSpirvConstant(pModule, getSpirvWord(pModule, def, 3), &length,
+                          NULL)) {
+      return (0);
+    }
+    return (pDecorations[typeId].arrayStride * length);
+  }
+  case SPIRV_OP_TYPE_STRUCT: {
+    uint32_t size = 0;
+    uint32_t memberCount = getSpirvWordCount(pModule, def) - 2;
+    for (uint32_t member = 0; member < memberCount; member++) {
+      uint32_t memberOffset = 0;
+      uint32_t memberMatrixStride = 0;
+      getMemberDecoration(pModule, typeId, member, DECORATION_OFFSET,
+                          &memberOffset);
+      getMemberDecoration(pModule, typeId, member, DECORATION_MATRIX_STRIDE,
+                          &memberMatrixStride);
+      uint32_t memberTypeId = getSpirvWord(pModule, def, 2 + member);
+      uint32_t memberSize = getTypeSize(pModule, pDecorations, memberTypeId,
+                                        memberMatrixStride);
+      if (memberSize == 0) {
+        return (0);
+      }
+      if (memberOffset + memberSize > size) {
+        size = memberOffset + memberSize;
+      }
+    }
+    return (size);
+  }
+  default:
+    return (0);
+  }
+}
+
+static bool getShaderStage(const uint32_t executionModel,
+                           VkShaderStageFlags *pStage) {
+  static const VkShaderStageFlags pStages[] = {
+      VK_SHADER_STAGE_VERTEX_BIT,
+      VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT,
+      VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT,
+      VK_SHADER_STAGE_GEOMETRY_BIT,
+      VK_SHADER_STAGE_FRAGMENT_BIT,
+      VK_SHADER_STAGE_COMPUTE_BIT};
+  if (executionModel >= sizeof(pStages) / sizeof(pStages[0])) {
+    return (false);
+  }
+  *pStage = pStages[executionModel];
+  return (true);
+}
+
+// the format a 32 bit scalar or vector is read as
+static bool getVertexInputFormat(const SpirvModule *pModule,
+                                 const uint32_t typeId, VkFormat *pFormat,
+                                 bool *pIsFloat) {
+  static const VkFormat pFloatFormats[4] = {
+      VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT,
+      VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT};
+  static const VkFormat pSintFormats[4] = {
+      VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT,
+      VK_FORMAT_R32G32B32A32_SINT};
+  static const VkFormat pUintFormats[4] = {
+      VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT,
+      VK_FORMAT_R32G32B32A32_UINT};
+
+  uint32_t def = getSpirvDef(pModule, typeId);
+  uint32_t componentCount = 1;
+  if (getSpirvOpcode(pModule, def) == SPIRV_OP_TYPE_VECTOR) {
+    componentCount = getSpirvWord(pModule, def, 3);
+    def = getSpirvDef(pModule, getSpirvWord(pModule, def, 2));
+  }
+  if (componentCount < 1 || componentCount > 4 ||
+      getSpirvWord(pModule, def, 2) != 32) {
+    return (false);
+  }
+  switch (getSpirvOpcode(pModule, def)) {
+  case SPIRV_OP_TYPE_FLOAT:
+    *pFormat = pFloatFormats[componentCount - 1];
+    *pIsFloat = true;
+    return (true);
+  case SPIRV_OP_TYPE_INT:
+    // word 3 is the signedness
+    *pFormat = getSpirvWord(pModule, def, 3) ? pSintFormats[componentCount - 1]
+                                        : pUintFormats[componentCount - 1];
+    *pIsFloat = false;
+    return (true);
+  default:
+    return (false);
+  }
+}
+
+static ErrVal addVertexInput(ShaderInterface *pInterface,
+                             const ReflectedVertexInput input) {
+  if (pInterface->vertexInputCount == SPIRV_REFLECTION_MAX_INPUTS) {
+    LOG_ERROR(ERR_LEVEL_ERROR, "too many vertex inputs to reflect");
+    return (ERR_NOTSUPPORTED);
+  }
+  uint32_t i = pInterface->vertexInputCount++;
+  for (; i > 0 && pInterface->pVertexInputs[i - 1].location > input.location;
+       i--) {
+    pInterface->pVertexInputs[i] = pInterface->pVertexInputs[i - 1];
+  }
+  pInterface->pVertexInputs[i] = input;
+  return (ERR_OK);
+}
+
+// an input takes a location per matrix column and per array element
+static ErrVal reflectVertexInput(ShaderInterface *pInterface,
+                                 const SpirvModule *pModule,
+                                 const Decorations *pDecorations,
+                                 const uint32_t variableId,
+                                 const uint32_t typeId) {
+  uint32_t def = getSpirvDef(pModule, typeId);
+  uint32_t elementCount = 1;
+  if (getSpirvOpcode(pModule, def) == SPIRV_OP_TYPE_ARRAY) {
+    if (!getSpirvConstant(pModule, getSpirvWord(pModule, def, 3),
+                          &elementCount, NULL)) {
+      return (ERR_NOTSUPPORTED);
+    }
+    def = getSpirvDef(pModule, getSpirvWord(pModule, def, 2));
+  }
+  uint32_t columnCount = 1;
+  uint32_t columnTypeId = getSpirvWord(pModule, def, 1);
+  if (getSpirvOpcode(pModule, def) == SPIRV_OP_TYPE_MATRIX) {
+    columnCount = getSpirvWord(pModule, def, 3);
+    columnTypeId = getSpirvWord(pModule, def, 2);
+  }
+
+  ReflectedVertexInput input = {0};
+  if (!getVertexInputFormat(pModule, columnTypeId, &input.format,
+                            &input.isFloat)) {
+    LOG_ERROR_ARGS(ERR_LEVEL_ERROR,
+                   "vertex input at location %u has an unsupported type",
+                   pDecorations[variableId].location);
+    return (ERR_NOTSUPPORTED);
+  }
+  uint32_t location = pDecorations[variableId].location;
+  for (uint32_t i = 0; i < elementCount * columnCount; i++) {
+    input.location = location + i;
+    ErrVal retVal = addVertexInput(pInterface, input);
+    if (retVal != ERR_OK) {
+      return (retVal);
+    }
+  }
+  return (ERR_OK);
+}
+
+static ErrVal reflectDescriptor(ShaderInterface *pInterface,
+                                const SpirvModule *pModule,
+                                const Decorations *pDecorations,
+                                const uint32_t variableId,
+                                const uint32_t storageClass,
+                                const uint32_t typeId) {
+  ReflectedBinding binding = {0};
+  binding.set = pDecorations[variableId].set;
+  binding.binding = pDecorations[variableId].binding;
+  binding.descriptorCount = 1;
+  binding.stageFlags = pInterface->stageFlags;
+
+  uint32_t elementTypeId = typeId;
+  uint32_t def = getSpirvDef(pModule, typeId);
+  if (getSpirvOpcode(pModule, def) == SPIRV_OP_TYPE_ARRAY) {
+    elementTypeId = getSpirvWord(pModule, def, 2);
+    if (!getSpirvConstant(pModule, getSpirvWord(pModule, def, 3),
+                          &binding.descriptorCount, NULL)) {
+      return (ERR_NOTSUPPORTED);
+    }
+    def = getSpirvDef(pModule, elementTypeId);
+  }
+
+  switch (getSpirvOpcode(pModule, def)) {
+  case SPIRV_OP_TYPE_STRUCT:
+    if (storageClass == STORAGE_CLASS_STORAGE_BUFFER ||
+        pDecorations[elementTypeId].isBufferBlock) {
+      binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    } else {
+      binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    }
+    break;
+  case SPIRV_OP_TYPE_IMAGE: {
+    // word 3 is the dimensionality, and word 7 is 1 if sampled, 2 if storage
+    uint32_t dim = getSpirvWord(pModule, def, 3);
+    bool storage = getSpirvWord(pModule, def, 7) == 2;
+    if (dim == DIM_SUBPASS_DATA) {
+      binding.descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+    } else if (dim == DIM_BUFFER) {
+      binding.descriptorType = storage
+                                   ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER
+                                   : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+    } else {
+      binding.descriptorType = storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE
+                                       : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    }
+    break;
+  }
+  case SPIRV_OP_TYPE_SAMPLER:
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+    break;
+  case SPIRV_OP_TYPE_SAMPLED_IMAGE:
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    break;
+  default:
+    // runtime arrays need descriptor indexing, acceleration structures need
+    // ray tracing, this renderer uses neither
+    LOG_ERROR_ARGS(ERR_LEVEL_ERROR,
+                   "descriptor at set %u binding %u has an unsupported type",
+                   binding.set, binding.binding);
+    return (ERR_NOTSUPPORTED);
+  }
+
+  ShaderInterface stage = {0};
+  stage.stageFlags = pInterface->stageFlags;
+  stage.bindingCount = 1;
+  stage.pBindings[0] = binding;
+  return (mergeShaderInterface(pInterface, &stage));
+}
+
+// reads the decorations of every id
+static void indexDecorations(const SpirvModule *pModule,
+                             Decorations *pDecorations) {
+  for (uint32_t i = 0; i < pModule->instructionCount; i++) {
+    uint32_t opcode = getSpirvOpcode(pModule, i);
+    if (opcode == SPIRV_OP_FUNCTION) {
+      break;
+    }
+    uint32_t target = getSpirvWord(pModule, i, 1);
+    if (opcode != SPIRV_OP_DECORATE || target >= pModule->idBound) {
+      continue;
+    }
+    Decorations *pTarget = &pDecorations[target];
+    uint32_t value = getSpirvWord(pModule, i, 3);
+    switch (getSpirvWord(pModule, i, 2)) {
+    case DECORATION_BLOCK:
+      pTarget->isBlock = true;
+      break;
+    case DECORATION_BUFFER_BLOCK:
+      pTarget->isBufferBlock = true;
+      break;
+    case DECORATION_ARRAY_STRIDE:
+      pTarget->arrayStride = value;
+      break;
+    case DECORATION_BUILT_IN:
+      pTarget->isBuiltIn = true;
+      break;
+    case DECORATION_LOCATION:
+      pTarget->location = value;
+      pTarget->hasLocation = true;
+      break;
+    case DECORATION_BINDING:
+      pTarget->binding = value;
+      break;
+    case DECORATION_DESCRIPTOR_SET:
+      pTarget->set = value;
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+ErrVal reflectSpirv(ShaderInterface *pInterface, const uint32_t *pCode,
+                    const size_t codeSize) {
+  memset(pInterface, 0, sizeof(ShaderInterface));
+  SpirvModule module;
+  ErrVal retVal = new_SpirvModule(&module, pCode, codeSize);
+  if (retVal != ERR_OK) {
+    return (retVal);
+  }
+  Decorations *pDecorations = calloc(module.idBound, sizeof(Decorations));
+  if (pDecorations == NULL) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "failed to reflect SPIR-V: %s",
+                   strerror(errno));
+    PANIC();
+  }
+  indexDecorations(&module, pDecorations);
+
+  retVal = ERR_BADARGS;
+  for (uint32_t i = 0; i < module.instructionCount; i++) {
+    if (getSpirvOpcode(&module, i) == SPIRV_OP_ENTRY_POINT) {
+      retVal = getShaderStage(getSpirvWord(&module, i, 1),
+                              &pInterface->stageFlags)
+                   ? ERR_OK
+                   : ERR_NOTSUPPORTED;
+      break;
+    }
+  }
+  if (retVal != ERR_OK) {
+    LOG_ERROR(ERR_LEVEL_ERROR, "SPIR-V module has no usable entry point");
+  }
+
+  for (uint32_t i = 0; i < module.instructionCount && retVal == ERR_OK; i++) {
+    uint32_t opcode = getSpirvOpcode(&module, i);
+    if (opcode == SPIRV_OP_FUNCTION) {
+      break;
+    }
+    if (opcode != SPIRV_OP_VARIABLE) {
+      continue;
+    }
+    uint32_t variableId = getSpirvWord(&module, i, 2);
+    uint32_t storageClass = getSpirvWord(&module, i, 3);
+    uint32_t pointerDef = getSpirvDef(&module, getSpirvWord(&module, i, 1));
+    if (getSpirvOpcode(&module, pointerDef) != SPIRV_OP_TYPE_POINTER ||
+        variableId >= module.idBound) {
+      retVal = ERR_BADARGS;
+      break;
+    }
+    uint32_t typeId = getSpirvWord(&module, pointerDef, 3);
+    const Decorations *pVariable = &pDecorations[variableId];
+
+    switch (storageClass) {
+    case STORAGE_CLASS_INPUT:
+      if (pInterface->stageFlags == VK_SHADER_STAGE_VERTEX_BIT &&
+          pVariable->hasLocation && !pVariable->isBuiltIn) {
+        retVal = reflectVertexInput(pInterface, &module, pDecorations,
+                                    variableId, typeId);
+      }
+      break;
+    case STORAGE_CLASS_UNIFORM_CONSTANT:
+    case STORAGE_CLASS_UNIFORM:
+    case STORAGE_CLASS_STORAGE_BUFFER:
+      retVal = reflectDescriptor(pInterface, &module, pDecorations,
+                                 variableId, storageClass, typeId);
+      break;
+    case STORAGE_CLASS_PUSH_CONSTANT:
+      pInterface->pushConstantSize =
+          getTypeSize(&module, pDecorations, typeId, 0);
+      pInterface->pushConstantStages = pInterface->stageFlags;
+      if (pInterface->pushConstantSize == 0) {
+        LOG_ERROR(ERR_LEVEL_ERROR, "push constant block has no known size");
+        retVal = ERR_NOTSUPPORTED;
+      }
+      break;
+    default:
+      break;
+    }
+  }
+
+  free(pDecorations);
+  delete_SpirvModule(&module);
+  return (retVal);
+}
+
+ErrVal mergeShaderInterface(ShaderInterface *pInterface,
+                            const ShaderInterface *pStage) {
+  pInterface->stageFlags |= pStage->stageFlags;
+  if (pStage->stageFlags & VK_SHADER_STAGE_VERTEX_BIT) {
+    pInterface->vertexInputCount = pStage->vertexInputCount;
+    memcpy(pInterface->pVertexInputs, pStage->pVertexInputs,
+           sizeof(pInterface->pVertexInputs));
+  }
+
+  for (uint32_t i = 0; i < pStage->bindingCount; i++) {
+    const ReflectedBinding *pBinding = &pStage->pBindings[i];
+    // find where it goes, or the binding it has to agree with
+    uint32_t j = 0;
+    while (j < pInterface->bindingCount &&
+           (pInterface->pBindings[j].set < pBinding->set ||
+            (pInterface->pBindings[j].set == pBinding->set &&
+             pInterface->pBindings[j].binding < pBinding->binding))) {
+      j++;
+    }
+    ReflectedBinding *pExisting = &pInterface->pBindings[j];
+    if (j < pInterface->bindingCount && pExisting->set == pBinding->set &&
+        pExisting->binding == pBinding->binding) {
+      if (pExisting->descriptorType != pBinding->descriptorType ||
+          pExisting->descriptorCount != pBinding->descriptorCount) {
+        LOG_ERROR_ARGS(ERR_LEVEL_ERROR,
+                       "shader stages disagree on set %u binding %u",
+                       pBinding->set, pBinding->binding);
+        return (ERR_BADARGS);
+      }
+      pExisting->stageFlags |= pBinding->stageFlags;
+      continue;
+    }
+    if (pInterface->bindingCount == SPIRV_REFLECTION_MAX_BINDINGS ||
+        pBinding->set >= SPIRV_REFLECTION_MAX_SETS) {
+      LOG_ERROR(ERR_LEVEL_ERROR, "too many descriptors to reflect");
+      return (ERR_NOTSUPPORTED);
+    }
+    memmove(&pInterface->pBindings[j + 1], &pInterface->pBindings[j],
+            (pInterface->bindingCount - j) * sizeof(ReflectedBinding));
+    pInterface->pBindings[j] = *pBinding;
+    pInterface->bindingCount++;
+  }
+
+  if (pStage->pushConstantSize > pInterface->pushConstantSize) {
+    pInterface->pushConstantSize = pStage->pushConstantSize;
+  }
+  pInterface->pushConstantStages |= pStage->pushConstantStages;
+  return (ERR_OK);
+}
+
+const ReflectedBinding *findReflectedBinding(const ShaderInterface *pInterface,
+                                             const uint32_t set,
+                                             const uint32_t binding) {
+  for (uint32_t i = 0; i < pInterface->bindingCount; i++) {
+    if (pInterface->pBindings[i].set == set &&
+        pInterface->pBindings[i].binding == binding) {
+      return (&pInterface->pBindings[i]);
+    }
+  }
+  return (NULL);
+}
+
+uint32_t getReflectedSetCount(const ShaderInterface *pInterface) {
+  // the bindings are sorted by set
+  if (pInterface->bindingCount == 0) {
+    return (0);
+  }
+  return (pInterface->pBindings[pInterface->bindingCount - 1].set + 1);
+}
+
+static uint64_t hashWord(uint64_t hash, const uint32_t word) {
+  for (uint32_t i = 0; i < 4; i++) {
+    hash ^= (word >> (i * 8)) & 0xFFu;
+    hash *= FNV_PRIME;
+  }
+  return (hash);
+}
+
+uint64_t hashShaderInterfaceLayout(const ShaderInterface *pInterface,
+                                   const uint32_t set) {
+  uint64_t hash = FNV_OFFSET_BASIS;
+  for (uint32_t i = 0; i < pInterface->bindingCount; i++) {
+    const ReflectedBinding *pBinding = &pInterface->pBindings[i];
+    if (set != UINT32_MAX && pBinding->set != set) {
+      continue;
+    }
+    hash = hashWord(hash, pBinding->set);
+    hash = hashWord(hash, pBinding->binding);
+    hash = hashWord(hash, (uint32_t)pBinding->descriptorType);
+    hash = hashWord(hash, pBinding->descriptorCount);
+    hash = hashWord(hash, pBinding->stageFlags);
+  }
+  if (set == UINT32_MAX) {
+    hash = hashWord(hash, pInterface->pushConstantSize);
+    hash = hashWord(hash, pInterface->pushConstantStages);
+  }
+  return (hash);
+}
+
+bool isShaderInterfaceLayoutEqual(const ShaderInterface *pA,
+                                  const ShaderInterface *pB,
+                                  const uint32_t set) {
+  if (set == UINT32_MAX &&
+      (pA->pushConstantSize != pB->pushConstantSize ||
+       pA->pushConstantStages != pB->pushConstantStages)) {
+    return (false);
+  }
+  // walk both sorted lists, skipping the other sets
+  uint32_t i = 0;
+  uint32_t j = 0;
+  while (true) {
+    while (i < pA->bindingCount && set != UINT32_MAX &&
+           pA->pBindings[i].set != set) {
+      i++;
+    }
+    while (j < pB->bindingCount && set != UINT32_MAX &&
+           pB->pBindings[j].set != set) {
+      j++;
+    }
+    if (i == pA->bindingCount || j == pB->bindingCount) {
+      return (i == pA->bindingCount && j == pB->bindingCount);
+    }
+    const ReflectedBinding *pBindingA = &pA->pBindings[i++];
+    const ReflectedBinding *pBindingB = &pB->pBindings[j++];
+    if (pBindingA->set != pBindingB->set ||
+        pBindingA->binding != pBindingB->binding ||
+        pBindingA->descriptorType != pBindingB->descriptorType ||
+        pBindingA->descriptorCount != pBindingB->descriptorCount ||
+        pBindingA->stageFlags != pBindingB->stageFlags) {
+      return (false);
+    }
+  }
+}
@@ -0,0 +1,98 @@
+///
+/// Copyright 2019 Govind Pimpale
+/// spirv_reflection.h
+///
+/// Reads what a SPIR-V module expects from the pipeline it is built into: the
+/// vertex attributes it reads, the descriptors it binds and the size of its
+/// push constants. Pipeline layouts and vertex input state are derived from
+/// this rather than written out by hand, so a shader edit can't leave them
+/// silently out of step.
+///
+
+#ifndef SRC_SPIRV_REFLECTION_H_
+#define SRC_SPIRV_REFLECTION_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "errors.h"
+
+#define SPIRV_REFLECTION_MAX_INPUTS 16
+#define SPIRV_REFLECTION_MAX_BINDINGS 16
+#define SPIRV_REFLECTION_MAX_SETS 4
+
+typedef struct {
+  uint32_t location;
+  // the 32 bit format of the shader's own type, e.g. R32G32B32_SFLOAT for a
+  // vec3, one location of a matrix or array each
+  VkFormat format;
+  // whether the shader reads floats, which normalized formats also provide
+  bool isFloat;
+} ReflectedVertexInput;
+
+typedef struct {
+  uint32_t set;
+  uint32_t binding;
+  VkDescriptorType descriptorType;
+  uint32_t descriptorCount;
+  VkShaderStageFlags stageFlags;
+} ReflectedBinding;
+
+// The interface of one shader stage, or of every stage of a pipeline once
+// merged
+typedef struct {
+  VkShaderStageFlags stageFlags;
+  // sorted by location, from the vertex stage only
+  uint32_t vertexInputCount;
+  ReflectedVertexInput pVertexInputs[SPIRV_REFLECTION_MAX_INPUTS];
+  // sorted by set, then binding
+  uint32_t bindingCount;
+  ReflectedBinding pBindings[SPIRV_REFLECTION_MAX_BINDINGS];
+  // one range from offset 0, 0 if no stage has push constants
+  uint32_t pushConstantSize;
+  VkShaderStageFlags pushConstantStages;
+} ShaderInterface;
+
+/// Reflects the interface of the first entry point in `pCode`
+/// --- PRECONDITIONS ---
+/// * `pCode` passes isSpirv
+/// --- POSTCONDITIONS ---
+/// * returns error status, ERR_NOTSUPPORTED if the module uses something the
+/// reflection doesn't describe, e.g. 64 bit vertex inputs or runtime arrays
+/// of descriptors
+ErrVal reflectSpirv(ShaderInterface *pInterface, const uint32_t *pCode,
+                    const size_t codeSize);
+
+/// Adds `pStage` to `pInterface`, which starts out zeroed or as a copy of
+/// another stage
+/// --- POSTCONDITIONS ---
+/// * returns error status, ERR_BADARGS if both declare the same binding
+/// differently
+ErrVal mergeShaderInterface(ShaderInterface *pInterface,
+                            const ShaderInterface *pStage);
+
+/// Returns the binding at `set` and `binding`, or NULL if there is none
+const ReflectedBinding *findReflectedBinding(const ShaderInterface *pInterface,
+                                             const uint32_t set,
+                                             const uint32_t binding);
+
+/// Returns the number of descriptor sets a layout for `pInterface` needs,
+/// counting any unused ones below the highest
+uint32_t getReflectedSetCount(const ShaderInterface *pInterface);
+
+/// Hashes the bindings of `set`, or every binding and the push constants if
+/// `set` is UINT32_MAX, i.e. what a descriptor set layout or a pipeline
+/// layout is made of
+uint64_t hashShaderInterfaceLayout(const ShaderInterface *pInterface,
+                                   const uint32_t set);
+
+/// Returns whether `pA` and `pB` need the same layout for `set`, or the same
+/// pipeline layout if `set` is UINT32_MAX
+bool isShaderInterfaceLayoutEqual(const ShaderInterface *pA,
+                                  const ShaderInterface *pB,
+                                  const uint32_t set);
+
+#endif /* SRC_SPIRV_REFLECTION_H_ */
@@ -0,0 +1,141 @@
+#include "staging_ring.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vulkan/vulkan.h>
+
+#include "vulkan_utils.h"
+
+ErrVal new_StagingRing(StagingRing *pRing, const VkDeviceSize size,
+                       const uint32_t frameCount, DeviceAllocator *pAllocator,
+                       const VkDevice device) {
+  /* coherent memory so that we never have to flush the mapping */
+  ErrVal bufferRetVal = new_Buffer_DeviceMemory(
+      &pRing->buffer, &pRing->allocation, size, pAllocator, device,
+      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  if (bufferRetVal != ERR_OK) {
+    LOG_ERROR(ERR_LEVEL_ERROR, "failed to create staging ring buffer");
+    return (bufferRetVal);
+  }
+
+  pRing->pFrameHeads = calloc(frameCount, sizeof(VkDeviceSize));
+  pRing->pendingCopyCapacity = 64;
+  pRing->pPendingDstBuffers =
+      malloc(pRing->pendingCopyCapacity * sizeof(VkBuffer));
+  pRing->pPendingRegions =
+      malloc(pRing->pendingCopyCapacity * sizeof(VkBufferCopy));
+  if (pRing->pFrameHeads == NULL || pRing->pPendingDstBuffers == NULL ||
+      pRing->pPendingRegions == NULL) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "failed to create staging ring: %s",
+                   strerror(errno));
+    PANIC();
+  }
+
+  pRing->size = size;
+  pRing->head = 0;
+  pRing->tail = 0;
+  pRing->frameCount = frameCount;
+  pRing->currentFrame = 0;
+  pRing->pendingCopyCount = 0;
+  return (ERR_OK);
+}
+
+void delete_StagingRing(StagingRing *pRing, DeviceAllocator *pAllocator,
+                        const VkDevice device) {
+  delete_Buffer(&pRing->buffer, device);
+  delete_DeviceMemory(&pRing->allocation, pAllocator);
+  free(pRing->pFrameHeads);
+  free(pRing->pPendingDstBuffers);
+  free(pRing->pPendingRegions);
+  pRing->pFrameHeads = NULL;
+  pRing->pPendingDstBuffers = NULL;
+  pRing->pPendingRegions = NULL;
+}
+
+void beginStagingRingFrame(StagingRing *pRing, const uint32_t frameIndex) {
+  // frames retire in order, so everything this frame wrote is now free
+  if (pRing->pFrameHeads[frameIndex] > pRing->tail) {
+    pRing->tail = pRing->pFrameHeads[frameIndex];
+  }
+  pRing->currentFrame = frameIndex;
+}
+
+ErrVal stageBufferUpload(StagingRing *pRing, const VkBuffer dstBuffer,
+                         const VkDeviceSize dstOffset, const void *pData,
+                         const VkDeviceSize size) {
+  VkDeviceSize start = ((pRing->head + STAGING_RING_ALIGNMENT - 1) /
+                        STAGING_RING_ALIGNMENT) *
+                       STAGING_RING_ALIGNMENT;
+  // uploads must be contiguous, so skip the end of the ring if we'd straddle it
+  if (start % pRing->size + size > pRing->size) {
+    start += pRing->size - start % pRing->size;
+  }
+  if (start + size - pRing->tail > pRing->size) {
+    LOG_ERROR_ARGS(ERR_LEVEL_WARN,
+                   "staging ring full: %" PRIu64 " bytes requested, %" PRIu64
+                   " in flight",
+                   (uint64_t)size, (uint64_t)(pRing->head - pRing->tail));
+    return (ERR_MEMORY);
+  }
+
+  VkDeviceSize ringOffset = start % pRing->size;
+  memcpy((uint8_t *)pRing->allocation.pMapped + ringOffset, pData,
+         (size_t)size);
+  pRing->head = start + size;
+
+  if (pRing->pendingCopyCount == pRing->pendingCopyCapacity) {
+    uint32_t newCapacity = pRing->pendingCopyCapacity * 2;
+    VkBuffer *pNewDstBuffers =
+        realloc(pRing->pPendingDstBuffers, newCapacity * sizeof(VkBuffer));
+    VkBufferCopy *pNewRegions =
+        realloc(pRing->pPendingRegions, newCapacity * sizeof(VkBufferCopy));
+    if (pNewDstBuffers == NULL || pNewRegions == NULL) {
+      LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "failed to queue staging copy: %s",
+                     strerror(errno));
+      PANIC();
+    }
+    pRing->pPendingDstBuffers = pNewDstBuffers;
+    pRing->pPendingRegions = pNewRegions;
+    pRing->pendingCopyCapacity = newCapacity;
+  }
+
+  uint32_t copyIndex = pRing->pendingCopyCount;
+  pRing->pPendingDstBuffers[copyIndex] = dstBuffer;
+  pRing->pPendingRegions[copyIndex].srcOffset = ringOffset;
+  pRing->pPendingRegions[copyIndex].dstOffset = dstOffset;
+  pRing->pPendingRegions[copyIndex].size = size;
+  pRing->pendingCopyCount++;
+  return (ERR_OK);
+}
+
+void recordStagingRingCopies(StagingRing *pRing,
+                             const VkCommandBuffer commandBuffer) {
+  // whatever we've written so far belongs to the frame being recorded
+  pRing->pFrameHeads[pRing->currentFrame] = pRing->head;
+
+  if (pRing->pendingCopyCount == 0) {
+    return;
+  }
+
+  // copies into the same buffer go out as one command
+  uint32_t first = 0;
+  while (first < pRing->pendingCopyCount) {
+    VkBuffer dstBuffer = pRing->pPendingDstBuffers[first];
+    uint32_t last = first;
+    while (last < pRing->pendingCopyCount &&
+           pRing->pPendingDstBuffers[last] == dstBuffer) {
+      last++;
+    }
+    vkCmdCopyBuffer(commandBuffer, pRing->buffer, dstBuffer, last - first,
+                    &pRing->pPendingRegions[first]);
+    first = last;
+  }
+
+  pRing->pendingCopyCount = 0;
+}
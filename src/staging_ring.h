@@ -0,0 +1,89 @@
+///
+/// Copyright 2019 Govind Pimpale
+/// staging_ring.h
+///
+/// A long lived, persistently mapped staging buffer used as a ring.
+/// Uploads are written straight into the mapping and the copies out of it are
+/// recorded once per frame. A frame's space is reclaimed once the work that
+/// copied out of it has retired.
+///
+
+#ifndef SRC_STAGING_RING_H_
+#define SRC_STAGING_RING_H_
+
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "errors.h"
+#include "memory_allocator.h"
+
+// every upload starts on a multiple of this many bytes
+#define STAGING_RING_ALIGNMENT 16
+
+typedef struct {
+  VkBuffer buffer;
+  DeviceAllocation allocation;
+  VkDeviceSize size;
+  // head and tail only ever grow, the byte offset in the ring is pos % size
+  // bytes in [tail, head) belong to frames that may still be in flight
+  VkDeviceSize head;
+  VkDeviceSize tail;
+  // the value of head when each frame in flight was recorded
+  VkDeviceSize *pFrameHeads;
+  uint32_t frameCount;
+  uint32_t currentFrame;
+  // copies that will go out with the next recordStagingRingCopies
+  VkBuffer *pPendingDstBuffers;
+  VkBufferCopy *pPendingRegions;
+  uint32_t pendingCopyCount;
+  uint32_t pendingCopyCapacity;
+} StagingRing;
+
+/// Creates a new staging ring
+/// --- PRECONDITIONS ---
+/// * `pRing` is a valid pointer
+/// * `frameCount` is the number of frames in flight
+/// --- POSTCONDITIONS ---
+/// * returns error status
+/// * on success, `*pRing` is an empty ring of `size` host coherent bytes
+/// --- CLEANUP ---
+/// * call delete_StagingRing once no frames are in flight
+ErrVal new_StagingRing(StagingRing *pRing, const VkDeviceSize size,
+                       const uint32_t frameCount, DeviceAllocator *pAllocator,
+                       const VkDevice device);
+
+void delete_StagingRing(StagingRing *pRing, DeviceAllocator *pAllocator,
+                        const VkDevice device);
+
+/// Reclaims the space used by `frameIndex` the last time it was recorded
+/// --- PRECONDITIONS ---
+/// * the work recorded for `frameIndex` has completed on the device
+/// --- POSTCONDITIONS ---
+/// * later copies are recorded as part of `frameIndex`
+void beginStagingRingFrame(StagingRing *pRing, const uint32_t frameIndex);
+
+/// Copies `size` bytes from `pData` into the ring and queues a copy into
+/// `dstBuffer` at `dstOffset`
+/// --- PRECONDITIONS ---
+/// * `dstBuffer` was created with VK_BUFFER_USAGE_TRANSFER_DST_BIT
+/// --- POSTCONDITIONS ---
+/// * returns error status
+/// * returns ERR_MEMORY if the frames in flight leave no room for `size`
+/// bytes, in which case nothing is queued
+/// * on success, the copy runs with the next recordStagingRingCopies
+ErrVal stageBufferUpload(StagingRing *pRing, const VkBuffer dstBuffer,
+                         const VkDeviceSize dstOffset, const void *pData,
+                         const VkDeviceSize size);
+
+/// Records every queued copy into `commandBuffer`
+/// --- PRECONDITIONS ---
+/// * `commandBuffer` is recording and outside of a render pass
+/// * `commandBuffer` is retired before the current frame is begun again
+/// --- POSTCONDITIONS ---
+/// * the queue of copies is empty
+/// * the caller is responsible for making the copies visible to their readers
+void recordStagingRingCopies(StagingRing *pRing,
+                             const VkCommandBuffer commandBuffer);
+
+#endif /* SRC_STAGING_RING_H_ */
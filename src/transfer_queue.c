@@ -0,0 +1,336 @@
+#include "transfer_queue.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vulkan/vulkan.h>
+
+#include "vulkan_utils.h"
+
+ErrVal new_TransferQueue(                    //
+    TransferQueue *pTransferQueue,           //
+    const VkDevice device,                   //
+    const uint32_t queueFamilyIndex,         //
+    const uint32_t dstQueueFamilyIndex,      //
+    const VkPipelineStageFlags dstStageMask, //
+    const VkAccessFlags dstAccessMask,       //
+    const VkDeviceSize stagingSize,          //
+    DeviceAllocator *pAllocator              //
+) {
+  ErrVal ringRetVal =
+      new_StagingRing(&pTransferQueue->stagingRing, stagingSize,
+                      TRANSFER_QUEUE_BATCH_COUNT, pAllocator, device);
+  if (ringRetVal != ERR_OK) {
+    LOG_ERROR(ERR_LEVEL_ERROR, "failed to create transfer queue");
+    return (ringRetVal);
+  }
+
+  ErrVal poolRetVal =
+      new_CommandPool(&pTransferQueue->commandPool, device, queueFamilyIndex);
+  if (poolRetVal != ERR_OK) {
+    LOG_ERROR(ERR_LEVEL_ERROR, "failed to create transfer queue");
+    delete_StagingRing(&pTransferQueue->stagingRing, pAllocator, device);
+    return (poolRetVal);
+  }
+  new_CommandBuffers(pTransferQueue->pCommandBuffers,
+                     TRANSFER_QUEUE_BATCH_COUNT, pTransferQueue->commandPool,
+                     device);
+
+  ErrVal semaphoreRetVal =
+      new_TimelineSemaphore(&pTransferQueue->timeline, device, 0);
+  if (semaphoreRetVal != ERR_OK) {
+    LOG_ERROR(ERR_LEVEL_ERROR, "failed to create transfer queue");
+    delete_CommandBuffers(pTransferQueue->pCommandBuffers,
+                          TRANSFER_QUEUE_BATCH_COUNT,
+                          pTransferQueue->commandPool, device);
+    delete_CommandPool(&pTransferQueue->commandPool, device);
+    delete_StagingRing(&pTransferQueue->stagingRing, pAllocator, device);
+    return (semaphoreRetVal);
+  }
+
+  pTransferQueue->ownershipBarrierCapacity = 64;
+  pTransferQueue->pOwnershipBarriers = malloc(
+      pTransferQueue->ownershipBarrierCapacity * sizeof(VkBufferMemoryBarrier));
+  if (pTransferQueue->pOwnershipBarriers == NULL) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "failed to create transfer queue: %s",
+                   strerror(errno));
+    PANIC();
+  }
+
+  getQueue(&pTransferQueue->queue, device, queueFamilyIndex);
+  pTransferQueue->device = device;
+  pTransferQueue->queueFamilyIndex = queueFamilyIndex;
+  pTransferQueue->dstQueueFamilyIndex = dstQueueFamilyIndex;
+  pTransferQueue->dstStageMask = dstStageMask;
+  pTransferQueue->dstAccessMask = dstAccessMask;
+  for (uint32_t i = 0; i < TRANSFER_QUEUE_BATCH_COUNT; i++) {
+    pTransferQueue->pBatchValues[i] = 0;
+  }
+  pTransferQueue->nextBatch = 0;
+  pTransferQueue->submittedValue = 0;
+  pTransferQueue->acquiredValue = 0;
+  pTransferQueue->ownershipBarrierCount = 0;
+  pTransferQueue->releasedCount = 0;
+  return (ERR_OK);
+}
+
+void delete_TransferQueue(TransferQueue *pTransferQueue,
+                          DeviceAllocator *pAllocator) {
+  VkDevice device = pTransferQueue->device;
+  waitTransferTicket(pTransferQueue, pTransferQueue->submittedValue);
+  delete_Semaphore(&pTransferQueue->timeline, device);
+  delete_CommandBuffers(pTransferQueue->pCommandBuffers,
+                        TRANSFER_QUEUE_BATCH_COUNT, pTransferQueue->commandPool,
+                        device);
+  delete_CommandPool(&pTransferQueue->commandPool, device);
+  delete_StagingRing(&pTransferQueue->stagingRing, pAllocator, device);
+  free(pTransferQueue->pOwnershipBarriers);
+  pTransferQueue->pOwnershipBarriers = NULL;
+}
+
+/* Gives the staging memory of every retired batch back to the ring */
+static void reclaimTransferQueue(TransferQueue *pTransferQueue) {
+  uint64_t completedValue = 0;
+  vkGetSemaphoreCounterValue(pTransferQueue->device, pTransferQueue->timeline,
+                             &completedValue);
+  // nextBatch is the oldest batch, walk forward so the ring retires in order
+  for (uint32_t i = 0; i < TRANSFER_QUEUE_BATCH_COUNT; i++) {
+    uint32_t batch =
+        (pTransferQueue->nextBatch + i) % TRANSFER_QUEUE_BATCH_COUNT;
+    TransferTicket value = pTransferQueue->pBatchValues[batch];
+    if (value != 0 && value <= completedValue) {
+      beginStagingRingFrame(&pTransferQueue->stagingRing, batch);
+    }
+  }
+}
+
+static ErrVal stageTransferChunk(TransferQueue *pTransferQueue,
+                                 const VkBuffer dstBuffer,
+                                 const VkDeviceSize dstOffset,
+                                 const void *pData, const VkDeviceSize size) {
+  StagingRing *pRing = &pTransferQueue->stagingRing;
+  ErrVal stageRetVal =
+      stageBufferUpload(pRing, dstBuffer, dstOffset, pData, size);
+  if (stageRetVal == ERR_MEMORY) {
+    // try again with whatever the device has finished with since
+    reclaimTransferQueue(pTransferQueue);
+    stageRetVal = stageBufferUpload(pRing, dstBuffer, dstOffset, pData, size);
+  }
+  if (stageRetVal == ERR_MEMORY) {
+    // still full, so flush what we have and block until all of it is done
+    TransferTicket ticket;
+    submitTransferQueue(pTransferQueue, &ticket);
+    waitTransferTicket(pTransferQueue, ticket);
+    reclaimTransferQueue(pTransferQueue);
+    stageRetVal = stageBufferUpload(pRing, dstBuffer, dstOffset, pData, size);
+  }
+  if (stageRetVal != ERR_OK) {
+    LOG_ERROR(ERR_LEVEL_ERROR, "failed to stage transfer upload");
+    return (stageRetVal);
+  }
+
+  if (pTransferQueue->queueFamilyIndex == pTransferQueue->dstQueueFamilyIndex) {
+    // the timeline wait alone makes the copy visible
+    return (ERR_OK);
+  }
+
+  if (pTransferQueue->ownershipBarrierCount ==
+      pTransferQueue->ownershipBarrierCapacity) {
+    uint32_t newCapacity = pTransferQueue->ownershipBarrierCapacity * 2;
+    VkBufferMemoryBarrier *pNewBarriers =
+        realloc(pTransferQueue->pOwnershipBarriers,
+                newCapacity * sizeof(VkBufferMemoryBarrier));
+    if (pNewBarriers == NULL) {
+      LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "failed to stage transfer upload: %s",
+                     strerror(errno));
+      PANIC();
+    }
+    pTransferQueue->pOwnershipBarriers = pNewBarriers;
+    pTransferQueue->ownershipBarrierCapacity = newCapacity;
+  }
+
+  // the release and the acquire must describe the same range
+  VkBufferMemoryBarrier barrier = {0};
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.srcQueueFamilyIndex = pTransferQueue->queueFamilyIndex;
+  barrier.dstQueueFamilyIndex = pTransferQueue->dstQueueFamilyIndex;
+  barrier.buffer = dstBuffer;
+  barrier.offset = dstOffset;
+  barrier.size = size;
+  pTransferQueue->pOwnershipBarriers[pTransferQueue->ownershipBarrierCount] =
+      barrier;
+  pTransferQueue->ownershipBarrierCount++;
+  return (ERR_OK);
+}
+
+ErrVal stageTransferUpload(TransferQueue *pTransferQueue,
+                           const VkBuffer dstBuffer,
+                           const VkDeviceSize dstOffset, const void *pData,
+                           const VkDeviceSize size) {
+  // large uploads go through in pieces so that they never need the whole ring
+  VkDeviceSize chunkSize = pTransferQueue->stagingRing.size / 4;
+  chunkSize -= chunkSize % STAGING_RING_ALIGNMENT;
+  for (VkDeviceSize offset = 0; offset < size; offset += chunkSize) {
+    VkDeviceSize remaining = size - offset;
+    ErrVal chunkRetVal = stageTransferChunk(
+        pTransferQueue, dstBuffer, dstOffset + offset,
+        (const uint8_t *)pData + offset,
+        remaining < chunkSize ? remaining : chunkSize);
+    if (chunkRetVal != ERR_OK) {
+      return (chunkRetVal);
+    }
+  }
+  return (ERR_OK);
+}
+
+ErrVal submitTransferQueue(TransferQueue *pTransferQueue,
+                           TransferTicket *pTicket) {
+  StagingRing *pRing = &pTransferQueue->stagingRing;
+  if (pRing->pendingCopyCount == 0) {
+    *pTicket = pTransferQueue->submittedValue;
+    return (ERR_OK);
+  }
+
+  uint32_t batch = pTransferQueue->nextBatch;
+  // the batch's command buffer and staging memory are reused, so it must be
+  // done, which it only isn't if every batch is in flight
+  waitTransferTicket(pTransferQueue, pTransferQueue->pBatchValues[batch]);
+  beginStagingRingFrame(pRing, batch);
+
+  VkCommandBuffer commandBuffer = pTransferQueue->pCommandBuffers[batch];
+  VkCommandBufferBeginInfo beginInfo = {0};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  VkResult beginRet = vkBeginCommandBuffer(commandBuffer, &beginInfo);
+  if (beginRet != VK_SUCCESS) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL,
+                   "failed to begin transfer command buffer: %s",
+                   vkstrerror(beginRet));
+    PANIC();
+  }
+
+  recordStagingRingCopies(pRing, commandBuffer);
+
+  // release ownership of everything we just wrote to the consumer's family
+  uint32_t releaseCount =
+      pTransferQueue->ownershipBarrierCount - pTransferQueue->releasedCount;
+  if (releaseCount > 0) {
+    VkBufferMemoryBarrier *pReleases =
+        &pTransferQueue->pOwnershipBarriers[pTransferQueue->releasedCount];
+    for (uint32_t i = 0; i < releaseCount; i++) {
+      pReleases[i].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      pReleases[i].dstAccessMask = 0;
+    }
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, NULL,
+                         releaseCount, pReleases, 0, NULL);
+  }
+
+  VkResult endRet = vkEndCommandBuffer(commandBuffer);
+  if (endRet != VK_SUCCESS) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "failed to end transfer command buffer: %s",
+                   vkstrerror(endRet));
+    PANIC();
+  }
+
+  TransferTicket signalValue = pTransferQueue->submittedValue + 1;
+  VkTimelineSemaphoreSubmitInfo timelineInfo = {0};
+  timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+  timelineInfo.signalSemaphoreValueCount = 1;
+  timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+  VkSubmitInfo submitInfo = {0};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.pNext = &timelineInfo;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &commandBuffer;
+  submitInfo.signalSemaphoreCount = 1;
+  submitInfo.pSignalSemaphores = &pTransferQueue->timeline;
+
+  VkResult submitRet =
+      vkQueueSubmit(pTransferQueue->queue, 1, &submitInfo, VK_NULL_HANDLE);
+  if (submitRet != VK_SUCCESS) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "failed to submit transfer batch: %s",
+                   vkstrerror(submitRet));
+    PANIC();
+  }
+
+  pTransferQueue->pBatchValues[batch] = signalValue;
+  pTransferQueue->nextBatch = (batch + 1) % TRANSFER_QUEUE_BATCH_COUNT;
+  pTransferQueue->submittedValue = signalValue;
+  pTransferQueue->releasedCount = pTransferQueue->ownershipBarrierCount;
+  *pTicket = signalValue;
+  return (ERR_OK);
+}
+
+bool isTransferTicketComplete(const TransferQueue *pTransferQueue,
+                              const TransferTicket ticket) {
+  uint64_t completedValue = 0;
+  VkResult ret = vkGetSemaphoreCounterValue(
+      pTransferQueue->device, pTransferQueue->timeline, &completedValue);
+  if (ret != VK_SUCCESS) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "failed to query transfer timeline: %s",
+                   vkstrerror(ret));
+    PANIC();
+  }
+  return (completedValue >= ticket);
+}
+
+ErrVal waitTransferTicket(const TransferQueue *pTransferQueue,
+                          const TransferTicket ticket) {
+  if (ticket == 0) {
+    return (ERR_OK);
+  }
+  VkSemaphoreWaitInfo waitInfo = {0};
+  waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+  waitInfo.semaphoreCount = 1;
+  waitInfo.pSemaphores = &pTransferQueue->timeline;
+  waitInfo.pValues = &ticket;
+  VkResult ret =
+      vkWaitSemaphores(pTransferQueue->device, &waitInfo, UINT64_MAX);
+  if (ret != VK_SUCCESS) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "failed to wait for transfer timeline: %s",
+                   vkstrerror(ret));
+    PANIC();
+  }
+  return (ERR_OK);
+}
+
+bool hasTransferQueueAcquires(const TransferQueue *pTransferQueue) {
+  return (pTransferQueue->releasedCount > 0 ||
+          pTransferQueue->submittedValue > pTransferQueue->acquiredValue);
+}
+
+TransferTicket
+recordTransferQueueAcquires(TransferQueue *pTransferQueue,
+                            const VkCommandBuffer commandBuffer) {
+  uint32_t acquireCount = pTransferQueue->releasedCount;
+  if (acquireCount > 0) {
+    VkBufferMemoryBarrier *pAcquires = pTransferQueue->pOwnershipBarriers;
+    for (uint32_t i = 0; i < acquireCount; i++) {
+      pAcquires[i].srcAccessMask = 0;
+      pAcquires[i].dstAccessMask = pTransferQueue->dstAccessMask;
+    }
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         pTransferQueue->dstStageMask, 0, 0, NULL, acquireCount,
+                         pAcquires, 0, NULL);
+
+    // drop the acquired barriers, keeping the ones not yet submitted
+    uint32_t pendingCount =
+        pTransferQueue->ownershipBarrierCount - acquireCount;
+    memmove(pAcquires, pAcquires + acquireCount,
+            pendingCount * sizeof(VkBufferMemoryBarrier));
+    pTransferQueue->ownershipBarrierCount = pendingCount;
+    pTransferQueue->releasedCount = 0;
+  }
+
+  // a semaphore wait also covers every later submit on the same queue, so
+  // each value only needs waiting on once
+  if (pTransferQueue->submittedValue > pTransferQueue->acquiredValue) {
+    pTransferQueue->acquiredValue = pTransferQueue->submittedValue;
+    return (pTransferQueue->acquiredValue);
+  }
+  return (0);
+}
@@ -0,0 +1,134 @@
+///
+/// Copyright 2019 Govind Pimpale
+/// transfer_queue.h
+///
+/// Uploads buffer data on its own queue, ideally from a dedicated transfer
+/// queue family, so that copies overlap rendering instead of stalling it.
+/// Each submitted batch signals a timeline semaphore, and the value it
+/// signals is handed back as a ticket that can be polled, waited on, or made
+/// a wait of the next graphics submit.
+///
+
+#ifndef SRC_TRANSFER_QUEUE_H_
+#define SRC_TRANSFER_QUEUE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "errors.h"
+#include "memory_allocator.h"
+#include "staging_ring.h"
+
+// number of batches that may be in flight on the transfer queue at once
+#define TRANSFER_QUEUE_BATCH_COUNT 4
+
+// A timeline value, the upload it was handed out for is complete once the
+// timeline semaphore reaches it. 0 is always complete.
+typedef uint64_t TransferTicket;
+
+typedef struct {
+  VkDevice device;
+  VkQueue queue;
+  uint32_t queueFamilyIndex;
+  // the family that reads the uploads, and the stages and accesses it reads
+  // them with
+  uint32_t dstQueueFamilyIndex;
+  VkPipelineStageFlags dstStageMask;
+  VkAccessFlags dstAccessMask;
+  VkCommandPool commandPool;
+  VkCommandBuffer pCommandBuffers[TRANSFER_QUEUE_BATCH_COUNT];
+  // timeline value signaled by each batch, 0 if it has never been submitted
+  TransferTicket pBatchValues[TRANSFER_QUEUE_BATCH_COUNT];
+  uint32_t nextBatch;
+  VkSemaphore timeline;
+  TransferTicket submittedValue;
+  // the highest value a consumer has already been told to wait on
+  TransferTicket acquiredValue;
+  // the ring doubles up as our batches' staging memory, one frame per batch
+  StagingRing stagingRing;
+  // only used when the two families differ:
+  // [0, releasedCount) are released and waiting to be acquired,
+  // [releasedCount, ownershipBarrierCount) are staged but not yet submitted
+  VkBufferMemoryBarrier *pOwnershipBarriers;
+  uint32_t ownershipBarrierCount;
+  uint32_t ownershipBarrierCapacity;
+  uint32_t releasedCount;
+} TransferQueue;
+
+/// Creates a new transfer queue
+/// --- PRECONDITIONS ---
+/// * `pTransferQueue` is a valid pointer
+/// * `device` was created with a queue from `queueFamilyIndex` and from
+/// `dstQueueFamilyIndex`, and with the timelineSemaphore feature
+/// * `dstStageMask` and `dstAccessMask` cover every way the consumer reads
+/// the uploaded buffers
+/// --- POSTCONDITIONS ---
+/// * returns error status
+/// * on success, `*pTransferQueue` has nothing staged or in flight
+/// --- CLEANUP ---
+/// * call delete_TransferQueue
+ErrVal new_TransferQueue(                    //
+    TransferQueue *pTransferQueue,           //
+    const VkDevice device,                   //
+    const uint32_t queueFamilyIndex,         //
+    const uint32_t dstQueueFamilyIndex,      //
+    const VkPipelineStageFlags dstStageMask, //
+    const VkAccessFlags dstAccessMask,       //
+    const VkDeviceSize stagingSize,          //
+    DeviceAllocator *pAllocator              //
+);
+
+/// Waits for every submitted batch, then frees the queue's resources
+void delete_TransferQueue(TransferQueue *pTransferQueue,
+                          DeviceAllocator *pAllocator);
+
+/// Stages `size` bytes from `pData` for copying into `dstBuffer` at
+/// `dstOffset` with the next submitTransferQueue
+/// --- PRECONDITIONS ---
+/// * `dstBuffer` was created with VK_BUFFER_USAGE_TRANSFER_DST_BIT and is
+/// owned by the transfer queue's family, or was never used
+/// --- POSTCONDITIONS ---
+/// * returns error status
+/// * uploads larger than a quarter of the staging memory are split up
+/// * blocks on the device if the staging memory is full of batches still in
+/// flight
+ErrVal stageTransferUpload(TransferQueue *pTransferQueue,
+                           const VkBuffer dstBuffer,
+                           const VkDeviceSize dstOffset, const void *pData,
+                           const VkDeviceSize size);
+
+/// Submits everything staged so far as one batch
+/// --- POSTCONDITIONS ---
+/// * returns error status
+/// * `*pTicket` completes once every upload staged before this call has
+/// landed
+/// * only blocks if all TRANSFER_QUEUE_BATCH_COUNT batches are in flight
+ErrVal submitTransferQueue(TransferQueue *pTransferQueue,
+                           TransferTicket *pTicket);
+
+/// Returns whether the uploads for `ticket` have completed, without blocking
+bool isTransferTicketComplete(const TransferQueue *pTransferQueue,
+                              const TransferTicket ticket);
+
+/// Blocks until the uploads for `ticket` have completed
+ErrVal waitTransferTicket(const TransferQueue *pTransferQueue,
+                          const TransferTicket ticket);
+
+/// Returns whether a submitted upload hasn't been handed over to the consumer
+/// yet, i.e. whether recordTransferQueueAcquires has anything to record
+bool hasTransferQueueAcquires(const TransferQueue *pTransferQueue);
+
+/// Hands every submitted upload over to the consumer
+/// --- PRECONDITIONS ---
+/// * `commandBuffer` is recording on `dstQueueFamilyIndex`, outside of a render
+/// pass
+/// --- POSTCONDITIONS ---
+/// * records the queue family ownership acquires for submitted uploads
+/// * returns the ticket that the submit of `commandBuffer` must wait on at
+/// `dstStageMask`, or 0 if it need not wait
+TransferTicket recordTransferQueueAcquires(TransferQueue *pTransferQueue,
+                                           const VkCommandBuffer commandBuffer);
+
+#endif /* SRC_TRANSFER_QUEUE_H_ */
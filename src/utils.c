@@ -5,11 +5,15 @@
  *      Author: gpi
  */
 
+#define _POSIX_C_SOURCE 199309L
+
 #include <errno.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 #include <vulkan/vulkan.h>
 #define GLFW_INCLUDE_VULKAN
@@ -30,39 +34,13 @@ uint64_t getLength(FILE *f) {
   return ((uint64_t)size);
 }
 
-/**
- * Mallocs
- */
-void readShaderFile(const char *filename, uint32_t *length, uint32_t **code) {
-  FILE *fp = fopen(filename, "rb");
-  if (!fp) {
-    LOG_ERROR(ERR_LEVEL_FATAL, "could not read file");
-    PANIC();
-  }
-  /* We can coerce to a 32 bit, because no realistic files will be
-   * greater than 2 GB */
-  uint32_t filesize = (uint32_t)getLength(fp);
-  // pad to a multiple of 4
-  uint32_t filesizepadded = (filesize + 3) & ~0x03u;
-
-  char *str = malloc(filesizepadded);
-  if (!str) {
-    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "could not read shader file: %s",
-                   strerror(errno));
-    fclose(fp);
-    PANIC();
-  }
-
-  fread(str, filesize, sizeof(char), fp);
-  fclose(fp);
-
-  /*pad data*/
-  for (uint32_t i = filesize; i < filesizepadded; i++) {
-    str[i] = 0;
-  }
+double getTime(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return ((double)now.tv_sec + (double)now.tv_nsec / 1e9);
+}
 
-  /*cast data t array of uints*/
-  *length = filesizepadded;
-  *code = (uint32_t *)((void *)str);
-  return;
+uint32_t getProcessorCount(void) {
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return (count < 1 ? 1 : (uint32_t)count);
 }
@@ -15,7 +15,11 @@
 
 uint64_t getLength(FILE *f);
 
-void readShaderFile(const char *filename, uint32_t *length, uint32_t **code);
+/// Returns monotonic time in seconds, usable without a window system
+double getTime(void);
+
+/// Returns the number of processors online, at least 1
+uint32_t getProcessorCount(void);
 
 
 
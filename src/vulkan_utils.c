@@ -268,7 +268,7 @@ ErrVal getQueueFamilyIndexByCapability(uint32_t *pQueueFamilyIndex,
                                            pFamilyProperties);
   for (uint32_t i = 0; i < queueFamilyCount; i++) {
     if (pFamilyProperties[i].queueCount > 0 &&
-        (pFamilyProperties[0].queueFlags & bit)) {
+        (pFamilyProperties[i].queueFlags & bit) == bit) {
       free(pFamilyProperties);
       *pQueueFamilyIndex = i;
       return (ERR_OK);
@@ -279,6 +279,37 @@ ErrVal getQueueFamilyIndexByCapability(uint32_t *pQueueFamilyIndex,
   return (ERR_NOTSUPPORTED);
 }
 
+ErrVal getTransferQueueFamilyIndex(uint32_t *pQueueFamilyIndex,
+                                   const VkPhysicalDevice device) {
+  uint32_t queueFamilyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, NULL);
+  VkQueueFamilyProperties *pFamilyProperties =
+      (VkQueueFamilyProperties *)malloc(queueFamilyCount *
+                                        sizeof(VkQueueFamilyProperties));
+  if (queueFamilyCount > 0 && !pFamilyProperties) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "Failed to get transfer queue index: %s",
+                   strerror(errno));
+    PANIC();
+  }
+  vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount,
+                                           pFamilyProperties);
+  for (uint32_t i = 0; i < queueFamilyCount; i++) {
+    VkQueueFlags flags = pFamilyProperties[i].queueFlags;
+    if (pFamilyProperties[i].queueCount > 0 &&
+        (flags & VK_QUEUE_TRANSFER_BIT) &&
+        !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+      free(pFamilyProperties);
+      *pQueueFamilyIndex = i;
+      return (ERR_OK);
+    }
+  }
+  free(pFamilyProperties);
+  /* No dedicated family, any graphics or compute family can transfer too */
+  LOG_ERROR(ERR_LEVEL_INFO, "no dedicated transfer queue, sharing one");
+  return (getQueueFamilyIndexByCapability(pQueueFamilyIndex, device,
+                                          VK_QUEUE_TRANSFER_BIT));
+}
+
 ErrVal getPresentQueueFamilyIndex(uint32_t *pQueueFamilyIndex,
                                   const VkPhysicalDevice physicalDevice,
                                   const VkSurfaceKHR surface) {
@@ -313,27 +344,78 @@ ErrVal getPresentQueueFamilyIndex(uint32_t *pQueueFamilyIndex,
 }
 
 ErrVal new_Device(VkDevice *pDevice, const VkPhysicalDevice physicalDevice,
-                  const uint32_t queueFamilyIndex,
+                  const uint32_t queueFamilyIndexCount,
+                  const uint32_t *pQueueFamilyIndices,
                   const uint32_t enabledExtensionCount,
                   const char *const *ppEnabledExtensionNames) {
+  /* uploads are tracked with timeline semaphores */
+  VkPhysicalDeviceVulkan12Features supportedFeatures12 = {0};
+  supportedFeatures12.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+  VkPhysicalDeviceFeatures2 supportedFeatures = {0};
+  supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  supportedFeatures.pNext = &supportedFeatures12;
+  vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures);
+  if (!supportedFeatures12.timelineSemaphore) {
+    LOG_ERROR(ERR_LEVEL_ERROR,
+              "Failed to create device: timeline semaphores not supported");
+    return (ERR_NOTSUPPORTED);
+  }
+
+  VkPhysicalDeviceVulkan12Features deviceFeatures12 = {0};
+  deviceFeatures12.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+  deviceFeatures12.timelineSemaphore = VK_TRUE;
   VkPhysicalDeviceFeatures deviceFeatures = {0};
-  VkDeviceQueueCreateInfo queueCreateInfo = {0};
-  queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-  queueCreateInfo.queueFamilyIndex = queueFamilyIndex;
-  queueCreateInfo.queueCount = 1;
+
+  /* optional, GPU culling draws with these when they are there */
+  deviceFeatures12.drawIndirectCount = supportedFeatures12.drawIndirectCount;
+  deviceFeatures.multiDrawIndirect =
+      supportedFeatures.features.multiDrawIndirect;
+  deviceFeatures.drawIndirectFirstInstance =
+      supportedFeatures.features.drawIndirectFirstInstance;
+
+  /* each family may only be listed once */
+  VkDeviceQueueCreateInfo *pQueueCreateInfos =
+      malloc(queueFamilyIndexCount * sizeof(VkDeviceQueueCreateInfo));
+  if (pQueueCreateInfos == NULL) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "Failed to create device: %s",
+                   strerror(errno));
+    PANIC();
+  }
   float queuePriority = 1.0f;
-  queueCreateInfo.pQueuePriorities = &queuePriority;
+  uint32_t queueCreateInfoCount = 0;
+  for (uint32_t i = 0; i < queueFamilyIndexCount; i++) {
+    bool duplicate = false;
+    for (uint32_t j = 0; j < queueCreateInfoCount; j++) {
+      if (pQueueCreateInfos[j].queueFamilyIndex == pQueueFamilyIndices[i]) {
+        duplicate = true;
+      }
+    }
+    if (duplicate) {
+      continue;
+    }
+    VkDeviceQueueCreateInfo queueCreateInfo = {0};
+    queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queueCreateInfo.queueFamilyIndex = pQueueFamilyIndices[i];
+    queueCreateInfo.queueCount = 1;
+    queueCreateInfo.pQueuePriorities = &queuePriority;
+    pQueueCreateInfos[queueCreateInfoCount] = queueCreateInfo;
+    queueCreateInfoCount++;
+  }
 
   VkDeviceCreateInfo createInfo = {0};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-  createInfo.pQueueCreateInfos = &queueCreateInfo;
-  createInfo.queueCreateInfoCount = 1;
+  createInfo.pNext = &deviceFeatures12;
+  createInfo.pQueueCreateInfos = pQueueCreateInfos;
+  createInfo.queueCreateInfoCount = queueCreateInfoCount;
   createInfo.pEnabledFeatures = &deviceFeatures;
   createInfo.enabledExtensionCount = enabledExtensionCount;
   createInfo.ppEnabledExtensionNames = ppEnabledExtensionNames;
   createInfo.enabledLayerCount = 0;
 
   VkResult res = vkCreateDevice(physicalDevice, &createInfo, NULL, pDevice);
+  free(pQueueCreateInfos);
   if (res != VK_SUCCESS) {
     LOG_ERROR_ARGS(ERR_LEVEL_ERROR, "Failed to create device, error code: %s",
                    vkstrerror(res));
@@ -348,23 +430,94 @@ ErrVal getQueue(VkQueue *pQueue, const VkDevice device,
   return (ERR_OK);
 }
 
+ErrVal getPresentMode(VkPresentModeKHR *pPresentMode,
+                      const VkPresentModeKHR preferredPresentMode,
+                      const VkPhysicalDevice physicalDevice,
+                      const VkSurfaceKHR surface) {
+  /* FIFO is the fallback, it's guaranteed to be available */
+  *pPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+  if (preferredPresentMode == VK_PRESENT_MODE_FIFO_KHR) {
+    return (ERR_OK);
+  }
+
+  uint32_t presentModeCount = 0;
+  vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface,
+                                            &presentModeCount, NULL);
+  VkPresentModeKHR *pPresentModes =
+      malloc(presentModeCount * sizeof(VkPresentModeKHR));
+  if (pPresentModes == NULL) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "could not get present modes: %s",
+                   strerror(errno));
+    PANIC();
+  }
+  vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface,
+                                            &presentModeCount, pPresentModes);
+
+  bool supported = false;
+  for (uint32_t i = 0; i < presentModeCount; i++) {
+    if (pPresentModes[i] == preferredPresentMode) {
+      supported = true;
+    }
+  }
+  free(pPresentModes);
+
+  if (!supported) {
+    LOG_ERROR_ARGS(ERR_LEVEL_WARN, "present mode %s not supported, using %s",
+                   getPresentModeName(preferredPresentMode),
+                   getPresentModeName(VK_PRESENT_MODE_FIFO_KHR));
+    return (ERR_NOTSUPPORTED);
+  }
+  *pPresentMode = preferredPresentMode;
+  return (ERR_OK);
+}
+
+const char *getPresentModeName(const VkPresentModeKHR presentMode) {
+  switch (presentMode) {
+  case VK_PRESENT_MODE_IMMEDIATE_KHR:
+    return ("immediate");
+  case VK_PRESENT_MODE_MAILBOX_KHR:
+    return ("mailbox");
+  case VK_PRESENT_MODE_FIFO_KHR:
+    return ("fifo");
+  case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+    return ("fifo_relaxed");
+  default:
+    return ("unknown");
+  }
+}
+
 ErrVal new_Swapchain(VkSwapchainKHR *pSwapchain, uint32_t *pImageCount,
                      const VkSwapchainKHR oldSwapchain,
                      const VkSurfaceFormatKHR surfaceFormat,
                      const VkPhysicalDevice physicalDevice,
                      const VkDevice device, const VkSurfaceKHR surface,
                      const VkExtent2D extent, const uint32_t graphicsIndex,
-                     const uint32_t presentIndex) {
+                     const uint32_t presentIndex,
+                     const VkPresentModeKHR presentMode,
+                     const uint32_t requestedImageCount) {
   VkSurfaceCapabilitiesKHR capabilities;
   vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface,
                                             &capabilities);
 
+  /* one more than the minimum unless asked otherwise, within the surface's
+   * limits (a maxImageCount of 0 means there is no maximum) */
+  uint32_t minImageCount = requestedImageCount == 0
+                               ? capabilities.minImageCount + 1
+                               : requestedImageCount;
+  if (minImageCount < capabilities.minImageCount) {
+    minImageCount = capabilities.minImageCount;
+  }
+  if (capabilities.maxImageCount != 0 &&
+      minImageCount > capabilities.maxImageCount) {
+    minImageCount = capabilities.maxImageCount;
+  }
+
   // it's important to note that minImageCount isn't necessarily the size of the
   // swapchain we get
   VkSwapchainCreateInfoKHR createInfo = {0};
   createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
   createInfo.surface = surface;
-  createInfo.minImageCount = capabilities.minImageCount + 1;
+  createInfo.minImageCount = minImageCount;
   createInfo.imageFormat = surfaceFormat.format;
   createInfo.imageColorSpace = surfaceFormat.colorSpace;
   createInfo.imageExtent = extent;
@@ -384,8 +537,7 @@ ErrVal new_Swapchain(VkSwapchainKHR *pSwapchain, uint32_t *pImageCount,
 
   createInfo.preTransform = capabilities.currentTransform;
   createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-  /* guaranteed to be available */
-  createInfo.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+  createInfo.presentMode = presentMode;
   createInfo.clipped = VK_TRUE;
   createInfo.oldSwapchain = oldSwapchain;
   VkResult res = vkCreateSwapchainKHR(device, &createInfo, NULL, pSwapchain);
@@ -571,7 +723,8 @@ void delete_ShaderModule(VkShaderModule *pShaderModule, const VkDevice device) {
 
 ErrVal new_VertexDisplayRenderPass(VkRenderPass *pRenderPass,
                                    const VkDevice device,
-                                   const VkFormat swapchainImageFormat) {
+                                   const VkFormat swapchainImageFormat,
+                                   const VkImageLayout finalLayout) {
   VkAttachmentDescription colorAttachment = {0};
   colorAttachment.format = swapchainImageFormat;
   colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -580,7 +733,7 @@ ErrVal new_VertexDisplayRenderPass(VkRenderPass *pRenderPass,
   colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
   colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
   colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  colorAttachment.finalLayout = finalLayout;
 
   VkAttachmentDescription depthAttachment = {0};
   getDepthFormat(&depthAttachment.format);
@@ -618,17 +771,36 @@ ErrVal new_VertexDisplayRenderPass(VkRenderPass *pRenderPass,
   renderPassInfo.subpassCount = 1;
   renderPassInfo.pSubpasses = &subpass;
 
-  VkSubpassDependency dependency = {0};
-  dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-  dependency.dstSubpass = 0;
-  dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-  dependency.srcAccessMask = 0;
-  dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-  dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
-                             VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-  renderPassInfo.dependencyCount = 1;
-  renderPassInfo.pDependencies = &dependency;
+  // every frame in flight shares the depth image, so a frame's depth clear
+  // has to wait for the depth tests of the frame before it
+  VkSubpassDependency pDependencies[2] = {{0}};
+  pDependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+  pDependencies[0].dstSubpass = 0;
+  pDependencies[0].srcStageMask =
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+      VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+      VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  pDependencies[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  pDependencies[0].dstStageMask =
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+      VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+      VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  pDependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+                                   VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                   VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+  // the image gets copied out once the pass ends, so the copy has to wait
+  // for the color writes
+  pDependencies[1].srcSubpass = 0;
+  pDependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+  pDependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  pDependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  pDependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+  pDependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+  renderPassInfo.dependencyCount =
+      finalLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL ? 2 : 1;
+  renderPassInfo.pDependencies = pDependencies;
 
   VkResult res = vkCreateRenderPass(device, &renderPassInfo, NULL, pRenderPass);
   if (res != VK_SUCCESS) {
@@ -644,48 +816,27 @@ void delete_RenderPass(VkRenderPass *pRenderPass, const VkDevice device) {
   *pRenderPass = VK_NULL_HANDLE;
 }
 
-ErrVal new_VertexDisplayPipelineLayout(VkPipelineLayout *pPipelineLayout,
-                                       const VkDevice device) {
-  VkPushConstantRange pushConstantRange = {0};
-  pushConstantRange.offset = 0;
-  pushConstantRange.size = sizeof(mat4x4);
-  pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-
-  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {0};
-  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-  pipelineLayoutInfo.setLayoutCount = 0;
-  pipelineLayoutInfo.pushConstantRangeCount = 1;
-  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
-  VkResult res = vkCreatePipelineLayout(device, &pipelineLayoutInfo, NULL,
-                                        pPipelineLayout);
-  if (res != VK_SUCCESS) {
-    LOG_ERROR_ARGS(ERR_LEVEL_FATAL,
-                   "failed to create pipeline layout with error: %s",
-                   vkstrerror(res));
-    PANIC();
-  }
-  return (ERR_OK);
-}
-
 void delete_PipelineLayout(VkPipelineLayout *pPipelineLayout,
                            const VkDevice device) {
   vkDestroyPipelineLayout(device, *pPipelineLayout, NULL);
   *pPipelineLayout = VK_NULL_HANDLE;
 }
 
-ErrVal new_VertexDisplayPipeline(VkPipeline *pGraphicsPipeline,
-                                 const VkDevice device,
-                                 const VkShaderModule vertShaderModule,
-                                 const VkShaderModule fragShaderModule,
-                                 const VkExtent2D extent,
-                                 const VkRenderPass renderPass,
-                                 const VkPipelineLayout pipelineLayout) {
+ErrVal new_SpecializedVertexDisplayPipeline(
+    VkPipeline *pGraphicsPipeline, const VkDevice device,
+    const VkPipelineCache pipelineCache, const VkShaderModule vertShaderModule,
+    const VkShaderModule fragShaderModule, const VkRenderPass renderPass,
+    const VkPipelineLayout pipelineLayout, const ShaderInterface *pInterface,
+    const VertexFormat vertexFormat, const bool instanced,
+    const VkSpecializationInfo *pVertSpecialization,
+    const VkSpecializationInfo *pFragSpecialization) {
   VkPipelineShaderStageCreateInfo vertShaderStageInfo = {0};
   vertShaderStageInfo.sType =
       VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
   vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
   vertShaderStageInfo.module = vertShaderModule;
   vertShaderStageInfo.pName = "main";
+  vertShaderStageInfo.pSpecializationInfo = pVertSpecialization;
 
   VkPipelineShaderStageCreateInfo fragShaderStageInfo = {0};
   fragShaderStageInfo.sType =
@@ -693,33 +844,93 @@ ErrVal new_VertexDisplayPipeline(VkPipeline *pGraphicsPipeline,
   fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
   fragShaderStageInfo.module = fragShaderModule;
   fragShaderStageInfo.pName = "main";
+  fragShaderStageInfo.pSpecializationInfo = pFragSpecialization;
 
   VkPipelineShaderStageCreateInfo shaderStages[2] = {vertShaderStageInfo,
                                                      fragShaderStageInfo};
 
+  VkVertexInputBindingDescription bindingDescriptions[2] = {0};
   VkVertexInputBindingDescription bindingDescription = {0};
   bindingDescription.binding = 0;
-  bindingDescription.stride = sizeof(Vertex);
   bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
-  VkVertexInputAttributeDescription attributeDescriptions[2];
+  // every attribute the buffers hold, the shader picks the ones it reads
+  VkVertexInputAttributeDescription pBufferAttributes[5];
 
-  attributeDescriptions[0].binding = 0;
-  attributeDescriptions[0].location = 0;
-  attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-  attributeDescriptions[0].offset = offsetof(Vertex, position);
+  pBufferAttributes[0].binding = 0;
+  pBufferAttributes[0].location = 0;
 
-  attributeDescriptions[1].binding = 0;
-  attributeDescriptions[1].location = 1;
-  attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-  attributeDescriptions[1].offset = offsetof(Vertex, color);
+  pBufferAttributes[1].binding = 0;
+  pBufferAttributes[1].location = 1;
+
+  // the shader reads vec3s either way, the fetch unit expands the packed
+  // formats to float and drops the extra component
+  switch (vertexFormat) {
+  case VERTEX_FORMAT_PACKED:
+    bindingDescription.stride = sizeof(PackedVertex);
+    pBufferAttributes[0].format = VK_FORMAT_R16G16B16A16_SNORM;
+    pBufferAttributes[0].offset = offsetof(PackedVertex, position);
+    pBufferAttributes[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+    pBufferAttributes[1].offset = offsetof(PackedVertex, color);
+    break;
+  case VERTEX_FORMAT_FLOAT:
+  default:
+    bindingDescription.stride = sizeof(Vertex);
+    pBufferAttributes[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+    pBufferAttributes[0].offset = offsetof(Vertex, position);
+    pBufferAttributes[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+    pBufferAttributes[1].offset = offsetof(Vertex, color);
+    break;
+  }
+  bindingDescriptions[0] = bindingDescription;
+  uint32_t bufferAttributeCount = 2;
+
+  if (instanced) {
+    // one row of the model matrix per location
+    bindingDescriptions[1].binding = 1;
+    bindingDescriptions[1].stride = sizeof(InstanceTransform);
+    bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+    for (uint32_t i = 0; i < 3; i++) {
+      pBufferAttributes[2 + i].binding = 1;
+      pBufferAttributes[2 + i].location = 2 + i;
+      pBufferAttributes[2 + i].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+      pBufferAttributes[2 + i].offset =
+          offsetof(InstanceTransform, rows) + i * sizeof(vec4);
+    }
+    bufferAttributeCount = 5;
+  }
+
+  VkVertexInputAttributeDescription
+      attributeDescriptions[SPIRV_REFLECTION_MAX_INPUTS];
+  uint32_t attributeCount = 0;
+  uint32_t bindingCount = 1;
+  for (uint32_t i = 0; i < pInterface->vertexInputCount; i++) {
+    const ReflectedVertexInput *pInput = &pInterface->pVertexInputs[i];
+    uint32_t j = 0;
+    while (j < bufferAttributeCount &&
+           pBufferAttributes[j].location != pInput->location) {
+      j++;
+    }
+    // the buffers only hold floats and normalized integers
+    if (j == bufferAttributeCount || !pInput->isFloat) {
+      LOG_ERROR_ARGS(ERR_LEVEL_ERROR,
+                     "vertex shader reads location %u, which the vertex "
+                     "buffers don't provide as floats",
+                     pInput->location);
+      return (ERR_BADARGS);
+    }
+    attributeDescriptions[attributeCount++] = pBufferAttributes[j];
+    if (pBufferAttributes[j].binding == 1) {
+      bindingCount = 2;
+    }
+  }
 
   VkPipelineVertexInputStateCreateInfo vertexInputInfo = {0};
   vertexInputInfo.sType =
       VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-  vertexInputInfo.vertexBindingDescriptionCount = 1;
-  vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-  vertexInputInfo.vertexAttributeDescriptionCount = 2;
+  vertexInputInfo.vertexBindingDescriptionCount = bindingCount;
+  vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions;
+  vertexInputInfo.vertexAttributeDescriptionCount = attributeCount;
   vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions;
 
   VkPipelineInputAssemblyStateCreateInfo inputAssembly = {0};
@@ -728,19 +939,6 @@ ErrVal new_VertexDisplayPipeline(VkPipeline *pGraphicsPipeline,
   inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
   inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-  VkViewport viewport = {0};
-  viewport.x = 0.0f;
-  viewport.y = 0.0f;
-  viewport.width = (float)extent.width;
-  viewport.height = (float)extent.height;
-  viewport.minDepth = 0.0f;
-  viewport.maxDepth = 1.0f;
-
-  VkRect2D scissor = {0};
-  scissor.offset.x = 0;
-  scissor.offset.y = 0;
-  scissor.extent = extent;
-
   VkPipelineDepthStencilStateCreateInfo depthStencil = {0};
   depthStencil.sType =
       VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
@@ -753,9 +951,17 @@ ErrVal new_VertexDisplayPipeline(VkPipeline *pGraphicsPipeline,
   VkPipelineViewportStateCreateInfo viewportState = {0};
   viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
   viewportState.viewportCount = 1;
-  viewportState.pViewports = &viewport;
+  viewportState.pViewports = NULL;
   viewportState.scissorCount = 1;
-  viewportState.pScissors = &scissor;
+  viewportState.pScissors = NULL;
+
+  /* Set when recording, so that resizing doesn't mean a new pipeline */
+  VkDynamicState pDynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT,
+                                     VK_DYNAMIC_STATE_SCISSOR};
+  VkPipelineDynamicStateCreateInfo dynamicState = {0};
+  dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamicState.dynamicStateCount = 2;
+  dynamicState.pDynamicStates = pDynamicStates;
 
   VkPipelineRasterizationStateCreateInfo rasterizer = {0};
   rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -802,19 +1008,50 @@ ErrVal new_VertexDisplayPipeline(VkPipeline *pGraphicsPipeline,
   pipelineInfo.pMultisampleState = &multisampling;
   pipelineInfo.pColorBlendState = &colorBlending;
   pipelineInfo.pDepthStencilState = &depthStencil;
+  pipelineInfo.pDynamicState = &dynamicState;
   pipelineInfo.layout = pipelineLayout;
   pipelineInfo.renderPass = renderPass;
   pipelineInfo.subpass = 0;
   pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-  if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, NULL,
-                                pGraphicsPipeline) != VK_SUCCESS) {
-    LOG_ERROR(ERR_LEVEL_FATAL, "failed to create graphics pipeline!");
-    PANIC();
+  VkResult res = vkCreateGraphicsPipelines(device, pipelineCache, 1,
+                                           &pipelineInfo, NULL,
+                                           pGraphicsPipeline);
+  if (res != VK_SUCCESS) {
+    LOG_ERROR_ARGS(ERR_LEVEL_ERROR, "failed to create graphics pipeline: %s",
+                   vkstrerror(res));
+    return (ERR_UNKNOWN);
   }
   return (ERR_OK);
 }
 
+ErrVal new_VertexDisplayPipeline(VkPipeline *pGraphicsPipeline,
+                                 const VkDevice device,
+                                 const VkPipelineCache pipelineCache,
+                                 const VkShaderModule vertShaderModule,
+                                 const VkShaderModule fragShaderModule,
+                                 const VkRenderPass renderPass,
+                                 const VkPipelineLayout pipelineLayout,
+                                 const ShaderInterface *pInterface,
+                                 const VertexFormat vertexFormat) {
+  return (new_SpecializedVertexDisplayPipeline(
+      pGraphicsPipeline, device, pipelineCache, vertShaderModule,
+      fragShaderModule, renderPass, pipelineLayout, pInterface, vertexFormat,
+      false, NULL, NULL));
+}
+
+ErrVal new_InstancedVertexDisplayPipeline(
+    VkPipeline *pGraphicsPipeline, const VkDevice device,
+    const VkPipelineCache pipelineCache, const VkShaderModule vertShaderModule,
+    const VkShaderModule fragShaderModule, const VkRenderPass renderPass,
+    const VkPipelineLayout pipelineLayout, const ShaderInterface *pInterface,
+    const VertexFormat vertexFormat) {
+  return (new_SpecializedVertexDisplayPipeline(
+      pGraphicsPipeline, device, pipelineCache, vertShaderModule,
+      fragShaderModule, renderPass, pipelineLayout, pInterface, vertexFormat,
+      true, NULL, NULL));
+}
+
 void delete_Pipeline(VkPipeline *pPipeline, const VkDevice device) {
   vkDestroyPipeline(device, *pPipeline, NULL);
 }
@@ -895,21 +1132,63 @@ void delete_CommandPool(VkCommandPool *pCommandPool, const VkDevice device) {
   vkDestroyCommandPool(device, *pCommandPool, NULL);
 }
 
-ErrVal recordVertexDisplayCommandBuffer(                //
-    VkCommandBuffer commandBuffer,                      //
-    const VkFramebuffer swapchainFramebuffer,           //
-    const VkBuffer vertexBuffer,                        //
-    const uint32_t vertexCount,                         //
-    const VkRenderPass renderPass,                      //
-    const VkPipelineLayout vertexDisplayPipelineLayout, //
-    const VkPipeline vertexDisplayPipeline,             //
-    const VkExtent2D swapchainExtent,                   //
-    const mat4x4 cameraTransform,                       //
-    const VkClearColorValue clearColor                  //
-) {
+void recordVertexDisplayBindings(VkCommandBuffer commandBuffer,
+                                 const VkPipelineLayout pipelineLayout,
+                                 const VkPipeline pipeline,
+                                 const VkExtent2D extent,
+                                 const mat4x4 cameraTransform,
+                                 const VkDescriptorSet cameraDescriptorSet,
+                                 const VkBuffer vertexBuffer,
+                                 const VkBuffer indexBuffer,
+                                 const VkBuffer instanceBuffer) {
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+  VkViewport viewport = {0};
+  viewport.x = 0.0f;
+  viewport.y = 0.0f;
+  viewport.width = (float)extent.width;
+  viewport.height = (float)extent.height;
+  viewport.minDepth = 0.0f;
+  viewport.maxDepth = 1.0f;
+  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+  VkRect2D scissor = {0};
+  scissor.offset.x = 0;
+  scissor.offset.y = 0;
+  scissor.extent = extent;
+  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+  if (cameraDescriptorSet != VK_NULL_HANDLE) {
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            pipelineLayout, 0, 1, &cameraDescriptorSet, 0,
+                            NULL);
+  } else {
+    vkCmdPushConstants(commandBuffer, pipelineLayout,
+                       VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(mat4x4),
+                       cameraTransform);
+  }
+
+  VkBuffer vertexBuffers[] = {vertexBuffer};
+  VkDeviceSize offsets[] = {0};
+  vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+  if (instanceBuffer != VK_NULL_HANDLE) {
+    vkCmdBindVertexBuffers(commandBuffer, 1, 1, &instanceBuffer, offsets);
+  }
+  vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+}
+
+ErrVal recordVertexDisplayCommandBuffer(VkCommandBuffer commandBuffer,
+                                        TransferQueue *pTransferQueue,
+                                        TransferTicket *pTransferWaitTicket,
+                                        const VertexDisplayFrame *pFrame) {
+  GpuProfiler *pProfiler = pFrame->pProfiler;
+
   VkCommandBufferBeginInfo beginInfo = {0};
   beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  // a buffer that reads the camera from memory is submitted again and again
+  if (pFrame->cameraDescriptorSet == VK_NULL_HANDLE) {
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  }
 
   VkResult beginRet = vkBeginCommandBuffer(commandBuffer, &beginInfo);
 
@@ -920,36 +1199,133 @@ ErrVal recordVertexDisplayCommandBuffer(                //
     PANIC();
   }
 
+  uint32_t frameScope = 0;
+  if (pProfiler != NULL) {
+    recordGpuProfilerReset(pProfiler, commandBuffer);
+    frameScope = beginGpuProfilerScope(
+        pProfiler, commandBuffer, getGpuProfilerScope(pProfiler, "frame"));
+  }
+
+  /* Take ownership of any finished uploads before the render pass reads them */
+  *pTransferWaitTicket = 0;
+  if (pTransferQueue != NULL) {
+    *pTransferWaitTicket =
+        recordTransferQueueAcquires(pTransferQueue, commandBuffer);
+  }
+
+  /* Culling has to be done before the render pass starts */
+  if (pFrame->pCuller != NULL) {
+    uint32_t cullScope = 0;
+    if (pProfiler != NULL) {
+      cullScope = beginGpuProfilerScope(
+          pProfiler, commandBuffer, getGpuProfilerScope(pProfiler, "cull"));
+    }
+    recordGpuCulling(pFrame->pCuller, commandBuffer);
+    if (pProfiler != NULL) {
+      endGpuProfilerScope(pProfiler, commandBuffer, cullScope);
+    }
+  }
+
   VkRenderPassBeginInfo renderPassInfo = {0};
   renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-  renderPassInfo.renderPass = renderPass;
-  renderPassInfo.framebuffer = swapchainFramebuffer;
+  renderPassInfo.renderPass = pFrame->renderPass;
+  renderPassInfo.framebuffer = pFrame->framebuffer;
   renderPassInfo.renderArea.offset = (VkOffset2D){0, 0};
-  renderPassInfo.renderArea.extent = swapchainExtent;
+  renderPassInfo.renderArea.extent = pFrame->extent;
 
   VkClearValue pClearColors[2];
-  pClearColors[0].color = clearColor;
+  pClearColors[0].color = pFrame->clearColor;
   pClearColors[1].depthStencil.depth = 1.0f;
   pClearColors[1].depthStencil.stencil = 0;
 
   renderPassInfo.clearValueCount = 2;
   renderPassInfo.pClearValues = pClearColors;
 
-  vkCmdBeginRenderPass(commandBuffer, &renderPassInfo,
-                       VK_SUBPASS_CONTENTS_INLINE);
-  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                    vertexDisplayPipeline);
-  vkCmdPushConstants(commandBuffer, vertexDisplayPipelineLayout,
-                     VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(mat4x4),
-                     cameraTransform);
-
-  VkBuffer vertexBuffers[] = {vertexBuffer};
-  VkDeviceSize offsets[] = {0};
-  vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-
-  vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
+  uint32_t renderPassScope = 0;
+  if (pProfiler != NULL) {
+    renderPassScope =
+        beginGpuProfilerScope(pProfiler, commandBuffer,
+                              getGpuProfilerScope(pProfiler, "render pass"));
+  }
+  if (pFrame->pRecorder != NULL) {
+    // the workers record the draws, the render pass only executes them
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo,
+                         VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    ParallelDrawJob job = {0};
+    job.renderPass = pFrame->renderPass;
+    job.framebuffer = pFrame->framebuffer;
+    job.pipelineLayout = pFrame->pipelineLayout;
+    job.pipeline = pFrame->pipeline;
+    job.extent = pFrame->extent;
+    job.vertexBuffer = pFrame->vertexBuffer;
+    job.indexBuffer = pFrame->indexBuffer;
+    job.indexCount = pFrame->indexCount;
+    job.instanceBuffer = pFrame->instanceBuffer;
+    job.drawCount = pFrame->instanceCount;
+    if (pFrame->pCpuCuller != NULL) {
+      job.drawCount = pFrame->pCpuCuller->visibleCount;
+      job.pInstances = pFrame->pCpuCuller->pVisible;
+    }
+    memcpy(job.transform, pFrame->cameraTransform, sizeof(mat4x4));
+    recordParallelDraws(pFrame->pRecorder, &job, commandBuffer);
+  } else {
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo,
+                         VK_SUBPASS_CONTENTS_INLINE);
+    recordVertexDisplayBindings(
+        commandBuffer, pFrame->pipelineLayout, pFrame->pipeline,
+        pFrame->extent, pFrame->cameraTransform, pFrame->cameraDescriptorSet,
+        pFrame->vertexBuffer, pFrame->indexBuffer, pFrame->instanceBuffer);
+    if (pFrame->pCuller != NULL) {
+      recordGpuCulledDraw(pFrame->pCuller, commandBuffer);
+    } else if (pFrame->pCpuCuller != NULL) {
+      recordCpuCulledDraws(pFrame->pCpuCuller, commandBuffer,
+                           pFrame->indexCount);
+    } else {
+      vkCmdDrawIndexed(commandBuffer, pFrame->indexCount,
+                       pFrame->instanceCount, 0, 0, 0);
+    }
+  }
   vkCmdEndRenderPass(commandBuffer);
 
+  if (pProfiler != NULL) {
+    endGpuProfilerScope(pProfiler, commandBuffer, renderPassScope);
+  }
+
+  /* The render pass' outgoing dependency orders this after the color writes */
+  if (pFrame->readbackBuffer != VK_NULL_HANDLE) {
+    VkBufferImageCopy region = {0};
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = (VkOffset3D){0, 0, 0};
+    region.imageExtent =
+        (VkExtent3D){pFrame->extent.width, pFrame->extent.height, 1};
+    vkCmdCopyImageToBuffer(commandBuffer, pFrame->readbackImage,
+                           VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           pFrame->readbackBuffer, 1, &region);
+
+    VkBufferMemoryBarrier barrier = {0};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = pFrame->readbackBuffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_HOST_BIT, 0, 0, NULL, 1, &barrier, 0,
+                         NULL);
+  }
+
+  if (pProfiler != NULL) {
+    endGpuProfilerScope(pProfiler, commandBuffer, frameScope);
+  }
+
   VkResult endCommandBufferRetVal = vkEndCommandBuffer(commandBuffer);
   if (endCommandBufferRetVal != VK_SUCCESS) {
     LOG_ERROR_ARGS(ERR_LEVEL_FATAL,
@@ -972,6 +1348,25 @@ ErrVal new_Semaphore(VkSemaphore *pSemaphore, const VkDevice device) {
   return (ERR_OK);
 }
 
+ErrVal new_TimelineSemaphore(VkSemaphore *pSemaphore, const VkDevice device,
+                             const uint64_t initialValue) {
+  VkSemaphoreTypeCreateInfo typeInfo = {0};
+  typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+  typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+  typeInfo.initialValue = initialValue;
+
+  VkSemaphoreCreateInfo semaphoreInfo = {0};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  semaphoreInfo.pNext = &typeInfo;
+  VkResult ret = vkCreateSemaphore(device, &semaphoreInfo, NULL, pSemaphore);
+  if (ret != VK_SUCCESS) {
+    LOG_ERROR_ARGS(ERR_LEVEL_ERROR, "failed to create timeline semaphore: %s",
+                   vkstrerror(ret));
+    return (ERR_UNKNOWN);
+  }
+  return (ERR_OK);
+}
+
 void delete_Semaphore(VkSemaphore *pSemaphore, const VkDevice device) {
   vkDestroySemaphore(device, *pSemaphore, NULL);
   *pSemaphore = VK_NULL_HANDLE;
@@ -1041,14 +1436,19 @@ void delete_Fences(VkFence *pFences, const uint32_t fenceCount,
   }
 }
 
-ErrVal waitAndResetFence(VkFence fence, const VkDevice device) {
-  // Wait for the current frame to finish processing
+ErrVal waitForFence(VkFence fence, const VkDevice device) {
   VkResult waitRet = vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
   if (waitRet != VK_SUCCESS) {
     LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "failed to wait for fence: %s",
                    vkstrerror(waitRet));
     PANIC();
   }
+  return (ERR_OK);
+}
+
+ErrVal waitAndResetFence(VkFence fence, const VkDevice device) {
+  // Wait for the current frame to finish processing
+  waitForFence(fence, device);
 
   // reset the fence
   VkResult resetRet = vkResetFences(device, 1, &fence);
@@ -1085,31 +1485,57 @@ ErrVal getNextSwapchainImage(           //
 }
 
 // Draws a frame to the surface provided, and sets things up for the next frame
-ErrVal drawFrame(                        //
-    VkCommandBuffer commandBuffer,       //
-    VkSwapchainKHR swapchain,            //
-    const uint32_t swapchainImageIndex,  //
-    VkSemaphore imageAvailableSemaphore, //
-    VkSemaphore renderFinishedSemaphore, //
-    VkFence inFlightFence,               //
-    const VkQueue graphicsQueue,         //
-    const VkQueue presentQueue           //
+ErrVal drawFrame(                             //
+    VkCommandBuffer commandBuffer,            //
+    VkSwapchainKHR swapchain,                 //
+    const uint32_t swapchainImageIndex,       //
+    VkSemaphore imageAvailableSemaphore,      //
+    VkSemaphore renderFinishedSemaphore,      //
+    VkFence inFlightFence,                    //
+    const TransferQueue *pTransferQueue,      //
+    const TransferTicket transferWaitTicket,  //
+    const VkQueue graphicsQueue,              //
+    const VkQueue presentQueue                //
 ) {
 
-  // Sets up for next frame
-  VkPipelineStageFlags waitStages[] = {
-      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+  // Sets up for next frame, without a swapchain there is no image to wait on
+  VkSemaphore waitSemaphores[2];
+  VkPipelineStageFlags waitStages[2];
+  // the value for the binary semaphore is ignored
+  uint64_t waitValues[2];
+  uint32_t waitSemaphoreCount = 0;
+  if (swapchain != VK_NULL_HANDLE) {
+    waitSemaphores[waitSemaphoreCount] = imageAvailableSemaphore;
+    waitStages[waitSemaphoreCount] =
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    waitValues[waitSemaphoreCount] = 0;
+    waitSemaphoreCount++;
+  }
+  if (pTransferQueue != NULL && transferWaitTicket != 0) {
+    waitSemaphores[waitSemaphoreCount] = pTransferQueue->timeline;
+    waitStages[waitSemaphoreCount] = pTransferQueue->dstStageMask;
+    waitValues[waitSemaphoreCount] = transferWaitTicket;
+    waitSemaphoreCount++;
+  }
+
+  VkTimelineSemaphoreSubmitInfo timelineInfo = {0};
+  timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+  timelineInfo.waitSemaphoreValueCount = waitSemaphoreCount;
+  timelineInfo.pWaitSemaphoreValues = waitValues;
 
   VkSubmitInfo submitInfo = {0};
   submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-  submitInfo.waitSemaphoreCount = 1;
-  submitInfo.pWaitSemaphores = &imageAvailableSemaphore;
+  submitInfo.pNext = &timelineInfo;
+  submitInfo.waitSemaphoreCount = waitSemaphoreCount;
+  submitInfo.pWaitSemaphores = waitSemaphores;
   submitInfo.pWaitDstStageMask = waitStages;
   submitInfo.commandBufferCount = 1;
   submitInfo.pCommandBuffers = &commandBuffer;
 
-  submitInfo.signalSemaphoreCount = 1;
-  submitInfo.pSignalSemaphores = &renderFinishedSemaphore;
+  if (swapchain != VK_NULL_HANDLE) {
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &renderFinishedSemaphore;
+  }
 
   VkResult queueSubmitResult =
       vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFence);
@@ -1119,6 +1545,10 @@ ErrVal drawFrame(                        //
     PANIC();
   }
 
+  if (swapchain == VK_NULL_HANDLE) {
+    return (ERR_OK);
+  }
+
   // Present frame to screen
   VkPresentInfoKHR presentInfo = {0};
   presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -1200,67 +1630,71 @@ ErrVal getMemoryTypeIndex(uint32_t *memoryTypeIndex,
   return (ERR_MEMORY);
 }
 
-ErrVal new_VertexBuffer(VkBuffer *pBuffer, VkDeviceMemory *pBufferMemory,
-                        const Vertex *pVertices, const uint32_t vertexCount,
-                        const VkDevice device,
-                        const VkPhysicalDevice physicalDevice,
-                        const VkCommandPool commandPool, const VkQueue queue) {
-  /* Construct staging buffers */
-  VkDeviceSize bufferSize = sizeof(Vertex) * vertexCount;
-  VkBuffer stagingBuffer;
-  VkDeviceMemory stagingBufferMemory;
-  ErrVal stagingBufferCreateResult = new_Buffer_DeviceMemory(
-      &stagingBuffer, &stagingBufferMemory, bufferSize, physicalDevice, device,
-      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-  if (stagingBufferCreateResult != ERR_OK) {
-    LOG_ERROR(
-        ERR_LEVEL_ERROR,
-        "failed to create vertex buffer: failed to create staging buffer");
-    return (stagingBufferCreateResult);
-  }
-
-  /* Copy data to staging buffer, making sure to clean up leaks */
-  ErrVal copyResult =
-      copyToDeviceMemory(&stagingBufferMemory, bufferSize, pVertices, device);
-  if (copyResult != ERR_OK) {
-    LOG_ERROR(ERR_LEVEL_ERROR,
-              "failed to create vertex buffer: could not map memory");
-    delete_Buffer(&stagingBuffer, device);
-    delete_DeviceMemory(&stagingBufferMemory, device);
-    return (copyResult);
-  }
+ErrVal new_VertexBuffer(VkBuffer *pBuffer, DeviceAllocation *pBufferAllocation,
+                        const void *pVertexData,
+                        const VkDeviceSize vertexDataSize,
+                        const VkDevice device, DeviceAllocator *pAllocator,
+                        TransferQueue *pTransferQueue) {
+  VkDeviceSize bufferSize = vertexDataSize;
 
   /* Create vertex buffer and allocate memory for it */
   ErrVal vertexBufferCreateResult = new_Buffer_DeviceMemory(
-      pBuffer, pBufferMemory, bufferSize, physicalDevice, device,
+      pBuffer, pBufferAllocation, bufferSize, pAllocator, device,
       VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-  /* Handle errors */
   if (vertexBufferCreateResult != ERR_OK) {
-    /* Delete the temporary staging buffers */
     LOG_ERROR(ERR_LEVEL_ERROR, "failed to create vertex buffer");
-    delete_Buffer(&stagingBuffer, device);
-    delete_DeviceMemory(&stagingBufferMemory, device);
     return (vertexBufferCreateResult);
   }
 
-  /* Copy the data over from the staging buffer to the vertex buffer */
-  copyBuffer(*pBuffer, stagingBuffer, bufferSize, commandPool, queue, device);
+  /* Stage the data, it gets copied with the next transfer batch */
+  ErrVal stageResult =
+      stageTransferUpload(pTransferQueue, *pBuffer, 0, pVertexData, bufferSize);
+  if (stageResult != ERR_OK) {
+    LOG_ERROR(ERR_LEVEL_ERROR,
+              "failed to create vertex buffer: could not stage upload");
+    delete_Buffer(pBuffer, device);
+    delete_DeviceMemory(pBufferAllocation, pAllocator);
+    return (stageResult);
+  }
+
+  return (ERR_OK);
+}
+
+ErrVal new_IndexBuffer(VkBuffer *pBuffer, DeviceAllocation *pBufferAllocation,
+                       const uint32_t *pIndices, const uint32_t indexCount,
+                       const VkDevice device, DeviceAllocator *pAllocator,
+                       TransferQueue *pTransferQueue) {
+  VkDeviceSize bufferSize = sizeof(uint32_t) * indexCount;
+
+  /* Create index buffer and allocate memory for it */
+  ErrVal indexBufferCreateResult = new_Buffer_DeviceMemory(
+      pBuffer, pBufferAllocation, bufferSize, pAllocator, device,
+      VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  if (indexBufferCreateResult != ERR_OK) {
+    LOG_ERROR(ERR_LEVEL_ERROR, "failed to create index buffer");
+    return (indexBufferCreateResult);
+  }
 
-  /* Delete the temporary staging buffers */
-  delete_Buffer(&stagingBuffer, device);
-  delete_DeviceMemory(&stagingBufferMemory, device);
+  /* Stage the data, it gets copied with the next transfer batch */
+  ErrVal stageResult =
+      stageTransferUpload(pTransferQueue, *pBuffer, 0, pIndices, bufferSize);
+  if (stageResult != ERR_OK) {
+    LOG_ERROR(ERR_LEVEL_ERROR,
+              "failed to create index buffer: could not stage upload");
+    delete_Buffer(pBuffer, device);
+    delete_DeviceMemory(pBufferAllocation, pAllocator);
+    return (stageResult);
+  }
 
   return (ERR_OK);
 }
 
-ErrVal new_Buffer_DeviceMemory(VkBuffer *pBuffer, VkDeviceMemory *pBufferMemory,
+ErrVal new_Buffer_DeviceMemory(VkBuffer *pBuffer,
+                               DeviceAllocation *pBufferAllocation,
                                const VkDeviceSize size,
-                               const VkPhysicalDevice physicalDevice,
+                               DeviceAllocator *pAllocator,
                                const VkDevice device,
                                const VkBufferUsageFlags usage,
                                const VkMemoryPropertyFlags properties) {
@@ -1281,104 +1715,38 @@ ErrVal new_Buffer_DeviceMemory(VkBuffer *pBuffer, VkDeviceMemory *pBufferMemory,
   VkMemoryRequirements memoryRequirements;
   vkGetBufferMemoryRequirements(device, *pBuffer, &memoryRequirements);
 
-  VkMemoryAllocateInfo allocateInfo = {0};
-  allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocateInfo.allocationSize = memoryRequirements.size;
-  /* Get the type of memory required, handle errors */
-  ErrVal getMemoryTypeRetVal = getMemoryTypeIndex(
-      &allocateInfo.memoryTypeIndex, memoryRequirements.memoryTypeBits,
-      properties, physicalDevice);
-  if (getMemoryTypeRetVal != ERR_OK) {
-    LOG_ERROR(ERR_LEVEL_ERROR, "failed to get type of memory to allocate");
-    return (ERR_MEMORY);
+  /* Carve the memory out of one of the allocator's blocks */
+  ErrVal allocateRetVal =
+      allocateDeviceMemory(pBufferAllocation, pAllocator, memoryRequirements,
+                           properties, DEVICE_ALLOCATION_KIND_LINEAR);
+  if (allocateRetVal != ERR_OK) {
+    LOG_ERROR(ERR_LEVEL_ERROR, "failed to allocate memory for buffer");
+    delete_Buffer(pBuffer, device);
+    return (allocateRetVal);
   }
 
-  /* Actually allocate memory */
-  VkResult memoryAllocateResult =
-      vkAllocateMemory(device, &allocateInfo, NULL, pBufferMemory);
-  if (memoryAllocateResult != VK_SUCCESS) {
-    LOG_ERROR_ARGS(ERR_LEVEL_ERROR, "failed to allocate memory for buffer: %s",
-                   vkstrerror(memoryAllocateResult));
-    return (ERR_ALLOCFAIL);
+  VkResult bindResult =
+      vkBindBufferMemory(device, *pBuffer, pBufferAllocation->memory,
+                         pBufferAllocation->offset);
+  if (bindResult != VK_SUCCESS) {
+    LOG_ERROR_ARGS(ERR_LEVEL_ERROR, "failed to bind buffer memory: %s",
+                   vkstrerror(bindResult));
+    delete_Buffer(pBuffer, device);
+    delete_DeviceMemory(pBufferAllocation, pAllocator);
+    return (ERR_UNKNOWN);
   }
-  vkBindBufferMemory(device, *pBuffer, *pBufferMemory, 0);
   return (ERR_OK);
 }
 
 // submits a copy to the queue, you'll later need to wait for idle
-ErrVal copyBuffer(VkBuffer destinationBuffer, const VkBuffer sourceBuffer,
-                  const VkDeviceSize size, const VkCommandPool commandPool,
-                  const VkQueue queue, const VkDevice device) {
-  VkCommandBuffer copyCommandBuffer;
-  ErrVal createResult =
-      new_CommandBuffers(&copyCommandBuffer, 1, commandPool, device);
-  if (createResult != ERR_OK) {
-  }
-
-  VkCommandBufferBeginInfo beginInfo = {0};
-  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-
-  VkResult beginRet = vkBeginCommandBuffer(copyCommandBuffer, &beginInfo);
-  if (beginRet != VK_SUCCESS) {
-    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "Failed to begin copy command buffer: %s",
-                   vkstrerror(beginRet));
-    PANIC();
-  }
-
-  VkBufferCopy copyRegion = {.size = size, .srcOffset = 0, .dstOffset = 0};
-  vkCmdCopyBuffer(copyCommandBuffer, sourceBuffer, destinationBuffer, 1,
-                  &copyRegion);
-
-  // End buffer
-  VkResult bufferEndResult = vkEndCommandBuffer(copyCommandBuffer);
-  if (bufferEndResult != VK_SUCCESS) {
-    /* Clean up resources */
-    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "failed to end command buffer: %s",
-                   vkstrerror(bufferEndResult));
-    PANIC();
-  }
-
-  // wait for completion with a fence
-  VkFence fence;
-  if (new_Fence(&fence, device, false) != ERR_OK) {
-    LOG_ERROR(ERR_LEVEL_FATAL, "Failed to make copy fence");
-    PANIC();
-  }
-
-  VkSubmitInfo submitInfo = {0};
-  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-  submitInfo.commandBufferCount = 1;
-  submitInfo.pCommandBuffers = &copyCommandBuffer;
-
-  VkResult queueSubmitResult = vkQueueSubmit(queue, 1, &submitInfo, fence);
-  if (queueSubmitResult != VK_SUCCESS) {
-    LOG_ERROR_ARGS(ERR_LEVEL_FATAL,
-                   "failed to submit command buffer to queue: %s",
-                   vkstrerror(queueSubmitResult));
-    PANIC();
-  }
-
-  VkResult waitRet = vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
-  if (waitRet != VK_SUCCESS) {
-    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "failed to wait for fence: %s",
-                   vkstrerror(waitRet));
-    PANIC();
-  }
-
-  delete_Fence(&fence, device);
-
-  return (ERR_OK);
-}
-
 void delete_Buffer(VkBuffer *pBuffer, const VkDevice device) {
   vkDestroyBuffer(device, *pBuffer, NULL);
   *pBuffer = VK_NULL_HANDLE;
 }
 
-void delete_DeviceMemory(VkDeviceMemory *pDeviceMemory, const VkDevice device) {
-  vkFreeMemory(device, *pDeviceMemory, NULL);
-  *pDeviceMemory = VK_NULL_HANDLE;
+void delete_DeviceMemory(DeviceAllocation *pAllocation,
+                         DeviceAllocator *pAllocator) {
+  freeDeviceMemory(pAllocation, pAllocator);
 }
 
 // creates a command buffer that hasn't yet been begun
@@ -1418,37 +1786,29 @@ void delete_CommandBuffers(            //
   }
 }
 
-ErrVal copyToDeviceMemory(VkDeviceMemory *pDeviceMemory,
+ErrVal copyToDeviceMemory(const DeviceAllocation *pAllocation,
                           const VkDeviceSize deviceSize, const void *source,
-                          const VkDevice device) {
-  void *data;
-  VkResult mapMemoryResult =
-      vkMapMemory(device, *pDeviceMemory, 0, deviceSize, 0, &data);
-
-  /* On failure */
-  if (mapMemoryResult != VK_SUCCESS) {
-    LOG_ERROR_ARGS(ERR_LEVEL_ERROR,
-                   "failed to copy to device memory: failed to map memory: %s",
-                   vkstrerror(mapMemoryResult));
+                          const DeviceAllocator *pAllocator) {
+  /* Host visible allocations stay mapped for their whole lifetime */
+  if (pAllocation->pMapped == NULL) {
+    LOG_ERROR(ERR_LEVEL_ERROR,
+              "failed to copy to device memory: memory is not host visible");
     return (ERR_MEMORY);
   }
 
-  /* If it was successful, go on and actually copy it, making sure to unmap once
-   * done */
-  memcpy(data, source, (size_t)deviceSize);
-  vkUnmapMemory(device, *pDeviceMemory);
-  return (ERR_OK);
+  memcpy(pAllocation->pMapped, source, (size_t)deviceSize);
+  return (flushDeviceMemory(pAllocation, pAllocator));
 }
 
 ErrVal new_Image(                           //
     VkImage *pImage,                        //
-    VkDeviceMemory *pImageMemory,           //
+    DeviceAllocation *pImageAllocation,     //
     const VkExtent2D dimensions,            //
     const VkFormat format,                  //
     const VkImageTiling tiling,             //
     const VkImageUsageFlags usage,          //
     const VkMemoryPropertyFlags properties, //
-    const VkPhysicalDevice physicalDevice,  //
+    DeviceAllocator *pAllocator,            //
     const VkDevice device                   //
 ) {
   VkImageCreateInfo imageInfo = {0};
@@ -1476,31 +1836,26 @@ ErrVal new_Image(                           //
   VkMemoryRequirements memRequirements;
   vkGetImageMemoryRequirements(device, *pImage, &memRequirements);
 
-  VkMemoryAllocateInfo allocInfo = {0};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-
-  ErrVal memGetResult = getMemoryTypeIndex(&allocInfo.memoryTypeIndex,
-                                           memRequirements.memoryTypeBits,
-                                           properties, physicalDevice);
-
-  if (memGetResult != ERR_OK) {
+  /* linear images may share a granularity page with buffers, optimal ones may
+   * not */
+  DeviceAllocationKind kind = tiling == VK_IMAGE_TILING_LINEAR
+                                  ? DEVICE_ALLOCATION_KIND_LINEAR
+                                  : DEVICE_ALLOCATION_KIND_OPTIMAL;
+  ErrVal allocateResult = allocateDeviceMemory(
+      pImageAllocation, pAllocator, memRequirements, properties, kind);
+  if (allocateResult != ERR_OK) {
     LOG_ERROR(ERR_LEVEL_ERROR, "failed to create image: allocation failed");
-    return (ERR_MEMORY);
+    delete_Image(pImage, device);
+    return (allocateResult);
   }
 
-  VkResult allocateResult =
-      vkAllocateMemory(device, &allocInfo, NULL, pImageMemory);
-  if (allocateResult != VK_SUCCESS) {
-    LOG_ERROR_ARGS(ERR_LEVEL_ERROR, "failed to create image: %s",
-                   vkstrerror(allocateResult));
-    return (ERR_MEMORY);
-  }
-
-  VkResult bindResult = vkBindImageMemory(device, *pImage, *pImageMemory, 0);
+  VkResult bindResult = vkBindImageMemory(
+      device, *pImage, pImageAllocation->memory, pImageAllocation->offset);
   if (bindResult != VK_SUCCESS) {
     LOG_ERROR_ARGS(ERR_LEVEL_ERROR, "failed to create image: %s",
                    vkstrerror(bindResult));
+    delete_Image(pImage, device);
+    delete_DeviceMemory(pImageAllocation, pAllocator);
     return (ERR_UNKNOWN);
   }
   return (ERR_OK);
@@ -1508,6 +1863,7 @@ ErrVal new_Image(                           //
 
 void delete_Image(VkImage *pImage, const VkDevice device) {
   vkDestroyImage(device, *pImage, NULL);
+  *pImage = VK_NULL_HANDLE;
 }
 
 /* Gets image format of depth */
@@ -1516,16 +1872,15 @@ void getDepthFormat(VkFormat *pFormat) {
   *pFormat = VK_FORMAT_D32_SFLOAT;
 }
 
-ErrVal new_DepthImage(VkImage *pImage, VkDeviceMemory *pImageMemory,
+ErrVal new_DepthImage(VkImage *pImage, DeviceAllocation *pImageAllocation,
                       const VkExtent2D swapchainExtent,
-                      const VkPhysicalDevice physicalDevice,
-                      const VkDevice device) {
+                      DeviceAllocator *pAllocator, const VkDevice device) {
   VkFormat depthFormat = {0};
   getDepthFormat(&depthFormat);
   ErrVal retVal = new_Image(
-      pImage, pImageMemory, swapchainExtent, depthFormat,
+      pImage, pImageAllocation, swapchainExtent, depthFormat,
       VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, physicalDevice, device);
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, pAllocator, device);
   if (retVal != ERR_OK) {
     LOG_ERROR(ERR_LEVEL_ERROR, "failed to create depth image");
     return (retVal);
@@ -1549,6 +1904,7 @@ ErrVal new_DepthImageView(VkImageView *pImageView, const VkDevice device,
 ErrVal new_ComputePipeline(VkPipeline *pPipeline,
                            const VkPipelineLayout pipelineLayout,
                            const VkShaderModule shaderModule,
+                           const VkPipelineCache pipelineCache,
                            const VkDevice device) {
 
   VkPipelineShaderStageCreateInfo shaderStageCreateInfo = {0};
@@ -1565,7 +1921,7 @@ ErrVal new_ComputePipeline(VkPipeline *pPipeline,
   computePipelineCreateInfo.stage = shaderStageCreateInfo;
 
   VkResult ret = vkCreateComputePipelines(
-      device, VK_NULL_HANDLE, 1, &computePipelineCreateInfo, NULL, pPipeline);
+      device, pipelineCache, 1, &computePipelineCreateInfo, NULL, pPipeline);
   if (ret != VK_SUCCESS) {
     LOG_ERROR_ARGS(ERR_LEVEL_ERROR, "failed to create compute pipelines %s",
                    vkstrerror(ret));
@@ -1574,20 +1930,59 @@ ErrVal new_ComputePipeline(VkPipeline *pPipeline,
   return (ERR_OK);
 }
 
+ErrVal new_ComputePipelineLayout(
+    VkPipelineLayout *pPipelineLayout,
+    const VkDescriptorSetLayout descriptorSetLayout,
+    const uint32_t pushConstantSize, const VkDevice device) {
+  VkPushConstantRange pushConstantRange = {0};
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = pushConstantSize;
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {0};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = pushConstantSize == 0 ? 0 : 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+  VkResult res = vkCreatePipelineLayout(device, &pipelineLayoutInfo, NULL,
+                                        pPipelineLayout);
+  if (res != VK_SUCCESS) {
+    LOG_ERROR_ARGS(ERR_LEVEL_ERROR,
+                   "failed to create compute pipeline layout: %s",
+                   vkstrerror(res));
+    return (ERR_UNKNOWN);
+  }
+  return (ERR_OK);
+}
+
 ErrVal new_ComputeStorageDescriptorSetLayout(
-    VkDescriptorSetLayout *pDescriptorSetLayout, const VkDevice device) {
-  VkDescriptorSetLayoutBinding storageLayoutBinding = {0};
-  storageLayoutBinding.binding = 0;
-  storageLayoutBinding.descriptorCount = 1;
-  storageLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-  storageLayoutBinding.pImmutableSamplers = NULL;
-  storageLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    VkDescriptorSetLayout *pDescriptorSetLayout, const uint32_t bindingCount,
+    const VkDevice device) {
+  VkDescriptorSetLayoutBinding *pStorageLayoutBindings =
+      malloc(bindingCount * sizeof(VkDescriptorSetLayoutBinding));
+  if (pStorageLayoutBindings == NULL) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL,
+                   "failed to create descriptor set layout: %s",
+                   strerror(errno));
+    PANIC();
+  }
+  for (uint32_t i = 0; i < bindingCount; i++) {
+    VkDescriptorSetLayoutBinding storageLayoutBinding = {0};
+    storageLayoutBinding.binding = i;
+    storageLayoutBinding.descriptorCount = 1;
+    storageLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    storageLayoutBinding.pImmutableSamplers = NULL;
+    storageLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pStorageLayoutBindings[i] = storageLayoutBinding;
+  }
   VkDescriptorSetLayoutCreateInfo layoutInfo = {0};
   layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-  layoutInfo.bindingCount = 1;
-  layoutInfo.pBindings = &storageLayoutBinding;
+  layoutInfo.bindingCount = bindingCount;
+  layoutInfo.pBindings = pStorageLayoutBindings;
   VkResult retVal = vkCreateDescriptorSetLayout(device, &layoutInfo, NULL,
                                                 pDescriptorSetLayout);
+  free(pStorageLayoutBindings);
   if (retVal != VK_SUCCESS) {
     LOG_ERROR_ARGS(ERR_LEVEL_ERROR,
                    "failed to create descriptor set layout: %s",
@@ -1636,8 +2031,8 @@ void delete_DescriptorPool(VkDescriptorPool *pDescriptorPool,
 }
 
 ErrVal new_ComputeBufferDescriptorSet(
-    VkDescriptorSet *pDescriptorSet, const VkBuffer computeBufferDescriptorSet,
-    const VkDeviceSize computeBufferSize,
+    VkDescriptorSet *pDescriptorSet, const uint32_t bufferCount,
+    const VkBuffer *pComputeBuffers,
     const VkDescriptorSetLayout descriptorSetLayout,
     const VkDescriptorPool descriptorPool, const VkDevice device) {
 
@@ -1654,22 +2049,75 @@ ErrVal new_ComputeBufferDescriptorSet(
     return (ERR_MEMORY);
   }
 
+  VkDescriptorBufferInfo *pBufferInfos =
+      malloc(bufferCount * sizeof(VkDescriptorBufferInfo));
+  VkWriteDescriptorSet *pDescriptorWrites =
+      malloc(bufferCount * sizeof(VkWriteDescriptorSet));
+  if (pBufferInfos == NULL || pDescriptorWrites == NULL) {
+    LOG_ERROR_ARGS(ERR_LEVEL_FATAL, "failed to write descriptor set: %s",
+                   strerror(errno));
+    PANIC();
+  }
+
+  /* buffer i goes to binding i */
+  for (uint32_t i = 0; i < bufferCount; i++) {
+    VkDescriptorBufferInfo bufferInfo = {0};
+    bufferInfo.buffer = pComputeBuffers[i];
+    bufferInfo.range = VK_WHOLE_SIZE;
+    bufferInfo.offset = 0;
+    pBufferInfos[i] = bufferInfo;
+
+    VkWriteDescriptorSet descriptorWrites = {0};
+    descriptorWrites.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrites.dstSet = *pDescriptorSet;
+    descriptorWrites.dstBinding = i;
+    descriptorWrites.dstArrayElement = 0;
+    descriptorWrites.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorWrites.descriptorCount = 1;
+    descriptorWrites.pBufferInfo = &pBufferInfos[i];
+    descriptorWrites.pImageInfo = NULL;
+    descriptorWrites.pTexelBufferView = NULL;
+    pDescriptorWrites[i] = descriptorWrites;
+  }
+  vkUpdateDescriptorSets(device, bufferCount, pDescriptorWrites, 0, NULL);
+  free(pDescriptorWrites);
+  free(pBufferInfos);
+  return (ERR_OK);
+}
+
+ErrVal new_UniformBufferDescriptorSet(
+    VkDescriptorSet *pDescriptorSet, const VkBuffer uniformBuffer,
+    const VkDescriptorSetLayout descriptorSetLayout,
+    const VkDescriptorPool descriptorPool, const VkDevice device) {
+  VkDescriptorSetAllocateInfo allocateInfo = {0};
+  allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocateInfo.descriptorPool = descriptorPool;
+  allocateInfo.descriptorSetCount = 1;
+  allocateInfo.pSetLayouts = &descriptorSetLayout;
+  VkResult allocateDescriptorSetRetVal =
+      vkAllocateDescriptorSets(device, &allocateInfo, pDescriptorSet);
+  if (allocateDescriptorSetRetVal != VK_SUCCESS) {
+    LOG_ERROR_ARGS(ERR_LEVEL_ERROR, "failed to allocate descriptor sets: %s",
+                   vkstrerror(allocateDescriptorSetRetVal));
+    return (ERR_MEMORY);
+  }
+
   VkDescriptorBufferInfo bufferInfo = {0};
-  bufferInfo.buffer = computeBufferDescriptorSet;
-  bufferInfo.range = computeBufferSize;
+  bufferInfo.buffer = uniformBuffer;
+  bufferInfo.range = VK_WHOLE_SIZE;
   bufferInfo.offset = 0;
 
-  VkWriteDescriptorSet descriptorWrites = {0};
-  descriptorWrites.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-  descriptorWrites.dstSet = *pDescriptorSet;
-  descriptorWrites.dstBinding = 0;
-  descriptorWrites.dstArrayElement = 0;
-  descriptorWrites.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-  descriptorWrites.descriptorCount = 1;
-  descriptorWrites.pBufferInfo = &bufferInfo;
-  descriptorWrites.pImageInfo = NULL;
-  descriptorWrites.pTexelBufferView = NULL;
-  vkUpdateDescriptorSets(device, 1, &descriptorWrites, 0, NULL);
+  VkWriteDescriptorSet descriptorWrite = {0};
+  descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  descriptorWrite.dstSet = *pDescriptorSet;
+  descriptorWrite.dstBinding = 0;
+  descriptorWrite.dstArrayElement = 0;
+  descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  descriptorWrite.descriptorCount = 1;
+  descriptorWrite.pBufferInfo = &bufferInfo;
+  descriptorWrite.pImageInfo = NULL;
+  descriptorWrite.pTexelBufferView = NULL;
+  vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, NULL);
   return (ERR_OK);
 }
 
@@ -19,13 +19,40 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include "cpu_culling.h"
 #include "errors.h"
+#include "gpu_culling.h"
+#include "gpu_profiler.h"
+#include "memory_allocator.h"
+#include "parallel_recorder.h"
+#include "spirv_reflection.h"
+#include "transfer_queue.h"
 
 typedef struct {
   vec3 position;
   vec3 color;
 } Vertex;
 
+// A Vertex quantized against the bounds of its mesh, 12 bytes instead of 24
+// position is snorm16 relative to the bounds, the w component is padding
+// color is unorm8 RGBA
+typedef struct {
+  int16_t position[4];
+  uint8_t color[4];
+} PackedVertex;
+
+// Per instance data read by the instanced vertex display pipeline: the top
+// three rows of an affine model matrix
+typedef struct {
+  vec4 rows[3];
+} InstanceTransform;
+
+// The vertex layouts new_VertexDisplayPipeline can read
+typedef enum {
+  VERTEX_FORMAT_FLOAT = 0,
+  VERTEX_FORMAT_PACKED = 1,
+} VertexFormat;
+
 /// Creates a new VkInstance with the specified extensions and layers
 /// --- PRECONDITIONS ---
 /// * `ppEnabledExtensionNames` must be a pointer to at least
@@ -124,18 +151,24 @@ ErrVal getPhysicalDevice(VkPhysicalDevice *pDevice, const VkInstance instance);
 /// --- PRECONDITIONS ---
 /// * `pDevice` must be a valid pointer
 /// * `physicalDevice` must be a valid physical device created from
-/// * `getPhysicalDevice` `queueFamilyIndex` must be the index of the queue
-/// family to use `ppEnabledExtensionNames` must be a pointer to at least
-/// * `enabledExtensionCount` extensions
+/// `getPhysicalDevice`
+/// * `pQueueFamilyIndices` must be a pointer to at least
+/// `queueFamilyIndexCount` indices of queue families to use, duplicates are
+/// allowed
+/// * `ppEnabledExtensionNames` must be a pointer to at least
+/// `enabledExtensionCount` extensions
 /// --- POSTCONDITIONS ---
-/// returns error status
-/// on success, `*pDevice` will be a new logical device
+/// * returns error status
+/// * returns ERR_NOTSUPPORTED if `physicalDevice` lacks timeline semaphores
+/// * on success, `*pDevice` will be a new logical device with one queue from
+/// each of the given families, and timeline semaphores enabled
 /// --- CLEANUP ---
 /// call delete_Device
 ErrVal new_Device(                             //
     VkDevice *pDevice,                         //
     const VkPhysicalDevice physicalDevice,     //
-    const uint32_t queueFamilyIndex,           //
+    const uint32_t queueFamilyIndexCount,      //
+    const uint32_t *pQueueFamilyIndices,       //
     const uint32_t enabledExtensionCount,      //
     const char *const *ppEnabledExtensionNames //
 );
@@ -155,13 +188,27 @@ void delete_Device(VkDevice *pDevice);
 /// `device` must be created by getPhysicalDevice
 /// --- POSTCONDITIONS ---
 /// sets `*pQueueFamilyIndex` contains the index of the first queue family
-/// supporting `bit`
+/// supporting every capability in `bit`
 ErrVal getQueueFamilyIndexByCapability( //
     uint32_t *pQueueFamilyIndex,        //
     const VkPhysicalDevice device,      //
     const VkQueueFlags bit              //
 );
 
+/// Gets the queue family index best suited to asynchronous uploads
+/// --- PRECONDITIONS ---
+/// * `pQueueFamilyIndex` must be a valid pointer
+/// * `device` must be created by getPhysicalDevice
+/// --- POSTCONDITIONS ---
+/// * returns error status
+/// * on success, `*pQueueFamilyIndex` is a family supporting transfers,
+/// preferring one without graphics or compute so that its copies run on the
+/// DMA engines alongside rendering
+ErrVal getTransferQueueFamilyIndex(  //
+    uint32_t *pQueueFamilyIndex,     //
+    const VkPhysicalDevice device    //
+);
+
 /// Gets the first queue family index which can support rendering to `surface`
 /// --- PRECONDITIONS ---
 /// * `pQueueFamilyIndex` must be a valid pointer
@@ -204,6 +251,22 @@ ErrVal getPreferredSurfaceFormat(VkSurfaceFormatKHR *pSurfaceFormat,
                                  const VkPhysicalDevice physicalDevice,
                                  const VkSurfaceKHR surface);
 
+/// Picks the present mode a swapchain is created with
+/// --- PRECONDITIONS ---
+/// * `surface` has been allocated from the same instance as `physicalDevice`
+/// --- POSTCONDITIONS ---
+/// * returns error status
+/// * `*pPresentMode` is `preferredPresentMode` if `surface` supports it
+/// * otherwise returns ERR_NOTSUPPORTED and `*pPresentMode` is
+/// VK_PRESENT_MODE_FIFO_KHR, which every surface supports
+ErrVal getPresentMode(VkPresentModeKHR *pPresentMode,
+                      const VkPresentModeKHR preferredPresentMode,
+                      const VkPhysicalDevice physicalDevice,
+                      const VkSurfaceKHR surface);
+
+/// Returns a short lowercase name for `presentMode`, e.g. "mailbox"
+const char *getPresentModeName(const VkPresentModeKHR presentMode);
+
 /// Creates a new swapchain, possibly reusing the old one
 /// --- PRECONDITIONS ---
 /// * All vulkan objects come from the same instance
@@ -218,11 +281,15 @@ ErrVal getPreferredSurfaceFormat(VkSurfaceFormatKHR *pSurfaceFormat,
 /// * `extent` is the current extent of `surface`
 /// * `graphicsIndex` is the queue family index for graphics operations
 /// * `presentIndex` is the queue family index to submit present operations
+/// * `presentMode` is from getPresentMode
+/// * `requestedImageCount` is the number of images to ask for, or 0 for one
+/// more than the surface's minimum
 /// --- POSTCONDITIONS ---
 /// * returns error status
 /// * on success, `*pSwapchain` is set to a new swapchain
 /// * on success, `*pSwapchainImageCount` is set to the number of images in the
-/// swapchain
+/// swapchain, which may differ from `requestedImageCount`, as the request is
+/// clamped to what the surface allows and the driver may add more
 /// --- CLEANUP ---
 /// * call `delete_Swapchain` to free resources associated with this swapchain
 ErrVal new_Swapchain(                       //
@@ -235,7 +302,9 @@ ErrVal new_Swapchain(                       //
     const VkSurfaceKHR surface,             //
     const VkExtent2D extent,                //
     const uint32_t graphicsIndex,           //
-    const uint32_t presentIndex             //
+    const uint32_t presentIndex,            //
+    const VkPresentModeKHR presentMode,     //
+    const uint32_t requestedImageCount      //
 );
 
 /// Deletes a swapchain created from new_Swapchain
@@ -259,15 +328,24 @@ ErrVal getSwapchainImages(         //
     const VkSwapchainKHR swapchain //
 );
 
+/// Creates a 2D image and binds it to memory carved out of `pAllocator`
+/// --- PRECONDITIONS ---
+/// * `pImage` and `pImageAllocation` are valid pointers
+/// * `pAllocator` was created for `device`
+/// --- POSTCONDITIONS ---
+/// * returns error status
+/// * on success, `*pImage` is bound to `*pImageAllocation`
+/// --- CLEANUP ---
+/// * call delete_Image, then delete_DeviceMemory on the allocation
 ErrVal new_Image(                           //
     VkImage *pImage,                        //
-    VkDeviceMemory *pImageMemory,           //
+    DeviceAllocation *pImageAllocation,     //
     const VkExtent2D dimensions,            //
     const VkFormat format,                  //
     const VkImageTiling tiling,             //
     const VkImageUsageFlags usage,          //
     const VkMemoryPropertyFlags properties, //
-    const VkPhysicalDevice physicalDevice,  //
+    DeviceAllocator *pAllocator,            //
     const VkDevice device                   //
 );
 
@@ -329,25 +407,83 @@ ErrVal new_ShaderModule(VkShaderModule *pShaderModule, const VkDevice device,
 /// * `*pShaderModule` is set to VK_NULL_HANDLE
 void delete_ShaderModule(VkShaderModule *pShaderModule, const VkDevice device);
 
+/// Creates the render pass that draws into a color and a depth attachment
+/// --- POSTCONDITIONS ---
+/// * returns error status
+/// * the color attachment ends in `finalLayout`, either
+/// VK_IMAGE_LAYOUT_PRESENT_SRC_KHR to present it, or
+/// VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL to copy it out after the pass
 ErrVal new_VertexDisplayRenderPass(VkRenderPass *pRenderPass,
                                    const VkDevice device,
-                                   const VkFormat swapchainImageFormat);
+                                   const VkFormat swapchainImageFormat,
+                                   const VkImageLayout finalLayout);
 
 void delete_RenderPass(VkRenderPass *pRenderPass, const VkDevice device);
 
-ErrVal new_VertexDisplayPipelineLayout(VkPipelineLayout *pPipelineLayout,
-                                       const VkDevice device);
-
 void delete_PipelineLayout(VkPipelineLayout *pPipelineLayout,
                            const VkDevice device);
 
+/// Creates the pipeline that draws vertex buffers
+/// --- PRECONDITIONS ---
+/// * `pipelineCache` is VK_NULL_HANDLE or a cache created for `device`
+/// * `vertexFormat` is the layout of the vertex buffers it will draw, either
+/// Vertex or PackedVertex
+/// * `pInterface` is the merged interface of both shaders, and
+/// `pipelineLayout` was built from it, see getReflectedPipelineLayout
+/// --- POSTCONDITIONS ---
+/// * returns error status, ERR_BADARGS if the vertex shader reads a location
+/// the vertex buffers don't hold
+/// * only the attributes the vertex shader reads are fetched
+/// * with VERTEX_FORMAT_PACKED, positions reach the shader in [-1, 1] and
+/// the dequantization matrix has to be folded into the MVP
+/// * the viewport and scissor are dynamic, so the pipeline outlives swapchain
+/// resizes
+/// --- CLEANUP ---
+/// * call delete_Pipeline
 ErrVal new_VertexDisplayPipeline(VkPipeline *pVertexDisplayPipeline,
                                  const VkDevice device,
+                                 const VkPipelineCache pipelineCache,
                                  const VkShaderModule vertShaderModule,
                                  const VkShaderModule fragShaderModule,
-                                 const VkExtent2D extent,
                                  const VkRenderPass renderPass,
-                                 const VkPipelineLayout pipelineLayout);
+                                 const VkPipelineLayout pipelineLayout,
+                                 const ShaderInterface *pInterface,
+                                 const VertexFormat vertexFormat);
+
+/// Creates a variant of the vertex display pipeline that also reads an
+/// InstanceTransform per instance from binding 1, at locations 2 to 4
+/// --- PRECONDITIONS ---
+/// * as for new_VertexDisplayPipeline
+/// --- POSTCONDITIONS ---
+/// * returns error status
+/// * the MVP push constant is applied after the instance transform
+/// --- CLEANUP ---
+/// * call delete_Pipeline
+ErrVal new_InstancedVertexDisplayPipeline(
+    VkPipeline *pVertexDisplayPipeline, const VkDevice device,
+    const VkPipelineCache pipelineCache, const VkShaderModule vertShaderModule,
+    const VkShaderModule fragShaderModule, const VkRenderPass renderPass,
+    const VkPipelineLayout pipelineLayout, const ShaderInterface *pInterface,
+    const VertexFormat vertexFormat);
+
+/// Creates the vertex display pipeline, instanced or not, with the shader
+/// stages specialized by `pVertSpecialization` and `pFragSpecialization`
+/// --- PRECONDITIONS ---
+/// * as for new_VertexDisplayPipeline
+/// * the specialization infos are NULL or set constants the shaders declare
+/// --- POSTCONDITIONS ---
+/// * returns error status
+/// * safe to call from several threads sharing `pipelineCache`
+/// --- CLEANUP ---
+/// * call delete_Pipeline
+ErrVal new_SpecializedVertexDisplayPipeline(
+    VkPipeline *pVertexDisplayPipeline, const VkDevice device,
+    const VkPipelineCache pipelineCache, const VkShaderModule vertShaderModule,
+    const VkShaderModule fragShaderModule, const VkRenderPass renderPass,
+    const VkPipelineLayout pipelineLayout, const ShaderInterface *pInterface,
+    const VertexFormat vertexFormat, const bool instanced,
+    const VkSpecializationInfo *pVertSpecialization,
+    const VkSpecializationInfo *pFragSpecialization);
 
 void delete_Pipeline(VkPipeline *pPipeline, const VkDevice device);
 
@@ -393,21 +529,104 @@ void delete_CommandBuffers(            //
     const VkDevice device              //
 );
 
-ErrVal recordVertexDisplayCommandBuffer(                //
-    VkCommandBuffer commandBuffer,                      //
-    const VkFramebuffer swapchainFramebuffer,           //
-    const VkBuffer vertexBuffer,                        //
-    const uint32_t vertexCount,                         //
-    const VkRenderPass renderPass,                      //
-    const VkPipelineLayout vertexDisplayPipelineLayout, //
-    const VkPipeline vertexDisplayPipeline,             //
-    const VkExtent2D swapchainExtent,                   //
-    const mat4x4 cameraTransform,                       //
-    const VkClearColorValue clearColor                  //
-);
+/// Binds the pipeline and buffers of a vertex display draw, and sets its
+/// viewport, scissor and camera
+/// --- PRECONDITIONS ---
+/// * `commandBuffer` is inside a render pass `pipeline` is compatible with
+/// * `cameraDescriptorSet` is VK_NULL_HANDLE, and `cameraTransform` is pushed,
+/// unless `pipelineLayout` has the camera uniform buffer in set 0
+/// * `instanceBuffer` is VK_NULL_HANDLE unless `pipeline` is instanced
+void recordVertexDisplayBindings(VkCommandBuffer commandBuffer,
+                                 const VkPipelineLayout pipelineLayout,
+                                 const VkPipeline pipeline,
+                                 const VkExtent2D extent,
+                                 const mat4x4 cameraTransform,
+                                 const VkDescriptorSet cameraDescriptorSet,
+                                 const VkBuffer vertexBuffer,
+                                 const VkBuffer indexBuffer,
+                                 const VkBuffer instanceBuffer);
+
+// Everything recordVertexDisplayCommandBuffer draws one frame from
+typedef struct {
+  VkRenderPass renderPass;
+  VkFramebuffer framebuffer;
+  VkPipelineLayout pipelineLayout;
+  VkPipeline pipeline;
+  VkExtent2D extent;
+  VkClearColorValue clearColor;
+  VkBuffer vertexBuffer;
+  VkBuffer indexBuffer;
+  uint32_t indexCount;
+  VkBuffer instanceBuffer;
+  uint32_t instanceCount;
+  mat4x4 cameraTransform;
+  VkDescriptorSet cameraDescriptorSet;
+  // the frame is copied out of readbackImage unless readbackBuffer is unset
+  VkImage readbackImage;
+  VkBuffer readbackBuffer;
+  // each of these is optional, NULL leaves its step out of the frame
+  const GpuCuller *pCuller;
+  const CpuCuller *pCpuCuller;
+  GpuProfiler *pProfiler;
+  ParallelRecorder *pRecorder;
+} VertexDisplayFrame;
+
+/// Records the frame `pFrame` describes into `commandBuffer`
+/// --- PRECONDITIONS ---
+/// * `pTransferQueue` is NULL or a transfer queue whose uploads are consumed
+/// by the graphics queue family
+/// * `pFrame->instanceBuffer` is VK_NULL_HANDLE, or holds
+/// `pFrame->instanceCount` InstanceTransforms and `pFrame->pipeline` is
+/// instanced
+/// * `pFrame->pCuller` is NULL, or culls the objects in
+/// `pFrame->instanceBuffer` and beginGpuCullerFrame has been called for this
+/// frame
+/// * `pFrame->pCpuCuller` is NULL, or `pFrame->pCuller` is NULL and
+/// `pFrame->pCpuCuller` has culled the objects in `pFrame->instanceBuffer`
+/// against this frame's camera
+/// * `pFrame->pProfiler` is NULL, or beginGpuProfilerFrame has been called for
+/// this frame
+/// * `pFrame->pRecorder` is NULL, or `pFrame->pCuller` is NULL,
+/// `pFrame->instanceBuffer` is set and beginParallelRecorderFrame has been
+/// called for this frame
+/// * `pFrame->cameraDescriptorSet` is VK_NULL_HANDLE, or `pFrame->pProfiler`
+/// and `pFrame->pRecorder` are NULL and `pFrame->pipelineLayout` has the
+/// camera uniform buffer in set 0
+/// * `pFrame->readbackBuffer` is VK_NULL_HANDLE, or `pFrame->readbackImage` is
+/// the framebuffer's color image, left in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+/// by `pFrame->renderPass`, and `pFrame->readbackBuffer` fits all of its
+/// pixels
+/// --- POSTCONDITIONS ---
+/// * returns error status
+/// * `*pTransferWaitTicket` is set to the ticket the submit of
+/// `commandBuffer` has to wait on, see drawFrame
+/// * with a readback buffer, the frame is copied into it and made visible to
+/// the host once the submit's fence signals
+/// * with a profiler, the "frame", "cull" and "render pass" scopes are timed
+/// * with a recorder, each instance is drawn separately by its workers
+/// * with a CPU culler, only the instances that passed its cull are drawn
+/// * with a camera descriptor set, `pFrame->cameraTransform` is ignored and
+/// `commandBuffer` may be submitted again, as long as it records no transfer
+/// queue acquires
+/// * `pFrame` is not referenced after the call returns
+ErrVal recordVertexDisplayCommandBuffer(VkCommandBuffer commandBuffer,
+                                        TransferQueue *pTransferQueue,
+                                        TransferTicket *pTransferWaitTicket,
+                                        const VertexDisplayFrame *pFrame);
 
 ErrVal new_Semaphore(VkSemaphore *pSemaphore, const VkDevice device);
 
+/// Creates a new timeline semaphore
+/// --- PRECONDITIONS ---
+/// * `device` was created with the timelineSemaphore feature
+/// --- POSTCONDITIONS ---
+/// * returns error status
+/// * on success, `*pSemaphore` is a timeline semaphore at `initialValue`
+/// --- CLEANUP ---
+/// * call delete_Semaphore
+ErrVal new_TimelineSemaphore(VkSemaphore *pSemaphore, const VkDevice device,
+                             const uint64_t initialValue);
+
 void delete_Semaphore(VkSemaphore *pSemaphore, const VkDevice device);
 
 ErrVal new_Semaphores(VkSemaphore *pSemaphores, const uint32_t semaphoreCount,
@@ -420,6 +639,9 @@ ErrVal new_Fence(VkFence *pFence, const VkDevice device, const bool signaled);
 
 void delete_Fence(VkFence *pFence, const VkDevice device);
 
+/// Blocks until `fence` is signaled, leaving it signaled
+ErrVal waitForFence(VkFence fence, const VkDevice device);
+
 ErrVal waitAndResetFence(VkFence fence, const VkDevice device);
 
 ErrVal new_Fences(
@@ -439,15 +661,27 @@ ErrVal getNextSwapchainImage(           //
     VkSemaphore imageAvailableSemaphore //
 );
 
-ErrVal drawFrame(                        //
-    VkCommandBuffer commandBuffer,       //
-    VkSwapchainKHR swapchain,            //
-    const uint32_t swapchainImageIndex,  //
-    VkSemaphore imageAvailableSemaphore, //
-    VkSemaphore renderFinishedSemaphore, //
-    VkFence inFlightFence,               //
-    const VkQueue graphicsQueue,         //
-    const VkQueue presentQueue           //
+/// Submits `commandBuffer` and presents the swapchain image
+/// --- PRECONDITIONS ---
+/// * `pTransferQueue` is NULL or the transfer queue passed when recording
+/// `commandBuffer`
+/// --- POSTCONDITIONS ---
+/// * returns error status
+/// * if `transferWaitTicket` is not 0, the submit waits for it on the
+/// timeline of `pTransferQueue` before reading any uploads
+/// * if `swapchain` is VK_NULL_HANDLE, the frame is only submitted, and both
+/// semaphores are ignored
+ErrVal drawFrame(                             //
+    VkCommandBuffer commandBuffer,            //
+    VkSwapchainKHR swapchain,                 //
+    const uint32_t swapchainImageIndex,       //
+    VkSemaphore imageAvailableSemaphore,      //
+    VkSemaphore renderFinishedSemaphore,      //
+    VkFence inFlightFence,                    //
+    const TransferQueue *pTransferQueue,      //
+    const TransferTicket transferWaitTicket,  //
+    const VkQueue graphicsQueue,              //
+    const VkQueue presentQueue                //
 );
 
 ErrVal new_SurfaceFromGLFW(VkSurfaceKHR *pSurface, GLFWwindow *pWindow,
@@ -455,40 +689,78 @@ ErrVal new_SurfaceFromGLFW(VkSurfaceKHR *pSurface, GLFWwindow *pWindow,
 
 void delete_Surface(VkSurfaceKHR *pSurface, const VkInstance instance);
 
-ErrVal new_VertexBuffer(VkBuffer *pBuffer, VkDeviceMemory *pBufferMemory,
-                        const Vertex *pVertices, const uint32_t vertexCount,
-                        const VkDevice device,
-                        const VkPhysicalDevice physicalDevice,
-                        const VkCommandPool commandPool, const VkQueue queue);
+/// Creates a device local vertex buffer and stages the upload of
+/// `vertexDataSize` bytes of vertices from `pVertexData`
+/// --- PRECONDITIONS ---
+/// * `pTransferQueue` was created for `device`
+/// --- POSTCONDITIONS ---
+/// * returns error status
+/// * on success, the vertices are copied in by the next submitTransferQueue,
+/// and must not be drawn before a frame has acquired them
+/// --- CLEANUP ---
+/// * call delete_Buffer, then delete_DeviceMemory on the allocation
+ErrVal new_VertexBuffer(VkBuffer *pBuffer, DeviceAllocation *pBufferAllocation,
+                        const void *pVertexData,
+                        const VkDeviceSize vertexDataSize,
+                        const VkDevice device, DeviceAllocator *pAllocator,
+                        TransferQueue *pTransferQueue);
+
+/// Creates a device local index buffer and stages the upload of `pIndices`
+/// --- PRECONDITIONS ---
+/// * `pTransferQueue` was created for `device`
+/// --- POSTCONDITIONS ---
+/// * returns error status
+/// * on success, the buffer holds `indexCount` VK_INDEX_TYPE_UINT32 indices
+/// once the next submitTransferQueue has been acquired by a frame
+/// --- CLEANUP ---
+/// * call delete_Buffer, then delete_DeviceMemory on the allocation
+ErrVal new_IndexBuffer(VkBuffer *pBuffer, DeviceAllocation *pBufferAllocation,
+                       const uint32_t *pIndices, const uint32_t indexCount,
+                       const VkDevice device, DeviceAllocator *pAllocator,
+                       TransferQueue *pTransferQueue);
 
-ErrVal new_Buffer_DeviceMemory(VkBuffer *pBuffer, VkDeviceMemory *pBufferMemory,
+/// Creates a buffer and binds it to memory carved out of `pAllocator`
+/// --- PRECONDITIONS ---
+/// * `pBuffer` and `pBufferAllocation` are valid pointers
+/// * `pAllocator` was created for `device`
+/// --- POSTCONDITIONS ---
+/// * returns error status
+/// * on success, `*pBuffer` is bound to `*pBufferAllocation`
+/// * if `properties` includes VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+/// `pBufferAllocation->pMapped` stays mapped until the allocation is freed
+/// --- CLEANUP ---
+/// * call delete_Buffer, then delete_DeviceMemory on the allocation
+ErrVal new_Buffer_DeviceMemory(VkBuffer *pBuffer,
+                               DeviceAllocation *pBufferAllocation,
                                const VkDeviceSize size,
-                               const VkPhysicalDevice physicalDevice,
+                               DeviceAllocator *pAllocator,
                                const VkDevice device,
                                const VkBufferUsageFlags usage,
                                const VkMemoryPropertyFlags properties);
 
-ErrVal copyBuffer(VkBuffer destinationBuffer, const VkBuffer sourceBuffer,
-                  const VkDeviceSize size, const VkCommandPool commandPool,
-                  const VkQueue queue, const VkDevice device);
-
 void delete_Buffer(VkBuffer *pBuffer, const VkDevice device);
 
-void delete_DeviceMemory(VkDeviceMemory *pDeviceMemory, const VkDevice device);
+/// Returns the memory of a buffer or image to the allocator
+/// --- PRECONDITIONS ---
+/// * `pAllocation` came from new_Buffer_DeviceMemory or new_Image
+/// * the resource bound to it has already been deleted
+/// --- POSTCONDITIONS ---
+/// * `*pAllocation` is no longer valid
+void delete_DeviceMemory(DeviceAllocation *pAllocation,
+                         DeviceAllocator *pAllocator);
 
-ErrVal copyToDeviceMemory(VkDeviceMemory *pDeviceMemory,
+ErrVal copyToDeviceMemory(const DeviceAllocation *pAllocation,
                           const VkDeviceSize deviceSize, const void *source,
-                          const VkDevice device);
+                          const DeviceAllocator *pAllocator);
 
 void getDepthFormat(VkFormat *pFormat);
 
 ErrVal new_DepthImageView(VkImageView *pImageView, const VkDevice device,
                           const VkImage depthImage);
 
-ErrVal new_DepthImage(VkImage *pImage, VkDeviceMemory *pImageMemory,
+ErrVal new_DepthImage(VkImage *pImage, DeviceAllocation *pImageAllocation,
                       const VkExtent2D swapchainExtent,
-                      const VkPhysicalDevice physicalDevice,
-                      const VkDevice device);
+                      DeviceAllocator *pAllocator, const VkDevice device);
 
 ErrVal getMemoryTypeIndex(uint32_t *memoryTypeIndex,
                           const uint32_t memoryTypeBits,
@@ -498,10 +770,25 @@ ErrVal getMemoryTypeIndex(uint32_t *memoryTypeIndex,
 ErrVal new_ComputePipeline(VkPipeline *pPipeline,
                            const VkPipelineLayout pipelineLayout,
                            const VkShaderModule shaderModule,
+                           const VkPipelineCache pipelineCache,
                            const VkDevice device);
 
+/// Creates a pipeline layout with one descriptor set and `pushConstantSize`
+/// bytes of push constants, both visible to the compute stage
+/// --- POSTCONDITIONS ---
+/// * returns error status
+/// --- CLEANUP ---
+/// * call delete_PipelineLayout
+ErrVal new_ComputePipelineLayout(
+    VkPipelineLayout *pPipelineLayout,
+    const VkDescriptorSetLayout descriptorSetLayout,
+    const uint32_t pushConstantSize, const VkDevice device);
+
+/// Creates a layout of `bindingCount` storage buffers, at bindings 0 through
+/// `bindingCount` - 1
 ErrVal new_ComputeStorageDescriptorSetLayout(
-    VkDescriptorSetLayout *pDescriptorSetLayout, const VkDevice device);
+    VkDescriptorSetLayout *pDescriptorSetLayout, const uint32_t bindingCount,
+    const VkDevice device);
 
 void delete_DescriptorSetLayout(VkDescriptorSetLayout *pDescriptorSetLayout,
                                 const VkDevice device);
@@ -513,9 +800,18 @@ ErrVal new_DescriptorPool(VkDescriptorPool *pDescriptorPool,
 void delete_DescriptorPool(VkDescriptorPool *pDescriptorPool,
                            const VkDevice device);
 
+/// Allocates a descriptor set from `descriptorPool` and binds the whole of
+/// `pComputeBuffers[i]` to binding i
 ErrVal new_ComputeBufferDescriptorSet(
-    VkDescriptorSet *pDescriptorSet, const VkBuffer computeBufferDescriptorSet,
-    const VkDeviceSize computeBufferSize,
+    VkDescriptorSet *pDescriptorSet, const uint32_t bufferCount,
+    const VkBuffer *pComputeBuffers,
+    const VkDescriptorSetLayout descriptorSetLayout,
+    const VkDescriptorPool descriptorPool, const VkDevice device);
+
+/// Allocates a descriptor set from `descriptorPool` and binds the whole of
+/// `uniformBuffer` to binding 0
+ErrVal new_UniformBufferDescriptorSet(
+    VkDescriptorSet *pDescriptorSet, const VkBuffer uniformBuffer,
     const VkDescriptorSetLayout descriptorSetLayout,
     const VkDescriptorPool descriptorPool, const VkDevice device);
 